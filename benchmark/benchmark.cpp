@@ -0,0 +1,496 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <type_traits>
+
+#include "mos6502.h"
+#include "workloads.h"
+#include "checks.h"
+
+using namespace mos6502;
+using namespace mos6502::bench;
+
+namespace {
+	// Which CPU configurations to measure (see README)
+	struct Options {
+		bool classic = true;
+		bool mapped = true;
+		bool flat = true;
+
+		// Measure with the CPU block cache enabled (see BasicCPU::SetBlockCache)
+		bool blockCache = false;
+
+		// Measure the flat CPU with the JIT compiler enabled (see BasicCPU::SetJit),
+		// the others with the block cache
+		bool jit = false;
+
+		bool micro = true;
+		double minSeconds = 0.25;
+		std::string filter;
+
+		std::string dormannPath;
+		word dormannSuccess = 0x3469;
+
+		std::string jsonPath;
+
+		// Results saved earlier with --json, to compare the throughput against
+		std::string baselinePath;
+		double thresholdPercent = 10.0;
+
+		// Run the correctness checks (see checks.h) instead of the workloads
+		bool check = false;
+	};
+
+	enum class Verdict {
+		NONE,		// Nothing to verify
+		PASS,
+		FAIL,
+	};
+
+	struct Result {
+		std::string workload, group, cpu;
+		uint64_t iterations = 0;
+		uint64_t instructions = 0;
+		uint64_t cycles = 0;
+		double seconds = 0.0;
+		Verdict verdict = Verdict::NONE;
+		std::string detail;
+
+		// Emulated clock speed in MHz
+		double EmulatedMHz() const { return seconds > 0 ? cycles / seconds / 1e6 : 0.0; }
+
+		// Host time spent per emulated instruction
+		double NanosPerInstruction() const { return instructions > 0 ? seconds * 1e9 / instructions : 0.0; }
+
+		double InstructionsPerSecond() const { return seconds > 0 ? instructions / seconds : 0.0; }
+	};
+
+	const char* VerdictName(const Verdict v) {
+		switch (v) {
+		case Verdict::PASS: return "pass";
+		case Verdict::FAIL: return "FAIL";
+		default: return "-";
+		}
+	}
+
+	// Compares the state left behind by one run against the expectations
+	Verdict Verify(Memory& memory, const Workload& w, const bool trapped, const word trapAddress, std::string& outDetail) {
+		std::ostringstream ss;
+
+		if (w.end == WorkloadEnd::TRAP) {
+			if (!trapped) {
+				outDetail = "did not finish within the cycle limit";
+				return Verdict::FAIL;
+			}
+
+			ss << "trapped at $" << address(trapAddress);
+			outDetail = ss.str();
+			return trapAddress == w.successTrap ? Verdict::PASS : Verdict::FAIL;
+		}
+
+		if (w.expected.empty())
+			return Verdict::NONE;
+
+		bool match = true;
+		ss << "$" << address(w.resultAddress) << " =";
+		for (size_t i = 0; i < w.expected.size(); i++) {
+			const byte value = memory.ReadByte(static_cast<word>(w.resultAddress + i));
+			ss << " " << Hex(value);
+			match = match && value == w.expected[i];
+		}
+		outDetail = ss.str();
+		return match ? Verdict::PASS : Verdict::FAIL;
+	}
+
+	// Runs the workload repeatedly on a fresh copy of memory until at least
+	// minSeconds of host time has been spent executing it.
+	template<class CPUType>
+	Result Measure(const char* cpuName, std::shared_ptr<typename CPUType::bus_type> bus, std::shared_ptr<Memory> memory, const Workload& w, const Options& opt) {
+		using Clock = std::chrono::steady_clock;
+
+		// Trapping workloads are run in slices, checking for the trap in between
+		const uint64_t slice = w.end == WorkloadEnd::TRAP ? 1'000'000 : w.cycleLimit;
+
+		Result res;
+		res.workload = w.name;
+		res.group = w.group;
+		res.cpu = cpuName;
+
+		CPUType cpu(bus);
+		cpu.SetBlockCache(opt.blockCache || opt.jit);
+		if constexpr (std::is_same_v<CPUType, FlatCPU>) {
+			if (opt.jit && cpu.SetJit(true))
+				res.cpu += "+jit";
+		}
+		if (cpu.IsBlockCache() && !cpu.IsJit())
+			res.cpu += "+cache";
+
+		do {
+			LoadWorkload(*memory, w);
+			cpu.Reset();
+
+			// Reloading the program starts the cache over, rather than
+			// counting as rewritten code
+			cpu.FlushBlockCache();
+
+			bool trapped = false;
+			word trapAddress = 0;
+			uint64_t cycles = 0;
+			const uint64_t startInstructions = cpu.GetInstructionsExecuted();
+
+			const auto start = Clock::now();
+			while (cycles < w.cycleLimit) {
+				cycles += cpu.Run(std::min(slice, w.cycleLimit - cycles));
+
+				const auto reason = cpu.GetStopReason();
+				if (reason == CPUType::StopReason::BREAK || reason == CPUType::StopReason::ILLEGAL)
+					break;
+
+				if (w.end == WorkloadEnd::TRAP) {
+					trapAddress = cpu.GetProgramCounter();
+					cycles += cpu.Step();
+					if (cpu.GetProgramCounter() == trapAddress) {
+						trapped = true;
+						break;
+					}
+				}
+			}
+			const auto end = Clock::now();
+
+			res.iterations++;
+			res.cycles += cycles;
+			res.instructions += cpu.GetInstructionsExecuted() - startInstructions;
+			res.seconds += std::chrono::duration<double>(end - start).count();
+
+			// Only the first run is verified, the rest are identical
+			if (res.iterations == 1)
+				res.verdict = Verify(*memory, w, trapped, trapAddress, res.detail);
+		} while (res.seconds < opt.minSeconds);
+
+		return res;
+	}
+
+	void PrintHeader() {
+		std::cout << std::left
+			<< std::setw(22) << "workload"
+			<< std::setw(14) << "cpu"
+			<< std::right
+			<< std::setw(8) << "iters"
+			<< std::setw(14) << "instructions"
+			<< std::setw(10) << "MHz"
+			<< std::setw(10) << "ns/inst"
+			<< std::setw(10) << "MIPS"
+			<< "  " << "check"
+			<< std::endl;
+	}
+
+	void PrintResult(const Result& r) {
+		std::cout << std::left
+			<< std::setw(22) << r.workload
+			<< std::setw(14) << r.cpu
+			<< std::right << std::dec << std::fixed
+			<< std::setw(8) << r.iterations
+			<< std::setw(14) << r.instructions
+			<< std::setw(10) << std::setprecision(2) << r.EmulatedMHz()
+			<< std::setw(10) << std::setprecision(2) << r.NanosPerInstruction()
+			<< std::setw(10) << std::setprecision(2) << r.InstructionsPerSecond() / 1e6
+			<< "  " << VerdictName(r.verdict);
+		if (!r.detail.empty())
+			std::cout << " (" << r.detail << ")";
+		std::cout << std::endl;
+	}
+
+	// Escapes a string for use in JSON
+	std::string Quote(const std::string& s) {
+		std::ostringstream ss;
+		ss << '"';
+		for (const char c : s) {
+			switch (c) {
+			case '"': ss << "\\\""; break;
+			case '\\': ss << "\\\\"; break;
+			case '\n': ss << "\\n"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+					ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+				else
+					ss << c;
+			}
+		}
+		ss << '"';
+		return ss.str();
+	}
+
+	bool WriteJSON(const std::string& path, const std::vector<Result>& results) {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cerr << "failed to open \"" << path << "\" for writing" << std::endl;
+			return false;
+		}
+
+		file << std::setprecision(6) << std::fixed;
+		file << "{\n";
+		file << "  \"emulator\": \"mos6502\",\n";
+		file << "  \"timestamp\": " << static_cast<long long>(std::time(nullptr)) << ",\n";
+		file << "  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			file << "    {"
+				<< " \"workload\": " << Quote(r.workload) << ","
+				<< " \"group\": " << Quote(r.group) << ","
+				<< " \"cpu\": " << Quote(r.cpu) << ","
+				<< " \"iterations\": " << r.iterations << ","
+				<< " \"instructions\": " << r.instructions << ","
+				<< " \"cycles\": " << r.cycles << ","
+				<< " \"seconds\": " << r.seconds << ","
+				<< " \"emulated_mhz\": " << r.EmulatedMHz() << ","
+				<< " \"ns_per_instruction\": " << r.NanosPerInstruction() << ","
+				<< " \"instructions_per_second\": " << r.InstructionsPerSecond() << ","
+				<< " \"check\": " << Quote(VerdictName(r.verdict)) << ","
+				<< " \"detail\": " << Quote(r.detail)
+				<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n";
+		file << "}\n";
+		return true;
+	}
+
+	// Returns the value of the field in a line of the JSON written by
+	// WriteJSON(), which puts each result on a line of its own
+	std::optional<std::string> FindField(const std::string& line, const std::string& name) {
+		const std::string key = Quote(name) + ": ";
+		const size_t start = line.find(key);
+		if (start == std::string::npos)
+			return std::nullopt;
+
+		size_t pos = start + key.size();
+		std::string value;
+		if (pos < line.size() && line[pos] == '"') {
+			for (pos++; pos < line.size() && line[pos] != '"'; pos++) {
+				if (line[pos] == '\\' && pos + 1 < line.size())
+					pos++;
+				value += line[pos];
+			}
+		} else {
+			for (; pos < line.size() && line[pos] != ',' && line[pos] != ' ' && line[pos] != '}'; pos++)
+				value += line[pos];
+		}
+		return value;
+	}
+
+	// Reads the instructions per second of each workload and CPU out of
+	// results written by WriteJSON()
+	bool ReadBaseline(const std::string& path, std::map<std::string, double>& outThroughput) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			std::cerr << "failed to open the baseline \"" << path << "\", write one with --json" << std::endl;
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(file, line)) {
+			const auto workload = FindField(line, "workload");
+			const auto cpu = FindField(line, "cpu");
+			const auto throughput = FindField(line, "instructions_per_second");
+			if (workload && cpu && throughput)
+				outThroughput[*workload + " " + *cpu] = std::stod(*throughput);
+		}
+		return true;
+	}
+
+	// Compares the throughput of the results against the baseline. Returns
+	// false if, taken together (as a geometric mean), they have dropped by
+	// more than the threshold, or nothing could be compared.
+	bool CompareBaseline(const std::vector<Result>& results, const std::map<std::string, double>& baseline, const double thresholdPercent) {
+		std::cout << std::endl;
+		std::cout << "Against the baseline" << std::endl;
+		std::cout << "====================" << std::endl;
+
+		const double limit = 1.0 - thresholdPercent / 100.0;
+		double logSum = 0.0;
+		size_t compared = 0;
+		for (const Result& r : results) {
+			const auto itr = baseline.find(r.workload + " " + r.cpu);
+			if (itr == baseline.end() || itr->second <= 0 || r.InstructionsPerSecond() <= 0)
+				continue;
+
+			const double ratio = r.InstructionsPerSecond() / itr->second;
+			logSum += std::log(ratio);
+			compared++;
+
+			std::cout << std::left
+				<< std::setw(22) << r.workload
+				<< std::setw(14) << r.cpu
+				<< std::right << std::fixed
+				<< std::setw(9) << std::setprecision(1) << (ratio - 1.0) * 100.0 << "%"
+				<< (ratio < limit ? "  slower" : "")
+				<< std::endl;
+		}
+
+		if (compared == 0) {
+			std::cerr << "no results match the baseline" << std::endl;
+			return false;
+		}
+
+		const double overall = std::exp(logSum / compared);
+		std::cout << "Throughput is " << std::setprecision(1) << overall * 100.0 << "% of the baseline over "
+			<< compared << " results, the threshold is " << limit * 100.0 << "%" << std::endl;
+		return overall >= limit;
+	}
+
+	// Runs every correctness check, printing how each went. Returns false
+	// if any failed.
+	bool RunChecks() {
+		std::cout << "MOS-6502 Checks" << std::endl;
+		std::cout << "===============" << std::endl;
+
+		bool ok = true;
+		for (const CheckResult& r : { CheckDecimal(), CheckWide(8), CheckWide(16), CheckLockstep(false), CheckLockstep(true) }) {
+			std::cout << std::left << std::setw(22) << r.name
+				<< std::right << std::dec << std::setw(14) << r.cases << " cases  "
+				<< (r.Passed() ? "pass" : "FAIL");
+			if (r.failures > 0)
+				std::cout << " (" << r.failures << " failed, first " << r.detail << ")";
+			std::cout << std::endl;
+			ok = ok && r.Passed();
+		}
+		return ok;
+	}
+
+	void PrintUsage(const char* program) {
+		std::cout << "Usage: " << program << " [options]" << std::endl;
+		std::cout << "\t--cpu <classic|mapped|flat|all>  CPU configuration to measure (default all)" << std::endl;
+		std::cout << "\t--block-cache                    Enable the CPU block cache" << std::endl;
+		std::cout << "\t--jit                            Enable the JIT compiler (flat only, the block cache elsewhere)" << std::endl;
+		std::cout << "\t--min-time <seconds>             Minimum time spent on each workload (default 0.25)" << std::endl;
+		std::cout << "\t--filter <text>                  Only run workloads whose name contains the text" << std::endl;
+		std::cout << "\t--no-micro                       Skip the addressing mode and opcode family kernels" << std::endl;
+		std::cout << "\t--dormann <file>                 Also run Klaus Dormann's functional test binary" << std::endl;
+		std::cout << "\t--dormann-success <hex>          Trap address of a passing functional test (default 3469)" << std::endl;
+		std::cout << "\t--json <file>                    Write the results as JSON" << std::endl;
+		std::cout << "\t--baseline <file>                Fail if slower than results written by --json" << std::endl;
+		std::cout << "\t--threshold <percent>            Slowdown allowed against the baseline (default 10)" << std::endl;
+		std::cout << "\t--check                          Run the correctness checks instead, failing if any fails" << std::endl;
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& opt) {
+		for (int i = 1; i < argc; i++) {
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (arg == "--cpu" && hasValue) {
+				const std::string cpu = argv[++i];
+				opt.classic = cpu == "classic" || cpu == "all";
+				opt.mapped = cpu == "mapped" || cpu == "all";
+				opt.flat = cpu == "flat" || cpu == "all";
+				if (!opt.classic && !opt.mapped && !opt.flat) {
+					std::cerr << "unknown CPU configuration \"" << cpu << "\"" << std::endl;
+					return false;
+				}
+			} else if (arg == "--block-cache") {
+				opt.blockCache = true;
+			} else if (arg == "--jit") {
+				opt.jit = true;
+			} else if (arg == "--min-time" && hasValue) {
+				opt.minSeconds = std::stod(argv[++i]);
+			} else if (arg == "--filter" && hasValue) {
+				opt.filter = argv[++i];
+			} else if (arg == "--no-micro") {
+				opt.micro = false;
+			} else if (arg == "--dormann" && hasValue) {
+				opt.dormannPath = argv[++i];
+			} else if (arg == "--dormann-success" && hasValue) {
+				opt.dormannSuccess = static_cast<word>(std::stoul(argv[++i], nullptr, 16));
+			} else if (arg == "--json" && hasValue) {
+				opt.jsonPath = argv[++i];
+			} else if (arg == "--baseline" && hasValue) {
+				opt.baselinePath = argv[++i];
+			} else if (arg == "--threshold" && hasValue) {
+				opt.thresholdPercent = std::stod(argv[++i]);
+			} else if (arg == "--check") {
+				opt.check = true;
+			} else {
+				PrintUsage(argv[0]);
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv) {
+	Options opt;
+	if (!ParseOptions(argc, argv, opt))
+		return EXIT_FAILURE;
+
+	if (opt.check)
+		return RunChecks() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	// Read first, so a missing baseline fails before the long part
+	std::map<std::string, double> baseline;
+	if (!opt.baselinePath.empty() && !ReadBaseline(opt.baselinePath, baseline))
+		return EXIT_FAILURE;
+
+	std::vector<Workload> workloads = MakeProgramWorkloads();
+	if (!opt.dormannPath.empty()) {
+		auto dormann = LoadDormannWorkload(opt.dormannPath, opt.dormannSuccess);
+		if (!dormann)
+			return EXIT_FAILURE;
+		workloads.push_back(dormann.value());
+	}
+	if (opt.micro) {
+		for (auto& w : MakeAddressingWorkloads())
+			workloads.push_back(w);
+		for (auto& w : MakeFamilyWorkloads())
+			workloads.push_back(w);
+	}
+
+	std::cout << "MOS-6502 Benchmark" << std::endl;
+	std::cout << "==================" << std::endl;
+	PrintHeader();
+
+	// All configurations share the one memory, reloaded before every run
+	auto memory = std::make_shared<Memory>(MAKE_KB(64));
+
+	std::vector<Result> results;
+	for (const Workload& w : workloads) {
+		if (!opt.filter.empty() && w.name.find(opt.filter) == std::string::npos)
+			continue;
+
+		if (opt.classic)
+			results.push_back(Measure<CPU>("classic", Bus::Make(memory), memory, w, opt));
+		if (opt.mapped)
+			results.push_back(Measure<MappedCPU>("mapped", std::make_shared<Bus>(memory), memory, w, opt));
+		if (opt.flat)
+			results.push_back(Measure<FlatCPU>("flat", FlatMemoryBus::Make(memory), memory, w, opt));
+
+		for (auto itr = results.end() - (opt.classic + opt.mapped + opt.flat); itr != results.end(); itr++)
+			PrintResult(*itr);
+	}
+
+	if (!opt.jsonPath.empty() && !WriteJSON(opt.jsonPath, results))
+		return EXIT_FAILURE;
+
+	if (!opt.baselinePath.empty() && !CompareBaseline(results, baseline, opt.thresholdPercent))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
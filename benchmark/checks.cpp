@@ -0,0 +1,353 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "checks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mos6502.h"
+#include "decimal.h"
+#include "lockstep.h"
+#include "wide_cpu.h"
+#include "workloads.h"
+
+namespace mos6502 {
+namespace bench {
+
+	namespace {
+		// The flags of a model result, in their Processor Status positions
+		constexpr byte MODEL_FLAGS = 0xC3;
+
+		// A result of the model, the accumulator low and the flags high, as
+		// the decimal tables pack them
+		word PackModel(const int acc, const bool c, const bool z, const bool v, const bool n) {
+			const int flags = (c ? 0x01 : 0) | (z ? 0x02 : 0) | (v ? 0x40 : 0) | (n ? 0x80 : 0);
+			return static_cast<word>((flags << 8) | (acc & 0xFF));
+		}
+
+		// Decimal ADC on the NMOS 6502, a digit at a time with the carry
+		// between them, as MAME's m6502 core does it. Z is taken from the
+		// binary sum, and N and V from the high digit before it is corrected.
+		word ModelAdd(const byte a, const byte b, const bool carry) {
+			int low = (a & 0x0F) + (b & 0x0F) + (carry ? 1 : 0);
+			if (low > 9)
+				low += 6;
+			int high = (a >> 4) + (b >> 4) + (low > 0x0F ? 1 : 0);
+
+			const bool z = ((a + b + (carry ? 1 : 0)) & 0xFF) == 0;
+			const bool n = !z && (high & 0x08);
+			const bool v = ~(a ^ b) & (a ^ (high << 4)) & 0x80;
+
+			if (high > 9)
+				high += 6;
+			return PackModel(((high & 0x0F) << 4) | (low & 0x0F), high > 0x0F, z, v, n);
+		}
+
+		// Decimal SBC on the NMOS 6502, the flags all being those of the
+		// binary subtraction
+		word ModelSubtract(const byte a, const byte b, const bool carry) {
+			const int borrow = carry ? 0 : 1;
+			const int binary = a - b - borrow;
+
+			int low = (a & 0x0F) - (b & 0x0F) - borrow;
+			if (low < 0)
+				low -= 6;
+			int high = (a >> 4) - (b >> 4) - (low < 0 ? 1 : 0);
+			if (high < 0)
+				high -= 6;
+
+			const bool v = (a ^ b) & (a ^ binary) & 0x80;
+			return PackModel(((high & 0x0F) << 4) | (low & 0x0F), binary >= 0, (binary & 0xFF) == 0, v, binary & 0x80);
+		}
+
+		// Random programs are loaded here, and are this many instructions long
+		constexpr word PROGRAM_ORIGIN = 0x0400;
+		constexpr unsigned int PROGRAM_INSTRUCTIONS = 600;
+
+		// Random programs for the wide CPU, each run for a few budgets
+		constexpr unsigned int WIDE_PROGRAMS = 200;
+		constexpr unsigned int WIDE_RUNS = 3;
+
+		// Random programs run in lockstep, each for this many instructions,
+		// with an illegal opcode one instruction in LOCKSTEP_ILLEGAL_EVERY
+		constexpr unsigned int LOCKSTEP_PROGRAMS = 200;
+		constexpr uint64_t LOCKSTEP_PROGRAM_RUN = 20000;
+		constexpr unsigned int LOCKSTEP_ILLEGAL_EVERY = 50;
+
+		// The benchmark workloads run in lockstep up to their BRK, for at
+		// most this many instructions
+		constexpr uint64_t LOCKSTEP_WORKLOAD_RUN = 1000000;
+
+		// Makes a program of random instructions, with random operands, but
+		// for the jumps and calls, which mostly land within the program.
+		// BRK and RTI would end most programs too soon. Illegal opcodes are
+		// left out too, unless illegalEvery is not 0, when about one
+		// instruction in that many is one.
+		std::vector<byte> MakeRandomProgram(std::mt19937& rng, const unsigned int illegalEvery = 0) {
+			static const auto opcodes = [] {
+				std::pair<std::vector<byte>, std::vector<byte>> result;
+				for (int opcode = 0; opcode < 256; opcode++) {
+					const Instruction instruction = InstructionDetails[opcode].instruction;
+					if (instruction == Instruction::ILL)
+						result.second.push_back(static_cast<byte>(opcode));
+					else if (instruction != Instruction::BRK && instruction != Instruction::RTI)
+						result.first.push_back(static_cast<byte>(opcode));
+				}
+				return result;
+			}();
+			const std::vector<byte>& legal = opcodes.first;
+			const std::vector<byte>& illegal = opcodes.second;
+
+			std::vector<byte> program;
+			for (unsigned int i = 0; i < PROGRAM_INSTRUCTIONS; i++) {
+				const byte opcode = illegalEvery && rng() % illegalEvery == 0
+					? illegal[rng() % illegal.size()]
+					: legal[rng() % legal.size()];
+				const InstructionDetail& detail = InstructionDetails[opcode];
+				program.push_back(opcode);
+
+				if (detail.instruction == Instruction::JMP || detail.instruction == Instruction::JSR) {
+					const word target = static_cast<word>(PROGRAM_ORIGIN + rng() % (PROGRAM_INSTRUCTIONS * 2));
+					program.push_back(GET_LOW_BYTE(target));
+					program.push_back(GET_HIGH_BYTE(target));
+				} else {
+					for (int b = 1; b < detail.bytesUsed; b++)
+						program.push_back(static_cast<byte>(rng()));
+				}
+			}
+			return program;
+		}
+
+		template<size_t Lanes>
+		CheckResult CheckWideLanes() {
+			CheckResult res;
+			res.name = "wide." + std::to_string(Lanes);
+
+			std::mt19937 rng(6502 + Lanes);
+			auto wide = std::make_unique<WideCPU<Lanes>>();
+			std::vector<std::unique_ptr<System>> scalar;
+			for (size_t lane = 0; lane < Lanes; lane++)
+				scalar.push_back(std::make_unique<System>());
+
+			// The programs run into illegal opcodes, which the core reports on
+			// std::cerr, so that is silenced while they do
+			std::streambuf* const errors = std::cerr.rdbuf(nullptr);
+
+			for (unsigned int program = 0; program < WIDE_PROGRAMS; program++) {
+				const std::vector<byte> code = MakeRandomProgram(rng);
+				wide->Load(code, PROGRAM_ORIGIN, PROGRAM_ORIGIN);
+
+				// The lanes fall in three groups with zero pages of their own,
+				// so they both run together and split apart. Every third
+				// program, one lane is also interrupted.
+				for (size_t lane = 0; lane < Lanes; lane++) {
+					System& system = *scalar[lane];
+					system.Load(code, PROGRAM_ORIGIN, PROGRAM_ORIGIN);
+
+					std::mt19937 inputs(program * 3 + lane % 3);
+					for (word addr = 0; addr < 0x100; addr++) {
+						const byte value = static_cast<byte>(inputs());
+						wide->GetLane(lane).GetMemory().WriteByte(addr, value);
+						system.GetMemory().WriteByte(addr, value);
+					}
+
+					if (lane == Lanes / 2 && program % 3 == 0) {
+						wide->GetLane(lane).GetCPU().ScheduleIRQ(300);
+						system.GetCPU().ScheduleIRQ(300);
+					}
+				}
+
+				const uint64_t budget = 500 + rng() % 5000;
+				for (unsigned int run = 0; run < WIDE_RUNS; run++) {
+					wide->Run(budget);
+
+					for (size_t lane = 0; lane < Lanes; lane++) {
+						FlatCPU& expected = scalar[lane]->GetCPU();
+						FlatCPU& actual = wide->GetLane(lane).GetCPU();
+						const uint64_t consumed = expected.Run(budget);
+
+						const FlatCPU::State a = expected.Snapshot();
+						const FlatCPU::State b = actual.Snapshot();
+						const bool same = a.pc == b.pc && a.sp == b.sp && a.acc == b.acc && a.x == b.x && a.y == b.y
+							&& a.status.value == b.status.value
+							&& a.cyclesExecuted == b.cyclesExecuted && a.instructionsExecuted == b.instructionsExecuted
+							&& consumed == wide->GetCyclesConsumed(lane)
+							&& expected.GetStopReason() == wide->GetStopReason(lane)
+							&& std::memcmp(scalar[lane]->GetMemory().GetData(), wide->GetLane(lane).GetMemory().GetData(), MAKE_KB(64)) == 0;
+
+						res.cases++;
+						if (!same && res.failures++ == 0) {
+							std::ostringstream ss;
+							ss << "program " << program << " run " << run << " lane " << lane
+								<< ": the lane is at " << actual << ", a FlatCPU at " << expected;
+							res.detail = ss.str();
+						}
+					}
+				}
+			}
+
+			std::cerr.rdbuf(errors);
+			return res;
+		}
+
+		// The classic CPU as the reference, and a FlatCPU with the block
+		// cache (and the JIT compiler) under test, each with a memory of its own
+		struct LockstepPair {
+			std::shared_ptr<Memory> referenceMemory = std::make_shared<Memory>(MAKE_KB(64));
+			std::shared_ptr<Memory> testMemory = std::make_shared<Memory>(MAKE_KB(64));
+			CPU reference{ Bus::Make(referenceMemory) };
+			FlatCPU test{ FlatMemoryBus::Make(testMemory) };
+
+			LockstepPair(const bool jit) {
+				test.SetBlockCache(true);
+				if (jit)
+					test.SetJit(true);
+			}
+		};
+
+		// Runs the pair in lockstep for the instructions, from the reference's
+		// memory after a reset. Adds the instructions compared to the cases.
+		void RunLockstep(LockstepPair& pair, const std::string& name, const uint64_t instructions, const unsigned int interval, CheckResult& res) {
+			pair.reference.Reset();
+			Lockstep<FlatCPU> lockstep(pair.reference, *pair.referenceMemory, pair.test, *pair.testMemory);
+			lockstep.SetInterval(interval);
+			lockstep.Start(pair.reference.Snapshot(), pair.referenceMemory->Snapshot());
+
+			const std::optional<LockstepDivergence> divergence = lockstep.Run(instructions);
+			res.cases += lockstep.GetInstructionsCompared();
+			if (divergence && res.failures++ == 0) {
+				std::ostringstream ss;
+				ss << name << ":" << std::endl << *divergence;
+				res.detail = ss.str();
+			}
+		}
+
+		void Describe(std::string& outDetail, const char* what, const byte a, const byte b, const bool carry, const word got, const word expected) {
+			std::ostringstream ss;
+			ss << what << " $" << Hex(a) << " $" << Hex(b) << " carry " << carry
+				<< " gave $" << Hex(got) << ", the NMOS 6502 gives $" << Hex(expected);
+			outDetail = ss.str();
+		}
+	}
+
+	CheckResult CheckDecimal() {
+		CheckResult res;
+		res.name = "decimal";
+
+		// The CPU runs ADC # or SBC # at $0200 for each case
+		auto memory = std::make_shared<Memory>(MAKE_KB(64));
+		FlatCPU cpu(FlatMemoryBus::Make(memory));
+		constexpr word pc = 0x0200;
+
+		for (int subtract = 0; subtract < 2; subtract++) {
+			const auto& table = subtract ? DecimalSubtractTable : DecimalAddTable;
+			const char* name = subtract ? "SBC" : "ADC";
+			memory->WriteByte(pc, subtract ? 0xE9 : 0x69);
+
+			for (int carry = 0; carry < 2; carry++) {
+				for (int a = 0; a < 256; a++) {
+					for (int b = 0; b < 256; b++) {
+						const word expected = subtract ? ModelSubtract(a, b, carry) : ModelAdd(a, b, carry);
+						const word entry = table[DecimalIndex(a, b, carry)];
+
+						memory->WriteByte(pc + 1, static_cast<byte>(b));
+						cpu.Restore(FlatCPU::State{
+							pc, 0xFD, static_cast<byte>(a), 0, 0, FlatCPU::Status(0x28 | carry),
+							0, 0, 0, false, false
+						});
+						cpu.Step();
+						const word executed = static_cast<word>(((cpu.GetStatus().value & MODEL_FLAGS) << 8) | cpu.GetAccumulator());
+
+						res.cases += 2;
+						if (entry != expected) {
+							if (res.failures++ == 0)
+								Describe(res.detail, subtract ? "table SBC" : "table ADC", a, b, carry, entry, expected);
+						}
+						if (executed != expected) {
+							if (res.failures++ == 0)
+								Describe(res.detail, name, a, b, carry, executed, expected);
+						}
+					}
+				}
+			}
+		}
+
+		return res;
+	}
+
+	CheckResult CheckWide(const size_t lanes) {
+		return lanes == 16 ? CheckWideLanes<16>() : CheckWideLanes<8>();
+	}
+
+	CheckResult CheckLockstep(const bool jit) {
+		CheckResult res;
+		res.name = jit ? "lockstep.jit" : "lockstep.cache";
+
+		LockstepPair pair(jit);
+		std::mt19937 rng(jit ? 6503 : 6502);
+
+		// Random programs running into illegal opcodes, which the core
+		// reports on std::cerr, so that is silenced while they run
+		std::streambuf* const errors = std::cerr.rdbuf(nullptr);
+
+		for (unsigned int program = 0; program < LOCKSTEP_PROGRAMS; program++) {
+			Memory& memory = *pair.referenceMemory;
+			memory.Clear();
+			memory.WriteBytes(PROGRAM_ORIGIN, MakeRandomProgram(rng, LOCKSTEP_ILLEGAL_EVERY));
+			for (word addr = 0; addr < 0x100; addr++)
+				memory.WriteByte(addr, static_cast<byte>(rng()));
+			memory.WriteWord(ADDRESS_RESET_VECTOR, PROGRAM_ORIGIN);
+
+			const unsigned int interval = 1 + rng() % 200;
+			RunLockstep(pair, "program " + std::to_string(program), LOCKSTEP_PROGRAM_RUN, interval, res);
+		}
+
+		std::cerr.rdbuf(errors);
+
+		// The workloads the benchmark measures, from start to finish
+		std::vector<Workload> workloads = MakeProgramWorkloads();
+		for (auto& w : MakeAddressingWorkloads())
+			workloads.push_back(w);
+		for (auto& w : MakeFamilyWorkloads())
+			workloads.push_back(w);
+
+		// Each is run on a CPU of its own first, to count the instructions up
+		// to and including the BRK it ends with. Past that, it would run into
+		// whatever the BRK vector points at.
+		auto memory = std::make_shared<Memory>(MAKE_KB(64));
+		CPU counter(Bus::Make(memory));
+		for (const Workload& w : workloads) {
+			LoadWorkload(*memory, w);
+			counter.Reset();
+			const uint64_t start = counter.GetInstructionsExecuted();
+			counter.Run(w.cycleLimit);
+			if (counter.GetStopReason() != CPU::StopReason::BREAK) {
+				if (res.failures++ == 0)
+					res.detail = w.name + ": did not reach its BRK on the classic CPU";
+				continue;
+			}
+
+			LoadWorkload(*pair.referenceMemory, w);
+			const uint64_t instructions = std::min(counter.GetInstructionsExecuted() - start, LOCKSTEP_WORKLOAD_RUN);
+			RunLockstep(pair, w.name, instructions, 1000, res);
+		}
+
+		return res;
+	}
+
+}
+}
@@ -0,0 +1,53 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+namespace mos6502 {
+namespace bench {
+
+	// The outcome of one of the correctness checks run with --check. These
+	// cover the parts of the core that are only worth their speed if they
+	// are exact, against a model or a core they must agree with.
+	struct CheckResult {
+		std::string name;
+
+		// Cases compared, and those that failed
+		uint64_t cases = 0;
+		uint64_t failures = 0;
+
+		// The first failure, if there was one
+		std::string detail;
+
+		bool Passed() const { return cases > 0 && failures == 0; }
+	};
+
+	// Compares every entry of DecimalAddTable and DecimalSubtractTable, and
+	// what ADC and SBC do on a FlatCPU in decimal mode for every operand
+	// and carry, against a model of the NMOS 6502 kept apart from decimal.h
+	CheckResult CheckDecimal();
+
+	// Runs random programs on a WideCPU of 8 or 16 lanes, the lanes given
+	// inputs that make some of them take different paths, and compares every
+	// lane after each Run() against a FlatCPU of its own run from the same
+	// start: the registers, cycle counts, stop reason and the whole memory
+	CheckResult CheckWide(const size_t lanes);
+
+	// Runs random programs, a few of their instructions illegal, and then
+	// every benchmark workload on a FlatCPU with the block cache, and also
+	// the JIT compiler if jit is set, in Lockstep with the classic CPU. The
+	// cases are the instructions they agreed on.
+	CheckResult CheckLockstep(const bool jit);
+
+}
+}
@@ -0,0 +1,451 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "workloads.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+
+#include "instructions.h"
+#include "memory.h"
+#include "utils.h"
+
+namespace mos6502 {
+namespace bench {
+
+	namespace {
+		// Where the programs and kernels are loaded
+		constexpr word CODE_ORIGIN = 0x0600;
+
+		// Sieve of Eratosthenes over 8192 byte flags at $2000-$3FFF.
+		// Counts the primes below 8192 into $26/$27, which should be 1028.
+		const std::vector<byte> SieveProgram = {
+			0xA9, 0x00,         // $0600          LDA #$00
+			0x85, 0x12,         // $0602          STA $12
+			0xA9, 0x20,         // $0604          LDA #$20
+			0x85, 0x13,         // $0606          STA $13     ; ($12) = $2000
+			0xA0, 0x00,         // $0608          LDY #$00
+			0xA2, 0x20,         // $060A          LDX #$20    ; 32 pages of flags
+			0xA9, 0x00,         // $060C          LDA #$00
+			0x91, 0x12,         // $060E  clear:  STA ($12),Y
+			0xC8,               // $0610          INY
+			0xD0, 0xFB,         // $0611          BNE clear
+			0xE6, 0x13,         // $0613          INC $13
+			0xCA,               // $0615          DEX
+			0xD0, 0xF6,         // $0616          BNE clear
+			0x85, 0x26,         // $0618          STA $26     ; count = 0
+			0x85, 0x27,         // $061A          STA $27
+			0xA9, 0x02,         // $061C          LDA #$02
+			0x85, 0x10,         // $061E          STA $10     ; i = 2
+			0xA9, 0x00,         // $0620          LDA #$00
+			0x85, 0x11,         // $0622          STA $11
+			0xA5, 0x10,         // $0624  outer:  LDA $10
+			0x85, 0x12,         // $0626          STA $12     ; ($12) = $2000 + i
+			0xA5, 0x11,         // $0628          LDA $11
+			0x18,               // $062A          CLC
+			0x69, 0x20,         // $062B          ADC #$20
+			0x85, 0x13,         // $062D          STA $13
+			0xB1, 0x12,         // $062F          LDA ($12),Y
+			0xD0, 0x1E,         // $0631          BNE next    ; i is not prime
+			0xE6, 0x26,         // $0633          INC $26     ; count++
+			0xD0, 0x02,         // $0635          BNE mark
+			0xE6, 0x27,         // $0637          INC $27
+			0x18,               // $0639  mark:   CLC
+			0xA5, 0x12,         // $063A          LDA $12     ; ($12) += i
+			0x65, 0x10,         // $063C          ADC $10
+			0x85, 0x12,         // $063E          STA $12
+			0xA5, 0x13,         // $0640          LDA $13
+			0x65, 0x11,         // $0642          ADC $11
+			0x85, 0x13,         // $0644          STA $13
+			0xC9, 0x40,         // $0646          CMP #$40    ; past $3FFF?
+			0xB0, 0x07,         // $0648          BCS next
+			0xA9, 0x01,         // $064A          LDA #$01
+			0x91, 0x12,         // $064C          STA ($12),Y ; flag the multiple
+			0x4C, 0x39, 0x06,   // $064E          JMP mark
+			0xE6, 0x10,         // $0651  next:   INC $10     ; i++
+			0xD0, 0x02,         // $0653          BNE check
+			0xE6, 0x11,         // $0655          INC $11
+			0xA5, 0x11,         // $0657  check:  LDA $11
+			0xC9, 0x20,         // $0659          CMP #$20    ; i < 8192?
+			0x90, 0xC7,         // $065B          BCC outer
+			0x00,               // $065D          BRK
+		};
+
+		// CRC-32 (MSB first, polynomial $04C11DB7, as used by BZIP2) of 1KB at
+		// $1000, which is first filled with (offset + page) & $FF.
+		// The result is stored big-endian at $20-$23, and should be $944FFA2F.
+		const std::vector<byte> CRC32Program = {
+			0xA9, 0x00,         // $0600          LDA #$00
+			0x85, 0x12,         // $0602          STA $12
+			0xA9, 0x10,         // $0604          LDA #$10
+			0x85, 0x13,         // $0606          STA $13     ; ($12) = $1000
+			0xA2, 0x04,         // $0608          LDX #$04    ; 4 pages
+			0xA0, 0x00,         // $060A          LDY #$00
+			0x98,               // $060C  fill:   TYA
+			0x18,               // $060D          CLC
+			0x65, 0x13,         // $060E          ADC $13
+			0x91, 0x12,         // $0610          STA ($12),Y
+			0xC8,               // $0612          INY
+			0xD0, 0xF7,         // $0613          BNE fill
+			0xE6, 0x13,         // $0615          INC $13
+			0xCA,               // $0617          DEX
+			0xD0, 0xF2,         // $0618          BNE fill
+			0xA9, 0xFF,         // $061A          LDA #$FF    ; crc = $FFFFFFFF
+			0x85, 0x20,         // $061C          STA $20
+			0x85, 0x21,         // $061E          STA $21
+			0x85, 0x22,         // $0620          STA $22
+			0x85, 0x23,         // $0622          STA $23
+			0xA9, 0x10,         // $0624          LDA #$10
+			0x85, 0x13,         // $0626          STA $13
+			0xA9, 0x04,         // $0628          LDA #$04
+			0x85, 0x14,         // $062A          STA $14
+			0xB1, 0x12,         // $062C  byte:   LDA ($12),Y
+			0x45, 0x20,         // $062E          EOR $20     ; crc ^= data << 24
+			0x85, 0x20,         // $0630          STA $20
+			0xA2, 0x08,         // $0632          LDX #$08
+			0xA5, 0x23,         // $0634  bit:    LDA $23     ; crc <<= 1
+			0x0A,               // $0636          ASL A
+			0x85, 0x23,         // $0637          STA $23
+			0xA5, 0x22,         // $0639          LDA $22
+			0x2A,               // $063B          ROL A
+			0x85, 0x22,         // $063C          STA $22
+			0xA5, 0x21,         // $063E          LDA $21
+			0x2A,               // $0640          ROL A
+			0x85, 0x21,         // $0641          STA $21
+			0xA5, 0x20,         // $0643          LDA $20
+			0x2A,               // $0645          ROL A
+			0x85, 0x20,         // $0646          STA $20
+			0x90, 0x16,         // $0648          BCC noxor
+			0x49, 0x04,         // $064A          EOR #$04    ; crc ^= $04C11DB7
+			0x85, 0x20,         // $064C          STA $20
+			0xA5, 0x21,         // $064E          LDA $21
+			0x49, 0xC1,         // $0650          EOR #$C1
+			0x85, 0x21,         // $0652          STA $21
+			0xA5, 0x22,         // $0654          LDA $22
+			0x49, 0x1D,         // $0656          EOR #$1D
+			0x85, 0x22,         // $0658          STA $22
+			0xA5, 0x23,         // $065A          LDA $23
+			0x49, 0xB7,         // $065C          EOR #$B7
+			0x85, 0x23,         // $065E          STA $23
+			0xCA,               // $0660  noxor:  DEX
+			0xD0, 0xD1,         // $0661          BNE bit
+			0xC8,               // $0663          INY
+			0xD0, 0xC6,         // $0664          BNE byte
+			0xE6, 0x13,         // $0666          INC $13
+			0xC6, 0x14,         // $0668          DEC $14
+			0xD0, 0xC0,         // $066A          BNE byte
+			0xA2, 0x03,         // $066C          LDX #$03
+			0xB5, 0x20,         // $066E  final:  LDA $20,X   ; crc ^= $FFFFFFFF
+			0x49, 0xFF,         // $0670          EOR #$FF
+			0x95, 0x20,         // $0672          STA $20,X
+			0xCA,               // $0674          DEX
+			0x10, 0xF7,         // $0675          BPL final
+			0x00,               // $0677          BRK
+		};
+
+		// Decimal mode stress, every pair of operands (including invalid BCD)
+		// through ADC and SBC, with the carry chained from one to the next.
+		// The results and N, V, Z, C flags are folded into $30 (ADC) and
+		// $31 (SBC). On an NMOS 6502 these are $34 and $03.
+		const std::vector<byte> DecimalProgram = {
+			0xF8,               // $0600          SED
+			0x18,               // $0601          CLC
+			0xA9, 0x00,         // $0602          LDA #$00
+			0x85, 0x30,         // $0604          STA $30
+			0x85, 0x31,         // $0606          STA $31
+			0xAA,               // $0608          TAX
+			0xA0, 0x00,         // $0609  outer:  LDY #$00
+			0x84, 0x32,         // $060B  inner:  STY $32
+			0x8A,               // $060D          TXA
+			0x65, 0x32,         // $060E          ADC $32
+			0x85, 0x33,         // $0610          STA $33
+			0x08,               // $0612          PHP
+			0x68,               // $0613          PLA
+			0x29, 0xC3,         // $0614          AND #$C3    ; N V Z C
+			0x45, 0x33,         // $0616          EOR $33
+			0x45, 0x30,         // $0618          EOR $30
+			0x85, 0x30,         // $061A          STA $30
+			0x8A,               // $061C          TXA
+			0xE5, 0x32,         // $061D          SBC $32
+			0x85, 0x33,         // $061F          STA $33
+			0x08,               // $0621          PHP
+			0x68,               // $0622          PLA
+			0x29, 0xC3,         // $0623          AND #$C3    ; N V Z C
+			0x45, 0x33,         // $0625          EOR $33
+			0x45, 0x31,         // $0627          EOR $31
+			0x85, 0x31,         // $0629          STA $31
+			0xC8,               // $062B          INY
+			0xD0, 0xDD,         // $062C          BNE inner
+			0xE8,               // $062E          INX
+			0xD0, 0xD8,         // $062F          BNE outer
+			0xD8,               // $0631          CLD
+			0x00,               // $0632          BRK
+		};
+
+		// Zero page locations used by the kernels
+		constexpr byte KERNEL_COUNTER_LOW = 0xF0;
+		constexpr byte KERNEL_COUNTER_HIGH = 0xF1;
+		constexpr byte KERNEL_POINTER_X = 0x10;	// ($10,X) with X = 0
+		constexpr byte KERNEL_POINTER_Y = 0x12;	// ($12),Y
+		constexpr byte KERNEL_ZERO_PAGE = 0x20;
+
+		// Absolute locations used by the kernels
+		constexpr word KERNEL_DATA = 0x0300;
+		constexpr word KERNEL_VECTORS = 0x0400;
+
+		// Number of times the kernel body is repeated per loop, and the number
+		// of loops (256 * KERNEL_LOOPS_HIGH).
+		constexpr fast_word KERNEL_REPEAT = 16;
+		constexpr byte KERNEL_LOOPS_HIGH = 16;
+
+		// How the operand of a kernel operation is resolved
+		enum class Operand : byte {
+			VALUE,		// The value given
+			NEXT,		// Address of the following instruction
+			VECTOR,		// A fresh vector pointing at the following instruction
+			SUBROUTINE,	// Address of a subroutine that returns straight away
+		};
+
+		struct Op {
+			Instruction instruction;
+			AddressMode addressing;
+			word value = 0;
+			Operand operand = Operand::VALUE;
+		};
+
+		struct KernelSpec {
+			const char* name;
+			const char* description;
+			std::vector<Op> setup;
+			std::vector<Op> body;
+		};
+
+		// Assembles kernels straight from the InstructionDetails table
+		class KernelBuilder {
+		public:
+			KernelBuilder(const word origin) : m_Origin(origin) {}
+
+			inline word Here() const { return static_cast<word>(m_Origin + m_Code.size()); }
+
+			// Emits a single instruction, returning the offset of its operand
+			size_t Emit(const Op& op) {
+				const InstructionDetail& detail = FindInstructionDetail(op.instruction, op.addressing);
+				if (detail.instruction == Instruction::ILL)
+					std::cerr << "mos6502::bench kernel uses an instruction and addressing mode pair that does not exist" << std::endl;
+
+				const word next = static_cast<word>(Here() + detail.bytesUsed);
+				word value = op.value;
+				switch (op.operand) {
+				case Operand::NEXT:
+					value = next;
+					break;
+				case Operand::VECTOR:
+					value = static_cast<word>(KERNEL_VECTORS + m_Vectors.size());
+					m_Vectors.push_back(GET_LOW_BYTE(next));
+					m_Vectors.push_back(GET_HIGH_BYTE(next));
+					break;
+				case Operand::SUBROUTINE:
+					m_SubroutineFixups.push_back(m_Code.size() + 1);
+					break;
+				default:
+					break;
+				}
+
+				m_Code.push_back(detail.opCode);
+				if (detail.bytesUsed > 1)
+					m_Code.push_back(GET_LOW_BYTE(value));
+				if (detail.bytesUsed > 2)
+					m_Code.push_back(GET_HIGH_BYTE(value));
+
+				return m_Code.size() - (detail.bytesUsed - 1);
+			}
+
+			// Points a two byte operand at the given address
+			void Patch(const size_t offset, const word value) {
+				m_Code[offset] = GET_LOW_BYTE(value);
+				m_Code[offset + 1] = GET_HIGH_BYTE(value);
+			}
+
+			Workload Build(const KernelSpec& spec, const std::string& group) {
+				for (const Op& op : spec.setup)
+					Emit(op);
+
+				Emit({ Instruction::LDA, AddressMode::IMM, KERNEL_LOOPS_HIGH });
+				Emit({ Instruction::STA, AddressMode::ZPG, KERNEL_COUNTER_HIGH });
+				Emit({ Instruction::LDA, AddressMode::IMM, 0 });
+				Emit({ Instruction::STA, AddressMode::ZPG, KERNEL_COUNTER_LOW });
+
+				// The repeated body, any loads leave Z clear for the branches
+				const word loop = Here();
+				for (fast_word i = 0; i < KERNEL_REPEAT; i++) {
+					for (const Op& op : spec.body)
+						Emit(op);
+				}
+
+				// Loop overhead, far enough apart that the loop uses JMP
+				Emit({ Instruction::DEC, AddressMode::ZPG, KERNEL_COUNTER_LOW });
+				Emit({ Instruction::BEQ, AddressMode::REL, 3 });
+				Emit({ Instruction::JMP, AddressMode::ABS, loop });
+				Emit({ Instruction::DEC, AddressMode::ZPG, KERNEL_COUNTER_HIGH });
+				Emit({ Instruction::BEQ, AddressMode::REL, 3 });
+				Emit({ Instruction::JMP, AddressMode::ABS, loop });
+				Emit({ Instruction::BRK, AddressMode::IMP });
+
+				// Subroutine that returns immediately
+				const word subroutine = Here();
+				Emit({ Instruction::RTS, AddressMode::IMP });
+				for (const size_t offset : m_SubroutineFixups)
+					Patch(offset, subroutine);
+
+				Workload w;
+				w.name = group + "." + spec.name;
+				w.group = group;
+				w.description = spec.description;
+				w.entry = m_Origin;
+				w.segments.push_back({ m_Origin, m_Code });
+
+				// Pointers for the indirect modes, and some data to read
+				std::vector<byte> zeroPage(0x30, 0x5A);
+				zeroPage[KERNEL_POINTER_X] = GET_LOW_BYTE(KERNEL_DATA);
+				zeroPage[KERNEL_POINTER_X + 1] = GET_HIGH_BYTE(KERNEL_DATA);
+				zeroPage[KERNEL_POINTER_Y] = GET_LOW_BYTE(KERNEL_DATA);
+				zeroPage[KERNEL_POINTER_Y + 1] = GET_HIGH_BYTE(KERNEL_DATA);
+				w.segments.push_back({ 0x0000, zeroPage });
+				w.segments.push_back({ KERNEL_DATA, std::vector<byte>(0x100, 0xA5) });
+				if (!m_Vectors.empty())
+					w.segments.push_back({ KERNEL_VECTORS, m_Vectors });
+
+				return w;
+			}
+
+		private:
+			const word m_Origin;
+
+			std::vector<byte> m_Code;
+			std::vector<byte> m_Vectors;
+			std::vector<size_t> m_SubroutineFixups;
+		};
+
+		std::vector<Workload> BuildKernels(const std::vector<KernelSpec>& specs, const std::string& group) {
+			std::vector<Workload> out;
+			for (const KernelSpec& spec : specs)
+				out.push_back(KernelBuilder(CODE_ORIGIN).Build(spec, group));
+			return out;
+		}
+
+		Workload MakeProgram(const char* name, const char* description, const std::vector<byte>& code, const word resultAddress, const std::vector<byte>& expected) {
+			Workload w;
+			w.name = name;
+			w.group = "program";
+			w.description = description;
+			w.entry = CODE_ORIGIN;
+			w.segments.push_back({ CODE_ORIGIN, code });
+			w.resultAddress = resultAddress;
+			w.expected = expected;
+			return w;
+		}
+	}
+
+	void LoadWorkload(Memory& memory, const Workload& w) {
+		memory.Clear();
+		for (const Segment& seg : w.segments)
+			memory.WriteBytes(seg.origin, seg.bytes);
+		memory.WriteWord(ADDRESS_RESET_VECTOR, w.entry);
+	}
+
+	std::vector<Workload> MakeProgramWorkloads() {
+		return {
+			MakeProgram("sieve", "Sieve of Eratosthenes, primes below 8192", SieveProgram, 0x0026, { 0x04, 0x04 }),
+			MakeProgram("crc32", "CRC-32 of 1KB, bit at a time", CRC32Program, 0x0020, { 0x94, 0x4F, 0xFA, 0x2F }),
+			MakeProgram("decimal", "Decimal mode ADC/SBC over all operand pairs", DecimalProgram, 0x0030, { 0x34, 0x03 }),
+		};
+	}
+
+	std::vector<Workload> MakeAddressingWorkloads() {
+		using I = Instruction;
+		using A = AddressMode;
+
+		return BuildKernels({
+			{ "ABS", "LDA absolute", {}, { { I::LDA, A::ABS, KERNEL_DATA } } },
+			{ "ABX", "LDA absolute,X", { { I::LDX, A::IMM, 0x10 } }, { { I::LDA, A::ABX, KERNEL_DATA } } },
+			{ "ABY", "LDA absolute,Y", { { I::LDY, A::IMM, 0x10 } }, { { I::LDA, A::ABY, KERNEL_DATA } } },
+			{ "ACC", "ASL accumulator", {}, { { I::ASL, A::ACC } } },
+			{ "IMM", "LDA immediate", {}, { { I::LDA, A::IMM, 0x42 } } },
+			{ "IMP", "INX implied", {}, { { I::INX, A::IMP } } },
+			{ "IND", "JMP indirect", {}, { { I::JMP, A::IND, 0, Operand::VECTOR } } },
+			{ "INX", "LDA (zero page,X)", { { I::LDX, A::IMM, 0 } }, { { I::LDA, A::INX, KERNEL_POINTER_X } } },
+			{ "INY", "LDA (zero page),Y", { { I::LDY, A::IMM, 0x10 } }, { { I::LDA, A::INY, KERNEL_POINTER_Y } } },
+			{ "REL", "BNE taken", {}, { { I::BNE, A::REL, 0 } } },
+			{ "ZPG", "LDA zero page", {}, { { I::LDA, A::ZPG, KERNEL_ZERO_PAGE } } },
+			{ "ZPX", "LDA zero page,X", { { I::LDX, A::IMM, 0x04 } }, { { I::LDA, A::ZPX, KERNEL_ZERO_PAGE } } },
+			{ "ZPY", "LDX zero page,Y", { { I::LDY, A::IMM, 0x04 } }, { { I::LDX, A::ZPY, KERNEL_ZERO_PAGE } } },
+		}, "addressing");
+	}
+
+	std::vector<Workload> MakeFamilyWorkloads() {
+		using I = Instruction;
+		using A = AddressMode;
+
+		return BuildKernels({
+			{ "load", "LDA, LDX, LDY", {}, {
+				{ I::LDA, A::IMM, 0x42 }, { I::LDX, A::ZPG, KERNEL_ZERO_PAGE }, { I::LDY, A::ABS, KERNEL_DATA } } },
+			{ "store", "STA, STX, STY", { { I::LDX, A::IMM, 0x04 } }, {
+				{ I::STA, A::ZPG, KERNEL_ZERO_PAGE }, { I::STX, A::ABS, KERNEL_DATA }, { I::STY, A::ZPX, KERNEL_ZERO_PAGE } } },
+			{ "logic", "AND, ORA, EOR, BIT", {}, {
+				{ I::AND, A::IMM, 0xF7 }, { I::ORA, A::ZPG, KERNEL_ZERO_PAGE }, { I::EOR, A::IMM, 0x3C }, { I::BIT, A::ABS, KERNEL_DATA } } },
+			{ "arith", "Binary ADC, SBC, CMP, CPX, CPY", { { I::CLD, A::IMP } }, {
+				{ I::ADC, A::IMM, 0x13 }, { I::SBC, A::ZPG, KERNEL_ZERO_PAGE }, { I::CMP, A::IMM, 0x80 }, { I::CPX, A::IMM, 0x10 }, { I::CPY, A::ZPG, KERNEL_ZERO_PAGE } } },
+			{ "decimal", "Decimal ADC, SBC", { { I::SED, A::IMP } }, {
+				{ I::ADC, A::IMM, 0x19 }, { I::SBC, A::IMM, 0x07 } } },
+			{ "shift", "ASL, LSR, ROL, ROR on the accumulator", {}, {
+				{ I::ASL, A::ACC }, { I::LSR, A::ACC }, { I::ROL, A::ACC }, { I::ROR, A::ACC } } },
+			{ "incdec", "INC, DEC, INX, DEY", {}, {
+				{ I::INC, A::ZPG, KERNEL_ZERO_PAGE }, { I::DEC, A::ABS, KERNEL_DATA }, { I::INX, A::IMP }, { I::DEY, A::IMP } } },
+			{ "transfer", "TAX, TXA, TAY, TYA, TSX, TXS", {}, {
+				{ I::TAX, A::IMP }, { I::TXA, A::IMP }, { I::TAY, A::IMP }, { I::TYA, A::IMP }, { I::TSX, A::IMP }, { I::TXS, A::IMP } } },
+			{ "flags", "CLC, SEC, CLV, SEI, CLI, CLD", {}, {
+				{ I::CLC, A::IMP }, { I::SEC, A::IMP }, { I::CLV, A::IMP }, { I::SEI, A::IMP }, { I::CLI, A::IMP }, { I::CLD, A::IMP } } },
+			{ "branch", "Taken and not taken branches", { { I::CLC, A::IMP } }, {
+				{ I::BNE, A::REL, 0 }, { I::BEQ, A::REL, 0 }, { I::BCC, A::REL, 0 }, { I::BCS, A::REL, 0 } } },
+			{ "stack", "PHA, PLA, PHP, PLP", {}, {
+				{ I::PHA, A::IMP }, { I::PLA, A::IMP }, { I::PHP, A::IMP }, { I::PLP, A::IMP } } },
+			{ "jump", "JMP absolute and indirect", {}, {
+				{ I::JMP, A::ABS, 0, Operand::NEXT }, { I::JMP, A::IND, 0, Operand::VECTOR } } },
+			{ "subroutine", "JSR and RTS", {}, {
+				{ I::JSR, A::ABS, 0, Operand::SUBROUTINE } } },
+		}, "family");
+	}
+
+	std::optional<Workload> LoadDormannWorkload(const std::string& filepath, const word successTrap) {
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "failed to open the functional test binary \"" << filepath << "\"" << std::endl;
+			return std::nullopt;
+		}
+
+		std::vector<byte> image{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+		if (image.empty() || image.size() > MAKE_KB(64)) {
+			std::cerr << "the functional test binary \"" << filepath << "\" should be a memory image of up to 64KB" << std::endl;
+			return std::nullopt;
+		}
+
+		Workload w;
+		w.name = "dormann";
+		w.group = "program";
+		w.description = "Klaus Dormann's 6502 functional test";
+		w.segments.push_back({ 0x0000, image });
+		w.entry = 0x0400;
+		w.end = WorkloadEnd::TRAP;
+		w.successTrap = successTrap;
+		w.cycleLimit = 1'000'000'000;
+		return w;
+	}
+
+}
+}
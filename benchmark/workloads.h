@@ -0,0 +1,83 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+
+#include "types.h"
+
+namespace mos6502 {
+	class Memory;
+
+namespace bench {
+
+	// A block of bytes loaded into memory before a workload runs
+	struct Segment {
+		word origin;
+		std::vector<byte> bytes;
+	};
+
+	// How a workload signals that it has finished
+	enum class WorkloadEnd : byte {
+		BREAK,	// Executes a BRK instruction
+		TRAP,	// Jumps or branches to itself (as the Klaus Dormann tests do)
+	};
+
+	// A headless program run by the benchmark.
+	struct Workload {
+		// Unique name, used on the command line and in reports
+		std::string name;
+
+		// Grouping used in reports: "program", "addressing", or "family"
+		std::string group;
+
+		std::string description;
+
+		// Memory contents, and where execution starts
+		std::vector<Segment> segments;
+		word entry = 0x0600;
+
+		WorkloadEnd end = WorkloadEnd::BREAK;
+
+		// Verification, after a BREAK the bytes at resultAddress are compared
+		// against expected (when not empty). After a TRAP the trap address is
+		// compared against successTrap.
+		word resultAddress = 0;
+		std::vector<byte> expected;
+		word successTrap = 0;
+
+		// Safety net for programs that never finish
+		uint64_t cycleLimit = 100'000'000;
+	};
+
+	// Clears the memory, loads the workload into it and points the reset
+	// vector at its entry
+	void LoadWorkload(Memory& memory, const Workload& w);
+
+	// The standard program workloads: Sieve, CRC32, and the decimal stress
+	std::vector<Workload> MakeProgramWorkloads();
+
+	// One kernel per addressing mode (AddressMode), each repeating a single
+	// instruction using that mode.
+	std::vector<Workload> MakeAddressingWorkloads();
+
+	// One kernel per opcode family (loads, stores, ALU, shifts, ...)
+	std::vector<Workload> MakeFamilyWorkloads();
+
+	// Loads the binary of Klaus Dormann's 6502 functional test, assembled to
+	// be loaded at $0000 and started at $0400. The test finishes by trapping,
+	// at successTrap when every test passed.
+	// The test is not bundled, build it from
+	// https://github.com/Klaus2m5/6502_65C02_functional_tests
+	std::optional<Workload> LoadDormannWorkload(const std::string& filepath, const word successTrap);
+
+}
+}
@@ -0,0 +1,115 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include "types.h"
+#include "utils.h"
+
+namespace mos6502 {
+
+	// The binary arithmetic, logic and stack steps of the instructions, as
+	// pure functions of their inputs. The CPU's handlers (BasicCPU::Ins_*)
+	// and the lanes of the WideCPU both work through these, so there is one
+	// definition of what each instruction computes and which flags it sets.
+	// Decimal mode arithmetic is in decimal.h. The JIT compiler emits the
+	// same steps as x86-64 instructions, and is checked against the CPU by
+	// the benchmark's --check.
+
+	// Bits of the Processor Status (see CPU::StatusFlag)
+	constexpr byte ALU_CARRY = 0x01;
+	constexpr byte ALU_ZERO = 0x02;
+	constexpr byte ALU_INTERRUPT = 0x04;
+	constexpr byte ALU_DECIMAL = 0x08;
+	constexpr byte ALU_UNUSED = 0x20;
+	constexpr byte ALU_OVERFLOW = 0x40;
+	constexpr byte ALU_NEGATIVE = 0x80;
+
+	// What an operation produced. Z is set if value is 0, and N is bit 7 of
+	// negative, which is the value itself but for BIT. The flags in mask
+	// (other than Z and N) are replaced by those in flags.
+	struct AluResult {
+		byte value;
+		byte negative;
+		byte flags;
+		byte mask;
+	};
+
+	// The Processor Status after the operation
+	constexpr byte AluStatus(const byte status, const AluResult& result) {
+		return static_cast<byte>((status & ~(result.mask | ALU_ZERO | ALU_NEGATIVE)) | result.flags
+			| (result.negative & ALU_NEGATIVE) | (result.value == 0 ? ALU_ZERO : 0));
+	}
+
+	// ADC with the Decimal flag clear
+	constexpr AluResult AluAdd(const byte a, const byte b, const bool carry) {
+		const unsigned int sum = a + b + (carry ? 1 : 0);
+		const byte value = static_cast<byte>(sum);
+		const byte overflow = static_cast<byte>((~(a ^ b) & (a ^ value) & 0x80) >> 1);
+		return { value, value, static_cast<byte>((sum >> 8) | overflow), ALU_CARRY | ALU_OVERFLOW };
+	}
+
+	// SBC with the Decimal flag clear, adding the one's complement with the
+	// carry being "not borrow"
+	constexpr AluResult AluSubtract(const byte a, const byte b, const bool carry) {
+		return AluAdd(a, static_cast<byte>(b ^ 0xFF), carry);
+	}
+
+	// CMP, CPX and CPY, of the register with the operand
+	constexpr AluResult AluCompare(const byte reg, const byte b) {
+		const byte value = static_cast<byte>(reg - b);
+		return { value, value, static_cast<byte>(reg >= b ? ALU_CARRY : 0), ALU_CARRY };
+	}
+
+	// BIT: Zero comes from the AND, but Negative and Overflow from the
+	// operand itself. The value is not written back.
+	constexpr AluResult AluBitTest(const byte a, const byte b) {
+		return { static_cast<byte>(a & b), b, static_cast<byte>(b & ALU_OVERFLOW), ALU_OVERFLOW };
+	}
+
+	// ASL
+	constexpr AluResult AluShiftLeft(const byte b) {
+		const byte value = static_cast<byte>(b << 1);
+		return { value, value, static_cast<byte>(b >> 7), ALU_CARRY };
+	}
+
+	// LSR
+	constexpr AluResult AluShiftRight(const byte b) {
+		const byte value = static_cast<byte>(b >> 1);
+		return { value, value, static_cast<byte>(b & ALU_CARRY), ALU_CARRY };
+	}
+
+	// ROL
+	constexpr AluResult AluRotateLeft(const byte b, const bool carry) {
+		const byte value = static_cast<byte>((b << 1) | (carry ? 1 : 0));
+		return { value, value, static_cast<byte>(b >> 7), ALU_CARRY };
+	}
+
+	// INC, INX and INY
+	constexpr AluResult AluIncrement(const byte b) {
+		const byte value = static_cast<byte>(b + 1);
+		return { value, value, 0, 0 };
+	}
+
+	// DEC, DEX and DEY
+	constexpr AluResult AluDecrement(const byte b) {
+		const byte value = static_cast<byte>(b - 1);
+		return { value, value, 0, 0 };
+	}
+
+	// The stack grows down through page 1. A push writes at the stack
+	// pointer and then decrements it, a pull increments it and then reads.
+	constexpr word StackAddress(const byte sp) { return static_cast<word>(ADDRESS_STACK | sp); }
+	constexpr byte StackPushed(const byte sp) { return static_cast<byte>(sp - 1); }
+	constexpr byte StackPulled(const byte sp) { return static_cast<byte>(sp + 1); }
+
+	// The Processor Status as held, whether pulled by PLP or RTI or set
+	// otherwise: the unused bit is always on
+	constexpr byte StatusWithUnused(const byte status) { return static_cast<byte>(status | ALU_UNUSED); }
+
+}
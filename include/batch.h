@@ -0,0 +1,205 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+#include "cpu.h"
+#include "system.h"
+
+namespace mos6502 {
+
+	// A single independent machine run: load a program, reset, run for a
+	// number of cycles, then report the registers and a range of memory.
+	struct BatchJob {
+		// Copied into the result, for the caller's own bookkeeping
+		uint64_t id = 0;
+
+		// Bytes loaded into an otherwise zeroed memory at loadAddress
+		std::vector<byte> program;
+		word loadAddress = 0x0200;
+
+		// Where execution starts, written to the reset vector before the reset
+		word entry = 0x0200;
+
+		// Cycle budget. The run stops early after a BRK or illegal opcode.
+		uint64_t cycles = 0;
+
+		// Range of memory copied into the result after the run
+		word dumpAddress = 0;
+		size_t dumpSize = 0;
+	};
+
+	// The outcome of a BatchJob
+	struct BatchResult {
+		uint64_t id = 0;
+
+		// Position of the job in the vector given to BatchRunner::Run()
+		size_t index = 0;
+
+		FlatCPU::StopReason stopReason = FlatCPU::StopReason::NONE;
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+
+		// Registers after the run
+		word pc = 0;
+		byte sp = 0, acc = 0, x = 0, y = 0, status = 0;
+
+		// Copy of the requested memory range
+		std::vector<byte> memory;
+	};
+
+	// Lock-free bounded multi-producer/multi-consumer queue.
+	// Each cell carries a sequence number saying whether it is free to be
+	// written or ready to be read, so producers and consumers only ever
+	// contend on their own index.
+	template<class T>
+	class CompletionQueue {
+	public:
+		// Capacity is rounded up to the next power of two (minimum 2)
+		CompletionQueue(const size_t capacity = 1024) {
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			m_Cells = std::make_unique<Cell[]>(size);
+			m_Mask = size - 1;
+			for (size_t i = 0; i < size; i++)
+				m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		CompletionQueue(const CompletionQueue&) = delete;
+		CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+		inline size_t GetCapacity() const { return m_Mask + 1; }
+
+		// Moves the value onto the queue, returning false if it was full
+		bool TryPush(T& value) {
+			size_t pos = m_Enqueue.load(std::memory_order_relaxed);
+			for (;;) {
+				Cell& cell = m_Cells[pos & m_Mask];
+				const size_t seq = cell.sequence.load(std::memory_order_acquire);
+				const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+				if (diff == 0) {
+					if (m_Enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						cell.value = std::move(value);
+						cell.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false; // Full
+				} else {
+					pos = m_Enqueue.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Moves the oldest value off of the queue, returning false if it was empty
+		bool TryPop(T& out) {
+			size_t pos = m_Dequeue.load(std::memory_order_relaxed);
+			for (;;) {
+				Cell& cell = m_Cells[pos & m_Mask];
+				const size_t seq = cell.sequence.load(std::memory_order_acquire);
+				const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+				if (diff == 0) {
+					if (m_Dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						out = std::move(cell.value);
+						cell.sequence.store(pos + m_Mask + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false; // Empty
+				} else {
+					pos = m_Dequeue.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		std::unique_ptr<Cell[]> m_Cells;
+		size_t m_Mask = 0;
+
+		alignas(64) std::atomic<size_t> m_Enqueue{ 0 };
+		alignas(64) std::atomic<size_t> m_Dequeue{ 0 };
+	};
+
+	// Runs batches of independent jobs across a pool of worker threads.
+	//
+	// Each worker owns a whole machine (a System of a FlatCPU and its 64KB
+	// memory), allocated on the worker's own thread and cleared for every
+	// job it runs, so nothing is shared between threads while jobs execute.
+	// The jobs of a batch are split into one range per worker. Workers
+	// take jobs from the front of their own range, and once it is empty
+	// steal half of the largest remaining range from another worker.
+	// Results are handed back through a lock-free CompletionQueue.
+	class BatchRunner {
+	public:
+		using ResultCallback = std::function<void(BatchResult& result)>;
+
+		// Starts the worker threads. Zero uses one worker per hardware thread.
+		BatchRunner(const unsigned int threads = 0);
+
+		// Stops and joins the worker threads
+		~BatchRunner();
+
+		BatchRunner(const BatchRunner&) = delete;
+		BatchRunner& operator=(const BatchRunner&) = delete;
+
+		// Returns the number of worker threads
+		inline unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_Workers.size()); }
+
+		// Runs every job, calling onResult on the calling thread as each
+		// one completes (in completion order). Blocks until all are done.
+		// Only one batch may run at a time.
+		void Run(const std::vector<BatchJob>& jobs, const ResultCallback& onResult);
+
+		// Runs every job, returning the results in the same order as the jobs
+		std::vector<BatchResult> Run(const std::vector<BatchJob>& jobs);
+
+	private:
+		struct Worker;
+
+		void WorkerMain(Worker& worker);
+
+		// Takes the next job index for the worker, stealing if needed.
+		// Returns false once there is no work left anywhere.
+		bool NextJob(Worker& worker, size_t& outIndex);
+
+		static void Execute(System& system, const BatchJob& job, BatchResult& result);
+
+		std::vector<std::unique_ptr<Worker>> m_Workers;
+		CompletionQueue<BatchResult> m_Completed;
+
+		// The batch being worked on
+		const std::vector<BatchJob>* m_Jobs = nullptr;
+
+		// Wakes the workers for a new batch (or to stop), and tells Run()
+		// when every worker has gone back to waiting.
+		std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::condition_variable m_Idle;
+		uint64_t m_Generation = 0;
+		unsigned int m_Busy = 0;
+		bool m_Stopping = false;
+	};
+}
@@ -0,0 +1,219 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+#include "bus.h"
+#include "memory.h"
+#include "jit.h"
+
+namespace mos6502 {
+
+	// Holds basic blocks (straight-line runs of decoded instructions) by the
+	// address of their first instruction, for the block cache of the CPU
+	// (see BasicCPU::SetBlockCache). The type of decoded instruction is
+	// supplied by the CPU.
+	//
+	// Every block is read from pages of a Memory, which are watched for
+	// writes (see Memory::WatchCode). A write throws away all of the blocks
+	// read from the page. The write is usually made by an instruction of a
+	// block that is still running, so the blocks are only dropped at the
+	// next Find(), and HasInvalidations() tells the CPU to stop and look.
+	template<class OpT>
+	class BlockCache final : public CodeWatcher {
+	public:
+		// Number of pages in the address space
+		static constexpr size_t PAGE_COUNT = 256;
+
+		// Longest block decoded, in instructions. At 3 bytes at most per
+		// instruction a block spans no more than two pages.
+		static constexpr size_t MAX_BLOCK_LENGTH = 32;
+
+		// Number of times the blocks of a page may be thrown away before the
+		// page is left to the interpreter. Code rewritten that often (or data
+		// written next to code) would spend longer being decoded than run.
+		static constexpr unsigned int MAX_INVALIDATIONS = 16;
+
+		// Where a page of the address space is read from
+		struct Source {
+			Memory* memory = nullptr;
+			size_t page = 0;
+
+			inline bool operator==(const Source& other) const { return memory == other.memory && page == other.page; }
+		};
+
+		// A decoded basic block
+		struct Block {
+			word start = 0;
+			std::vector<OpT> ops;
+
+			// The pages of the address space holding the block, the last is
+			// either the same as the first or the one following it
+			byte firstPage = 0;
+			byte lastPage = 0;
+
+			// Native code for the block, while the JIT is enabled
+			JitBlock native;
+		};
+
+		BlockCache() = default;
+
+		~BlockCache() override {
+			for (Memory* memory : m_Memories)
+				memory->RemoveCodeWatcher(this);
+		}
+
+		// No Copying, the memories know the cache by its address
+		BlockCache(const BlockCache&) = delete;
+		BlockCache& operator=(const BlockCache&) = delete;
+
+		// Returns the block starting at the address, or nullptr if none has
+		// been decoded. Throws away blocks whose code has been written first.
+		inline Block* Find(const word pc) {
+			if (m_Invalidated || (m_Bus && m_Bus->GetMappingVersion() != m_MappingVersion))
+				Flush();
+
+			const auto& page = m_Blocks[GET_HIGH_BYTE(pc)];
+			return page ? (*page)[GET_LOW_BYTE(pc)].get() : nullptr;
+		}
+
+		// Returns true if blocks may be decoded from the page
+		inline bool IsCacheable(const byte page) const { return !m_Uncached[page]; }
+
+		// Leaves the page to the interpreter, until the next Clear()
+		inline void SetUncached(const byte page) { m_Uncached[page] = true; }
+
+		// Returns true if code has been written since the last Find()
+		inline bool HasInvalidations() const { return m_Invalidated; }
+
+		// Takes ownership of a decoded block, watching the pages it was read
+		// from. The second source is only used by a block spanning two pages.
+		Block* Insert(Block&& block, const Source& first, const Source& second) {
+			Watch(block.firstPage, first);
+			if (block.lastPage != block.firstPage)
+				Watch(block.lastPage, second);
+
+			auto& page = m_Blocks[block.firstPage];
+			if (!page)
+				page = std::make_unique<PageBlocks>();
+
+			auto& slot = (*page)[GET_LOW_BYTE(block.start)];
+			slot = std::make_unique<Block>(std::move(block));
+
+			m_PageUsers[slot->firstPage].push_back(slot.get());
+			if (slot->lastPage != slot->firstPage)
+				m_PageUsers[slot->lastPage].push_back(slot.get());
+
+			return slot.get();
+		}
+
+		// Throws away every block. The page table of the given bus (if any)
+		// is what the blocks are decoded through, they are thrown away again
+		// whenever its mapping changes.
+		void Clear(const Bus* bus = nullptr) {
+			for (auto& page : m_Blocks)
+				page.reset();
+			for (auto& users : m_PageUsers)
+				users.clear();
+
+			m_Sources.fill(Source{});
+			m_Invalidations.fill(0);
+			m_Uncached.fill(false);
+			m_Pending.clear();
+			m_Invalidated = false;
+
+			m_Bus = bus;
+			m_MappingVersion = bus ? bus->GetMappingVersion() : 0;
+		}
+
+	public: // Implement CodeWatcher
+
+		void OnCodeWritten(Memory& memory, const size_t page) override {
+			m_Pending.push_back(Source{ &memory, page });
+			m_Invalidated = true;
+		}
+
+		void OnMemoryDestroyed(Memory& memory) override {
+			m_Memories.erase(std::remove(m_Memories.begin(), m_Memories.end(), &memory), m_Memories.end());
+			Clear(m_Bus);
+		}
+
+	private:
+		using PageBlocks = std::array<std::unique_ptr<Block>, PAGE_COUNT>;
+
+		void Watch(const byte page, const Source& source) {
+			m_Sources[page] = source;
+			source.memory->WatchCode(source.page, this);
+
+			if (std::find(m_Memories.begin(), m_Memories.end(), source.memory) == m_Memories.end())
+				m_Memories.push_back(source.memory);
+		}
+
+		// Drops the blocks read from written pages, or everything if the
+		// mapping changed
+		void Flush() {
+			if (m_Bus && m_Bus->GetMappingVersion() != m_MappingVersion) {
+				Clear(m_Bus);
+				return;
+			}
+
+			for (const Source& written : m_Pending) {
+				for (size_t page = 0; page < PAGE_COUNT; page++) {
+					if (m_Sources[page].memory && m_Sources[page] == written)
+						DropPage(static_cast<byte>(page));
+				}
+			}
+
+			m_Pending.clear();
+			m_Invalidated = false;
+		}
+
+		void DropPage(const byte page) {
+			// Copied, as dropping a block spanning two pages edits the lists
+			const std::vector<Block*> users = m_PageUsers[page];
+			for (Block* block : users) {
+				for (const byte used : { block->firstPage, block->lastPage }) {
+					auto& list = m_PageUsers[used];
+					list.erase(std::remove(list.begin(), list.end(), block), list.end());
+				}
+				(*m_Blocks[block->firstPage])[GET_LOW_BYTE(block->start)].reset();
+			}
+
+			m_Sources[page] = Source{};
+			if (++m_Invalidations[page] >= MAX_INVALIDATIONS)
+				m_Uncached[page] = true;
+		}
+
+		// Blocks by the page, then the record byte, of their first instruction
+		std::array<std::unique_ptr<PageBlocks>, PAGE_COUNT> m_Blocks;
+
+		// The blocks using each page, and where the page was read from
+		std::array<std::vector<Block*>, PAGE_COUNT> m_PageUsers;
+		std::array<Source, PAGE_COUNT> m_Sources;
+
+		std::array<unsigned int, PAGE_COUNT> m_Invalidations{};
+		std::array<bool, PAGE_COUNT> m_Uncached{};
+
+		// Pages written since the last Find()
+		std::vector<Source> m_Pending;
+		bool m_Invalidated = false;
+
+		// Memories holding watches for this cache
+		std::vector<Memory*> m_Memories;
+
+		const Bus* m_Bus = nullptr;
+		uint64_t m_MappingVersion = 0;
+	};
+}
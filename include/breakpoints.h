@@ -0,0 +1,150 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "types.h"
+
+namespace mos6502 {
+
+	// Identifies a breakpoint or watchpoint, for removing it
+	using BreakpointId = uint32_t;
+
+	// The breakpoints, watchpoints, and conditional breaks stopping a CPU's
+	// Run(), see BasicCPU::AttachBreakpoints().
+	//
+	// Each page of the address space has a byte of flags, the accesses that
+	// something is set for on that page. The CPU only looks any further
+	// when the flag is set: once per block for execution, or once per
+	// access for reads and writes. With nothing set on a page, its code
+	// runs as it would with no breakpoints attached at all.
+	class Breakpoints {
+	public:
+		// The kinds of access that can be stopped at, as flags
+		enum Access : byte {
+			EXECUTE	= (1 << 0),	// An instruction is about to execute from the address
+			READ	= (1 << 1),	// An instruction read from the address
+			WRITE	= (1 << 2),	// An instruction wrote to the address
+		};
+
+		// The registers a condition compares
+		enum class Register : byte {
+			A,
+			X,
+			Y,
+			SP,
+			PC,
+			STATUS,	// The processor status, flags as in BasicCPU::StatusFlag
+		};
+
+		enum class Comparison : byte {
+			EQUAL,
+			NOT_EQUAL,
+			LESS,
+			LESS_EQUAL,
+			GREATER,
+			GREATER_EQUAL,
+		};
+
+		// The registers of the CPU, as the conditions see them
+		struct Registers {
+			word pc;
+			byte sp, acc, x, y;
+			byte status;
+		};
+
+		// Holds when (reg & mask) compares to the value as given. For a
+		// flag, mask the status with it: { STATUS, EQUAL, 0, CARRY } holds
+		// while the carry is clear.
+		struct Condition {
+			Register reg;
+			Comparison comparison;
+			word value;
+			word mask = 0xFFFF;
+
+			bool Holds(const Registers& registers) const;
+		};
+
+		// Where and why the CPU stopped
+		struct Hit {
+			BreakpointId id;
+			Access access;
+			word pc;		// Address of the instruction
+			word addr;		// The address accessed, or executed
+			byte value;		// The byte read or written, 0 for execution
+		};
+
+		// Stops before executing the instruction at the address, while each
+		// of the conditions holds. Returns the ID for Remove().
+		BreakpointId AddBreakpoint(const word pc, std::vector<Condition> conditions = {});
+
+		// Stops before executing any instruction while each of the
+		// conditions holds. Every instruction is checked, so Run() does not
+		// use the block cache or JIT while one is set.
+		BreakpointId AddConditionalBreak(std::vector<Condition> conditions);
+
+		// Stops after an instruction reads and/or writes (as flags of
+		// Access) any address of the range first..last, while each of the
+		// conditions holds.
+		BreakpointId AddWatchpoint(const word first, const word last, const byte access, std::vector<Condition> conditions = {});
+
+		// Removes a breakpoint or watchpoint. Returns false if there was
+		// no such ID.
+		bool Remove(const BreakpointId id);
+
+		// Removes everything
+		void Clear();
+
+		// Returns the number of breakpoints and watchpoints set
+		inline size_t GetCount() const { return m_Entries.size(); }
+
+		// Returns the flags of Access set for some address of the page
+		inline byte GetPageAccess(const byte page) const { return m_Pages[page]; }
+
+		// Returns true if read or write watchpoints are set anywhere
+		inline bool HasWatchpoints() const { return m_Watching; }
+
+		// Returns the breakpoint (or conditional break) stopping execution
+		// at the address, if there is one
+		std::optional<BreakpointId> FindBreakpoint(const word pc, const Registers& registers) const;
+
+		// Returns the watchpoint stopping at the read or write (as one
+		// Access) of the address, if there is one
+		std::optional<BreakpointId> FindWatchpoint(const word addr, const Access access, const Registers& registers) const;
+
+		// Formats a hit, as "breakpoint 1 at $C000" or "watchpoint 2 write $10=$FF"
+		friend std::ostream& operator<<(std::ostream& os, const Hit& hit);
+
+	private:
+		struct Entry {
+			BreakpointId id;
+			word first, last;
+			byte access;
+			std::vector<Condition> conditions;
+		};
+
+		BreakpointId Add(const word first, const word last, const byte access, std::vector<Condition> conditions);
+
+		// Returns the first entry covering the access, whose conditions hold
+		std::optional<BreakpointId> Find(const word addr, const Access access, const Registers& registers) const;
+
+		// Works out the page flags again from the entries
+		void UpdatePages();
+
+		std::vector<Entry> m_Entries;
+		std::array<byte, 256> m_Pages{};
+		bool m_Watching = false;
+		BreakpointId m_NextId = 1;
+	};
+}
@@ -8,21 +8,73 @@
  */
 #pragma once
 
+#include <array>
 #include <memory>
 
 #include "types.h"
 #include "io_device.h"
+#include "memory.h"
+#include "utils.h"
 
 namespace mos6502 {
 	// The bus represents the address-bus portion of the MOS6502.
 	// This class is responsible for mapping incoming address registers to
 	// their respective hardware counterparts.
+	//
+	// The 64KB address space is split into 256 pages of 256 bytes each
+	// (the address.page byte). Every page is mapped either directly onto a
+	// host byte array, which is read and written inline, or onto an IODevice
+	// handler for memory-mapped IO. Decoding an address is a single index
+	// into the page table no matter how many devices are mapped.
 	class Bus : public IODevice {
+	public:
+		// Number of pages in the address space
+		static constexpr fast_word PAGE_COUNT = 256;
+
+		// Number of bytes in a single page
+		static constexpr fast_word PAGE_SIZE = 256;
+
+		// Flags describing how a page was mapped
+		enum class PageFlag : byte {
+			NONE		= 0,
+			READ_ONLY	= (1 << 0), // Writes to the page are ignored
+			MIRROR		= (1 << 1), // The page mirrors another page's mapping
+		};
+
+		// A single entry of the page table.
+		// Direct (host array) pages have data set, and writable set when
+		// they may be written. Otherwise the device handles the access,
+		// receiving offset + the record byte of the address.
+		// A page with neither is unmapped, reading as 0 and ignoring writes.
+		// Writable pages also point at the bit to set in the dirty page
+		// bitmap of the Memory they map (see Memory::Snapshot), and the bit
+		// at the same position in its watched code bitmap (see Memory::WatchCode).
+		// Pages mapped directly onto a Memory point back at the memory.
+		struct Page {
+			byte* data = nullptr;
+			byte* writable = nullptr;
+
+			uint64_t* dirty = nullptr;
+			const uint64_t* code = nullptr;
+			uint64_t dirtyMask = 0;
+
+			Memory* memory = nullptr;
+
+			IODevice* device = nullptr;
+			word offset = 0;
+
+			byte flags = 0;
+
+			inline bool HasFlag(const PageFlag f) const { return flags & static_cast<byte>(f); }
+			inline bool IsMapped() const { return data != nullptr || device != nullptr; }
+		};
+
 	public:
 		static ioptr Make(ioptr mem);
 
 		Bus() = default;
 
+		// Maps the provided memory (IODevice) across the whole address space
 		Bus(ioptr mem);
 
 		// Return the pointer to the attached memory object (IODevice)
@@ -31,29 +83,116 @@ namespace mos6502 {
 		}
 
 		// Replace the pointer to the attached memory object (IODevice)
-		// with the given pointer.
-		virtual inline void MountMemory(ioptr mem) {
-			m_Memory.swap(mem);
-		}
+		// with the given pointer, mapping it across the whole address space.
+		virtual void MountMemory(ioptr mem);
+
+	public: // Page mapping
+
+		// Maps pageCount pages starting at firstPage onto the given device.
+		// The device receives addresses starting at offset for the first page.
+		// A plain Memory object is mapped directly onto its byte array for speed,
+		// anything else (including subclasses of Memory) goes through its IODevice
+		// methods. Pages outside of a Memory's size are left unmapped.
+		void MapDevice(ioptr device, const byte firstPage, const fast_word pageCount, const word offset = 0, const byte flags = 0);
+
+		// Maps pages directly onto a host byte array owned by the caller, which
+		// must hold at least pageCount * PAGE_SIZE bytes and outlive the mapping.
+		void MapHostMemory(byte* data, const byte firstPage, const fast_word pageCount, const byte flags = 0);
+
+		// Makes pageCount pages starting at firstPage mirror the mapping of the
+		// sourceCount pages starting at sourcePage, repeating as needed.
+		// Later changes to the source pages are not reflected in the mirror.
+		void MapMirror(const byte firstPage, const fast_word pageCount, const byte sourcePage, const fast_word sourceCount = 1);
+
+		// Unmaps the given pages, they will read as 0 and ignore writes
+		void Unmap(const byte firstPage, const fast_word pageCount = 1);
+
+		// Returns the page table entry for the given page
+		inline const Page& GetPage(const byte page) const { return m_Pages[page]; }
+
+		// Returns a number that changes whenever the page mapping changes, so
+		// that anything derived from the mapping can tell when it is stale
+		inline uint64_t GetMappingVersion() const { return m_MappingVersion; }
 
 	public: // Implement IODevice
 
+		// NOTE: These are final, so that a CPU using Bus as its bus type
+		// (see MappedCPU) calls them statically and inlines the direct
+		// page path.
+
 		// Read a single 8-bit byte from the address specified and return it
-		virtual byte ReadByte(const address& addr) const override;
+		inline byte ReadByte(const address& addr) const override final {
+			const Page& page = m_Pages[addr.page];
+			if (page.data)
+				return page.data[addr.record];
+			return ReadDevice(page, addr);
+		}
 
 		// Read a single 16-bit (2 byte) word from the address specified and return it
-		virtual word ReadWord(const address& addr) const override;
+		inline word ReadWord(const address& addr) const override final {
+			const byte low = ReadByte(addr);
+			const byte high = ReadByte(static_cast<word>(addr.value + 1));
+			return MAKE_WORD(low, high);
+		}
 
 		// Write a single 8-bit byte to the address specified
-		virtual void WriteByte(const address& addr, const byte data) override;
+		inline void WriteByte(const address& addr, const byte data) override final {
+			const Page& page = m_Pages[addr.page];
+			if (page.writable) {
+				page.writable[addr.record] = data;
+				*page.dirty |= page.dirtyMask;
+				if (*page.code & page.dirtyMask)
+					CodeWritten(page);
+			} else {
+				WriteDevice(page, addr, data);
+			}
+		}
 
 		// Write a single 16-bit (2 byte) word to the address specified
-		virtual void WriteWord(const address& addr, const word data) override;
+		inline void WriteWord(const address& addr, const word data) override final {
+			WriteByte(addr, GET_LOW_BYTE(data));
+			WriteByte(static_cast<word>(addr.value + 1), GET_HIGH_BYTE(data));
+		}
 
 		// Write a vector of bytes to the device, starting at the offset and consuming the whole vector
-		virtual void WriteBytes(const address& offset, const std::vector<byte>& bytes);
+		virtual void WriteBytes(const address& offset, const std::vector<byte>& bytes) override final;
+
+		// Reads page by page, copying directly out of directly mapped pages and
+		// handing the rest to the mapped devices' ReadBlock(). Unmapped bytes read as 0.
+		virtual size_t ReadBlock(const address& offset, span<byte> out) const override final;
+
+		// Writes page by page, as ReadBlock(). Read-only and unmapped pages ignore the writes.
+		virtual size_t WriteBlock(const address& offset, span<const byte> bytes) override final;
+
+		// Returns the host byte array behind a directly mapped page, or the
+		// mapped device's own page if it starts on a page boundary of the device
+		virtual const byte* MapPage(const byte page) const override final;
 
 	protected:
+		// Slow paths for pages that are not directly mapped
+		byte ReadDevice(const Page& page, const address& addr) const;
+		void WriteDevice(const Page& page, const address& addr, const byte data);
+
+		// Slow path for writes to a page holding code decoded ahead of time
+		void CodeWritten(const Page& page);
+
 		ioptr m_Memory;
+
+		// The page table, indexed by address.page
+		std::array<Page, PAGE_COUNT> m_Pages;
+
+		// Keeps the devices (and memory) mapped to each page alive.
+		// Kept apart from the page table so the hot entries stay small.
+		std::array<ioptr, PAGE_COUNT> m_PageOwners;
+
+		// Dirty bits for writable pages that are not part of a Memory
+		// (see MapHostMemory), which nothing reads.
+		uint64_t m_UntrackedDirty = 0;
+
+		// Code bits for the same pages, which are never watched
+		static constexpr uint64_t UNTRACKED_CODE = 0;
+
+		// Incremented by every change to the page table
+		uint64_t m_MappingVersion = 0;
 	};
 }
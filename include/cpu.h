@@ -12,16 +12,42 @@
 #include <array>
 #include <set>
 #include <memory>
+#include <type_traits>
+#include <utility>
 
 #include "types.h"
 #include "instructions.h"
+#include "alu.h"
+#include "decimal.h"
 #include "io_device.h"
+#include "block_cache.h"
+#include "jit.h"
+#include "scheduler.h"
+#include "breakpoints.h"
+#include "journal.h"
+#include "bus.h"
+#include "flat_memory_bus.h"
 #include "utils.h"
 
+#ifdef MOS6502_TRACE
+#include "trace.h"
+#endif
+
+#ifdef MOS6502_PROFILE
+#include "profile.h"
+#endif
+
 namespace mos6502 {
 
 	// Emulates the CPU portion of the MOS6502 processor.
-	class CPU : public IODevice {
+	// The template parameter is the type of bus the CPU is connected to.
+	// Memory accesses are made through that static type, so a final bus
+	// class (such as FlatMemoryBus) has its reads and writes inlined
+	// directly into the instructions. Using IODevice keeps the fully dynamic,
+	// runtime-pluggable device chain.
+	// See the CPU and FlatCPU aliases at the bottom of this file.
+	template<class BusT>
+	class BasicCPU : public IODevice {
 	public:	// TYPES
 
 		// Processor Status:
@@ -112,12 +138,35 @@ namespace mos6502 {
 			NEGATIVE	= (1 << 7), // Negative Flag
 		};
 
+		// Reason the last call to Run() returned control to the caller.
+		enum class StopReason : byte {
+			NONE,		// Run() has not been called yet
+			BUDGET,		// The cycle budget was used up
+			BREAK,		// A BRK instruction was executed
+			ILLEGAL,	// An illegal opcode was executed
+			INTERRUPT,	// An interrupt request arrived and is waiting to be serviced
+			BREAKPOINT,	// The next instruction is at a breakpoint, see GetBreakpointHit()
+			WATCHPOINT,	// The last instruction touched a watchpoint, see GetBreakpointHit()
+		};
+
 	public:
+		// The type of bus the CPU is connected to
+		using bus_type = BusT;
 
-		// Construct using an IODevice pointer for mapping to memory/hardware
-		CPU(ioptr bus);
+		// Shared pointer to the connected bus
+		using busptr = std::shared_ptr<BusT>;
 
-		inline void MountBus(ioptr bus) { m_Bus.swap(bus); }
+		// Construct using a bus pointer for mapping to memory/hardware
+		BasicCPU(busptr bus);
+
+		inline void MountBus(busptr bus) {
+			m_Bus.swap(bus);
+			UpdateDirectAccess();
+			FlushBlockCache();
+		}
+
+		// Returns the bus the CPU is connected to
+		inline const busptr& GetBus() const { return m_Bus; }
 
 		// Reset Interrupt:
 		// Forces the CPU into a known state.
@@ -130,27 +179,146 @@ namespace mos6502 {
 		virtual void Reset();
 
 		// Interrupt Request:
-		// 
+		// Pushes the program counter and status, and jumps through the IRQ
+		// vector, unless interrupts are disabled. Called part way through an
+		// instruction (between Tick()s), it waits for the instruction to
+		// finish as RequestIRQ() does.
 		virtual void IRQ();
 
 		// Non-maskable Interrupt:
-		// 
+		// As IRQ(), through the NMI vector, and regardless of the
+		// interrupt disable flag.
 		virtual void NMI();
 
+		// Flags an interrupt request as pending. Rather than taking effect
+		// immediately like IRQ(), it is serviced at the next instruction
+		// boundary. Held off while interrupts are disabled.
+		inline void RequestIRQ() { m_PendingIRQ = true; }
+
+		// Flags a non-maskable interrupt as pending, serviced at the next
+		// instruction boundary.
+		inline void RequestNMI() { m_PendingNMI = true; }
+
+		// Returns true if an interrupt is waiting that would be serviced
+		// at the next instruction boundary.
+		inline bool HasPendingInterrupt() const {
+			return m_PendingNMI || (m_PendingIRQ && !HasStatusFlag(StatusFlag::INTERRUPT));
+		}
+
+		// Returns the scheduler of events on the absolute cycle counter,
+		// see GetCyclesExecuted()
+		inline EventScheduler& GetScheduler() { return m_Scheduler; }
+
+		// Schedules RequestIRQ() for the absolute cycle
+		inline EventId ScheduleIRQ(const uint64_t cycle) {
+			return m_Scheduler.Schedule(cycle, [this](uint64_t) { RequestIRQ(); });
+		}
+
+		// Schedules RequestNMI() for the absolute cycle
+		inline EventId ScheduleNMI(const uint64_t cycle) {
+			return m_Scheduler.Schedule(cycle, [this](uint64_t) { RequestNMI(); });
+		}
+
 		// Tick, performs a single clock cycle.
 		// Will return true if there are remaining
 		// cycles for the instruction.
 		virtual bool Tick();
 
-		friend std::ostream& operator<<(std::ostream& os, const CPU& c) {
-			os << "PS=" << c.m_ProcStatus;
+		// Step, performs exactly one whole instruction (or services one
+		// pending interrupt). Any cycles left over from a prior Tick() are
+		// completed first. Returns the number of cycles consumed.
+		virtual unsigned int Step();
+
+		// Run, executes whole instructions until the cycle budget is used up.
+		// Stops early after a BRK or illegal opcode, or before servicing an
+		// interrupt that was requested during the run (such as by an event).
+		// With breakpoints attached, also stops before an instruction at a
+		// breakpoint (other than the first, so that Run() carries on from
+		// one), or after an instruction touching a watchpoint.
+		// Scheduled events run as their deadlines are reached, without
+		// checking for them between the instructions in the meantime.
+		// Returns the number of cycles consumed, which may overshoot the budget
+		// by the remainder of the final instruction. See GetStopReason().
+		virtual uint64_t Run(const uint64_t cycleBudget);
+
+		// Returns why the last call to Run() returned
+		inline StopReason GetStopReason() const { return m_StopReason; }
+
+		// Returns the number of instructions executed since construction
+		inline uint64_t GetInstructionsExecuted() const { return m_InstructionsExecuted; }
+
+		// Returns the number of clock cycles executed since construction
+		inline uint64_t GetCyclesExecuted() const { return m_CyclesExecuted; }
+
+		// Attaches the breakpoints and watchpoints that stop Run(), which
+		// are checked from then on. Pass nullptr to detach. They may be
+		// changed while attached. Step() and Tick() never stop at them.
+		inline void AttachBreakpoints(Breakpoints* breakpoints) {
+			m_Breakpoints = breakpoints;
+			m_WatchpointHit = false;
+			UpdateDirectAccess();
+		}
+
+		// Returns the currently attached breakpoints, if any
+		inline Breakpoints* GetBreakpoints() const { return m_Breakpoints; }
+
+		// Returns what stopped the last call to Run(), when it stopped for
+		// StopReason::BREAKPOINT or StopReason::WATCHPOINT
+		inline const Breakpoints::Hit& GetBreakpointHit() const { return m_BreakpointHit; }
+
+		// Returns the registers as breakpoint conditions see them
+		inline Breakpoints::Registers GetRegisters() const {
+			return Breakpoints::Registers{ m_PC, m_SP, m_Acc, m_X, m_Y, GetStatus().value };
+		}
+
+		// Attaches a journal recording each step of Step() and Run() from
+		// then on, so that they can be undone with StepBack(). Pass nullptr
+		// to detach. While attached, Run() decodes every instruction rather
+		// than using the block cache or JIT. Tick() is not recorded.
+		inline void AttachJournal(Journal* journal) {
+			m_Journal = journal;
+			UpdateDirectAccess();
+		}
+
+		// Returns the currently attached journal, if any
+		inline Journal* GetJournal() const { return m_Journal; }
+
+		// Undoes the most recent step held by the attached journal, returning
+		// the registers, timing state, and the bytes it wrote to what they
+		// were before it. Scheduled events are left as they are.
+		// Returns false if there is no journal, or nothing left in it.
+		bool StepBack();
+
+#ifdef MOS6502_TRACE
+		// Attaches a trace buffer that receives one TraceRecord per
+		// executed instruction. Pass nullptr to detach.
+		// Only available when built with MOS6502_TRACE defined.
+		inline void AttachTrace(TraceBuffer* trace) { m_Trace = trace; }
+
+		// Returns the currently attached trace buffer, if any
+		inline TraceBuffer* GetTrace() const { return m_Trace; }
+#endif
+
+#ifdef MOS6502_PROFILE
+		// Attaches a profile that counts every instruction executed from
+		// then on. Pass nullptr to detach. While attached, Run() decodes
+		// every instruction rather than using the block cache or JIT.
+		// Only available when built with MOS6502_PROFILE defined.
+		inline void AttachProfile(Profile* profile) { m_Profile = profile; }
+
+		// Returns the currently attached profile, if any
+		inline Profile* GetProfile() const { return m_Profile; }
+#endif
+
+		friend std::ostream& operator<<(std::ostream& os, const BasicCPU& c) {
+			os << "PS=" << c.GetStatus();
 			os << " PC=" << address(c.m_PC);
 			os << " SP=" << Hex(c.m_SP);
 			os << " A=" << Hex(c.m_Acc);
 			os << " X=" << Hex(c.m_X);
 			os << " Y=" << Hex(c.m_Y);
 			os << " : CR=" << Hex(c.m_CyclesRem);
-			os << " : CE=" << ToHex<unsigned int>(c.m_CyclesExecuted);
+			os << " : CE=" << ToHex<uint64_t>(c.m_CyclesExecuted);
 			return os;
 		}
 
@@ -172,24 +340,85 @@ namespace mos6502 {
 		inline const byte GetY() const { return m_Y; }
 
 		// Returns the current Processor Status
-		inline const Status GetStatus() const { return m_ProcStatus; }
+		inline const Status GetStatus() const {
+			Status status = m_ProcStatus;
+			status.Z = m_ResultZ == 0;
+			status.N = IS_NEGATIVE(m_ResultN);
+			return status;
+		}
+
+		// Replaces the whole Processor Status, the unused bit is always kept on
+		inline void SetStatus(const Status status) {
+			m_ProcStatus.value = StatusWithUnused(status.value);
+			m_ResultZ = status.Z ? 0 : 1;
+			m_ResultN = status.N ? 0x80 : 0;
+		}
 
 		// Returns the specified flag bit as a byte value of 1 or 0.
 		inline const byte GetStatusFlag(const StatusFlag f) const {
-			return m_ProcStatus.value & static_cast<byte>(f) ? 1 : 0;
+			return HasStatusFlag(f) ? 1 : 0;
 		}
 
 		// Checks (returns true) if the current Processor Status has the given flag set
 		inline bool HasStatusFlag(const StatusFlag f) const { 
+			if (f == StatusFlag::ZERO)
+				return m_ResultZ == 0;
+			if (f == StatusFlag::NEGATIVE)
+				return IS_NEGATIVE(m_ResultN);
 			return (m_ProcStatus.value & static_cast<byte>(f)); 
 		}
 
 		// Sets the given flag to the status provided. Assumed default is to be set true/on.
 		inline void SetStatusFlag(const StatusFlag f, const bool v = true) { 
-			if (v) m_ProcStatus.value |= static_cast<byte>(f);
+			if (f == StatusFlag::ZERO)
+				m_ResultZ = v ? 0 : 1;
+			else if (f == StatusFlag::NEGATIVE)
+				m_ResultN = v ? 0x80 : 0;
+			else if (v) m_ProcStatus.value |= static_cast<byte>(f);
 			else m_ProcStatus.value &= ~(static_cast<byte>(f));
 		}
 
+	public:		// SNAPSHOTS
+
+		// A copy of the CPU's registers and timing state.
+		// Memory is saved separately, see Memory::Snapshot(), and the
+		// scheduled events are left as they are.
+		struct State {
+			word pc;
+			byte sp, acc, x, y;
+			Status status;
+
+			fast_byte cyclesRem;
+			uint64_t cyclesExecuted;
+			uint64_t instructionsExecuted;
+
+			bool pendingIRQ, pendingNMI;
+		};
+
+		// Returns a copy of the current state
+		inline State Snapshot() const {
+			return State{
+				m_PC, m_SP, m_Acc, m_X, m_Y, GetStatus(),
+				m_CyclesRem, m_CyclesExecuted, m_InstructionsExecuted,
+				m_PendingIRQ, m_PendingNMI
+			};
+		}
+
+		// Returns the CPU to a previously saved state
+		inline void Restore(const State& state) {
+			m_PC = state.pc;
+			m_SP = state.sp;
+			m_Acc = state.acc;
+			m_X = state.x;
+			m_Y = state.y;
+			SetStatus(state.status);
+			m_CyclesRem = state.cyclesRem;
+			m_CyclesExecuted = state.cyclesExecuted;
+			m_InstructionsExecuted = state.instructionsExecuted;
+			m_PendingIRQ = state.pendingIRQ;
+			m_PendingNMI = state.pendingNMI;
+		}
+
 	protected:	// REGISTERS
 
 		// Program Counter:
@@ -217,8 +446,235 @@ namespace mos6502 {
 
 		// Processor Status:
 		// Represents the current processor status as an 8-bit bitfield value.
+		// The Zero and Negative bits here are stale, those two flags are kept
+		// lazily in m_ResultZ and m_ResultN instead. Use GetStatus() and
+		// SetStatus() for the complete value.
 		Status m_ProcStatus;
 
+		// Lazy Zero and Negative flags:
+		// Nearly every instruction sets Z and N from the byte it produced.
+		// Rather than updating the bitfield, that byte is stored (see SetNZ)
+		// and the flags are only worked out when read.
+		// Z is set while m_ResultZ is 0, N is bit 7 of m_ResultN. They are
+		// separate so that BIT can set the two from different values.
+		byte m_ResultZ = 1;
+		byte m_ResultN = 0;
+
+		// Sets the Zero and Negative flags from the result of an operation
+		inline void SetNZ(const byte result) {
+			m_ResultZ = result;
+			m_ResultN = result;
+		}
+
+		// Takes the flags from the result of an operation (see alu.h)
+		inline void SetAluResult(const AluResult& result) {
+			m_ProcStatus.value = static_cast<byte>((m_ProcStatus.value & ~result.mask) | result.flags);
+			m_ResultZ = result.value;
+			m_ResultN = result.negative;
+		}
+
+		// Takes the accumulator and flags from a packed DecimalAddTable or
+		// DecimalSubtractTable entry
+		inline void SetDecimalResult(const word packed) {
+			const byte flags = GET_HIGH_BYTE(packed);
+			m_Acc = GET_LOW_BYTE(packed);
+			m_ProcStatus.value = static_cast<byte>((m_ProcStatus.value & ~(DECIMAL_CARRY | DECIMAL_OVERFLOW)) | (flags & (DECIMAL_CARRY | DECIMAL_OVERFLOW)));
+			m_ResultZ = static_cast<byte>(~flags & DECIMAL_ZERO);
+			m_ResultN = flags;
+		}
+
+	public: // Dispatch
+
+		// A handler executes one complete opcode (addressing and operation)
+		// and returns the cycle cost.
+		using Handler = fast_byte(*)(BasicCPU& cpu);
+
+		// Enables or disables the virtual (slow) dispatch path.
+		// By default each opcode is run through a single entry of the
+		// DispatchTable, which calls the base implementations of the
+		// Addr_* and Ins_* methods directly. Subclasses overriding any of
+		// those methods, or ExecuteAddressing/ExecuteInstruction, should
+		// enable this so their overrides are used.
+		inline void SetVirtualDispatch(const bool enabled) { m_VirtualDispatch = enabled; }
+
+		// Returns true if the virtual dispatch path is in use
+		inline bool IsVirtualDispatch() const { return m_VirtualDispatch; }
+
+	protected:
+
+		// Handler specialized for a single addressing mode and instruction
+		// pair, both resolved at compile time.
+		template<AddressMode Mode, Instruction Instr>
+		static fast_byte Dispatch(BasicCPU& cpu);
+
+		// Statically bound (non-virtual) addressing for the given mode
+		template<AddressMode Mode>
+		static address AddressingFor(BasicCPU& cpu, fast_byte& outCycles);
+
+		// Statically bound (non-virtual) operation for the given instruction
+		template<Instruction Instr>
+		static fast_byte InstructionFor(BasicCPU& cpu, const address& addr);
+
+		// Builds a handler for each opcode from the InstructionDetails table
+		template<size_t... OpCodes>
+		static constexpr std::array<Handler, 256> MakeDispatchTable(std::index_sequence<OpCodes...>);
+
+		// Maps each opcode to its specialized handler.
+		// Generated at compile time from InstructionDetails.
+		static const std::array<Handler, 256> DispatchTable;
+
+		// Whether opcodes go through the virtual ExecuteAddressing and
+		// ExecuteInstruction methods instead of the DispatchTable
+		bool m_VirtualDispatch = false;
+
+	public: // Block cache
+
+		// Enables or disables the block cache, which is off by default.
+		// While enabled, Run() decodes each basic block (a straight-line run
+		// of instructions, up to and including the next branch, jump, return,
+		// or BRK) the first time it is reached, and afterwards runs the
+		// decoded copy: the operands already fetched and a handler already
+		// chosen for each instruction. Common pairs of instructions, such as
+		// LDA then STA, CMP then a branch, or DEX then BNE, run as a single
+		// handler.
+		//
+		// Only code read from a Memory is cached. Writes to it through the
+		// Memory, a Bus, or a FlatMemoryBus throw the decoded copies away, so
+		// self-modifying code behaves as it does without the cache. Call
+		// Memory::MarkDirty() after writing code straight into Memory::GetData().
+		//
+		// Run() returns the same results, cycle counts, and stop reasons either
+		// way. Step() and Tick() always decode each instruction, as does Run()
+		// with virtual dispatch enabled, with a trace (MOS6502_TRACE) or
+		// profile (MOS6502_PROFILE) attached, while watchpoints are set, or
+		// for blocks on a page with a breakpoint.
+		void SetBlockCache(const bool enabled);
+
+		// Returns true if the block cache is enabled
+		inline bool IsBlockCache() const { return m_BlockCache != nullptr; }
+
+		// Throws away every cached block. Done automatically by MountBus(),
+		// and whenever the page mapping of a Bus changes.
+		void FlushBlockCache();
+
+		// Enables or disables the JIT compiler, which is off by default.
+		// Enabling it also enables the block cache, and disabling the block
+		// cache disables it again. Blocks that Run() has run often enough are
+		// compiled into native code (see JitCompiler), keeping the registers
+		// in host registers and reading and writing the memory directly.
+		//
+		// Only supported by the FlatCPU, on x86-64 hosts. Returns false, and
+		// stays disabled, anywhere else. Results, cycle counts, and stop
+		// reasons are the same as without it.
+		bool SetJit(const bool enabled);
+
+		// Returns true if the JIT compiler is enabled
+		inline bool IsJit() const { return m_Jit != nullptr; }
+
+	protected:
+
+		// A decoded instruction of a cached block
+		struct CachedOp;
+
+		// A handler runs one decoded instruction and returns the cycle cost.
+		// The budget is the number of cycles Run() has left before it.
+		using CachedHandler = fast_byte(*)(BasicCPU& cpu, const CachedOp& op, const uint64_t budget);
+
+		struct CachedOp {
+			CachedHandler handler;
+			word operand;		// The operand bytes, little-endian
+			word nextPC;		// Address of the following instruction
+			byte opCode;
+			Instruction instruction;
+		};
+
+		using CachedBlock = typename BlockCache<CachedOp>::Block;
+
+		// Handler for a decoded opcode, which does not fetch anything from the
+		// program counter
+		template<AddressMode Mode, Instruction Instr>
+		static fast_byte CachedDispatch(BasicCPU& cpu, const CachedOp& op, const uint64_t budget);
+
+		// Handler for a pair of decoded opcodes, the second being the entry
+		// following op. Only runs the first if Run() would stop between them.
+		template<byte First, byte Second>
+		static fast_byte FusedDispatch(BasicCPU& cpu, const CachedOp& op, const uint64_t budget);
+
+		// Statically bound (non-virtual) address resolution for the given mode
+		template<AddressMode Mode>
+		static address ResolveFor(BasicCPU& cpu, const word operand, fast_byte& outCycles);
+
+		// Builds a cached handler for each opcode from the InstructionDetails table
+		template<size_t... OpCodes>
+		static constexpr std::array<CachedHandler, 256> MakeCachedTable(std::index_sequence<OpCodes...>);
+
+		// Builds the handler for each pair of opcodes in the FusedPairs table
+		template<size_t... Pairs>
+		static constexpr std::array<CachedHandler, sizeof...(Pairs)> MakeFusedTable(std::index_sequence<Pairs...>);
+
+		// Maps each opcode to its cached handler
+		static const std::array<CachedHandler, 256> CachedTable;
+
+		// Returns the handler running the two opcodes together, or nullptr
+		// if the pair is not fused
+		static CachedHandler FindFusedHandler(const byte first, const byte second);
+
+		// Returns true if Run() may use a cached block for the next instruction
+		inline bool CanRunBlock() const {
+#ifdef MOS6502_TRACE
+			if (m_Trace)
+				return false;
+#endif
+#ifdef MOS6502_PROFILE
+			if (m_Profile)
+				return false;
+#endif
+			if (m_Breakpoints && m_Breakpoints->HasWatchpoints())
+				return false;
+			if (m_Journal)
+				return false;
+			return m_BlockCache && !m_VirtualDispatch && m_CyclesRem == 0 && !HasPendingInterrupt();
+		}
+
+		// Returns true if a breakpoint is set on one of the pages of the block
+		inline bool HasBreakpointIn(const CachedBlock& block) const {
+			return m_Breakpoints && ((m_Breakpoints->GetPageAccess(block.firstPage) | m_Breakpoints->GetPageAccess(block.lastPage)) & Breakpoints::EXECUTE);
+		}
+
+		// Returns true, and records the hit, if the instruction at the
+		// program counter is at a breakpoint
+		inline bool IsAtBreakpoint() {
+			return m_Breakpoints && (m_Breakpoints->GetPageAccess(GET_HIGH_BYTE(m_PC)) & Breakpoints::EXECUTE) && FindBreakpoint();
+		}
+
+		// The checks of breakpoints and watchpoints past their page flags
+		bool FindBreakpoint();
+		void FindWatchpoint(const word addr, const Breakpoints::Access access, const byte value) const;
+
+		// Returns the block starting at the address, decoding it if needed.
+		// Returns nullptr if the block cannot be cached.
+		CachedBlock* FindBlock(const word pc);
+
+		// Decodes and caches the block starting at the address
+		CachedBlock* DecodeBlock(const word pc);
+
+		// Finds the Memory, and the page of it, that the page of the address
+		// space reads from. Returns false if it is not directly a Memory.
+		bool FindCodeSource(const byte page, typename BlockCache<CachedOp>::Source& outSource);
+
+		// Runs the block from its start for at most the cycle budget, stopping
+		// wherever Run() would have stopped. Returns the cycles consumed, and
+		// outputs the last instruction executed.
+		uint64_t RunBlock(const CachedBlock& block, const uint64_t budget, Instruction& outInstruction);
+
+		// Number of times a block is run by RunBlock() before it is compiled
+		static constexpr unsigned int JIT_THRESHOLD = 16;
+
+		// As RunBlock(), but through the native code of the block, compiling
+		// it once it has run JIT_THRESHOLD times. Blocks that could not be
+		// compiled go straight to RunBlock().
+		uint64_t RunNative(CachedBlock& block, const uint64_t budget, Instruction& outInstruction);
+
 	public: // Address modes
 
 		virtual address ExecuteAddressing(const AddressMode addrMode, fast_byte& outCycles);
@@ -297,6 +753,26 @@ namespace mos6502 {
 		// Only used with LDX and STX instructions.
 		virtual address Addr_ZPY(fast_byte& outCycles);
 
+		// Address resolution:
+		// Each of the Addr_* methods above fetches its operand bytes from the
+		// program counter, then resolves the address from them as below.
+		// The block cache fetches the operand ahead of time and uses these
+		// directly. The operand is little-endian, the high byte being 0 for
+		// single byte operands. Immediate operands are supplied as the value.
+		address Resolve_ABS(const word operand, fast_byte& outCycles);
+		address Resolve_ABX(const word operand, fast_byte& outCycles);
+		address Resolve_ABY(const word operand, fast_byte& outCycles);
+		address Resolve_ACC(const word operand, fast_byte& outCycles);
+		address Resolve_IMM(const word operand, fast_byte& outCycles);
+		address Resolve_IMP(const word operand, fast_byte& outCycles);
+		address Resolve_IND(const word operand, fast_byte& outCycles);
+		address Resolve_INX(const word operand, fast_byte& outCycles);
+		address Resolve_INY(const word operand, fast_byte& outCycles);
+		address Resolve_REL(const word operand, fast_byte& outCycles);
+		address Resolve_ZPG(const word operand, fast_byte& outCycles);
+		address Resolve_ZPX(const word operand, fast_byte& outCycles);
+		address Resolve_ZPY(const word operand, fast_byte& outCycles);
+
 	public: // Instructions
 
 		virtual fast_byte ExecuteInstruction(const Instruction& inst, const address& addr);
@@ -476,13 +952,189 @@ namespace mos6502 {
 
 	protected: // Bus and IO systems
 
-		inline byte ReadByte(const address& addr) const override;
-		inline word ReadWord(const address& addr) const override;
-		inline void WriteByte(const address& addr, const byte data) override;
-		inline void WriteWord(const address& addr, const word data) override;
-		inline void WriteBytes(const address& addr, const std::vector<byte>& bytes) override;
+		// The memory path is defined here so that it inlines into each
+		// addressing mode and instruction. With a final bus type the
+		// bus calls themselves are resolved statically as well.
+
+		// While the bus is connected and no breakpoints or journal are
+		// attached, reads and writes go straight to it. Otherwise they take
+		// the Hooked*() path, checking them against the flags of their page
+		// for watchpoints, recording writes in the journal, and reporting a
+		// missing bus.
+
+		// Through the IODevice interface every access is a virtual call, so
+		// those to the zero page and stack page go to their host arrays
+		// instead when they can (see UpdateLowPages()). The final bus types
+		// index their pages directly already.
+
+		inline byte ReadByte(const address& addr) const override {
+			if constexpr (std::is_same_v<BusT, IODevice>) {
+				if (addr.page < 2 && m_LowPages && m_LowPages[addr.page].data)
+					return m_LowPages[addr.page].data[addr.record];
+			}
+			if (m_DirectAccess)
+				return m_Bus->ReadByte(addr);
+			return HookedReadByte(addr);
+		}
+
+		inline word ReadWord(const address& addr) const override {
+			if (m_DirectAccess)
+				return m_Bus->ReadWord(addr);
+			return HookedReadWord(addr);
+		}
+
+		inline void WriteByte(const address& addr, const byte data) override {
+			if constexpr (std::is_same_v<BusT, IODevice>) {
+				if (addr.page < 2 && WriteLowPage(addr.page, addr.record, data))
+					return;
+			}
+			if (m_DirectAccess)
+				m_Bus->WriteByte(addr, data);
+			else
+				HookedWriteByte(addr, data);
+		}
+
+		inline void WriteWord(const address& addr, const word data) override {
+			if (m_DirectAccess)
+				m_Bus->WriteWord(addr, data);
+			else
+				HookedWriteWord(addr, data);
+		}
+
+		inline void WriteBytes(const address& addr, const std::vector<byte>& bytes) override {
+			if (m_Bus)
+				m_Bus->WriteBytes(addr, bytes);
+			else
+				ReportMissingBus("WriteBytes");
+		}
+
+		inline size_t ReadBlock(const address& addr, span<byte> out) const override {
+			if (m_Bus)
+				return m_Bus->ReadBlock(addr, out);
+
+			ReportMissingBus("ReadBlock");
+			return 0;
+		}
+
+		inline size_t WriteBlock(const address& addr, span<const byte> bytes) override {
+			if (m_Bus)
+				return m_Bus->WriteBlock(addr, bytes);
+
+			ReportMissingBus("WriteBlock");
+			return 0;
+		}
+
+		inline const byte* MapPage(const byte page) const override {
+			return m_Bus ? m_Bus->MapPage(page) : nullptr;
+		}
+
+		// Reads a byte of the instruction stream (an opcode or operand).
+		// Unlike ReadByte(), never seen by watchpoints.
+		inline byte FetchByte(const address& addr) const {
+			if (m_Bus)
+				return m_Bus->ReadByte(addr);
+
+			ReportMissingBus("ReadByte");
+			return 0;
+		}
+
+		byte HookedReadByte(const address& addr) const;
+		word HookedReadWord(const address& addr) const;
+		void HookedWriteByte(const address& addr, const byte data);
+		void HookedWriteWord(const address& addr, const word data);
+
+		// Checks an access against the flags of its page
+		inline void WatchAccess(const word addr, const Breakpoints::Access access, const byte value) const {
+			if (m_Breakpoints->GetPageAccess(GET_HIGH_BYTE(addr)) & access)
+				FindWatchpoint(addr, access, value);
+		}
+
+		// Prints an error about an access attempted without a bus connected
+		static void ReportMissingBus(const char* method);
+
+		busptr m_Bus;
+
+		// Whether accesses may go straight to the bus, see ReadByte()
+		bool m_DirectAccess = false;
+
+		inline void UpdateDirectAccess() {
+			m_DirectAccess = m_Bus && !m_Breakpoints && !m_Journal;
+			UpdateLowPages();
+		}
+
+		// Decoded blocks for Run(), while enabled with SetBlockCache().
+		// Kept after the bus, so it is destroyed first.
+		std::unique_ptr<BlockCache<CachedOp>> m_BlockCache;
+
+		// Compiles blocks of the cache for RunNative(), while enabled with SetJit()
+		std::unique_ptr<JitCompiler> m_Jit;
+
+	protected: // Zero page and stack
+
+		// Pages 0 (the zero page) and 1 (the stack) are read and written
+		// straight through their host arrays, indexed by the masked 8-bit
+		// offset, whenever the bus maps them as plain memory and accesses
+		// go directly to it. Pages mapped onto a device, or read-only, take
+		// the usual path, as do writes to pages the block cache watches.
 
-		ioptr m_Bus;
+		// Finds the host arrays behind the low pages, on mounting a bus or
+		// attaching breakpoints. For a Bus they are its own page entries, so
+		// they follow any remapping.
+		void UpdateLowPages();
+
+		// As UpdateLowPages(), for a Memory mounted whole or behind a FlatMemoryBus
+		void MapLowPages(Memory& memory);
+
+		// Writes the byte if the page is a writable host array, marking it
+		// dirty. Returns false, having written nothing, otherwise.
+		inline bool WriteLowPage(const byte page, const byte offset, const byte data) {
+			if (!m_LowPages)
+				return false;
+
+			const Bus::Page& low = m_LowPages[page];
+			if (!low.writable || (*low.code & low.dirtyMask))
+				return false;
+
+			low.writable[offset] = data;
+			*low.dirty |= low.dirtyMask;
+			return true;
+		}
+
+		// Reads the 16-bit pointer at the zero page offset, whose high byte
+		// wraps round to $00 when the low byte is at $FF. Otherwise it is one
+		// 16-bit load out of the host array.
+		inline word ReadZeroPageWord(const byte offset) const {
+			if (m_LowPages && m_LowPages[0].data) {
+				const byte* zp = m_LowPages[0].data;
+				if (offset != 0xFF) {
+					// Indexed from the one pointer, so the two byte loads merge
+					const byte* pointer = zp + offset;
+					return MAKE_WORD(pointer[0], pointer[1]);
+				}
+				return MAKE_WORD(zp[0xFF], zp[0x00]);
+			}
+
+			const byte low = ReadByte(address(0, offset));
+			const byte high = ReadByte(address(0, static_cast<byte>(offset + 1)));
+			return MAKE_WORD(low, high);
+		}
+
+		inline byte ReadStack(const byte offset) const {
+			if (m_LowPages && m_LowPages[1].data)
+				return m_LowPages[1].data[offset];
+			return ReadByte(address(1, offset));
+		}
+
+		inline void WriteStack(const byte offset, const byte data) {
+			if (!WriteLowPage(1, offset, data))
+				WriteByte(address(1, offset), data);
+		}
+
+		// The entries for pages 0 and 1, or nullptr while accesses may not
+		// go directly to the bus. Points into m_OwnLowPages, or at the page
+		// table of a Bus.
+		const Bus::Page* m_LowPages = nullptr;
+		std::array<Bus::Page, 2> m_OwnLowPages{};
 
 	protected: // General
 
@@ -490,7 +1142,53 @@ namespace mos6502 {
 		fast_byte m_CyclesRem = 0;
 
 		// Number of clock cycles executed since object inseption.
-		unsigned int m_CyclesExecuted = 0;
+		uint64_t m_CyclesExecuted = 0;
+
+		// Events due at cycles of m_CyclesExecuted
+		EventScheduler m_Scheduler;
+
+		// Number of instructions executed since construction.
+		uint64_t m_InstructionsExecuted = 0;
+
+		// Interrupts requested through RequestIRQ() and RequestNMI()
+		bool m_PendingIRQ = false;
+		bool m_PendingNMI = false;
+
+		// Why the last call to Run() returned
+		StopReason m_StopReason = StopReason::NONE;
+
+		// Optional breakpoints and watchpoints stopping Run()
+		Breakpoints* m_Breakpoints = nullptr;
+
+		// What stopped Run() last, and whether a watchpoint was touched by
+		// the instruction being run. Set by reads, so mutable.
+		mutable Breakpoints::Hit m_BreakpointHit{};
+		mutable bool m_WatchpointHit = false;
+
+		// Optional journal recording the steps for StepBack()
+		Journal* m_Journal = nullptr;
+
+		// Notes the old value of a byte about to be written, if it changes
+		// and the page is plain memory
+		void JournalWrite(const address& addr, const byte data);
+
+		inline Journal::Registers GetJournalRegisters() const {
+			return Journal::Registers{
+				m_PC, m_SP, m_Acc, m_X, m_Y, GetStatus().value,
+				static_cast<byte>(m_CyclesRem), m_CyclesExecuted, m_InstructionsExecuted,
+				m_PendingIRQ, m_PendingNMI
+			};
+		}
+
+#ifdef MOS6502_TRACE
+		// Optional trace buffer receiving a record per instruction
+		TraceBuffer* m_Trace = nullptr;
+#endif
+
+#ifdef MOS6502_PROFILE
+		// Optional profile counting each instruction
+		Profile* m_Profile = nullptr;
+#endif
 
 		// Whether the addressing mode had the value supplied
 		bool m_WasSupplied = false;
@@ -523,6 +1221,41 @@ namespace mos6502 {
 
 		byte PullFromStack();
 
-	}; // class CPU
+		// Fetches, decodes and executes the instruction at the program counter.
+		// Returns the cycle cost, and outputs the instruction that was executed.
+		fast_byte ExecuteNext(Instruction& outInstruction);
+
+		// Runs the scheduled events that are due, at an instruction boundary
+		inline void RunDueEvents() {
+			if (m_CyclesExecuted >= m_Scheduler.GetNextDeadline())
+				m_Scheduler.RunDue(m_CyclesExecuted);
+		}
+
+		// Services a pending NMI, or an unmasked pending IRQ, if there is one.
+		// Returns true if an interrupt was serviced, its cost having been
+		// added onto the remaining cycles.
+		bool ServicePendingInterrupt();
+
+		// Performs one instruction, or services one pending interrupt, and
+		// accounts for the cycles. Used by both Step() and Run().
+		// The output instruction is left untouched if an interrupt was serviced.
+		unsigned int StepInstruction(Instruction& outInstruction);
+
+	}; // class BasicCPU
+
+	// The classic CPU, connected through the dynamic IODevice interface
+	using CPU = BasicCPU<IODevice>;
+
+	// CPU connected straight to a 64KB memory with fully inlined accesses
+	using FlatCPU = BasicCPU<FlatMemoryBus>;
+
+	// CPU connected to a page mapped Bus, with the direct page path inlined
+	using MappedCPU = BasicCPU<Bus>;
+
+	// The member definitions live in src/cpu*.cpp, and are explicitly
+	// instantiated there for each of the supported bus types above.
+	extern template class BasicCPU<IODevice>;
+	extern template class BasicCPU<FlatMemoryBus>;
+	extern template class BasicCPU<Bus>;
 
 }; // namespace mos6502
@@ -0,0 +1,100 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <array>
+
+#include "types.h"
+
+namespace mos6502 {
+
+	// Decimal Mode (BCD) arithmetic, as performed by the NMOS 6502.
+	//
+	// Each result is packed into a word. The low byte is the new accumulator,
+	// and the high byte holds the Carry, Zero, Overflow, and Negative flags in
+	// their Processor Status bit positions (the other bits are 0).
+	//
+	// The NMOS chips only correct the accumulator and carry for decimal mode.
+	// Z, N, and V come from intermediate values, which is observable by
+	// programs. The steps below follow Bruce Clark's "Decimal Mode" tutorial
+	// (6502.org, Appendix A), and also define the results of invalid BCD
+	// operands such as $0F. The benchmark's --check compares every entry of
+	// the tables below, and the CPU's decimal ADC and SBC, against a
+	// separate model of the chip.
+
+	constexpr byte DECIMAL_CARRY = 0x01;
+	constexpr byte DECIMAL_ZERO = 0x02;
+	constexpr byte DECIMAL_OVERFLOW = 0x40;
+	constexpr byte DECIMAL_NEGATIVE = 0x80;
+
+	constexpr word PackDecimalResult(const int result, const bool c, const bool z, const bool v, const bool n) {
+		const byte flags = (c ? DECIMAL_CARRY : 0) | (z ? DECIMAL_ZERO : 0) | (v ? DECIMAL_OVERFLOW : 0) | (n ? DECIMAL_NEGATIVE : 0);
+		return static_cast<word>((flags << 8) | (result & 0xFF));
+	}
+
+	// ADC with the Decimal flag set
+	constexpr word DecimalAdd(const byte a, const byte b, const bool carry) {
+		// Z is the same as for a binary addition
+		const bool z = ((a + b + (carry ? 1 : 0)) & 0xFF) == 0;
+
+		// Add the low digits, correcting them past 9
+		int low = (a & 0x0F) + (b & 0x0F) + (carry ? 1 : 0);
+		if (low >= 0x0A)
+			low = ((low + 0x06) & 0x0F) + 0x10;
+
+		// N and V are taken from the sum before the high digits are
+		// corrected, V treating the high digits as signed
+		int sum = (a & 0xF0) + (b & 0xF0) + low;
+		const int signedSum = static_cast<signed char>(a & 0xF0) + static_cast<signed char>(b & 0xF0) + low;
+		const bool n = sum & 0x80;
+		const bool v = signedSum < -128 || signedSum > 127;
+
+		// Correct the high digits
+		if (sum >= 0xA0)
+			sum += 0x60;
+
+		return PackDecimalResult(sum, sum >= 0x100, z, v, n);
+	}
+
+	// SBC with the Decimal flag set
+	constexpr word DecimalSubtract(const byte a, const byte b, const bool carry) {
+		// Every flag is the same as for a binary subtraction
+		const int binary = a - b - (carry ? 0 : 1);
+		const bool c = binary >= 0;
+		const bool z = (binary & 0xFF) == 0;
+		const bool v = (a ^ b) & (a ^ binary) & 0x80;
+		const bool n = binary & 0x80;
+
+		// Subtract the low digits, correcting them below 0
+		int low = (a & 0x0F) - (b & 0x0F) + (carry ? 1 : 0) - 1;
+		if (low < 0)
+			low = ((low - 0x06) & 0x0F) - 0x10;
+
+		// Then the high digits
+		int difference = (a & 0xF0) - (b & 0xF0) + low;
+		if (difference < 0)
+			difference -= 0x60;
+
+		return PackDecimalResult(difference, c, z, v, n);
+	}
+
+	// Number of entries in each decimal table, one per accumulator, operand, and carry
+	constexpr size_t DECIMAL_TABLE_SIZE = 2 * 256 * 256;
+
+	constexpr size_t DecimalIndex(const byte a, const byte b, const bool carry) {
+		return (carry ? 0x10000 : 0) | (static_cast<size_t>(a) << 8) | b;
+	}
+
+	// Every DecimalAdd and DecimalSubtract result, indexed by DecimalIndex().
+	// These are too large to generate at compile time within the constexpr
+	// limits of common compilers, so they are filled in from the functions
+	// above during static initialization instead.
+	extern const std::array<word, DECIMAL_TABLE_SIZE> DecimalAddTable;
+	extern const std::array<word, DECIMAL_TABLE_SIZE> DecimalSubtractTable;
+}
@@ -0,0 +1,71 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "types.h"
+#include "instructions.h"
+#include "io_device.h"
+#include "trace.h"
+
+namespace mos6502 {
+
+	// Formats byte code and trace records as text, decoded with the
+	// InstructionDetails table. Everything is written into a char buffer
+	// supplied by the caller, with the hex digits taken from a lookup table,
+	// so that nothing is allocated for each line. Dumps of millions of
+	// instructions cost the time to write them out, and little else.
+	class Disassembler {
+	public:
+		// The longest line FormatInstruction() writes, newline included:
+		//	"C000  6C 00 C1  JMP ($C100)"
+		static constexpr size_t MAX_INSTRUCTION_LENGTH = 28;
+
+		// The length of every line FormatRecord() writes, newline included.
+		// Lines are padded to the same length, so record i of a trace is
+		// always at i * TRACE_LINE_LENGTH of its text:
+		//	"000000000000001C  C000  A9  LDA #$10     A=00 X=00 Y=00 SP=FD PS=[czidbUvn]"
+		static constexpr size_t TRACE_LINE_LENGTH = 76;
+
+		// Writes one line for the instruction whose opcode is code[0], at
+		// the address pc, into out (which must have room for
+		// MAX_INSTRUCTION_LENGTH chars). Operand bytes beyond the end of
+		// the code are shown as missing. Returns the number of chars written.
+		static size_t FormatInstruction(char* out, const word pc, span<const byte> code);
+
+		// Disassembles the code, whose first byte is at the address base,
+		// into the buffer, one line per instruction, starting offset bytes
+		// into the code. Writes as many whole lines as fit, and moves the
+		// offset on past them. Returns the number of chars written.
+		static size_t Disassemble(span<char> out, span<const byte> code, const word base, size_t& offset);
+
+		// Writes the disassembly of the addresses first..last of the device
+		static void Disassemble(std::ostream& os, const IODevice& device, const word first, const word last);
+
+		// Writes the line for a trace record into out, which must have room
+		// for TRACE_LINE_LENGTH chars. The operand is read from memory (the
+		// whole of the address space, as it is now) when given, otherwise
+		// the addressing mode is shown. Returns TRACE_LINE_LENGTH.
+		static size_t FormatRecord(char* out, const TraceRecord& record, span<const byte> memory = {});
+
+		// Formats as many of the records as fit into the buffer, starting
+		// from the index, and moves the index on past them. Returns the
+		// number of chars written.
+		static size_t FormatTrace(span<char> out, span<const TraceRecord> records, size_t& index, span<const byte> memory = {});
+
+		// Formats a binary trace file, as written by TraceDrain::MakeStreamSink(),
+		// into a text file of one line per record. The records are split into
+		// chunks formatted in parallel over a pool of threads (as many as the
+		// host has, if 0), each straight into its place in the text file.
+		// Returns false if a file could not be read or written.
+		static bool FormatTraceFile(const std::string& tracePath, const std::string& textPath, const unsigned int threads = 0, span<const byte> memory = {});
+	};
+}
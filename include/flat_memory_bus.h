@@ -0,0 +1,107 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <memory>
+
+#include "types.h"
+#include "io_device.h"
+#include "memory.h"
+#include "utils.h"
+
+namespace mos6502 {
+	// A statically-typed bus connecting the address space directly to a
+	// single, full 64KB Memory object.
+	// The class and its methods are final and defined inline, so when used
+	// as the bus type of a BasicCPU (see FlatCPU) every read and write
+	// compiles down to a single index into the memory's byte array,
+	// with no virtual calls.
+	//
+	// NOTE: Accesses go straight to the memory data, any overrides of the
+	// Memory IODevice methods in a subclass are not used.
+	class FlatMemoryBus final : public IODevice {
+	public:
+		static std::shared_ptr<FlatMemoryBus> Make(std::shared_ptr<Memory> mem = nullptr);
+
+		// Connects the given memory. If the memory is missing, or does not
+		// cover the full 64KB address space, a new 64KB memory is made instead.
+		FlatMemoryBus(std::shared_ptr<Memory> mem = nullptr);
+
+		// Return the pointer to the attached memory object
+		inline const std::shared_ptr<Memory>& GetMemory() const { return m_Memory; }
+
+	public: // Implement IODevice
+
+		// Read a single 8-bit byte from the address specified and return it
+		inline byte ReadByte(const address& addr) const override {
+			return m_Data[addr.value];
+		}
+
+		// Read a single 16-bit (2 byte) word from the address specified and return it
+		inline word ReadWord(const address& addr) const override {
+			const byte low = m_Data[addr.value];
+			const byte high = m_Data[static_cast<word>(addr.value + 1)];
+			return MAKE_WORD(low, high);
+		}
+
+		// Write a single 8-bit byte to the address specified
+		inline void WriteByte(const address& addr, const byte data) override {
+			m_Data[addr.value] = data;
+			MarkDirty(addr);
+		}
+
+		// Write a single 16-bit (2 byte) word to the address specified
+		inline void WriteWord(const address& addr, const word data) override {
+			const address next = static_cast<word>(addr.value + 1);
+			m_Data[addr.value] = GET_LOW_BYTE(data);
+			m_Data[next.value] = GET_HIGH_BYTE(data);
+			MarkDirty(addr);
+			MarkDirty(next);
+		}
+
+		// Write a vector of bytes to the device, starting at the offset and consuming the whole vector
+		inline void WriteBytes(const address& offset, const std::vector<byte>& bytes) override {
+			m_Memory->WriteBytes(offset, bytes);
+		}
+
+		// Bulk reads and writes go straight to the memory
+		inline size_t ReadBlock(const address& offset, span<byte> out) const override {
+			return m_Memory->ReadBlock(offset, out);
+		}
+
+		inline size_t WriteBlock(const address& offset, span<const byte> bytes) override {
+			return m_Memory->WriteBlock(offset, bytes);
+		}
+
+		inline const byte* MapPage(const byte page) const override {
+			return m_Data + page * Memory::PAGE_SIZE;
+		}
+
+	private:
+		// Flags the page as written in the memory's dirty page bitmap (see Memory::Snapshot),
+		// letting the memory notify its code watchers if the page holds code (see Memory::WatchCode)
+		inline void MarkDirty(const address& addr) {
+			const uint64_t mask = uint64_t(1) << (addr.page % 64);
+			m_Dirty[addr.page / 64] |= mask;
+			if (m_Code[addr.page / 64] & mask)
+				m_Memory->MarkDirty(addr.value);
+		}
+
+		std::shared_ptr<Memory> m_Memory;
+
+		// Cached pointer to the memory's data, always 64KB in size
+		byte* m_Data = nullptr;
+
+		// Cached pointer to the memory's dirty page bitmap
+		uint64_t* m_Dirty = nullptr;
+
+		// Cached pointer to the memory's watched code page bitmap
+		const uint64_t* m_Code = nullptr;
+	};
+}
@@ -8,9 +8,12 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "types.h"
+#include "utils.h"
 
 namespace mos6502 {
 
@@ -19,6 +22,9 @@ namespace mos6502 {
 	// implement this interface to declare how memory is read/wrote.
 	class IODevice {
 	public:
+		// Size of the address space of the 16-bit address bus
+		static constexpr size_t ADDRESS_SPACE_SIZE = MAKE_KB(64);
+
 		// Read a single 8-bit byte from the address specified and return it
 		virtual byte ReadByte(const address& addr) const = 0;
 
@@ -34,6 +40,36 @@ namespace mos6502 {
 		// Write a vector of bytes to the device, starting at the offset and consuming the whole vector
 		virtual void WriteBytes(const address& offset, const std::vector<byte>& bytes) = 0;
 
+		// Reads bytes into the span, starting at the offset. Stops at the end
+		// of the device, or of the 64KB address space, without wrapping.
+		// Returns the number of bytes read.
+		// NOTE: Defaults to a ReadByte() per byte, devices backed by a byte
+		// array should copy directly instead.
+		virtual size_t ReadBlock(const address& offset, span<byte> out) const {
+			const size_t length = std::min<size_t>(out.size(), ADDRESS_SPACE_SIZE - offset.value);
+			for (size_t i = 0; i < length; i++)
+				out[i] = ReadByte(static_cast<word>(offset.value + i));
+			return length;
+		}
+
+		// Writes the bytes of the span, starting at the offset. Stops at the
+		// end of the device, or of the 64KB address space, without wrapping.
+		// Returns the number of bytes written (or ignored, if read-only).
+		// NOTE: Defaults to a WriteByte() per byte, as with ReadBlock().
+		virtual size_t WriteBlock(const address& offset, span<const byte> bytes) {
+			const size_t length = std::min<size_t>(bytes.size(), ADDRESS_SPACE_SIZE - offset.value);
+			for (size_t i = 0; i < length; i++)
+				WriteByte(static_cast<word>(offset.value + i), bytes[i]);
+			return length;
+		}
+
+		// Returns a pointer straight to the 256 bytes of the page, for reading,
+		// or nullptr if the device does not hold the page as a byte array.
+		// The pointer stays valid until the device's mapping changes.
+		// NOTE: There is no writable equivalent, writes have to be made through
+		// the device, so that they are seen by snapshots and the block cache.
+		virtual const byte* MapPage(const byte /*page*/) const { return nullptr; }
+
 		virtual void Write(const address& addr, const byte data) { WriteByte(addr, data); }
 		virtual void Write(const address& addr, const word data) { WriteWord(addr, data); }
 		virtual void Write(const address& addr, const std::vector<byte>& data) { WriteBytes(addr, data); }
@@ -41,4 +77,10 @@ namespace mos6502 {
 
 	// Shared pointer to an IODevice
 	using ioptr = std::shared_ptr<IODevice>;
+
+	// Copies length bytes from one device to another (or within the same
+	// device), as a DMA controller would. Moves a page at a time, straight out
+	// of the source's pages where it maps them. Returns the number of bytes
+	// copied, which stops short at the end of either address space.
+	size_t TransferBlock(IODevice& dest, const address& destOffset, const IODevice& source, const address& sourceOffset, const size_t length);
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+#include "utils.h"
+
+// The JIT compiler only generates x86-64 code. Elsewhere (or when compiled
+// with MOS6502_NO_JIT) it is never available, and the CPU keeps to the
+// block cache.
+#if !defined(MOS6502_NO_JIT) && (defined(_M_X64) || defined(__x86_64__))
+#define MOS6502_JIT_X64
+#endif
+
+namespace mos6502 {
+
+	// The registers and memory handed to compiled code, and what it hands
+	// back. The offsets of the fields are built into the generated code.
+	struct JitState {
+		byte* memory;				// The 64KB address space
+		uint64_t* dirty;			// Dirty page bitmap of the memory (see Memory::Snapshot)
+		const uint64_t* code;		// Code page bitmap of the memory (see Memory::WatchCode)
+
+		uint64_t cycles;			// Cycles run, starting from 0
+		uint64_t instructions;		// Instructions run, starting from 0
+		uint64_t cycleLimit;		// A block jumping back to its own start repeats while cycles is below this
+
+		word pc;
+		word codeAddress;			// The address written, when codeWritten is set
+
+		byte acc;
+		byte x;
+		byte y;
+		byte sp;
+		byte status;				// The Processor Status, without Z and N
+		byte resultZ;				// Z and N, evaluated lazily as by the CPU
+		byte resultN;
+
+		// Set when the code stopped after writing to a code page. The write
+		// has been made, but the memory has not yet been told about it.
+		bool codeWritten;
+	};
+
+	// Compiled code for (the start of) a basic block
+	using JitFunction = void(*)(JitState* state);
+
+	// An instruction of a basic block, as handed to the compiler
+	struct JitInstruction {
+		word pc;
+		word operand;		// The operand bytes, little-endian
+		byte opCode;
+	};
+
+	// What has been compiled for a basic block
+	struct JitBlock {
+		// Runs the instructions from the start of the block up to the first
+		// that could not be compiled, or nullptr if not compiled (yet)
+		JitFunction function = nullptr;
+
+		// The most cycles the compiled instructions but the last may take.
+		// Starting it with a larger cycle budget left, the compiled code runs
+		// every instruction that Run() would.
+		unsigned int maxCyclesBeforeLast = 0;
+
+		// Number of times the block has been run, and whether compiling it
+		// has been tried
+		unsigned int runs = 0;
+		bool attempted = false;
+	};
+
+	// Compiles basic blocks of 6502 code into x86-64 machine code, run by
+	// the FlatCPU (see BasicCPU::SetJit).
+	//
+	// NOTE: The common instructions on the registers and memory are
+	// compiled, with their flags and cycle counts exactly as interpreted. A
+	// block stops being compiled at the first instruction that is not, such
+	// as one changing the interrupt flag (which could leave an interrupt
+	// pending) or stopping Run() (BRK). The compiled code also stops before
+	// an ADC or SBC in decimal mode, and after writing to a code page.
+	//
+	// A block whose last instruction jumps back to its start (a tight loop)
+	// repeats inside the compiled code, while the cycle budget allows.
+	//
+	// The memory compiled into is never writable and executable at once.
+	// Compile() makes the pages it writes to writable, and executable again
+	// once the code is in place.
+	class JitCompiler {
+	public:
+		// Default size of the executable memory the code is compiled into
+		static constexpr size_t DEFAULT_CODE_SIZE = MAKE_KB(4096);
+
+		// Fewest instructions worth compiling, unless the block loops back
+		// to its own start. Shorter blocks run as fast through the block
+		// cache, which has less to set up per block.
+		static constexpr size_t MIN_LENGTH = 3;
+
+		// Allocates the memory the code is compiled into. The compiler is
+		// unavailable if that fails, if the host will not let that memory be
+		// made executable, or on hosts other than x86-64.
+		JitCompiler(const size_t codeSize = DEFAULT_CODE_SIZE);
+		~JitCompiler();
+
+		// No Copying, the compiled code is owned by the compiler
+		JitCompiler(const JitCompiler&) = delete;
+		JitCompiler& operator=(const JitCompiler&) = delete;
+
+		// Returns true if code can be compiled on this host
+		inline bool IsAvailable() const { return m_Code != nullptr; }
+
+		// Compiles the instructions of a block into the JitBlock. Returns
+		// false if too few could be compiled, or if the executable memory is
+		// full (see IsFull()).
+		bool Compile(const std::vector<JitInstruction>& instructions, JitBlock& outBlock);
+
+		// Returns true if the last Compile() ran out of executable memory
+		inline bool IsFull() const { return m_Full; }
+
+		// Throws away all of the compiled code, every JitFunction returned so
+		// far becomes invalid
+		void Reset();
+
+		// Returns true if the instruction can be compiled
+		static bool IsCompilable(const byte opCode);
+
+	private:
+		// Makes the pages holding the range of the code memory executable
+		// (and read-only), or writable (and not executable)
+		bool Protect(const size_t offset, const size_t size, const bool executable);
+
+		byte* m_Code = nullptr;
+		size_t m_CodeSize = 0;
+		size_t m_CodeUsed = 0;
+		size_t m_PageSize = 0;
+		bool m_Full = false;
+
+		// Set if compiled code could not be made executable again
+		bool m_Failed = false;
+	};
+}
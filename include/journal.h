@@ -0,0 +1,141 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+namespace mos6502 {
+
+	// Records what each step of a CPU (an instruction, or the servicing of
+	// an interrupt) changed, so that the steps can be undone one at a time
+	// with BasicCPU::StepBack(). See BasicCPU::AttachJournal().
+	//
+	// A step is kept as one variable-length record in a fixed-size ring of
+	// bytes: the cycles it took, the old values of only the registers it
+	// changed, and the address and old value of each byte it wrote through
+	// the CPU, usually 3 to 8 bytes in all. When the ring is full the oldest
+	// records are dropped to make room, so the journal reaches back as far
+	// as its capacity allows. To go back further, take a snapshot every so
+	// often, restore the one before the point wanted, and run forward.
+	//
+	// Only writes made by the CPU to pages of plain memory (those with an
+	// IODevice::MapPage()) are recorded. Writes made from outside the CPU,
+	// such as by scheduled events or the host, and the scheduled events
+	// themselves, are not.
+	class Journal {
+	public:
+		// The CPU state kept in a record, as BasicCPU::State
+		struct Registers {
+			word pc;
+			byte sp, acc, x, y, status;
+
+			byte cyclesRem;
+			uint64_t cyclesExecuted;
+			uint64_t instructionsExecuted;
+
+			bool pendingIRQ, pendingNMI;
+		};
+
+		// A byte written by a step, and what was there before
+		struct Write {
+			word addr;
+			byte old;
+		};
+
+		// The most writes a step may make. One making more cannot be undone,
+		// and the journal is cleared instead (no instruction or interrupt
+		// writes more than 3).
+		static constexpr size_t MAX_WRITES = 8;
+
+		// The bytes written by a step, in the order they were made
+		struct Writes {
+			std::array<Write, MAX_WRITES> entries;
+			size_t count = 0;
+		};
+
+		// Capacity, in bytes, is rounded up to the next power of two (minimum 256)
+		Journal(const size_t capacity = 1 << 20);
+
+		// Returns the number of bytes the ring can hold
+		inline size_t GetCapacity() const { return m_Data.size(); }
+
+		// Returns the number of bytes the records held take up
+		inline size_t GetSize() const { return m_Head - m_Tail; }
+
+		// Returns the number of steps held, that can be undone
+		inline size_t GetCount() const { return m_Count; }
+
+		// Returns the number of records dropped, oldest first, to make room
+		inline uint64_t GetDropped() const { return m_Dropped; }
+
+		// Forgets every step held. To be done whenever the CPU or memory is
+		// changed other than by running it, such as by a Reset() or Restore().
+		void Clear();
+
+	public: // Recording, done by the CPU
+
+		// Starts a step, forgetting the writes of any step not ended
+		inline void BeginStep() {
+			m_Writes.count = 0;
+			m_Overflow = false;
+		}
+
+		// Notes a byte written by the step
+		inline void RecordWrite(const word addr, const byte old) {
+			if (m_Writes.count < MAX_WRITES)
+				m_Writes.entries[m_Writes.count++] = Write{ addr, old };
+			else
+				m_Overflow = true;
+		}
+
+		// Ends the step, adding its record. The registers it changed are
+		// those that differ from the end of the last step recorded, rather
+		// than from its own start, so that what changed in between (such as
+		// an interrupt requested by the host) is undone along with it.
+		void EndStep(const Registers& start, const Registers& after);
+
+		// Takes off the most recent record. The registers are those after
+		// its step, and become those at the end of the step before it. The
+		// writes are output in the order they were made, to be undone in
+		// reverse.
+		// Returns false, having changed nothing, if no records are held.
+		bool Pop(Registers& registers, Writes& outWrites);
+
+	private:
+		// The most bytes a record takes up
+		static constexpr size_t MAX_RECORD = 64;
+
+		// Drops the oldest record
+		void DropOldest();
+
+		inline byte At(const size_t offset) const { return m_Data[offset & m_Mask]; }
+
+		std::vector<byte> m_Data;
+		size_t m_Mask;
+
+		// The oldest record starts at the tail, and the next is added at the
+		// head. Both only grow, and are masked into the ring.
+		size_t m_Head = 0;
+		size_t m_Tail = 0;
+		size_t m_Count = 0;
+		uint64_t m_Dropped = 0;
+
+		// The writes of the step being recorded
+		Writes m_Writes;
+		bool m_Overflow = false;
+
+		// The registers at the end of the last step recorded (or undone)
+		Registers m_Last{};
+		bool m_HasLast = false;
+	};
+}
@@ -0,0 +1,138 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "types.h"
+#include "cpu.h"
+#include "memory.h"
+
+namespace mos6502 {
+
+	// Where two cores run in lockstep first stopped agreeing, see Lockstep::Run()
+	struct LockstepDivergence {
+		// Instructions executed since Lockstep::Start(), before the
+		// instruction that diverged
+		uint64_t instruction = 0;
+
+		// The instruction, as the reference saw it before executing it
+		word pc = 0;
+		std::array<byte, 3> code{};
+
+		// Registers and timing of each core after executing it
+		Breakpoints::Registers reference{}, test{};
+		uint64_t referenceCycles = 0, testCycles = 0;
+
+		// The pages whose contents differ
+		std::vector<size_t> pages;
+
+		// False if replaying the interval the difference was found in did
+		// not find it again, in which case this is the end of that interval
+		bool exact = true;
+
+		// Formats the divergence over several lines, the instruction disassembled
+		friend std::ostream& operator<<(std::ostream& os, const LockstepDivergence& divergence);
+	};
+
+	// Runs a core under test in lockstep with the classic CPU, as the
+	// reference, and finds the first instruction on which they disagree.
+	// Used to check the faster paths (the block cache, the JIT compiler,
+	// the other bus types) instruction for instruction against the one
+	// they must behave the same as.
+	//
+	// Both cores are started from the same snapshot. The reference steps
+	// through a number of instructions, and the test core is given Run()
+	// with the cycles they took, so that it stops at the same instruction
+	// with everything it normally uses. The registers, the cycle and
+	// instruction counts, and the memory are then compared. Only the pages
+	// written since the last comparison are hashed again (see
+	// Memory::IsPageDirty), making a comparison cost little more than the
+	// writes made since. On a difference, both are taken back to the last
+	// point they agreed and run again an instruction at a time to find the
+	// one that diverged.
+	//
+	// Each Memory must be the one the core's bus reaches, and is
+	// snapshotted at every comparison. Scheduled events are neither copied
+	// nor compared, the cores should not have any.
+	template<class CPUT>
+	class Lockstep {
+	public:
+		Lockstep(CPU& reference, Memory& referenceMemory, CPUT& test, Memory& testMemory);
+
+		// No Copying, the harness holds references to the cores
+		Lockstep(const Lockstep&) = delete;
+		Lockstep& operator=(const Lockstep&) = delete;
+
+		// Sets the number of instructions run between comparisons (default 1000).
+		// Shorter intervals find a divergence with less replaying, longer ones
+		// compare less often.
+		inline void SetInterval(const uint64_t instructions) { m_Interval = instructions ? instructions : 1; }
+
+		// Returns the number of instructions run between comparisons
+		inline uint64_t GetInterval() const { return m_Interval; }
+
+		// Restores both cores to the state and memory. Returns false if a
+		// memory could not be restored to it.
+		bool Start(const CPU::State& state, const MemorySnapshot& memory);
+
+		// Runs both cores for the number of instructions, comparing them
+		// every interval and at the end. Returns the first divergence, if
+		// they disagree, after which both are left just after it.
+		std::optional<LockstepDivergence> Run(const uint64_t instructions);
+
+		// Returns the number of instructions run in agreement since Start()
+		inline uint64_t GetInstructionsCompared() const { return m_Compared; }
+
+	private:
+		// Runs the test core until it has made up the cycles and instructions
+		// of the reference
+		void CatchUp();
+
+		// Runs both cores for the number of instructions, and returns true
+		// if they still agree, or fills in the divergence
+		bool Advance(const uint64_t instructions, LockstepDivergence& outDivergence);
+
+		// Compares the cores, rehashing the pages written since the last checkpoint
+		bool Compare(LockstepDivergence& outDivergence);
+
+		// Saves both cores as the last point they agreed
+		void Checkpoint();
+
+		// Takes both cores back to the last checkpoint
+		bool Rewind();
+
+		CPU& m_Reference;
+		Memory& m_ReferenceMemory;
+		CPUT& m_Test;
+		Memory& m_TestMemory;
+
+		uint64_t m_Interval = 1000;
+		uint64_t m_Compared = 0;
+
+		// The instruction count of the reference at Start()
+		uint64_t m_StartInstructions = 0;
+
+		// The hash of every page of each memory, as of the last comparison
+		std::vector<uint64_t> m_ReferenceHashes, m_TestHashes;
+
+		// The last point the cores agreed
+		CPU::State m_ReferenceState{};
+		typename CPUT::State m_TestState{};
+		MemorySnapshot m_ReferenceSnapshot, m_TestSnapshot;
+	};
+
+	// Explicitly instantiated in src/lockstep.cpp, for each CPU type as the test core
+	extern template class Lockstep<CPU>;
+	extern template class Lockstep<FlatCPU>;
+	extern template class Lockstep<MappedCPU>;
+}
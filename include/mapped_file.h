@@ -0,0 +1,66 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "types.h"
+
+namespace mos6502 {
+
+	// A file mapped into the address space of the host, used to back a
+	// Memory (see Memory::MapFile) without copying its contents in.
+	// The operating system shares the physical pages between every mapping
+	// of the same file that has not written to them, so thousands of machines
+	// starting from the same ROM image cost the memory of one.
+	class MappedFile {
+	public:
+		// How the file is mapped
+		enum class Mode : byte {
+			READ_ONLY,	// ROM images, the mapping may not be written to at all
+			PRIVATE,	// Copy-on-write, the file itself is never changed
+			SHARED,		// Writes go through to the file (battery-backed RAM)
+		};
+
+		// Maps size bytes of the file, or the whole file if size is 0.
+		// A SHARED file is created, or grown with zeros, to hold size bytes.
+		// Returns nullptr if the file cannot be opened or mapped.
+		static std::shared_ptr<MappedFile> Open(const std::string& path, const Mode mode, const size_t size = 0);
+
+		~MappedFile();
+
+		// No Copying, the mapping is owned
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// Returns the first byte of the mapping
+		inline byte* GetData() const { return m_Data; }
+
+		// Returns the number of bytes mapped
+		inline size_t GetSize() const { return m_Size; }
+
+		inline Mode GetMode() const { return m_Mode; }
+
+		// Returns true if the mapping may not be written to
+		inline bool IsReadOnly() const { return m_Mode == Mode::READ_ONLY; }
+
+		// Waits for the writes to a SHARED file to reach the disk. They are
+		// kept regardless, this only matters should the host go down.
+		bool Flush();
+
+	private:
+		MappedFile(byte* data, const size_t size, const Mode mode) : m_Data(data), m_Size(size), m_Mode(mode) {}
+
+		byte* m_Data;
+		size_t m_Size;
+		Mode m_Mode;
+	};
+}
@@ -8,56 +8,132 @@
  */
 #pragma once
 
+#include <array>
+#include <memory>
 #include <vector>
 
 #include "types.h"
 #include "io_device.h"
+#include "mapped_file.h"
 #include "utils.h"
 
 namespace mos6502 {
+	class Memory;
+
+	// Receives notice of writes to pages of a Memory holding code that has
+	// been decoded ahead of time (see Memory::WatchCode), so that the
+	// decoded copy can be thrown away.
+	class CodeWatcher {
+	public:
+		virtual ~CodeWatcher() = default;
+
+		// Called when a watched page is written. The watch on the page has
+		// already been removed, so this is only called once per WatchCode().
+		virtual void OnCodeWritten(Memory& memory, const size_t page) = 0;
+
+		// Called when the memory is destroyed, removing every watch on it
+		virtual void OnMemoryDestroyed(Memory& memory) = 0;
+	};
+
+	// A saved copy of a Memory's contents, taken with Memory::Snapshot().
+	// The contents are held as immutable 256-byte page images, shared between
+	// every snapshot (and every Memory) in which the page did not change.
+	// Copying a snapshot is cheap, and the images are safe to share across threads.
+	class MemorySnapshot {
+	public:
+		MemorySnapshot() = default;
+
+		// Returns true if this snapshot has never been taken
+		inline bool IsEmpty() const { return m_Pages.empty(); }
+
+		// Returns the size of the memory the snapshot was taken from
+		inline size_t GetSize() const { return m_Size; }
+
+	private:
+		friend class Memory;
+
+		using PageImage = std::array<byte, 256>;
+
+		std::vector<std::shared_ptr<const PageImage>> m_Pages;
+		size_t m_Size = 0;
+	};
+
 	// Holds the memory for the mos6502 system.
 	// Originally the chip supported addressing for a max 64kb of memory.
+	//
+	// The bytes are normally allocated by the memory itself, but may instead
+	// be those of a file mapped in with MapFile(). A memory mapping a
+	// READ_ONLY file ignores every write, and is mapped read-only by a Bus.
 	class Memory : public IODevice {
 		using memory = std::vector<byte>;
 
 	public:
-		using iterator = memory::iterator;
-		using const_iterator = memory::const_iterator;
+		using iterator = byte*;
+		using const_iterator = const byte*;
 
 		// Instantiates and allocates a memory block, returning the ioptr (std::shared_ptr)
 		static ioptr Make(const size_t size = MAKE_KB(64));
 
+		// Instantiates a memory holding the mapped file (see MappedFile::Open),
+		// returning nullptr if the file cannot be mapped
+		static std::shared_ptr<Memory> MapFile(const std::string& path, const MappedFile::Mode mode, const size_t size = 0);
+
 		Memory(const size_t sizeBytes = MAKE_KB(64));
 
-		//Allow Moving
-		Memory(Memory&&) = default;
-		Memory& operator=(Memory&&) = default;
+		// Uses the mapped file as the contents, keeping it alive
+		Memory(std::shared_ptr<MappedFile> file);
+
+		// Uses the caller's bytes as the contents, nothing is allocated for
+		// them. They must outlive the memory. See System.
+		Memory(span<byte> storage);
+
+		// Code watchers are told the memory is gone
+		~Memory();
+
+		// Allow Moving, code watchers stay with (and are told of the end of) the old memory
+		Memory(Memory&& other);
+		Memory& operator=(Memory&&) = delete;
 
 		// No Copying
 		Memory(const Memory&) = delete;
 		Memory& operator=(const Memory&) = delete;
 
+		// Number of bytes in each page tracked for snapshots
+		static constexpr size_t PAGE_SIZE = 256;
+
 		// Resets each value in the memory scope with the specified value (default 0)
 		virtual inline void Clear(const byte value = 0) {
-			std::fill(m_Data.begin(), m_Data.end(), value);
+			if (m_ReadOnly)
+				return;
+
+			std::fill(m_Data, m_Data + m_Size, value);
+			MarkAllDirty();
 		}
 
 		// Return the fixed size of the memory
 		inline const size_t GetSize() const { return m_Size; }
 
 		// Return a pointer to the underlying data container
-		inline byte* GetData() { return m_Data.data(); }
+		// NOTE: The data of a read-only memory may not be written through
+		// this pointer, the host would fault.
+		inline byte* GetData() { return m_Data; }
+
+		// Returns true if the memory maps a READ_ONLY file, ignoring writes
+		inline bool IsReadOnly() const { return m_ReadOnly; }
+
+		// Returns the file the memory maps, if any
+		inline const std::shared_ptr<MappedFile>& GetFile() const { return m_File; }
 
 		// Prints the provided range of pages to the standard output
 		void Print(const fast_byte start, const fast_byte end, const fast_byte bytesPerLine = 16);
 
 		// Iterator implementations
-		iterator begin() { return m_Data.begin(); }
-		iterator end() { return m_Data.end(); }
-		const_iterator begin() const { return m_Data.begin(); }
-		const_iterator end() const { return m_Data.end(); }
-		const_iterator cbegin() const { return m_Data.cbegin(); }
-		const_iterator cend() const { return m_Data.cend(); }
+		iterator begin() { return m_Data; }
+		iterator end() { return m_Data + m_Size; }
+		const_iterator begin() const { return m_Data; }
+		const_iterator end() const { return m_Data + m_Size; }
+		const_iterator cbegin() const { return m_Data; }
+		const_iterator cend() const { return m_Data + m_Size; }
 
 		// Collection wrappers
 		size_t size() const { return GetSize(); }
@@ -65,8 +141,76 @@ namespace mos6502 {
 		void clear() { Clear(0); }
 
 		// Subscript operator
+		// NOTE: Writes made through this, or through GetData(), are not seen
+		// by the dirty page tracking. Call MarkDirty() after making them.
 		byte& operator[](size_t i) { return m_Data[i]; }
 
+	public: // Snapshots
+
+		// Saves the current contents. Only the pages written since the last
+		// Snapshot() or Restore() are copied, the rest are shared with the
+		// previous snapshot.
+		MemorySnapshot Snapshot();
+
+		// Returns the contents to those of the snapshot. Only the pages written
+		// since the last Snapshot() or Restore(), and those that differ between
+		// the two snapshots, are copied back.
+		// Returns false if the snapshot was taken from a memory of another size,
+		// or if a read-only memory would have to change.
+		bool Restore(const MemorySnapshot& snapshot);
+
+		// Flags the page holding the given offset as written to
+		inline void MarkDirty(const size_t offset) {
+			const size_t page = offset / PAGE_SIZE;
+			const uint64_t mask = uint64_t(1) << (page % 64);
+			m_Dirty[page / 64] |= mask;
+			if (m_Code[page / 64] & mask)
+				CodeWritten(page);
+		}
+
+		// Flags every page overlapping the range as written to
+		void MarkDirty(const size_t offset, const size_t length);
+
+		// Flags every page as written to
+		void MarkAllDirty();
+
+		// Returns true if the page has been written since the last Snapshot() or Restore()
+		inline bool IsPageDirty(const size_t page) const {
+			return m_Dirty[page / 64] & (uint64_t(1) << (page % 64));
+		}
+
+		// Returns the number of pages tracked, the last may be partial
+		inline size_t GetPageCount() const { return (m_Size + PAGE_SIZE - 1) / PAGE_SIZE; }
+
+		// Returns a 64-bit hash of the contents of the page, for telling
+		// cheaply whether two memories hold the same page
+		uint64_t HashPage(const size_t page) const;
+
+		// Returns the dirty page bitmap, one bit per page, 64 pages per word.
+		// Used by buses writing directly into the data to mark their writes.
+		inline uint64_t* GetDirtyBitmap() { return m_Dirty.data(); }
+
+	public: // Code watching
+
+		// Asks for the watcher to be told the next time the page is written,
+		// whether through this Memory, a Bus, a FlatMemoryBus, Clear(), Restore(),
+		// or MarkDirty(). Like the dirty page tracking, writes made straight
+		// into GetData() are not seen.
+		// Used by the CPU block cache (see BasicCPU::SetBlockCache).
+		void WatchCode(const size_t page, CodeWatcher* watcher);
+
+		// Forgets the watcher entirely, it will not be called again
+		void RemoveCodeWatcher(CodeWatcher* watcher);
+
+		// Returns true if the page is being watched for writes
+		inline bool IsCodePage(const size_t page) const {
+			return m_Code[page / 64] & (uint64_t(1) << (page % 64));
+		}
+
+		// Returns the watched page bitmap, laid out like the dirty page bitmap.
+		// Used by buses writing directly into the data to check their writes.
+		inline const uint64_t* GetCodeBitmap() const { return m_Code.data(); }
+
 	public: // Implement IODevice
 
 		// Read a single 8-bit byte from the address specified and return it
@@ -84,10 +228,37 @@ namespace mos6502 {
 		// Write a vector of bytes to the device, starting at the offset and consuming the whole vector
 		virtual void WriteBytes(const address& offset, const std::vector<byte>& bytes);
 
+		// Copies bytes straight out of the memory into the span
+		virtual size_t ReadBlock(const address& offset, span<byte> out) const override;
+
+		// Copies bytes straight into the memory, marking the pages dirty
+		virtual size_t WriteBlock(const address& offset, span<const byte> bytes) override;
+
+		// Returns the page of the byte array, if the memory holds all of it
+		virtual const byte* MapPage(const byte page) const override;
+
 	private:
+		// Removes the watch on the page and notifies the watchers
+		void CodeWritten(const size_t page);
+
 		const size_t m_Size;
 
-		memory m_Data;
+		// The contents, either m_Storage or the mapped m_File
+		byte* m_Data = nullptr;
+		memory m_Storage;
+		std::shared_ptr<MappedFile> m_File;
+		bool m_ReadOnly = false;
+
+		// One bit per page, set when the page is written
+		std::vector<uint64_t> m_Dirty;
+
+		// One bit per page, set while a watcher holds code decoded from the page
+		std::vector<uint64_t> m_Code;
+		std::vector<CodeWatcher*> m_CodeWatchers;
+
+		// Page images of the last Snapshot() or Restore(), which the
+		// clean pages still match
+		std::vector<std::shared_ptr<const MemorySnapshot::PageImage>> m_Base;
 	};
 }
 
@@ -14,9 +14,15 @@
 
 #include "io_device.h"
 #include "bus.h"
+#include "flat_memory_bus.h"
 #include "memory.h"
 #include "program.h"
 #include "cpu.h"
+#include "batch.h"
+#include "disassembler.h"
+#include "lockstep.h"
+#include "system.h"
+#include "wide_cpu.h"
 
 namespace mos6502 {
 	// Device is a convienience struct for holding
@@ -24,6 +30,12 @@ namespace mos6502 {
 	// "virtual machine".
 	// It's not formally neccessary.
 	struct Device {
+		// Saved state of the whole device, see Snapshot()
+		struct State {
+			CPU::State cpu;
+			MemorySnapshot memory;
+		};
+
 		std::shared_ptr<Program> program = nullptr;
 		std::shared_ptr<Memory> memory = nullptr;
 		std::shared_ptr<Bus> bus = nullptr;
@@ -43,5 +55,21 @@ namespace mos6502 {
 			// memory access
 			cpu = std::make_shared<CPU>(bus);
 		}
+
+		// Saves the CPU and memory. Only the memory pages written since the
+		// last Snapshot() or Restore() are copied.
+		State Snapshot() {
+			return State{ cpu->Snapshot(), memory->Snapshot() };
+		}
+
+		// Returns the CPU and memory to a saved state, copying back only the
+		// memory pages that differ from it.
+		bool Restore(const State& state) {
+			if (!memory->Restore(state.memory))
+				return false;
+
+			cpu->Restore(state.cpu);
+			return true;
+		}
 	};
 }
\ No newline at end of file
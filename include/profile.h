@@ -0,0 +1,116 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "instructions.h"
+
+// Profiling is compiled into the CPU only when MOS6502_PROFILE is defined
+// for the build, as with MOS6502_TRACE. Without it the CPU has no hooks
+// for a Profile at all, and nothing is counted.
+
+namespace mos6502 {
+
+	class Program;
+
+	// Counters of where the emulated time goes, filled in by a CPU with the
+	// profile attached (see BasicCPU::AttachProfile()). Every counter is a
+	// flat array indexed by opcode, address, or addressing mode, so counting
+	// an instruction is a handful of increments and no lookups.
+	class Profile {
+	public:
+		// What the samples of WriteFoldedStacks() count
+		enum class Weight : byte {
+			CYCLES,			// Clock cycles spent on the instructions
+			INSTRUCTIONS,	// Times the instructions were executed
+		};
+
+		Profile();
+
+		// Zeros every counter
+		void Reset();
+
+		// Counts an instruction executed at the address, and the cycles it took
+		inline void RecordInstruction(const word pc, const byte opCode, const unsigned int cycles) {
+			m_OpCodeInstructions[opCode]++;
+			m_OpCodeCycles[opCode] += cycles;
+			m_AddressHits[pc]++;
+			m_AddressCycles[pc] += cycles;
+		}
+
+		// Counts the extra cycle taken by crossing a page with the addressing mode
+		inline void RecordPageCrossing(const AddressMode mode) {
+			m_PageCrossings[static_cast<size_t>(mode)]++;
+		}
+
+		// Counts a branch instruction as taken or not
+		inline void RecordBranch(const byte opCode, const bool taken) {
+			(taken ? m_BranchesTaken : m_BranchesNotTaken)[opCode]++;
+		}
+
+		// Returns the number of times the opcode (an index of InstructionDetails) was executed
+		inline uint64_t GetInstructions(const byte opCode) const { return m_OpCodeInstructions[opCode]; }
+
+		// Returns the number of cycles spent on the opcode
+		inline uint64_t GetCycles(const byte opCode) const { return m_OpCodeCycles[opCode]; }
+
+		// Returns the number of instructions executed from the address
+		inline uint64_t GetHits(const word pc) const { return m_AddressHits[pc]; }
+
+		// Returns the number of cycles spent on the instructions at the address
+		inline uint64_t GetAddressCycles(const word pc) const { return m_AddressCycles[pc]; }
+
+		// Returns the number of page crossing penalties taken by the addressing mode.
+		// Only ABX, ABY, INY, and REL (taken branches) have them.
+		inline uint64_t GetPageCrossings(const AddressMode mode) const { return m_PageCrossings[static_cast<size_t>(mode)]; }
+
+		inline uint64_t GetBranchesTaken(const byte opCode) const { return m_BranchesTaken[opCode]; }
+		inline uint64_t GetBranchesNotTaken(const byte opCode) const { return m_BranchesNotTaken[opCode]; }
+
+		// Returns the total number of instructions counted
+		uint64_t GetTotalInstructions() const;
+
+		// Returns the total number of cycles counted
+		uint64_t GetTotalCycles() const;
+
+		// Writes the samples in the folded stacks format read by flamegraph.pl,
+		// inferno, and speedscope: one "frame;frame;frame count" line for each
+		// address executed. Given the program that was run, each address is
+		// attributed to its source line, under the label the line follows
+		// (the nearest symbol at or before it that is the address of a line).
+		void WriteFoldedStacks(std::ostream& os, const Program* program = nullptr, const Weight weight = Weight::CYCLES) const;
+
+		// As above, to a file. Returns false if it could not be written.
+		bool WriteFoldedStacks(const std::string& filepath, const Program* program = nullptr, const Weight weight = Weight::CYCLES) const;
+
+		// Prints the totals, the most executed opcodes, page crossings, and branches
+		friend std::ostream& operator<<(std::ostream& os, const Profile& p);
+
+	private:
+		static constexpr size_t ADDRESS_COUNT = 0x10000;
+
+		// Counted for each of the 256 opcodes
+		std::array<uint64_t, 256> m_OpCodeInstructions;
+		std::array<uint64_t, 256> m_OpCodeCycles;
+		std::array<uint64_t, 256> m_BranchesTaken;
+		std::array<uint64_t, 256> m_BranchesNotTaken;
+
+		// Counted for each address mode
+		std::array<uint64_t, static_cast<size_t>(AddressMode::ZPY) + 1> m_PageCrossings;
+
+		// Counted for each of the 64KB addresses
+		std::vector<uint64_t> m_AddressHits;
+		std::vector<uint64_t> m_AddressCycles;
+	};
+}
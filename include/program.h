@@ -8,12 +8,17 @@
  */
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "instructions.h"
+#include "mapped_file.h"
 
 namespace mos6502 {
 
@@ -24,13 +29,43 @@ namespace mos6502 {
 	public:
 
 	public:
+		// Labels and assigned symbols, keyed by their upper-cased name
+		using SymbolTable = std::unordered_map<std::string, word>;
+
 		static std::optional<std::shared_ptr<Program>> CompileFile(const std::string& filepath);
 
+		// Extension of the object files written next to the source by CompileFileCached()
+		static constexpr const char* OBJECT_EXTENSION = ".m65";
+
+		// As CompileFile(), but loads the object file saved the last time the
+		// source was assembled if the source has not changed since, and saves
+		// a new one otherwise. An empty objectPath uses the source path with
+		// OBJECT_EXTENSION in place of its extension.
+		static std::optional<std::shared_ptr<Program>> CompileFileCached(const std::string& filepath, const std::string& objectPath = "");
+
+		// Loads a program from an object file written by SaveObject()
+		static std::optional<std::shared_ptr<Program>> LoadObjectFile(const std::string& filepath);
+
+		// Links modules (see CompileModuleFile()) into one program. Each
+		// symbol may only be defined by one module, and is seen by all of
+		// them. Relocatable modules are placed in the order given, from $0200
+		// onwards, in the first space left free by the modules before them
+		// and by every module placed with "*=". The program's byte code runs
+		// from the lowest address of any module to the end of the highest.
+		static std::optional<std::shared_ptr<Program>> Link(const std::vector<std::shared_ptr<Program>>& modules);
+
+		// Assembles each file as a module, spread over a number of threads
+		// (0 for one per hardware thread), then links them in the order given
+		static std::optional<std::shared_ptr<Program>> CompileFiles(const std::vector<std::string>& filepaths, const unsigned int threads = 0);
+
 		struct Line {
 			const unsigned int lineNumber;
 			int pcOffset;
 
-			std::string raw, comment;
+			// Where the code of the line (trimmed, without the comment) and the
+			// comment are in the source, see GetRaw() and GetComment()
+			uint32_t rawOffset, rawLength;
+			uint32_t commentOffset, commentLength;
 
 			byte opCode;
 			Instruction instruction;
@@ -42,29 +77,129 @@ namespace mos6502 {
 	public:
 		Program() = default;
 
+		// Assembles the file, which is mapped into memory rather than read
 		bool CompileSourceFile(const std::string& filepath);
-		bool CompileString(const std::string& source);
+
+		// Assembles a copy of the source
+		bool CompileString(const std::string_view source);
+
+		// Assembles the file as a module, for Link(). Symbols it does not
+		// define are imported from the other modules. Unless the PC is moved
+		// with "*=" before any labels or code, the module is relocatable:
+		// its code is placed by the linker, and its labels are offsets from
+		// there until linked.
+		bool CompileModuleFile(const std::string& filepath);
+
+		// Assembles a copy of the source as a module, as CompileModuleFile()
+		bool CompileModuleString(const std::string_view source);
+
+		// Returns true if the program was assembled as a module, and is not yet linked
+		bool IsModule() const { return m_Module; }
+
+		// Returns true if the module's code is to be placed by the linker
+		bool IsRelocatable() const { return m_Relocatable; }
+
+		// Returns the symbols the module uses but does not define, upper-cased
+		const std::vector<std::string>& GetImports() const { return m_Imports; }
+
+		// Saves the assembled program as a binary object file: the byte code,
+		// starting PC, symbols, and source lines, along with a hash of the
+		// source it was assembled from
+		bool SaveObject(const std::string& filepath) const;
+
+		// Replaces the program with one saved by SaveObject()
+		bool LoadObject(const std::string& filepath);
+
+		// Returns the hash of the source the program was assembled from
+		uint64_t GetSourceHash() const { return m_SourceHash; }
+
+		// Hashes source code as for GetSourceHash() (64-bit FNV-1a)
+		static uint64_t HashSource(const std::string_view source);
 
 		const std::string& GetPath() const { return m_Path; }
 
 		const std::string& GetName() const { return m_Name; }
 		void SetName(const std::string& name) { m_Name = name; }
 
+		// Returns the address the byte code starts at, the lowest assembled to
 		const word& GetStartingPCOffset() const { return m_StartingPCOffset; }
 
 		const std::vector<Line>& GetSourceCode() const { return m_SourceCode; }
+
+		// Returns the source the lines were assembled from. For a program
+		// loaded from an object file, this only holds the text of its lines.
+		std::string_view GetSource() const;
+
+		// Returns the code of the line, trimmed and without its comment
+		std::string_view GetRaw(const Line& line) const { return GetSource().substr(line.rawOffset, line.rawLength); }
+
+		// Returns the comment of the line, without the ';'
+		std::string_view GetComment(const Line& line) const { return GetSource().substr(line.commentOffset, line.commentLength); }
+
 		const std::vector<byte>& GetByteCode() const { return m_ByteCode; }
 
+		const SymbolTable& GetSymbols() const { return m_Symbols; }
+
 	protected:
 
 
 	private:
+		// An operand only known once linked, the value of which is
+		//	addend + bases * (base address of the module) + imports...
+		// with the selector ('<' or '>') applied after
+		struct Relocation {
+			// Index of the line in m_SourceCode
+			uint32_t line;
+
+			int addend;
+			int bases;
+			char selector;
+
+			// The imports added or subtracted, [termsBegin, termsEnd) of m_RelocationTerms
+			uint32_t termsBegin, termsEnd;
+		};
+
+		struct RelocationTerm {
+			bool negative;
+
+			// Index of the symbol in m_Imports
+			uint32_t import;
+		};
+
+		// Maps a source file into memory, reporting why if it cannot be
+		static std::shared_ptr<MappedFile> OpenSourceFile(const std::string& filepath);
+
+		bool AssembleFile(const std::string& filepath, const bool module);
+
+		// Assembles whatever GetSource() returns
+		bool Assemble(const bool module);
+
+		// Checks that the value fits the operand of the instruction at pc,
+		// and turns it into the operand's bytes (a branch target into its offset)
+		static bool EncodeOperand(const InstructionDetail& detail, const int pc, int& value, std::string& outError);
+
 		std::string m_Path, m_Name;
 
+		// The source, either a copy or the mapped file
+		std::string m_SourceStorage;
+		std::shared_ptr<MappedFile> m_SourceFile;
+
+		uint64_t m_SourceHash = 0;
+
 		word m_StartingPCOffset = 0x0200;
 
 		std::vector<Line> m_SourceCode;
 		std::vector<byte> m_ByteCode;
+
+		SymbolTable m_Symbols;
+
+		// What a module leaves for Link() to finish
+		bool m_Module = false;
+		bool m_Relocatable = false;
+		std::unordered_set<std::string> m_RelocatableSymbols;
+		std::vector<std::string> m_Imports;
+		std::vector<RelocationTerm> m_RelocationTerms;
+		std::vector<Relocation> m_Relocations;
 	};
 	
 	using progptr = std::shared_ptr<Program>;
@@ -0,0 +1,71 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "types.h"
+
+namespace mos6502 {
+
+	// Identifies a scheduled event, for cancelling it
+	using EventId = uint64_t;
+
+	// Run when an event is due, given the cycle it was scheduled for
+	using EventCallback = std::function<void(uint64_t cycle)>;
+
+	// Callbacks scheduled on the CPU's absolute cycle counter, for devices
+	// such as timers and video to act (and raise IRQ/NMI) at exact cycles.
+	// Kept as a min-heap, so only the earliest deadline is ever looked at.
+	//
+	// NOTE: Events run at the first instruction boundary at or after their
+	// cycle, the CPU's state being that of the boundary.
+	class EventScheduler {
+	public:
+		// The deadline while nothing is scheduled
+		static constexpr uint64_t NEVER = UINT64_MAX;
+
+		// Schedules the callback for the absolute cycle. Events due on the
+		// same cycle run in the order they were scheduled.
+		EventId Schedule(const uint64_t cycle, EventCallback callback);
+
+		// Removes a scheduled event. Returns false if it has already run, or
+		// was never scheduled.
+		bool Cancel(const EventId id);
+
+		// Removes every scheduled event
+		void Clear();
+
+		// Returns the cycle of the earliest scheduled event, or NEVER
+		inline uint64_t GetNextDeadline() const { return m_Deadline; }
+
+		// Returns the number of events scheduled
+		inline size_t GetCount() const { return m_Events.size(); }
+
+		// Runs, earliest first, every event due at or before the cycle.
+		// Includes those the callbacks schedule for it.
+		void RunDue(const uint64_t cycle);
+
+	private:
+		struct Event {
+			uint64_t cycle;
+			EventId id;
+			EventCallback callback;
+		};
+
+		// Heap order, putting the earliest (then first scheduled) on top
+		static bool IsLater(const Event& a, const Event& b);
+
+		std::vector<Event> m_Events;
+		EventId m_NextId = 1;
+		uint64_t m_Deadline = NEVER;
+	};
+}
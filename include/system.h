@@ -0,0 +1,123 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.h"
+#include "cpu.h"
+#include "flat_memory_bus.h"
+#include "memory.h"
+
+namespace mos6502 {
+
+	// A whole machine, a FlatCPU on a FlatMemoryBus to a 64KB Memory, held
+	// in one object: the bytes of the memory, the Memory, the bus and the
+	// CPU laid out together, starting on a cache line. Making one is a
+	// single allocation (or none, placed in a SystemPool), and the parts are
+	// wired together with shared pointers that own nothing, so copying them
+	// around counts no references.
+	//
+	// A system is meant to be reused rather than destroyed. Clear() and
+	// Load() take it back to its power-on state without allocating or
+	// freeing anything, only zeroing the pages written since the last time.
+	//
+	// NOTE: The shared pointers returned by the CPU's GetBus() and the bus's
+	// GetMemory() do not keep the system alive.
+	class alignas(64) System {
+	public:
+		// Size of the memory, the whole address space
+		static constexpr size_t MEMORY_SIZE = FlatMemoryBus::ADDRESS_SPACE_SIZE;
+
+		// Makes a cleared system
+		System();
+
+		// No Copying or Moving, the parts point at each other
+		System(const System&) = delete;
+		System& operator=(const System&) = delete;
+
+		inline FlatCPU& GetCPU() { return m_CPU; }
+		inline FlatMemoryBus& GetBus() { return m_Bus; }
+		inline Memory& GetMemory() { return m_Memory; }
+
+		// Returns to the power-on state: the memory zeroed, the registers
+		// and the cycle and instruction counts zero, and no interrupts or
+		// events waiting. Attached breakpoints, traces and profiles, and the
+		// block cache and JIT settings, are kept.
+		// Only the pages written since the last Clear() are zeroed (see
+		// Memory::IsPageDirty), writes made straight into the memory's
+		// GetData() must be marked with Memory::MarkDirty().
+		void Clear();
+
+		// Clears the system, copies the program into the memory at the
+		// load address, and resets the CPU to start at the entry.
+		void Load(span<const byte> program, const word loadAddress, const word entry);
+
+	private:
+		// The contents of m_Memory, first so that they start on the cache line
+		std::array<byte, MEMORY_SIZE> m_Data;
+
+		Memory m_Memory;
+		FlatMemoryBus m_Bus;
+		FlatCPU m_CPU;
+	};
+
+	// A fixed number of Systems placed side by side in one block of memory,
+	// given to the pool by the caller or allocated once by the pool itself.
+	// Acquire() and Release() hand them out and take them back without
+	// allocating, so machines can be made and thrown away at the rate of
+	// Clear().
+	//
+	// Not thread-safe. Give each thread a pool of its own.
+	class SystemPool {
+	public:
+		// Returns the bytes of arena needed for the number of systems,
+		// wherever in memory the arena starts
+		static constexpr size_t GetArenaSize(const size_t count) {
+			return count * sizeof(System) + alignof(System) - 1;
+		}
+
+		// Allocates room for, and makes, the number of systems
+		SystemPool(const size_t count);
+
+		// Makes as many systems as fit in the arena, which must outlive the pool
+		SystemPool(span<byte> arena);
+
+		// Destroys the systems, whether they were released or not
+		~SystemPool();
+
+		// No Copying, the systems are handed out by address
+		SystemPool(const SystemPool&) = delete;
+		SystemPool& operator=(const SystemPool&) = delete;
+
+		// Returns the number of systems in the pool
+		inline size_t GetCapacity() const { return m_Count; }
+
+		// Returns the number of systems not handed out
+		inline size_t GetAvailable() const { return m_Free.size(); }
+
+		// Hands out a cleared system, or nullptr if all of them are in use
+		System* Acquire();
+
+		// Takes back a system given out by Acquire()
+		void Release(System* system);
+
+	private:
+		// Makes the systems in the block, from its first aligned address
+		void Place(byte* block, const size_t size);
+
+		std::unique_ptr<byte[]> m_Storage;
+		System* m_Systems = nullptr;
+		size_t m_Count = 0;
+
+		// Reserved for every system up front, so it never grows
+		std::vector<System*> m_Free;
+	};
+}
@@ -0,0 +1,125 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+// Execution tracing is compiled into the CPU only when MOS6502_TRACE is
+// defined for the build. Without it, none of the hooks below exist in the
+// CPU and the core runs with no per-instruction tracing cost whatsoever.
+
+namespace mos6502 {
+
+	// A single fixed-size binary trace record.
+	// One is captured per executed instruction, holding the machine state
+	// as it was just before the opcode at pc ran.
+	struct TraceRecord {
+		uint64_t cycle;	// Total cycles executed at the time of fetch
+
+		word pc;		// Address of the opcode
+		byte opCode;	// The opcode that was fetched
+
+		byte acc, x, y, sp, status;
+	};
+	static_assert(sizeof(TraceRecord) == 16, "TraceRecord is expected to be a packed 16 bytes");
+
+	// Lock-free single-producer/single-consumer ring of trace records.
+	// The CPU is the producer, and a TraceDrain (or any other single thread)
+	// is the consumer. When the ring is full, new records are dropped and
+	// counted rather than stalling the emulation.
+	class TraceBuffer {
+	public:
+		// Capacity is rounded up to the next power of two (minimum 2)
+		TraceBuffer(const size_t capacity = 1 << 16);
+
+		// No Copying or Moving, the atomics are shared across threads
+		TraceBuffer(const TraceBuffer&) = delete;
+		TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+		// Returns the number of records the ring can hold
+		inline size_t GetCapacity() const { return m_Records.size(); }
+
+		// Returns the number of records dropped because the ring was full
+		inline uint64_t GetDropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+		// Returns true if there are no records waiting to be consumed
+		inline bool IsEmpty() const {
+			return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+		}
+
+		// Pushes a record onto the ring (producer side).
+		// Returns false, and counts a drop, if the ring was full.
+		inline bool Push(const TraceRecord& record) {
+			const size_t head = m_Head.load(std::memory_order_relaxed);
+			if (head - m_Tail.load(std::memory_order_acquire) >= m_Records.size()) {
+				m_Dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			m_Records[head & m_Mask] = record;
+			m_Head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Pops up to maxCount records into the output array (consumer side).
+		// Returns the number of records that were copied out.
+		size_t Pop(TraceRecord* out, const size_t maxCount);
+
+	private:
+		std::vector<TraceRecord> m_Records;
+		size_t m_Mask;
+
+		// Kept on separate cache lines so the producer and consumer
+		// do not contend on each others index.
+		alignas(64) std::atomic<size_t> m_Head{ 0 };
+		alignas(64) std::atomic<size_t> m_Tail{ 0 };
+		alignas(64) std::atomic<uint64_t> m_Dropped{ 0 };
+	};
+
+	// Drains a TraceBuffer asynchronously on a background thread,
+	// handing batches of records to the supplied sink.
+	// The sink is only ever called from the drain thread.
+	class TraceDrain {
+	public:
+		using Sink = std::function<void(const TraceRecord* records, size_t count)>;
+
+		// Returns a sink writing the raw binary records to the given stream.
+		// The stream must outlive the drain.
+		static Sink MakeStreamSink(std::ostream& os);
+
+		// Starts the background thread immediately
+		TraceDrain(TraceBuffer& buffer, Sink sink, const size_t batchSize = 4096);
+
+		// Stops the thread, consuming anything left in the buffer first
+		~TraceDrain();
+
+		TraceDrain(const TraceDrain&) = delete;
+		TraceDrain& operator=(const TraceDrain&) = delete;
+
+		// Stops the background thread after the buffer has been emptied.
+		// Safe to call more than once.
+		void Stop();
+
+	private:
+		void Run();
+
+		TraceBuffer& m_Buffer;
+		Sink m_Sink;
+		std::vector<TraceRecord> m_Batch;
+
+		std::atomic<bool> m_Running{ true };
+		std::thread m_Thread;
+	};
+}
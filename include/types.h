@@ -8,9 +8,12 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <iomanip>
+#include <type_traits>
+#include <utility>
 
 namespace mos6502 {
 	// single 8-bit unsigned integer
@@ -50,4 +53,41 @@ namespace mos6502 {
 			return os;
 		}
 	};
-}
\ No newline at end of file
+
+	// A view of a contiguous run of elements owned by someone else, standing
+	// in for C++20's std::span. Made from a pointer and a count, or from any
+	// container with data() and size() (such as std::vector or std::array).
+	template<class T>
+	class span {
+	public:
+		using element_type = T;
+		using iterator = T*;
+
+		constexpr span() = default;
+		constexpr span(T* data, const size_t size) : m_Data(data), m_Size(size) {}
+
+		template<class Container, class = std::enable_if_t<
+			std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+		constexpr span(Container&& container) : m_Data(container.data()), m_Size(container.size()) {}
+
+		constexpr T* data() const { return m_Data; }
+		constexpr size_t size() const { return m_Size; }
+		constexpr bool empty() const { return m_Size == 0; }
+
+		constexpr T* begin() const { return m_Data; }
+		constexpr T* end() const { return m_Data + m_Size; }
+
+		constexpr T& operator[](const size_t i) const { return m_Data[i]; }
+
+		// Returns the count elements starting at offset, cut short at the end
+		constexpr span subspan(const size_t offset, const size_t count = SIZE_MAX) const {
+			if (offset >= m_Size)
+				return span();
+			return span(m_Data + offset, count < m_Size - offset ? count : m_Size - offset);
+		}
+
+	private:
+		T* m_Data = nullptr;
+		size_t m_Size = 0;
+	};
+}
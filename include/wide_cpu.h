@@ -0,0 +1,183 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <array>
+#include <iostream>
+
+#include "types.h"
+#include "cpu.h"
+#include "system.h"
+
+namespace mos6502 {
+
+	// How a WideCPU spent its instructions, see WideCPU::GetStats()
+	struct WideStats {
+		// Instructions run once for all the lanes together, and the lanes
+		// that took part in them added up
+		uint64_t vectorInstructions = 0;
+		uint64_t vectorLaneInstructions = 0;
+
+		// Instructions run by one lane on its own, whether the lanes were
+		// apart or together on an instruction that is not vectorized
+		uint64_t scalarInstructions = 0;
+
+		// Times the lanes were together on an instruction that is not
+		// vectorized (counting once for all of them)
+		uint64_t fallbacks = 0;
+
+		// Times the lanes split apart on a branch or return, and came back
+		// together again
+		uint64_t divergences = 0;
+		uint64_t reconvergences = 0;
+
+		// Returns the share of the lane instructions that were vectorized
+		double GetVectorFraction() const;
+
+		friend std::ostream& operator<<(std::ostream& os, const WideStats& stats);
+	};
+
+	// Runs a number of machines (lanes) on the same program at once, for
+	// fuzzing and sweeps where they mostly take the same path with
+	// different inputs. Each lane is a System of its own, with its own
+	// memory.
+	//
+	// While every running lane is at the same program counter, with the
+	// same code there, the instruction is run once for them all from
+	// registers kept side by side (A, X, Y, SP, P, and PC of every lane in
+	// an array each). The ALU operations (ADC and SBC in binary mode, AND,
+	// ORA, EOR, BIT, the compares, the shifts and ROL of the accumulator,
+	// INC and DEC, the loads, stores and transfers) are then a loop over the
+	// lanes that the compiler turns into SIMD, and the flag instructions,
+	// branches, JMP, JSR, RTS, and the stack pushes and pulls are done lane
+	// by lane without leaving the arrays. Each lane's result and flags come
+	// from the functions of alu.h, as do those of the FlatCPU's handlers.
+	//
+	// Everything else (BRK and RTI, an indirect JMP, (zp,X) addressing, ROR,
+	// the shifts of memory, and decimal mode arithmetic) falls back to the
+	// lanes' own FlatCPUs, and so to the same Ins_* handlers as any other
+	// core, for one instruction. When a branch or return splits the lanes
+	// up, each goes on alone on its FlatCPU, those furthest behind (at the
+	// lowest program counter) first, until they are all at the same place
+	// again.
+	//
+	// The results, cycle counts and stop reasons of every lane are those a
+	// FlatCPU::Run() with the same budget gives, as are the events they
+	// schedule. Lanes are only run together while none has breakpoints
+	// (or a journal, trace or profile) attached, and breakpoints are never
+	// stopped at, only watchpoints.
+	//
+	// The benchmark's --check runs random programs on 8 and 16 lanes, and
+	// compares every lane with a FlatCPU of its own (see benchmark/checks.h).
+	template<size_t Lanes>
+	class WideCPU {
+	public:
+		static_assert(Lanes > 0, "a WideCPU needs at least one lane");
+
+		using StopReason = FlatCPU::StopReason;
+
+		// Makes the lanes, each a cleared System
+		WideCPU();
+
+		// No Copying, the lanes are kept in a pool of their own
+		WideCPU(const WideCPU&) = delete;
+		WideCPU& operator=(const WideCPU&) = delete;
+
+		// Returns the number of lanes
+		static constexpr size_t GetLaneCount() { return Lanes; }
+
+		// Returns the machine of the lane. Its registers and memory may be
+		// read and changed freely in between calls to Run().
+		inline System& GetLane(const size_t lane) { return *m_Lanes[lane]; }
+
+		// Loads the program into every lane, see System::Load()
+		void Load(span<const byte> program, const word loadAddress, const word entry);
+
+		// Runs every lane for the cycle budget, or until it stops early as
+		// FlatCPU::Run() would. See GetStopReason() and GetCyclesConsumed().
+		void Run(const uint64_t cycleBudget);
+
+		// Returns why the lane stopped in the last Run()
+		inline StopReason GetStopReason(const size_t lane) const { return m_StopReasons[lane]; }
+
+		// Returns the cycles the lane consumed in the last Run()
+		inline uint64_t GetCyclesConsumed(const size_t lane) const { return m_Consumed[lane]; }
+
+		// Returns what the lanes did, added up over every Run() since
+		// construction or ResetStats()
+		inline const WideStats& GetStats() const { return m_Stats; }
+
+		inline void ResetStats() { m_Stats = WideStats{}; }
+
+	private:
+		// Why RunVector() handed the lanes back
+		enum class VectorExit : byte {
+			DONE,		// Every lane has stopped
+			FALLBACK,	// The next instruction has to be run lane by lane
+			SPLIT,		// The last instruction took the lanes different ways
+		};
+
+		// Returns true if every running lane is at the same program counter
+		bool IsConverged(word& outPC) const;
+
+		// Returns true if the running lanes may be run together
+		bool CanVectorize();
+
+		// Copies the registers of the lanes into the arrays and back
+		void Gather();
+		void Scatter();
+
+		// Runs the lanes together from the program counter, while they stay
+		// together and the instructions are vectorized
+		VectorExit RunVector(word pc);
+
+		// Runs the next instruction of the vectorized kind for every running
+		// lane. Returns false, having changed nothing, if it cannot.
+		bool StepVector(word& pc, bool& outSplit);
+
+		// Runs one instruction of the lane on its own FlatCPU
+		void StepLane(const size_t lane);
+
+		// Stops the lanes whose budget has been used up
+		void RetireLanes();
+
+		// Returns true if any lane is still running
+		bool IsRunning() const;
+
+		SystemPool m_Pool;
+		std::array<System*, Lanes> m_Lanes{};
+
+		// The bytes of each lane's memory, read directly by RunVector()
+		std::array<const byte*, Lanes> m_Data{};
+
+		// The registers of the lanes, valid while RunVector() runs them
+		alignas(64) std::array<word, Lanes> m_PC{};
+		alignas(64) std::array<byte, Lanes> m_A{}, m_X{}, m_Y{}, m_SP{}, m_P{};
+		alignas(64) std::array<uint64_t, Lanes> m_Cycles{}, m_Instructions{};
+
+		// 0xFF for each lane still running, 0 for those that have stopped
+		alignas(64) std::array<byte, Lanes> m_Running{};
+
+		// The cycle each lane's budget ends at, and its next scheduled event
+		alignas(64) std::array<uint64_t, Lanes> m_End{}, m_Deadline{};
+
+		// Whether each lane has an IRQ waiting for interrupts to be enabled
+		alignas(64) std::array<byte, Lanes> m_PendingIRQ{};
+
+		std::array<uint64_t, Lanes> m_Start{};
+		std::array<uint64_t, Lanes> m_Consumed{};
+		std::array<StopReason, Lanes> m_StopReasons{};
+
+		WideStats m_Stats;
+	};
+
+	// Explicitly instantiated in src/wide_cpu.cpp, for 8 and 16 lanes
+	extern template class WideCPU<8>;
+	extern template class WideCPU<16>;
+}
@@ -27,8 +27,8 @@ int main() {
 	std::cout << "MOS-6502 Processor Emulation" << std::endl;
 	std::cout << "============================" << std::endl;
 
-	// Compile the sample program
-	auto optProgram = mos6502::Program::CompileFile("./program.asm");
+	// Compile the sample program, or load it as assembled last time
+	auto optProgram = mos6502::Program::CompileFileCached("./program.asm");
 	if( !optProgram )
 		return EXIT_FAILURE;
 	const auto program = optProgram.value();
@@ -48,7 +48,10 @@ int main() {
 	// Construct a communication bus
 	auto bus = mos6502::Bus::Make(memory);
 
-	// Create the CPU
+	// Create the CPU, with somewhere to keep the breakpoints. They are only
+	// attached while there are any, as checking for them takes the CPU off
+	// its direct paths to memory.
+	mos6502::Breakpoints breakpoints;
 	auto cpu = mos6502::CPU(bus);
 	cpu.Reset();
 
@@ -58,7 +61,12 @@ int main() {
 	std::cout << "\tR - Reset CPU" << std::endl;
 	std::cout << "\tI - Interrupt Request" << std::endl;
 	std::cout << "\tN - Non-Maskable Interrupt" << std::endl;
-	std::cout << "\tE - Execute until cycles complete" << std::endl;
+	std::cout << "\tE - Execute one whole instruction" << std::endl;
+	std::cout << "\tG - Run until BRK, an illegal opcode, an interrupt, or a breakpoint" << std::endl;
+	std::cout << "\tB <addr> - Add a breakpoint at the hex address" << std::endl;
+	std::cout << "\tW <first> <last> - Add a read/write watchpoint on the hex address range" << std::endl;
+	std::cout << "\tC - Clear all breakpoints and watchpoints" << std::endl;
+	std::cout << "\tD <first> <last> - Disassemble the hex address range" << std::endl;
 	std::cout << "\tP - Print program counter page" << std::endl;
 	std::cout << "\tS - Print stack page" << std::endl;
 	std::cout << "\tZ - Print zero-page" << std::endl;
@@ -87,8 +95,39 @@ int main() {
 			cpu.NMI();
 			break;
 		case 'E':
-			while (cpu.Tick()) {}
+			std::cout << "Executed " << std::dec << cpu.Step() << " cycles" << std::endl;
 			break;
+		case 'G':
+			std::cout << "Ran " << std::dec << cpu.Run(UINT64_MAX) << " cycles" << std::endl;
+			if (cpu.GetStopReason() == mos6502::CPU::StopReason::BREAKPOINT || cpu.GetStopReason() == mos6502::CPU::StopReason::WATCHPOINT)
+				std::cout << "Stopped at " << cpu.GetBreakpointHit() << std::endl;
+			break;
+		case 'B': {
+			unsigned int pc = 0;
+			std::cin >> std::hex >> pc;
+			std::cout << "Breakpoint " << std::dec << breakpoints.AddBreakpoint(static_cast<mos6502::word>(pc)) << std::endl;
+			cpu.AttachBreakpoints(&breakpoints);
+			break;
+		}
+		case 'W': {
+			unsigned int first = 0, last = 0;
+			std::cin >> std::hex >> first >> last;
+			const auto id = breakpoints.AddWatchpoint(static_cast<mos6502::word>(first), static_cast<mos6502::word>(last), mos6502::Breakpoints::READ | mos6502::Breakpoints::WRITE);
+			std::cout << "Watchpoint " << std::dec << id << std::endl;
+			cpu.AttachBreakpoints(&breakpoints);
+			break;
+		}
+		case 'C':
+			breakpoints.Clear();
+			cpu.AttachBreakpoints(nullptr);
+			std::cout << "Cleared the breakpoints" << std::endl;
+			break;
+		case 'D': {
+			unsigned int first = 0, last = 0;
+			std::cin >> std::hex >> first >> last;
+			mos6502::Disassembler::Disassemble(std::cout, *memptr, static_cast<mos6502::word>(first), static_cast<mos6502::word>(last));
+			break;
+		}
 		case 'P': {
 			mos6502::fast_byte page = GET_HIGH_BYTE(cpu.GetProgramCounter());
 			memptr->Print(page, page);
@@ -12,12 +12,12 @@ START:
 	CLD
 	CLC
 	LDA #$32
-	SBC #$11	; C=0 A=20
+	SBC #$11	; C=1 A=20
 
 	CLD
 	CLC
 	LDA #0
-	SBC #1		; C=0 A=FF
+	SBC #1		; C=0 A=FE
 
 	SED
 	CLC
@@ -32,6 +32,6 @@ START:
 	SED
 	CLC
 	LDA #$21
-	SBC #$34	; C=0 A=87
+	SBC #$34	; C=0 A=86
 
     BRK
\ No newline at end of file
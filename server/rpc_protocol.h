@@ -0,0 +1,143 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+namespace mos6502 {
+namespace server {
+
+	// The binary protocol of mos6502_server. Every value is little-endian.
+	//
+	// A request is framed as:
+	//	u32 size		Bytes following this field
+	//	u32 tag			Chosen by the client, echoed in the response
+	//	u32 machine		Chosen by the client with CREATE, names the machine
+	//	u8  op			One of RpcOp
+	//	...				The payload of the op
+	//
+	// and its response as:
+	//	u32 size		Bytes following this field
+	//	u32 tag			The tag of the request
+	//	u8  status		One of RpcStatus
+	//	...				The payload of the op's response, if OK
+	//
+	// Requests may be sent without waiting for the responses. Those for one
+	// machine are executed in the order they were sent, while different
+	// machines run side by side, so responses come back in any order and
+	// are matched up by their tags. Since the client names its machines,
+	// a CREATE, LOAD and RUN can all be sent at once.
+
+	// Largest size of a request or response frame
+	constexpr uint32_t RPC_MAX_FRAME = 1 << 20;
+
+	// Most cycles a RUN runs, a larger budget stops with BUDGET after these.
+	// Keeps one request from holding a worker for more than a moment.
+	constexpr uint64_t RPC_MAX_RUN_CYCLES = 100000000;
+
+	// Most snapshots kept for a machine
+	constexpr uint32_t RPC_MAX_SNAPSHOTS = 64;
+
+	// Bytes of the header of a request after its size, and of a response
+	constexpr uint32_t RPC_REQUEST_HEADER = 9;
+	constexpr uint32_t RPC_RESPONSE_HEADER = 5;
+
+	enum class RpcOp : byte {
+		CREATE = 1,			// Makes a cleared machine for the connection
+		DESTROY,			// Throws the machine away, after its earlier requests
+		LOAD,				// u16 address, u16 entry, bytes: Clears, loads the bytes and resets
+		SET_REGISTERS,		// u16 pc, u8 sp, a, x, y, status
+		GET_REGISTERS,		// Responds with the registers
+		RUN,				// u64 cycles (up to RPC_MAX_RUN_CYCLES): Responds with u8 stop reason, u64 cycles run, the registers
+		READ,				// u16 address, u32 length: Responds with the bytes
+		WRITE,				// u16 address, bytes
+		SNAPSHOT,			// Saves the registers and memory, responds with u32 snapshot
+		RESTORE,			// u32 snapshot: Returns to the saved registers and memory
+	};
+
+	// The registers, as in responses:
+	//	u16 pc, u8 sp, a, x, y, status, u64 cycles executed, u64 instructions executed
+	constexpr uint32_t RPC_REGISTERS_SIZE = 23;
+
+	enum class RpcStatus : byte {
+		OK = 0,
+		BAD_REQUEST,		// Unknown op, or the payload is the wrong size
+		UNKNOWN_MACHINE,	// No machine of that ID on the connection
+		MACHINE_EXISTS,		// CREATE of an ID already in use
+		NO_MACHINES,		// Every machine of the server is in use
+		UNKNOWN_SNAPSHOT,	// RESTORE of a snapshot never taken
+		TOO_MANY_SNAPSHOTS,	// SNAPSHOT of a machine with RPC_MAX_SNAPSHOTS already
+	};
+
+	// Appends little-endian values to a frame
+	class RpcWriter {
+	public:
+		RpcWriter(std::vector<byte>& out) : m_Out(out) {}
+
+		inline RpcWriter& U8(const byte value) { m_Out.push_back(value); return *this; }
+		inline RpcWriter& U16(const word value) { return U8(GET_LOW_BYTE(value)).U8(GET_HIGH_BYTE(value)); }
+		inline RpcWriter& U32(const uint32_t value) { return U16(static_cast<word>(value)).U16(static_cast<word>(value >> 16)); }
+		inline RpcWriter& U64(const uint64_t value) { return U32(static_cast<uint32_t>(value)).U32(static_cast<uint32_t>(value >> 32)); }
+
+		inline RpcWriter& Bytes(span<const byte> bytes) {
+			m_Out.insert(m_Out.end(), bytes.begin(), bytes.end());
+			return *this;
+		}
+
+		// Writes the size of everything after the first four bytes into them
+		inline void FinishFrame() {
+			const uint32_t size = static_cast<uint32_t>(m_Out.size() - 4);
+			for (int i = 0; i < 4; i++)
+				m_Out[i] = static_cast<byte>(size >> (i * 8));
+		}
+
+	private:
+		std::vector<byte>& m_Out;
+	};
+
+	// Reads little-endian values from a payload. Reading past the end
+	// returns zeros and marks the reader as failed.
+	class RpcReader {
+	public:
+		RpcReader(span<const byte> in) : m_In(in) {}
+
+		inline byte U8() { return Take(1) ? m_In[m_Offset - 1] : 0; }
+		inline word U16() { const word low = U8(); return static_cast<word>(low | (U8() << 8)); }
+		inline uint32_t U32() { const uint32_t low = U16(); return low | (static_cast<uint32_t>(U16()) << 16); }
+		inline uint64_t U64() { const uint64_t low = U32(); return low | (static_cast<uint64_t>(U32()) << 32); }
+
+		// Returns the rest of the payload
+		inline span<const byte> Rest() {
+			const span<const byte> rest = m_In.subspan(m_Offset);
+			m_Offset = m_In.size();
+			return rest;
+		}
+
+		// Returns true if every read was within the payload, and all of it was read
+		inline bool IsComplete() const { return !m_Failed && m_Offset == m_In.size(); }
+
+	private:
+		inline bool Take(const size_t count) {
+			if (m_Failed || m_In.size() - m_Offset < count) {
+				m_Failed = true;
+				return false;
+			}
+			m_Offset += count;
+			return true;
+		}
+
+		span<const byte> m_In;
+		size_t m_Offset = 0;
+		bool m_Failed = false;
+	};
+}
+}
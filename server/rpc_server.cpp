@@ -0,0 +1,370 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "rpc_server.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+namespace mos6502 {
+namespace server {
+
+	struct RpcServer::Connection {
+		Stream& stream;
+
+		// Responses are written whole, one at a time
+		std::mutex writeMutex;
+
+		// Requests queued onto machines and not yet answered
+		std::mutex mutex;
+		std::condition_variable idle;
+		size_t outstanding = 0;
+
+		Connection(Stream& s) : stream(s) {}
+
+		void Send(const std::vector<byte>& frame) {
+			std::lock_guard<std::mutex> lock(writeMutex);
+			stream.Write(frame.data(), frame.size());
+		}
+	};
+
+	struct RpcServer::Machine {
+		Connection& connection;
+		System* system = nullptr;
+
+		struct Snapshot {
+			FlatCPU::State cpu;
+			MemorySnapshot memory;
+		};
+		std::vector<Snapshot> snapshots;
+
+		std::mutex mutex;
+		std::deque<Request> pending;
+
+		// Whether a worker has it, or it is in the ready queue
+		bool scheduled = false;
+
+		Machine(Connection& c, System* s) : connection(c), system(s) {}
+	};
+
+	namespace {
+		void WriteRegisters(RpcWriter& out, const FlatCPU& cpu) {
+			out.U16(cpu.GetProgramCounter())
+				.U8(cpu.GetStackPointer())
+				.U8(cpu.GetAccumulator())
+				.U8(cpu.GetX())
+				.U8(cpu.GetY())
+				.U8(cpu.GetStatus().value)
+				.U64(cpu.GetCyclesExecuted())
+				.U64(cpu.GetInstructionsExecuted());
+		}
+
+		// Begins a response frame, its size filled in by FinishFrame()
+		RpcWriter BeginResponse(std::vector<byte>& frame, const uint32_t tag, const RpcStatus status) {
+			frame.clear();
+			RpcWriter out(frame);
+			out.U32(0).U32(tag).U8(static_cast<byte>(status));
+			return out;
+		}
+	}
+
+	RpcServer::RpcServer(const size_t machines, const unsigned int threads) : m_Pool(machines) {
+		unsigned int count = threads ? threads : std::thread::hardware_concurrency();
+		if (count == 0)
+			count = 1;
+
+		m_Workers.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+			m_Workers.emplace_back(&RpcServer::WorkerMain, this);
+	}
+
+	RpcServer::~RpcServer() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Wake.notify_all();
+
+		for (std::thread& worker : m_Workers)
+			worker.join();
+	}
+
+	void RpcServer::Serve(Stream& stream) {
+		Connection connection(stream);
+		std::unordered_map<uint32_t, std::shared_ptr<Machine>> machines;
+
+		std::vector<byte> frame;
+		for (;;) {
+			byte sizeBytes[4];
+			if (!stream.Read(sizeBytes, sizeof(sizeBytes)))
+				break;
+
+			const uint32_t size = RpcReader(span<const byte>(sizeBytes, sizeof(sizeBytes))).U32();
+			if (size < RPC_REQUEST_HEADER || size > RPC_MAX_FRAME) {
+				std::cerr << "mos6502::server::RpcServer::Serve received a frame of " << size << " bytes, closing the connection" << std::endl;
+				break;
+			}
+
+			frame.resize(size);
+			if (!stream.Read(frame.data(), frame.size()))
+				break;
+
+			RpcReader header(span<const byte>(frame.data(), RPC_REQUEST_HEADER));
+			Request request;
+			request.tag = header.U32();
+			const uint32_t id = header.U32();
+			request.op = static_cast<RpcOp>(header.U8());
+			request.payload.assign(frame.begin() + RPC_REQUEST_HEADER, frame.end());
+
+			// Made here rather than by a worker, so that the requests
+			// following it have somewhere to queue
+			if (request.op == RpcOp::CREATE) {
+				if (!request.payload.empty()) {
+					Respond(connection, request.tag, RpcStatus::BAD_REQUEST);
+					continue;
+				}
+				if (machines.count(id)) {
+					Respond(connection, request.tag, RpcStatus::MACHINE_EXISTS);
+					continue;
+				}
+
+				System* system = nullptr;
+				{
+					std::unique_lock<std::mutex> lock(m_PoolMutex);
+					while (!(system = m_Pool.Acquire()) && m_Releasing > 0)
+						m_Released.wait(lock);
+				}
+				if (!system) {
+					Respond(connection, request.tag, RpcStatus::NO_MACHINES);
+					continue;
+				}
+
+				machines.emplace(id, std::make_shared<Machine>(connection, system));
+				Respond(connection, request.tag, RpcStatus::OK);
+				continue;
+			}
+
+			const auto itr = machines.find(id);
+			if (itr == machines.end()) {
+				Respond(connection, request.tag, RpcStatus::UNKNOWN_MACHINE);
+				continue;
+			}
+
+			// The ID is free again straight away, the machine goes once its
+			// earlier requests are done
+			const std::shared_ptr<Machine> machine = itr->second;
+			if (request.op == RpcOp::DESTROY) {
+				machines.erase(itr);
+
+				std::lock_guard<std::mutex> lock(m_PoolMutex);
+				m_Releasing++;
+			}
+			Enqueue(machine, std::move(request));
+		}
+
+		// Throw away the machines left, after what was sent for them
+		for (auto& entry : machines) {
+			{
+				std::lock_guard<std::mutex> lock(m_PoolMutex);
+				m_Releasing++;
+			}
+
+			Request destroy;
+			destroy.tag = 0;
+			destroy.op = RpcOp::DESTROY;
+			destroy.respond = false;
+			Enqueue(entry.second, std::move(destroy));
+		}
+		machines.clear();
+
+		std::unique_lock<std::mutex> lock(connection.mutex);
+		connection.idle.wait(lock, [&connection] { return connection.outstanding == 0; });
+	}
+
+	void RpcServer::Enqueue(const std::shared_ptr<Machine>& machine, Request request) {
+		{
+			std::lock_guard<std::mutex> lock(machine->connection.mutex);
+			machine->connection.outstanding++;
+		}
+
+		bool schedule = false;
+		{
+			std::lock_guard<std::mutex> lock(machine->mutex);
+			machine->pending.push_back(std::move(request));
+			schedule = !machine->scheduled;
+			machine->scheduled = true;
+		}
+
+		if (schedule) {
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Ready.push_back(machine);
+			}
+			m_Wake.notify_one();
+		}
+	}
+
+	void RpcServer::WorkerMain() {
+		std::vector<byte> frame;
+		for (;;) {
+			std::shared_ptr<Machine> machine;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Wake.wait(lock, [this] { return m_Stopping || !m_Ready.empty(); });
+				if (m_Ready.empty())
+					return;
+
+				machine = std::move(m_Ready.front());
+				m_Ready.pop_front();
+			}
+
+			// Everything waiting for the machine, until there is nothing left
+			for (;;) {
+				Request request;
+				{
+					std::lock_guard<std::mutex> lock(machine->mutex);
+					if (machine->pending.empty()) {
+						machine->scheduled = false;
+						break;
+					}
+					request = std::move(machine->pending.front());
+					machine->pending.pop_front();
+				}
+
+				RpcWriter response = BeginResponse(frame, request.tag, RpcStatus::OK);
+				const RpcStatus status = Execute(*machine, request, response);
+				if (request.respond) {
+					if (status != RpcStatus::OK)
+						BeginResponse(frame, request.tag, status);
+					RpcWriter(frame).FinishFrame();
+					machine->connection.Send(frame);
+				}
+
+				Connection& connection = machine->connection;
+				std::lock_guard<std::mutex> lock(connection.mutex);
+				if (--connection.outstanding == 0)
+					connection.idle.notify_all();
+			}
+		}
+	}
+
+	RpcStatus RpcServer::Execute(Machine& machine, const Request& request, RpcWriter& response) {
+		RpcReader in(request.payload);
+		System& system = *machine.system;
+		FlatCPU& cpu = system.GetCPU();
+		Memory& memory = system.GetMemory();
+
+		switch (request.op) {
+		case RpcOp::DESTROY: {
+			// Gone from the connection already, so it goes whatever the payload
+			machine.snapshots.clear();
+			{
+				std::lock_guard<std::mutex> lock(m_PoolMutex);
+				m_Pool.Release(machine.system);
+				machine.system = nullptr;
+				m_Releasing--;
+			}
+			m_Released.notify_all();
+			return in.IsComplete() ? RpcStatus::OK : RpcStatus::BAD_REQUEST;
+		}
+		case RpcOp::LOAD: {
+			const word loadAddress = in.U16();
+			const word entry = in.U16();
+			const span<const byte> program = in.Rest();
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+
+			system.Load(program, loadAddress, entry);
+			return RpcStatus::OK;
+		}
+		case RpcOp::SET_REGISTERS: {
+			FlatCPU::State state = cpu.Snapshot();
+			state.pc = in.U16();
+			state.sp = in.U8();
+			state.acc = in.U8();
+			state.x = in.U8();
+			state.y = in.U8();
+			state.status = in.U8();
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+
+			cpu.Restore(state);
+			return RpcStatus::OK;
+		}
+		case RpcOp::GET_REGISTERS:
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+
+			WriteRegisters(response, cpu);
+			return RpcStatus::OK;
+		case RpcOp::RUN: {
+			const uint64_t cycles = in.U64();
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+
+			const uint64_t consumed = cpu.Run(std::min(cycles, RPC_MAX_RUN_CYCLES));
+			response.U8(static_cast<byte>(cpu.GetStopReason())).U64(consumed);
+			WriteRegisters(response, cpu);
+			return RpcStatus::OK;
+		}
+		case RpcOp::READ: {
+			const word addr = in.U16();
+			const uint32_t length = in.U32();
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+
+			// Like Memory, the read does not wrap past the end of the address space
+			std::vector<byte> bytes(std::min<size_t>(length, System::MEMORY_SIZE - addr));
+			memory.ReadBlock(addr, bytes);
+			response.Bytes(bytes);
+			return RpcStatus::OK;
+		}
+		case RpcOp::WRITE: {
+			const word addr = in.U16();
+			const span<const byte> bytes = in.Rest();
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+
+			memory.WriteBlock(addr, bytes);
+			return RpcStatus::OK;
+		}
+		case RpcOp::SNAPSHOT:
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+			if (machine.snapshots.size() >= RPC_MAX_SNAPSHOTS)
+				return RpcStatus::TOO_MANY_SNAPSHOTS;
+
+			machine.snapshots.push_back(Machine::Snapshot{ cpu.Snapshot(), memory.Snapshot() });
+			response.U32(static_cast<uint32_t>(machine.snapshots.size() - 1));
+			return RpcStatus::OK;
+		case RpcOp::RESTORE: {
+			const uint32_t index = in.U32();
+			if (!in.IsComplete())
+				return RpcStatus::BAD_REQUEST;
+			if (index >= machine.snapshots.size())
+				return RpcStatus::UNKNOWN_SNAPSHOT;
+
+			const Machine::Snapshot& snapshot = machine.snapshots[index];
+			memory.Restore(snapshot.memory);
+			cpu.Restore(snapshot.cpu);
+			return RpcStatus::OK;
+		}
+		default:
+			return RpcStatus::BAD_REQUEST;
+		}
+	}
+
+	void RpcServer::Respond(Connection& connection, const uint32_t tag, const RpcStatus status) {
+		std::vector<byte> frame;
+		RpcWriter out = BeginResponse(frame, tag, status);
+		out.FinishFrame();
+		connection.Send(frame);
+	}
+}
+}
@@ -0,0 +1,99 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mos6502.h"
+#include "rpc_protocol.h"
+#include "stream.h"
+
+namespace mos6502 {
+namespace server {
+
+	// Serves the requests of rpc_protocol.h on a fixed number of machines
+	// (Systems of a SystemPool), shared by every connection.
+	//
+	// Each connection is read on its own thread, which does nothing but
+	// split the stream into requests and queue each onto its machine. A
+	// pool of worker threads takes machines with requests waiting and runs
+	// them, in order, writing each response as it is done. A client can
+	// keep any number of requests in flight, and the runs of different
+	// machines go on side by side.
+	//
+	// NOTE: The connection threads only ever block reading, and hold no
+	// more than a frame, so a thread per connection costs little next to
+	// the machines. Reading them all from one thread, with poll() or
+	// epoll, would only pay off with thousands of connections.
+	class RpcServer {
+	public:
+		// Makes the machines, and starts the worker threads. Zero uses one
+		// worker per hardware thread.
+		RpcServer(const size_t machines, const unsigned int threads = 0);
+
+		// Stops and joins the worker threads. Every Serve() must have returned.
+		~RpcServer();
+
+		RpcServer(const RpcServer&) = delete;
+		RpcServer& operator=(const RpcServer&) = delete;
+
+		// Serves the stream until it ends or sends a malformed frame, then
+		// waits for its requests to finish and throws its machines away.
+		// Several streams may be served at once, from different threads.
+		void Serve(Stream& stream);
+
+	private:
+		struct Connection;
+		struct Machine;
+
+		struct Request {
+			uint32_t tag;
+			RpcOp op;
+			std::vector<byte> payload;
+
+			// False for the DESTROY of machines left when the connection ends
+			bool respond = true;
+		};
+
+		// Queues the request onto the machine, in line for a worker if it
+		// was not already
+		void Enqueue(const std::shared_ptr<Machine>& machine, Request request);
+
+		void WorkerMain();
+
+		// Executes the request, appending the payload of the response, and
+		// returns its status
+		RpcStatus Execute(Machine& machine, const Request& request, RpcWriter& response);
+
+		// Writes a response with no payload
+		static void Respond(Connection& connection, const uint32_t tag, const RpcStatus status);
+
+		SystemPool m_Pool;
+		std::mutex m_PoolMutex;
+
+		// The machines with a DESTROY queued, whose systems are on their way
+		// back to the pool. A CREATE waits for them rather than failing.
+		std::condition_variable m_Released;
+		size_t m_Releasing = 0;
+
+		std::vector<std::thread> m_Workers;
+
+		// Machines with requests waiting, not yet taken by a worker
+		std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::deque<std::shared_ptr<Machine>> m_Ready;
+		bool m_Stopping = false;
+	};
+}
+}
@@ -0,0 +1,134 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rpc_server.h"
+#include "stream.h"
+
+using namespace mos6502;
+using namespace mos6502::server;
+
+namespace {
+	struct Options {
+		// Serve TCP connections on the port, rather than the standard input and output
+		int port = -1;
+
+		// The local address listened on, only this host by default
+		std::string bind = "127.0.0.1";
+
+		size_t machines = 1024;
+		unsigned int threads = 0;
+	};
+
+	void PrintUsage(const char* program) {
+		std::cerr << "Usage: " << program << " [options]" << std::endl;
+		std::cerr << "\t--port <number>      Serve TCP connections on the port (default the standard input and output)" << std::endl;
+		std::cerr << "\t--bind <address>     IPv4 address listened on, 0.0.0.0 for every interface (default 127.0.0.1)" << std::endl;
+		std::cerr << "\t--machines <count>   Machines shared by every connection (default 1024)" << std::endl;
+		std::cerr << "\t--threads <count>    Worker threads running the machines (default one per hardware thread)" << std::endl;
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& opt) {
+		for (int i = 1; i < argc; i++) {
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			// The numbers throw if they are not numbers, or are out of range
+			try {
+				if (arg == "--port" && hasValue) {
+					opt.port = std::stoi(argv[++i]);
+					if (opt.port < 0 || opt.port > 0xFFFF) {
+						std::cerr << "invalid port " << opt.port << std::endl;
+						return false;
+					}
+				} else if (arg == "--bind" && hasValue) {
+					opt.bind = argv[++i];
+				} else if (arg == "--machines" && hasValue) {
+					opt.machines = std::stoul(argv[++i]);
+				} else if (arg == "--threads" && hasValue) {
+					opt.threads = static_cast<unsigned int>(std::stoul(argv[++i]));
+				} else {
+					PrintUsage(argv[0]);
+					return false;
+				}
+			} catch (const std::exception&) {
+				std::cerr << "invalid value " << argv[i] << " for " << arg << std::endl;
+				PrintUsage(argv[0]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// A thread reading a connection, and whether it is done with it
+	struct ConnectionThread {
+		std::thread thread;
+		std::shared_ptr<std::atomic<bool>> finished;
+	};
+
+	// Joins the threads of the connections that have closed
+	void ReapConnections(std::vector<ConnectionThread>& connections) {
+		for (auto itr = connections.begin(); itr != connections.end();) {
+			if (!itr->finished->load()) {
+				++itr;
+				continue;
+			}
+
+			itr->thread.join();
+			itr = connections.erase(itr);
+		}
+	}
+}
+
+// Reports go to the standard error, the standard output may be the protocol
+int main(int argc, char** argv) {
+	Options opt;
+	if (!ParseOptions(argc, argv, opt))
+		return EXIT_FAILURE;
+
+	RpcServer server(opt.machines, opt.threads);
+
+	if (opt.port < 0) {
+		auto pipe = Stream::OpenPipe();
+		server.Serve(*pipe);
+		return EXIT_SUCCESS;
+	}
+
+	auto listener = Listener::Listen(opt.bind, static_cast<uint16_t>(opt.port));
+	if (!listener)
+		return EXIT_FAILURE;
+	std::cerr << "mos6502_server listening on " << opt.bind << " port " << opt.port << std::endl;
+
+	// A thread reading each connection, the machines are run by the server's
+	// workers. Those of closed connections are joined as the next arrives.
+	std::vector<ConnectionThread> connections;
+	while (auto stream = listener->Accept()) {
+		ReapConnections(connections);
+
+		ConnectionThread connection;
+		connection.finished = std::make_shared<std::atomic<bool>>(false);
+		connection.thread = std::thread([&server](std::unique_ptr<Stream> s, std::shared_ptr<std::atomic<bool>> finished) {
+			server.Serve(*s);
+			s.reset();
+			finished->store(true);
+		}, std::move(stream), connection.finished);
+		connections.push_back(std::move(connection));
+	}
+
+	for (ConnectionThread& connection : connections)
+		connection.thread.join();
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,170 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "stream.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <io.h>
+#include <fcntl.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <csignal>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace mos6502 {
+namespace server {
+
+	namespace {
+#ifdef _WIN32
+		using native_socket = SOCKET;
+		constexpr intptr_t NO_SOCKET = static_cast<intptr_t>(INVALID_SOCKET);
+
+		inline void CloseSocket(const intptr_t socket) { closesocket(static_cast<SOCKET>(socket)); }
+#else
+		using native_socket = int;
+		constexpr intptr_t NO_SOCKET = -1;
+
+		inline void CloseSocket(const intptr_t socket) { close(static_cast<int>(socket)); }
+
+		// Writing to a closed connection reports an error instead of ending the process
+		void IgnoreBrokenPipes() {
+			std::signal(SIGPIPE, SIG_IGN);
+		}
+#endif
+	}
+
+	std::unique_ptr<Stream> Stream::OpenPipe() {
+#ifdef _WIN32
+		_setmode(0, _O_BINARY);
+		_setmode(1, _O_BINARY);
+#else
+		IgnoreBrokenPipes();
+#endif
+		return std::unique_ptr<Stream>(new Stream(0, 1, false));
+	}
+
+	Stream::Stream(const intptr_t input, const intptr_t output, const bool socket)
+		: m_Input(input), m_Output(output), m_Socket(socket) {}
+
+	Stream::~Stream() {
+		if (m_Socket)
+			CloseSocket(m_Input);
+	}
+
+	bool Stream::Read(byte* out, const size_t size) {
+		size_t done = 0;
+		while (done < size) {
+			// Kept below INT_MAX for the Windows calls
+			const int chunk = static_cast<int>(std::min<size_t>(size - done, 1 << 30));
+#ifdef _WIN32
+			const int count = m_Socket
+				? recv(static_cast<SOCKET>(m_Input), reinterpret_cast<char*>(out + done), chunk, 0)
+				: _read(static_cast<int>(m_Input), out + done, static_cast<unsigned int>(chunk));
+#else
+			const ssize_t count = m_Socket
+				? recv(static_cast<int>(m_Input), out + done, chunk, 0)
+				: read(static_cast<int>(m_Input), out + done, chunk);
+			if (count < 0 && errno == EINTR)
+				continue;
+#endif
+			if (count <= 0)
+				return false;
+			done += static_cast<size_t>(count);
+		}
+		return true;
+	}
+
+	bool Stream::Write(const byte* data, const size_t size) {
+		size_t done = 0;
+		while (done < size) {
+			const int chunk = static_cast<int>(std::min<size_t>(size - done, 1 << 30));
+#ifdef _WIN32
+			const int count = m_Socket
+				? send(static_cast<SOCKET>(m_Output), reinterpret_cast<const char*>(data + done), chunk, 0)
+				: _write(static_cast<int>(m_Output), data + done, static_cast<unsigned int>(chunk));
+#else
+			const ssize_t count = m_Socket
+				? send(static_cast<int>(m_Output), data + done, chunk, 0)
+				: write(static_cast<int>(m_Output), data + done, chunk);
+			if (count < 0 && errno == EINTR)
+				continue;
+#endif
+			if (count <= 0)
+				return false;
+			done += static_cast<size_t>(count);
+		}
+		return true;
+	}
+
+	std::unique_ptr<Listener> Listener::Listen(const std::string& address, const uint16_t port) {
+#ifdef _WIN32
+		WSADATA data{};
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+			std::cerr << "mos6502::server::Listener::Listen failed to start Winsock" << std::endl;
+			return nullptr;
+		}
+#else
+		IgnoreBrokenPipes();
+#endif
+
+		sockaddr_in local{};
+		local.sin_family = AF_INET;
+		local.sin_port = htons(port);
+		if (inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1) {
+			std::cerr << "mos6502::server::Listener::Listen invalid IPv4 address " << address << std::endl;
+			return nullptr;
+		}
+
+		const native_socket listening = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (static_cast<intptr_t>(listening) == NO_SOCKET) {
+			std::cerr << "mos6502::server::Listener::Listen failed to make a socket" << std::endl;
+			return nullptr;
+		}
+
+		const int reuse = 1;
+		setsockopt(listening, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		if (bind(listening, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0 || listen(listening, SOMAXCONN) != 0) {
+			std::cerr << "mos6502::server::Listener::Listen failed to listen on " << address << " port " << port << std::endl;
+			CloseSocket(static_cast<intptr_t>(listening));
+			return nullptr;
+		}
+
+		return std::unique_ptr<Listener>(new Listener(static_cast<intptr_t>(listening)));
+	}
+
+	Listener::~Listener() {
+		CloseSocket(m_Socket);
+	}
+
+	std::unique_ptr<Stream> Listener::Accept() {
+		const native_socket connection = accept(static_cast<native_socket>(m_Socket), nullptr, nullptr);
+		if (static_cast<intptr_t>(connection) == NO_SOCKET)
+			return nullptr;
+
+		// Responses are written whole, there is nothing to gain from waiting to fill a packet
+		const int noDelay = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+		return std::unique_ptr<Stream>(new Stream(static_cast<intptr_t>(connection), static_cast<intptr_t>(connection), true));
+	}
+}
+}
@@ -0,0 +1,72 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "types.h"
+
+namespace mos6502 {
+namespace server {
+
+	// A two-way byte stream, the standard input and output or a TCP
+	// connection. Reading and writing may be done on different threads.
+	class Stream {
+	public:
+		// Uses the standard input and output, in binary mode
+		static std::unique_ptr<Stream> OpenPipe();
+
+		// Closes the connection, not the standard input and output
+		~Stream();
+
+		Stream(const Stream&) = delete;
+		Stream& operator=(const Stream&) = delete;
+
+		// Reads exactly the number of bytes. Returns false at the end of
+		// the stream, or on an error.
+		bool Read(byte* out, const size_t size);
+
+		// Writes all of the bytes. Returns false on an error.
+		bool Write(const byte* data, const size_t size);
+
+	private:
+		friend class Listener;
+
+		Stream(const intptr_t input, const intptr_t output, const bool socket);
+
+		// File descriptors, or a SOCKET on Windows
+		intptr_t m_Input, m_Output;
+		bool m_Socket;
+	};
+
+	// Listens for TCP connections
+	class Listener {
+	public:
+		// Listens on the port of the local IPv4 address, such as "127.0.0.1"
+		// or "0.0.0.0" for every address. Returns nullptr, and prints why,
+		// on failure.
+		static std::unique_ptr<Listener> Listen(const std::string& address, const uint16_t port);
+
+		~Listener();
+
+		Listener(const Listener&) = delete;
+		Listener& operator=(const Listener&) = delete;
+
+		// Waits for the next connection. Returns nullptr on an error.
+		std::unique_ptr<Stream> Accept();
+
+	private:
+		Listener(const intptr_t socket) : m_Socket(socket) {}
+
+		intptr_t m_Socket;
+	};
+}
+}
@@ -0,0 +1,207 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "batch.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace mos6502 {
+
+	namespace {
+		// A worker's range of job indices, packed as begin (low 32-bits) and
+		// end (high 32-bits) so both can be updated with one CAS.
+		constexpr uint64_t PackRange(const uint64_t begin, const uint64_t end) { return begin | (end << 32); }
+		constexpr uint64_t RangeBegin(const uint64_t range) { return range & 0xFFFFFFFF; }
+		constexpr uint64_t RangeEnd(const uint64_t range) { return range >> 32; }
+	}
+
+	struct BatchRunner::Worker {
+		std::thread thread;
+
+		// Job indices still to be run by this worker
+		alignas(64) std::atomic<uint64_t> range{ 0 };
+	};
+
+	BatchRunner::BatchRunner(const unsigned int threads) {
+		unsigned int count = threads ? threads : std::thread::hardware_concurrency();
+		if (count == 0)
+			count = 1;
+
+		m_Workers.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+			m_Workers.push_back(std::make_unique<Worker>());
+
+		// Started once every worker exists, as they steal from each other
+		for (auto& worker : m_Workers)
+			worker->thread = std::thread(&BatchRunner::WorkerMain, this, std::ref(*worker));
+	}
+
+	BatchRunner::~BatchRunner() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Wake.notify_all();
+
+		for (auto& worker : m_Workers) {
+			if (worker->thread.joinable())
+				worker->thread.join();
+		}
+	}
+
+	void BatchRunner::Run(const std::vector<BatchJob>& jobs, const ResultCallback& onResult) {
+		if (jobs.empty())
+			return;
+
+		if (jobs.size() > 0xFFFFFFFF) {
+			std::cerr << "mos6502::BatchRunner::Run can not run more than 2^32 jobs in one batch" << std::endl;
+			return;
+		}
+
+		// Split the jobs evenly across the workers
+		const uint64_t count = jobs.size();
+		const uint64_t workers = m_Workers.size();
+		for (uint64_t i = 0; i < workers; i++) {
+			const uint64_t begin = count * i / workers;
+			const uint64_t end = count * (i + 1) / workers;
+			m_Workers[i]->range.store(PackRange(begin, end), std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Jobs = &jobs;
+			m_Busy = static_cast<unsigned int>(m_Workers.size());
+			m_Generation++;
+		}
+		m_Wake.notify_all();
+
+		// Hand the results over as they complete
+		size_t received = 0;
+		BatchResult result;
+		while (received < jobs.size()) {
+			if (m_Completed.TryPop(result)) {
+				received++;
+				onResult(result);
+			} else {
+				std::this_thread::yield();
+			}
+		}
+
+		// Every job is done, wait for the workers to stop looking for more
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Idle.wait(lock, [this] { return m_Busy == 0; });
+		m_Jobs = nullptr;
+	}
+
+	std::vector<BatchResult> BatchRunner::Run(const std::vector<BatchJob>& jobs) {
+		std::vector<BatchResult> results(jobs.size());
+		Run(jobs, [&results](BatchResult& result) {
+			results[result.index] = std::move(result);
+		});
+		return results;
+	}
+
+	void BatchRunner::WorkerMain(Worker& worker) {
+		// The machine is made on this thread, so its memory is local to it.
+		// It is cleared rather than made again for each job.
+		auto system = std::make_unique<System>();
+
+		uint64_t generation = 0;
+		for (;;) {
+			const std::vector<BatchJob>* jobs = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Wake.wait(lock, [this, generation] { return m_Stopping || m_Generation != generation; });
+				if (m_Stopping)
+					return;
+
+				generation = m_Generation;
+				jobs = m_Jobs;
+			}
+
+			size_t index = 0;
+			while (NextJob(worker, index)) {
+				BatchResult result;
+				result.index = index;
+				Execute(*system, (*jobs)[index], result);
+
+				while (!m_Completed.TryPush(result))
+					std::this_thread::yield();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Busy--;
+			}
+			m_Idle.notify_all();
+		}
+	}
+
+	bool BatchRunner::NextJob(Worker& worker, size_t& outIndex) {
+		for (;;) {
+			// Take from the front of our own range
+			uint64_t range = worker.range.load(std::memory_order_acquire);
+			while (RangeBegin(range) < RangeEnd(range)) {
+				if (worker.range.compare_exchange_weak(range, PackRange(RangeBegin(range) + 1, RangeEnd(range)), std::memory_order_acq_rel)) {
+					outIndex = static_cast<size_t>(RangeBegin(range));
+					return true;
+				}
+			}
+
+			// Out of work, find the worker with the most left
+			Worker* victim = nullptr;
+			uint64_t victimRange = 0;
+			for (auto& other : m_Workers) {
+				const uint64_t r = other->range.load(std::memory_order_acquire);
+				if (RangeEnd(r) > RangeBegin(r) && (!victim || RangeEnd(r) - RangeBegin(r) > RangeEnd(victimRange) - RangeBegin(victimRange))) {
+					victim = other.get();
+					victimRange = r;
+				}
+			}
+
+			if (!victim)
+				return false; // Nothing left anywhere
+
+			// Steal the back half (rounded up), and run its first job
+			const uint64_t begin = RangeBegin(victimRange);
+			const uint64_t end = RangeEnd(victimRange);
+			const uint64_t split = begin + (end - begin) / 2;
+			if (!victim->range.compare_exchange_strong(victimRange, PackRange(begin, split), std::memory_order_acq_rel))
+				continue; // Lost a race, look again
+
+			worker.range.store(PackRange(split + 1, end), std::memory_order_release);
+			outIndex = static_cast<size_t>(split);
+			return true;
+		}
+	}
+
+	void BatchRunner::Execute(System& system, const BatchJob& job, BatchResult& result) {
+		FlatCPU& cpu = system.GetCPU();
+		Memory& memory = system.GetMemory();
+
+		system.Load(job.program, job.loadAddress, job.entry);
+		const uint64_t startInstructions = cpu.GetInstructionsExecuted();
+
+		result.id = job.id;
+		result.cycles = job.cycles ? cpu.Run(job.cycles) : 0;
+		result.stopReason = cpu.GetStopReason();
+		result.instructions = cpu.GetInstructionsExecuted() - startInstructions;
+
+		result.pc = cpu.GetProgramCounter();
+		result.sp = cpu.GetStackPointer();
+		result.acc = cpu.GetAccumulator();
+		result.x = cpu.GetX();
+		result.y = cpu.GetY();
+		result.status = cpu.GetStatus().value;
+
+		// Like Memory, the dump does not wrap past the end of the address space
+		result.memory.resize(std::min(job.dumpSize, Memory::ADDRESS_SPACE_SIZE - job.dumpAddress));
+		memory.ReadBlock(job.dumpAddress, result.memory);
+	}
+}
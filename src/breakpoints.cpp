@@ -0,0 +1,117 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "breakpoints.h"
+
+#include <algorithm>
+
+#include "utils.h"
+
+namespace mos6502 {
+
+	bool Breakpoints::Condition::Holds(const Registers& registers) const {
+		word actual = 0;
+		switch (reg) {
+		case Register::A:		actual = registers.acc; break;
+		case Register::X:		actual = registers.x; break;
+		case Register::Y:		actual = registers.y; break;
+		case Register::SP:		actual = registers.sp; break;
+		case Register::PC:		actual = registers.pc; break;
+		case Register::STATUS:	actual = registers.status; break;
+		}
+		actual &= mask;
+
+		switch (comparison) {
+		case Comparison::EQUAL:			return actual == value;
+		case Comparison::NOT_EQUAL:		return actual != value;
+		case Comparison::LESS:			return actual < value;
+		case Comparison::LESS_EQUAL:	return actual <= value;
+		case Comparison::GREATER:		return actual > value;
+		case Comparison::GREATER_EQUAL:	return actual >= value;
+		}
+		return false;
+	}
+
+	BreakpointId Breakpoints::AddBreakpoint(const word pc, std::vector<Condition> conditions) {
+		return Add(pc, pc, EXECUTE, std::move(conditions));
+	}
+
+	BreakpointId Breakpoints::AddConditionalBreak(std::vector<Condition> conditions) {
+		return Add(0x0000, 0xFFFF, EXECUTE, std::move(conditions));
+	}
+
+	BreakpointId Breakpoints::AddWatchpoint(const word first, const word last, const byte access, std::vector<Condition> conditions) {
+		return Add(first, last, access & (READ | WRITE), std::move(conditions));
+	}
+
+	BreakpointId Breakpoints::Add(const word first, const word last, const byte access, std::vector<Condition> conditions) {
+		const BreakpointId id = m_NextId++;
+		if (first > last || access == 0) {
+			std::cerr << "mos6502::Breakpoints::Add the range $" << address(first) << "-$" << address(last) << " is empty, or no access was given, so nothing would stop there" << std::endl;
+			return id;
+		}
+
+		m_Entries.push_back(Entry{ id, first, last, access, std::move(conditions) });
+		UpdatePages();
+		return id;
+	}
+
+	bool Breakpoints::Remove(const BreakpointId id) {
+		const auto it = std::find_if(m_Entries.begin(), m_Entries.end(), [id](const Entry& entry) { return entry.id == id; });
+		if (it == m_Entries.end())
+			return false;
+
+		m_Entries.erase(it);
+		UpdatePages();
+		return true;
+	}
+
+	void Breakpoints::Clear() {
+		m_Entries.clear();
+		UpdatePages();
+	}
+
+	std::optional<BreakpointId> Breakpoints::FindBreakpoint(const word pc, const Registers& registers) const {
+		return Find(pc, EXECUTE, registers);
+	}
+
+	std::optional<BreakpointId> Breakpoints::FindWatchpoint(const word addr, const Access access, const Registers& registers) const {
+		return Find(addr, access, registers);
+	}
+
+	std::optional<BreakpointId> Breakpoints::Find(const word addr, const Access access, const Registers& registers) const {
+		for (const Entry& entry : m_Entries) {
+			if (!(entry.access & access) || addr < entry.first || addr > entry.last)
+				continue;
+
+			const bool holds = std::all_of(entry.conditions.begin(), entry.conditions.end(),
+				[&registers](const Condition& condition) { return condition.Holds(registers); });
+			if (holds)
+				return entry.id;
+		}
+		return std::nullopt;
+	}
+
+	void Breakpoints::UpdatePages() {
+		m_Pages.fill(0);
+		m_Watching = false;
+		for (const Entry& entry : m_Entries) {
+			for (unsigned int page = GET_HIGH_BYTE(entry.first); page <= GET_HIGH_BYTE(entry.last); page++)
+				m_Pages[page] |= entry.access;
+			m_Watching = m_Watching || (entry.access & (READ | WRITE));
+		}
+	}
+
+	std::ostream& operator<<(std::ostream& os, const Breakpoints::Hit& hit) {
+		if (hit.access == Breakpoints::EXECUTE)
+			return os << "breakpoint " << std::dec << hit.id << " at $" << address(hit.addr);
+
+		os << "watchpoint " << std::dec << hit.id << (hit.access == Breakpoints::WRITE ? " write " : " read ");
+		return os << '$' << address(hit.addr) << "=$" << Hex(hit.value);
+	}
+}
@@ -8,52 +8,223 @@
  */
 #include "bus.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <typeinfo>
 
 namespace mos6502 {
 	ioptr Bus::Make(ioptr mem) {
 		return std::make_shared<Bus>(mem);
 	}
 
-	Bus::Bus(ioptr mem) : m_Memory(mem) {
-		//STUB
+	Bus::Bus(ioptr mem) {
+		MountMemory(mem);
 	}
 
-	byte Bus::ReadByte(const address& addr) const {
+	void Bus::MountMemory(ioptr mem) {
+		m_Memory.swap(mem);
+
 		if (m_Memory)
-			return m_Memory->ReadByte(addr);
+			MapDevice(m_Memory, 0, PAGE_COUNT);
 		else
-			std::cerr << "mos6502::Bus::ReadByte attempted to use memory that is not connected (nullptr)." << std::endl;
-		return 0;
+			Unmap(0, PAGE_COUNT);
 	}
 
-	word Bus::ReadWord(const address& addr) const {
-		if(m_Memory)
-			return m_Memory->ReadWord(addr);
-		else
-			std::cerr << "mos6502::Bus::ReadWord attempted to use memory that is not connected (nullptr)." << std::endl;
-		return 0;
+	void Bus::MapDevice(ioptr device, const byte firstPage, const fast_word pageCount, const word offset, const byte flags) {
+		if (firstPage + pageCount > PAGE_COUNT) {
+			std::cerr << "mos6502::Bus::MapDevice the mapping runs past the end of the address space" << std::endl;
+			return;
+		}
+
+		// Only exactly Memory can be mapped directly, subclasses may
+		// change how reads and writes behave.
+		Memory* memory = nullptr;
+		if (device && typeid(*device) == typeid(Memory))
+			memory = static_cast<Memory*>(device.get());
+
+		m_MappingVersion++;
+
+		for (fast_word i = 0; i < pageCount; i++) {
+			Page& page = m_Pages[firstPage + i];
+			page = Page{};
+			m_PageOwners[firstPage + i] = device;
+
+			if (!device)
+				continue;
+
+			page.flags = flags;
+			page.offset = static_cast<word>(offset + i * PAGE_SIZE);
+
+			if (memory) {
+				const size_t start = static_cast<size_t>(offset) + i * PAGE_SIZE;
+				if (start >= memory->GetSize()) {
+					// Leave anything outside of the memory unmapped
+					page = Page{};
+					m_PageOwners[firstPage + i] = nullptr;
+					continue;
+				} else if (start + PAGE_SIZE > memory->GetSize()) {
+					// Partially covered pages use the bounds checked methods
+					page.device = device.get();
+					continue;
+				}
+
+				page.data = memory->GetData() + start;
+				if (start % Memory::PAGE_SIZE != 0) {
+					// Straddles two of the memory's pages, so writes go through
+					// the memory itself to mark both dirty
+					page.device = device.get();
+					continue;
+				}
+
+				// A read-only memory (a mapped ROM image) cannot be written at all
+				if (memory->IsReadOnly())
+					page.flags |= static_cast<byte>(PageFlag::READ_ONLY);
+
+				page.memory = memory;
+				if (!page.HasFlag(PageFlag::READ_ONLY)) {
+					page.writable = page.data;
+					page.dirty = memory->GetDirtyBitmap() + (start / Memory::PAGE_SIZE) / 64;
+					page.code = memory->GetCodeBitmap() + (start / Memory::PAGE_SIZE) / 64;
+					page.dirtyMask = uint64_t(1) << ((start / Memory::PAGE_SIZE) % 64);
+				}
+			} else {
+				page.device = device.get();
+			}
+		}
 	}
 
-	void Bus::WriteByte(const address& addr, const byte data) {
-		if(m_Memory)
-			m_Memory->WriteByte(addr, data);
-		else
-			std::cerr << "mos6502::Bus::WriteByte attempted to use memory that is not connected (nullptr)." << std::endl;
+	void Bus::MapHostMemory(byte* data, const byte firstPage, const fast_word pageCount, const byte flags) {
+		if (firstPage + pageCount > PAGE_COUNT) {
+			std::cerr << "mos6502::Bus::MapHostMemory the mapping runs past the end of the address space" << std::endl;
+			return;
+		}
+
+		m_MappingVersion++;
+
+		for (fast_word i = 0; i < pageCount; i++) {
+			Page& page = m_Pages[firstPage + i];
+			page = Page{};
+			m_PageOwners[firstPage + i] = nullptr;
+
+			if (!data)
+				continue;
+
+			page.flags = flags;
+			page.offset = static_cast<word>(i * PAGE_SIZE);
+			page.data = data + page.offset;
+			if (!page.HasFlag(PageFlag::READ_ONLY)) {
+				page.writable = page.data;
+				page.dirty = &m_UntrackedDirty;
+				page.code = &UNTRACKED_CODE;
+				page.dirtyMask = 1;
+			}
+		}
 	}
 
-	void Bus::WriteWord(const address& addr, const word data) {
-		if (m_Memory)
-			m_Memory->WriteWord(addr, data);
-		else
-			std::cerr << "mos6502::Bus::WriteWord attempted to use memory that is not connected (nullptr)." << std::endl;
+	void Bus::MapMirror(const byte firstPage, const fast_word pageCount, const byte sourcePage, const fast_word sourceCount) {
+		if (firstPage + pageCount > PAGE_COUNT || sourcePage + sourceCount > PAGE_COUNT || sourceCount == 0) {
+			std::cerr << "mos6502::Bus::MapMirror the mirror or its source runs past the end of the address space" << std::endl;
+			return;
+		}
+
+		m_MappingVersion++;
+
+		for (fast_word i = 0; i < pageCount; i++) {
+			const fast_word source = sourcePage + (i % sourceCount);
+
+			m_Pages[firstPage + i] = m_Pages[source];
+			m_Pages[firstPage + i].flags |= static_cast<byte>(PageFlag::MIRROR);
+			m_PageOwners[firstPage + i] = m_PageOwners[source];
+		}
+	}
+
+	void Bus::Unmap(const byte firstPage, const fast_word pageCount) {
+		m_MappingVersion++;
+
+		for (fast_word i = 0; i < pageCount && firstPage + i < PAGE_COUNT; i++) {
+			m_Pages[firstPage + i] = Page{};
+			m_PageOwners[firstPage + i] = nullptr;
+		}
+	}
+
+	byte Bus::ReadDevice(const Page& page, const address& addr) const {
+		if (page.device)
+			return page.device->ReadByte(static_cast<word>(page.offset + addr.record));
+
+		return 0; // Unmapped
+	}
+
+	void Bus::WriteDevice(const Page& page, const address& addr, const byte data) {
+		if (page.device && !page.HasFlag(PageFlag::READ_ONLY))
+			page.device->WriteByte(static_cast<word>(page.offset + addr.record), data);
+	}
+
+	void Bus::CodeWritten(const Page& page) {
+		// Only pages of a Memory are ever watched, let it notify the watchers
+		page.memory->MarkDirty(static_cast<size_t>(page.writable - page.memory->GetData()));
 	}
 
 	void Bus::WriteBytes(const address& offset, const std::vector<byte>& bytes) {
-		if (m_Memory)
-			m_Memory->WriteBytes(offset, bytes);
-		else
-			std::cerr << "mos6502::Bus::WriteBytes attempted to use memory that is not connected (nullptr)." << std::endl;
+		WriteBlock(offset, bytes);
+	}
+
+	size_t Bus::ReadBlock(const address& offset, span<byte> out) const {
+		// Walk page by page, copying directly where possible.
+		// Like Memory, this does not wrap past the end of the address space.
+		const size_t total = std::min<size_t>(out.size(), ADDRESS_SPACE_SIZE - offset.value);
+		size_t index = 0;
+		while (index < total) {
+			const address addr = { static_cast<int>(offset.value + index) };
+			const Page& page = m_Pages[addr.page];
+			const span<byte> chunk = out.subspan(index, std::min<size_t>(PAGE_SIZE - addr.record, total - index));
+
+			size_t read = 0;
+			if (page.data) {
+				std::copy_n(page.data + addr.record, chunk.size(), chunk.data());
+				read = chunk.size();
+			} else if (page.device) {
+				read = page.device->ReadBlock(static_cast<word>(page.offset + addr.record), chunk);
+			}
+
+			// Whatever the device does not hold reads as 0, as with ReadByte()
+			std::fill(chunk.begin() + read, chunk.end(), 0);
+			index += chunk.size();
+		}
+
+		return total;
+	}
+
+	size_t Bus::WriteBlock(const address& offset, span<const byte> bytes) {
+		const size_t total = std::min<size_t>(bytes.size(), ADDRESS_SPACE_SIZE - offset.value);
+		size_t index = 0;
+		while (index < total) {
+			const address addr = { static_cast<int>(offset.value + index) };
+			const Page& page = m_Pages[addr.page];
+			const span<const byte> chunk = bytes.subspan(index, std::min<size_t>(PAGE_SIZE - addr.record, total - index));
+
+			if (page.writable) {
+				memmove(page.writable + addr.record, chunk.data(), chunk.size());
+				*page.dirty |= page.dirtyMask;
+				if (*page.code & page.dirtyMask)
+					CodeWritten(page);
+			} else if (page.device && !page.HasFlag(PageFlag::READ_ONLY)) {
+				page.device->WriteBlock(static_cast<word>(page.offset + addr.record), chunk);
+			}
+
+			index += chunk.size();
+		}
+
+		return total;
+	}
+
+	const byte* Bus::MapPage(const byte page) const {
+		const Page& entry = m_Pages[page];
+		if (entry.data)
+			return entry.data;
+		if (entry.device && entry.offset % PAGE_SIZE == 0)
+			return entry.device->MapPage(static_cast<byte>(entry.offset / PAGE_SIZE));
+		return nullptr;
 	}
 
-} // END - namespace mos6502
\ No newline at end of file
+} // END - namespace mos6502
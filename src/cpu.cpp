@@ -9,17 +9,21 @@
 #include "cpu.h"
 
 #include <iostream>
+#include <typeinfo>
 
 namespace mos6502 {
 
-	CPU::CPU(ioptr bus) : m_Bus(bus) {
+	template<class BusT>
+	BasicCPU<BusT>::BasicCPU(busptr bus) : m_Bus(bus) {
 		m_PC = 0;
 		m_SP = 0;
 		m_Acc = m_X = m_Y = 0;
-		m_ProcStatus = 0;
+		SetStatus(0);
+		UpdateDirectAccess();
 	}
 
-	void CPU::Reset() {
+	template<class BusT>
+	void BasicCPU<BusT>::Reset() {
 		// Clear the registers
 		m_Acc = m_X = m_Y = 0;
 
@@ -30,10 +34,15 @@ namespace mos6502 {
 		m_SP = 0xFD;
 
 		// Clear processor status except for the "unused" bit
-		m_ProcStatus = 0 | (byte)StatusFlag::UNUSED;
+		SetStatus(0 | (byte)StatusFlag::UNUSED);
 	}
 
-	bool CPU::Tick() {
+	template<class BusT>
+	bool BasicCPU<BusT>::Tick() {
+		// At an instruction boundary, events due by now come first
+		if (m_CyclesRem == 0)
+			RunDueEvents();
+
 		// Increment total cycles for posterity
 		m_CyclesExecuted++;
 
@@ -45,45 +54,249 @@ namespace mos6502 {
 		// emulation this is ok.
 		if (m_CyclesRem > 0) {
 			m_CyclesRem--;
-			std::cout << "Cycles remaining = " << Hex(m_CyclesRem) << std::endl;
 			return m_CyclesRem > 0;
 		}
 
-		std::cout << "Reading from PC " << Hex(m_PC) << std::endl;
+		// Interrupts requested with RequestIRQ/NMI land between instructions
+		if (ServicePendingInterrupt()) {
+			m_CyclesRem--; // This tick was the first cycle of the interrupt
+			return m_CyclesRem > 0;
+		}
 
-		// Read the next opcode from memory
-		const byte opcode = ReadByte(static_cast<address>(m_PC));
+		Instruction executed;
+		const fast_byte cycles = ExecuteNext(executed);
+
+		// This tick was the first cycle of the instruction
+		if (cycles > 0)
+			m_CyclesRem += cycles - 1;
+
+		return m_CyclesRem > 0;
+	}
+
+	template<class BusT>
+	unsigned int BasicCPU<BusT>::Step() {
+		Instruction executed = Instruction::NOP;
+		return StepInstruction(executed);
+	}
+
+	template<class BusT>
+	uint64_t BasicCPU<BusT>::Run(const uint64_t cycleBudget) {
+		uint64_t consumed = 0;
+
+		m_StopReason = StopReason::BUDGET;
+		m_WatchpointHit = false;
+		while (consumed < cycleBudget) {
+			// The budget given to blocks ends at the next deadline, so this is
+			// the only place Run() looks for events
+			RunDueEvents();
+
+			// An interrupt arriving mid-run hands control back to the caller,
+			// the next Step() or Run() will service it.
+			if (consumed > 0 && HasPendingInterrupt()) {
+				m_StopReason = StopReason::INTERRUPT;
+				break;
+			}
+
+			// Not the first instruction, which may be the breakpoint stopped at
+			// by the last Run()
+			if (consumed > 0 && IsAtBreakpoint()) {
+				m_StopReason = StopReason::BREAKPOINT;
+				break;
+			}
+
+			uint64_t budget = cycleBudget - consumed;
+			const uint64_t deadline = m_Scheduler.GetNextDeadline();
+			if (deadline != EventScheduler::NEVER && deadline - m_CyclesExecuted < budget)
+				budget = deadline - m_CyclesExecuted;
+
+			Instruction executed = Instruction::NOP;
+			const word pc = m_PC;
+			CachedBlock* block = CanRunBlock() ? FindBlock(m_PC) : nullptr;
+			if (block && HasBreakpointIn(*block))
+				block = nullptr;
+			if (block && m_Jit && (block->native.function || !block->native.attempted))
+				consumed += RunNative(*block, budget, executed);
+			else if (block)
+				consumed += RunBlock(*block, budget, executed);
+			else
+				consumed += StepInstruction(executed);
+
+			if (executed == Instruction::BRK) {
+				m_StopReason = StopReason::BREAK;
+				break;
+			} else if (executed == Instruction::ILL) {
+				m_StopReason = StopReason::ILLEGAL;
+				break;
+			} else if (m_WatchpointHit) {
+				m_WatchpointHit = false;
+				m_BreakpointHit.pc = pc;
+				m_StopReason = StopReason::WATCHPOINT;
+				break;
+			}
+		}
+
+		return consumed;
+	}
+
+	template<class BusT>
+	bool BasicCPU<BusT>::FindBreakpoint() {
+		const auto id = m_Breakpoints->FindBreakpoint(m_PC, GetRegisters());
+		if (!id)
+			return false;
+
+		m_BreakpointHit = Breakpoints::Hit{ *id, Breakpoints::EXECUTE, m_PC, m_PC, 0 };
+		return true;
+	}
 
-		std::cout << "OpCode = " << Hex(opcode) << std::endl;
+	template<class BusT>
+	void BasicCPU<BusT>::FindWatchpoint(const word addr, const Breakpoints::Access access, const byte value) const {
+		// The first access of an instruction is the one stopped for
+		if (m_WatchpointHit)
+			return;
+
+		if (const auto id = m_Breakpoints->FindWatchpoint(addr, access, GetRegisters())) {
+			m_BreakpointHit = Breakpoints::Hit{ *id, access, m_PC, addr, value };
+			m_WatchpointHit = true;
+		}
+	}
+
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::ExecuteNext(Instruction& outInstruction) {
+		// Read the next opcode from memory
+		const byte opcode = FetchByte(static_cast<address>(m_PC));
+
+#ifdef MOS6502_TRACE
+		// Record the state before the instruction executes
+		if (m_Trace) {
+			m_Trace->Push(TraceRecord{
+				m_CyclesExecuted,
+				m_PC,
+				opcode,
+				m_Acc, m_X, m_Y, m_SP, GetStatus().value
+			});
+		}
+#endif
 
 		// Increase the program counter since something was read
 		m_PC++;
+		m_InstructionsExecuted++;
 
 		// Retrieve the instruction details
 		const InstructionDetail& instruction = InstructionDetails[opcode];
+		outInstruction = instruction.instruction;
 
-		std::cout << "Executing Instruction \"" << GetInstructionMnmuemonic(instruction.instruction) 
-			<< "\", with addressing " << GetAddressMnmuemonic(instruction.addressing) << std::endl;
+#ifdef MOS6502_PROFILE
+		const word pc = m_PC - 1;
+#endif
 
-		// Perform addressing
-		fast_byte countAddressing = 0;
-		auto addr = ExecuteAddressing(instruction.addressing, countAddressing);
+		fast_byte cycles = 0;
+		if (m_VirtualDispatch) {
+			// Perform addressing
+			fast_byte countAddressing = 0;
+			auto addr = ExecuteAddressing(instruction.addressing, countAddressing);
 
-		// Perform instruction
-		fast_byte countInstruction = ExecuteInstruction(instruction.instruction, addr);
+			// Perform instruction
+			fast_byte countInstruction = ExecuteInstruction(instruction.instruction, addr);
 
-		// Add the cycle cost to the counter
-		m_CyclesRem += countAddressing + countInstruction;
+			cycles = countAddressing + countInstruction;
+		} else {
+			// Addressing and instruction in one specialized handler
+			cycles = DispatchTable[opcode](*this);
+		}
 
-		std::cout << "Completed, remaining cycles = " << Hex(m_CyclesRem) << std::endl;
+#ifdef MOS6502_PROFILE
+		if (m_Profile) {
+			m_Profile->RecordInstruction(pc, opcode, cycles);
 
-		// Ensure the unused flag is true, just for historics.
-		SetStatusFlag(StatusFlag::UNUSED);
+			// A branch not taken leaves the PC after its operand
+			if (instruction.addressing == AddressMode::REL)
+				m_Profile->RecordBranch(opcode, m_PC != static_cast<word>(pc + 2));
+		}
+#endif
 
-		return m_CyclesRem > 0;
+		return cycles;
+	}
+
+	template<class BusT>
+	unsigned int BasicCPU<BusT>::StepInstruction(Instruction& outInstruction) {
+		Journal::Registers before;
+		if (m_Journal) {
+			before = GetJournalRegisters();
+			m_Journal->BeginStep();
+		}
+
+		// Finish off whatever a previous Tick() left running
+		unsigned int cycles = m_CyclesRem;
+		m_CyclesExecuted += m_CyclesRem;
+		m_CyclesRem = 0;
+
+		RunDueEvents();
+		if (!ServicePendingInterrupt())
+			m_CyclesRem += ExecuteNext(outInstruction);
+
+		// Interrupts add their cost onto the remaining cycles
+		cycles += m_CyclesRem;
+		m_CyclesExecuted += m_CyclesRem;
+		m_CyclesRem = 0;
+
+		if (m_Journal)
+			m_Journal->EndStep(before, GetJournalRegisters());
+
+		return cycles;
 	}
 
-	void CPU::IRQ() {
+	template<class BusT>
+	bool BasicCPU<BusT>::StepBack() {
+		if (!m_Journal)
+			return false;
+
+		Journal::Registers registers = GetJournalRegisters();
+		Journal::Writes writes;
+		if (!m_Journal->Pop(registers, writes))
+			return false;
+
+		// Last first, so a byte written twice gets back its first old value
+		if (m_Bus) {
+			for (size_t i = writes.count; i-- > 0;)
+				m_Bus->WriteByte(writes.entries[i].addr, writes.entries[i].old);
+		}
+
+		m_PC = registers.pc;
+		m_SP = registers.sp;
+		m_Acc = registers.acc;
+		m_X = registers.x;
+		m_Y = registers.y;
+		SetStatus(registers.status);
+		m_CyclesRem = registers.cyclesRem;
+		m_CyclesExecuted = registers.cyclesExecuted;
+		m_InstructionsExecuted = registers.instructionsExecuted;
+		m_PendingIRQ = registers.pendingIRQ;
+		m_PendingNMI = registers.pendingNMI;
+		return true;
+	}
+
+	template<class BusT>
+	bool BasicCPU<BusT>::ServicePendingInterrupt() {
+		if (m_PendingNMI) {
+			m_PendingNMI = false;
+			NMI();
+			return true;
+		} else if (m_PendingIRQ && !HasStatusFlag(StatusFlag::INTERRUPT)) {
+			m_PendingIRQ = false;
+			IRQ();
+			return true;
+		}
+		return false;
+	}
+
+	template<class BusT>
+	void BasicCPU<BusT>::IRQ() {
+		// Part way through an instruction, wait for it to finish
+		if (m_CyclesRem > 0) {
+			RequestIRQ();
+			return;
+		}
+
 		if (HasStatusFlag(StatusFlag::INTERRUPT) == true)
 			return; // Interrupts are disabled, so no go.
 
@@ -95,7 +308,7 @@ namespace mos6502 {
 		SetStatusFlag(StatusFlag::BREAK, false);
 		SetStatusFlag(StatusFlag::INTERRUPT, true);
 		SetStatusFlag(StatusFlag::UNUSED, true);
-		PushToStack(m_ProcStatus.value);
+		PushToStack(GetStatus().value);
 
 		// Read new program location from interrupt vector
 		m_PC = ReadWord(ADDRESS_IRQ_VECTOR);
@@ -103,7 +316,14 @@ namespace mos6502 {
 		m_CyclesRem += 7; // 7 Cycles to complete
 	}
 
-	void CPU::NMI() {
+	template<class BusT>
+	void BasicCPU<BusT>::NMI() {
+		// Part way through an instruction, wait for it to finish
+		if (m_CyclesRem > 0) {
+			RequestNMI();
+			return;
+		}
+
 		// Push the current program counter
 		PushToStack(GET_HIGH_BYTE(m_PC));
 		PushToStack(GET_LOW_BYTE(m_PC));
@@ -112,7 +332,7 @@ namespace mos6502 {
 		SetStatusFlag(StatusFlag::BREAK, false);
 		SetStatusFlag(StatusFlag::INTERRUPT, true);
 		SetStatusFlag(StatusFlag::UNUSED, true);
-		PushToStack(m_ProcStatus.value);
+		PushToStack(GetStatus().value);
 
 		// Read new program location from interrupt vector
 		m_PC = ReadWord(ADDRESS_NMI_VECTOR);
@@ -120,59 +340,137 @@ namespace mos6502 {
 		m_CyclesRem += 8; // 8 Cycles to complete
 	}
 
-	byte CPU::FetchData(const address& addr) const {
+	template<class BusT>
+	byte BasicCPU<BusT>::FetchData(const address& addr) const {
 		if (m_WasSupplied)
 			return m_SuppliedValue;
 
 		return ReadByte(addr);
 	}
 
-	void CPU::PushToStack(const byte data) {
-		const address pointer = { ADDRESS_STACK + m_SP };
-		m_SP--;
-		WriteByte(pointer, data);
+	template<class BusT>
+	void BasicCPU<BusT>::PushToStack(const byte data) {
+		const byte pointer = m_SP;
+		m_SP = StackPushed(m_SP);
+		WriteStack(pointer, data);
 	}
 
-	byte CPU::PullFromStack() {
-		m_SP++;
-		const address pointer = { ADDRESS_STACK + m_SP };
-		return ReadByte(pointer);
+	template<class BusT>
+	byte BasicCPU<BusT>::PullFromStack() {
+		m_SP = StackPulled(m_SP);
+		return ReadStack(m_SP);
 	}
 
-	byte CPU::ReadByte(const address& addr) const {
-		if (m_Bus)
-			return m_Bus->ReadByte(addr);
+	template<class BusT>
+	void BasicCPU<BusT>::UpdateLowPages() {
+		m_LowPages = nullptr;
+		if (!m_DirectAccess)
+			return;
+
+		if constexpr (std::is_same_v<BusT, Bus>) {
+			m_LowPages = &m_Bus->GetPage(0);
+		} else if constexpr (std::is_same_v<BusT, FlatMemoryBus>) {
+			MapLowPages(*m_Bus->GetMemory());
+		} else {
+			// Only the bus types whose accesses are known to be plain
+			// indexing, anything else may do more with them
+			IODevice& device = *m_Bus;
+			if (typeid(device) == typeid(Bus))
+				m_LowPages = &static_cast<Bus&>(device).GetPage(0);
+			else if (typeid(device) == typeid(FlatMemoryBus))
+				MapLowPages(*static_cast<FlatMemoryBus&>(device).GetMemory());
+			else if (typeid(device) == typeid(Memory))
+				MapLowPages(static_cast<Memory&>(device));
+		}
+	}
 
-		std::cerr << "mos6502::CPU::ReadByte attempted to access bus that is not connected (nullptr)" << std::endl;
-		return 0;
+	template<class BusT>
+	void BasicCPU<BusT>::MapLowPages(Memory& memory) {
+		if (memory.GetSize() < 2 * Memory::PAGE_SIZE)
+			return;
+
+		for (size_t i = 0; i < m_OwnLowPages.size(); i++) {
+			Bus::Page& page = m_OwnLowPages[i];
+			page = Bus::Page{};
+			page.data = memory.GetData() + i * Memory::PAGE_SIZE;
+			page.writable = memory.IsReadOnly() ? nullptr : page.data;
+			page.dirty = memory.GetDirtyBitmap();
+			page.code = memory.GetCodeBitmap();
+			page.dirtyMask = uint64_t(1) << i;
+			page.memory = &memory;
+		}
+		m_LowPages = m_OwnLowPages.data();
 	}
 
-	word CPU::ReadWord(const address& addr) const {
+	template<class BusT>
+	byte BasicCPU<BusT>::HookedReadByte(const address& addr) const {
+		const byte value = FetchByte(addr);
+		if (m_Breakpoints)
+			WatchAccess(addr.value, Breakpoints::READ, value);
+		return value;
+	}
+
+	template<class BusT>
+	word BasicCPU<BusT>::HookedReadWord(const address& addr) const {
+		word value = 0;
 		if (m_Bus)
-			return m_Bus->ReadWord(addr);
+			value = m_Bus->ReadWord(addr);
+		else
+			ReportMissingBus("ReadWord");
 
-		std::cerr << "mos6502::CPU::ReadWord attempted to access bus that is not connected (nullptr)" << std::endl;
-		return 0;
+		if (m_Breakpoints) {
+			WatchAccess(addr.value, Breakpoints::READ, GET_LOW_BYTE(value));
+			WatchAccess(static_cast<word>(addr.value + 1), Breakpoints::READ, GET_HIGH_BYTE(value));
+		}
+		return value;
 	}
 
-	void CPU::WriteByte(const address& addr, const byte data) {
+	template<class BusT>
+	void BasicCPU<BusT>::HookedWriteByte(const address& addr, const byte data) {
+		if (m_Journal)
+			JournalWrite(addr, data);
+
 		if (m_Bus)
 			m_Bus->WriteByte(addr, data);
 		else
-			std::cerr << "mos6502::CPU::WriteByte attempted to access bus that is not connected (nullptr)" << std::endl;
+			ReportMissingBus("WriteByte");
+
+		if (m_Breakpoints)
+			WatchAccess(addr.value, Breakpoints::WRITE, data);
 	}
 
-	void CPU::WriteWord(const address& addr, const word data) {
+	template<class BusT>
+	void BasicCPU<BusT>::HookedWriteWord(const address& addr, const word data) {
+		if (m_Journal) {
+			JournalWrite(addr, GET_LOW_BYTE(data));
+			JournalWrite(static_cast<word>(addr.value + 1), GET_HIGH_BYTE(data));
+		}
+
 		if (m_Bus)
 			m_Bus->WriteWord(addr, data);
 		else
-			std::cerr << "mos6502::CPU::WriteWord attempted to access bus that is not connected (nullptr)" << std::endl;
+			ReportMissingBus("WriteWord");
+
+		if (m_Breakpoints) {
+			WatchAccess(addr.value, Breakpoints::WRITE, GET_LOW_BYTE(data));
+			WatchAccess(static_cast<word>(addr.value + 1), Breakpoints::WRITE, GET_HIGH_BYTE(data));
+		}
 	}
 
-	void CPU::WriteBytes(const address& offset, const std::vector<byte>& bytes) {
-		if (m_Bus)
-			m_Bus->WriteBytes(offset, bytes);
-		else
-			std::cerr << "mos6502::CPU::WriteBytes attempted to access bus that is not connected (nullptr)" << std::endl;
+	template<class BusT>
+	void BasicCPU<BusT>::JournalWrite(const address& addr, const byte data) {
+		const byte* page = m_Bus ? m_Bus->MapPage(addr.page) : nullptr;
+		if (page && page[addr.record] != data)
+			m_Journal->RecordWrite(addr.value, page[addr.record]);
+	}
+
+	template<class BusT>
+	void BasicCPU<BusT>::ReportMissingBus(const char* method) {
+		std::cerr << "mos6502::CPU::" << method << " attempted to access bus that is not connected (nullptr)" << std::endl;
 	}
+
+	// Explicit instantiations for the supported bus types (see cpu.h)
+	template class BasicCPU<IODevice>;
+	template class BasicCPU<FlatMemoryBus>;
+	template class BasicCPU<Bus>;
 }
\ No newline at end of file
@@ -14,7 +14,8 @@
 
 namespace mos6502 {
 
-	address CPU::ExecuteAddressing(const AddressMode addrMode, fast_byte& outCycles) {
+	template<class BusT>
+	address BasicCPU<BusT>::ExecuteAddressing(const AddressMode addrMode, fast_byte& outCycles) {
 		ClearSupplied();
 
 		switch (addrMode) {
@@ -55,51 +56,158 @@ namespace mos6502 {
 		return 0;
 	}
 
-	address CPU::Addr_ABS(fast_byte& outCycles) {
-		const byte low = ReadByte(m_PC);
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_ABS(fast_byte& outCycles) {
+		const byte low = FetchByte(m_PC);
 		m_PC++;
-		const byte high = ReadByte(m_PC);
+		const byte high = FetchByte(m_PC);
 		m_PC++;
-		const address addr = { MAKE_WORD(low, high) };
 
-		outCycles = 3; // Because of a 16-bit read
+		return Resolve_ABS(MAKE_WORD(low, high), outCycles);
+	}
 
-		return addr;
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_ABX(fast_byte& outCycles) {
+		const byte low = FetchByte(m_PC);
+		m_PC++;
+		const byte high = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_ABX(MAKE_WORD(low, high), outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_ABY(fast_byte& outCycles) {
+		const byte low = FetchByte(m_PC);
+		m_PC++;
+		const byte high = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_ABY(MAKE_WORD(low, high), outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_ACC(fast_byte& outCycles) {
+		return Resolve_ACC(0, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_IMM(fast_byte& outCycles) {
+		// Next program value, supplied as part of the instruction stream
+		const byte value = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_IMM(value, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_IMP(fast_byte& outCycles) {
+		return Resolve_IMP(0, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_IND(fast_byte& outCycles) {
+		const byte low = FetchByte(m_PC);
+		m_PC++;
+		const byte high = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_IND(MAKE_WORD(low, high), outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_INX(fast_byte& outCycles) {
+		const byte table = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_INX(table, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_INY(fast_byte& outCycles) {
+		const byte table = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_INY(table, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_REL(fast_byte& outCycles) {
+		const byte rel = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_REL(rel, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_ZPG(fast_byte& outCycles) { 
+		const byte low = FetchByte(m_PC);
+		m_PC++;
+
+		return Resolve_ZPG(low, outCycles);
 	}
 
-	address CPU::Addr_ABX(fast_byte& outCycles) {
-		const byte low = ReadByte(m_PC);
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_ZPX(fast_byte& outCycles) { 
+		const byte low = FetchByte(m_PC);
 		m_PC++;
-		const byte high = ReadByte(m_PC);
+
+		return Resolve_ZPX(low, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Addr_ZPY(fast_byte& outCycles) { 
+		const byte low = FetchByte(m_PC);
 		m_PC++;
-		const address addr = { MAKE_WORD(low, high) + m_X }; // Add X Register
+
+		return Resolve_ZPY(low, outCycles);
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_ABS(const word operand, fast_byte& outCycles) {
+		outCycles = 3; // Because of a 16-bit read
+
+		return address{ operand };
+	}
+
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_ABX(const word operand, fast_byte& outCycles) {
+		const address addr = { operand + m_X }; // Add X Register
 
 		//Calculate cost
-		if (addr.page != high)// Check for page change
+		if (addr.page != GET_HIGH_BYTE(operand)) { // Check for page change
 			outCycles = 4; // 16-bit address with a page change
-		else
+#ifdef MOS6502_PROFILE
+			if (m_Profile)
+				m_Profile->RecordPageCrossing(AddressMode::ABX);
+#endif
+		} else {
 			outCycles = 3; // 16-bit address within the same page
+		}
 
 		return addr;
 	}
 
-	address CPU::Addr_ABY(fast_byte& outCycles) {
-		const byte low = ReadByte(m_PC);
-		m_PC++;
-		const byte high = ReadByte(m_PC);
-		m_PC++;
-		const address addr = { MAKE_WORD(low, high) + m_Y }; // Add Y Register
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_ABY(const word operand, fast_byte& outCycles) {
+		const address addr = { operand + m_Y }; // Add Y Register
 
 		//Calculate cost
-		if (addr.page != high)// Check for page change
+		if (addr.page != GET_HIGH_BYTE(operand)) { // Check for page change
 			outCycles = 4; // 16-bit address with a page change
-		else
+#ifdef MOS6502_PROFILE
+			if (m_Profile)
+				m_Profile->RecordPageCrossing(AddressMode::ABY);
+#endif
+		} else {
 			outCycles = 3; // 16-bit address within the same page
+		}
 
 		return addr;
 	}
 
-	address CPU::Addr_ACC(fast_byte& outCycles) {
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_ACC(const word, fast_byte& outCycles) {
 		SetSupplied(m_Acc);
 
 		//No cost
@@ -108,17 +216,19 @@ namespace mos6502 {
 		return m_PC;
 	}
 
-	address CPU::Addr_IMM(fast_byte& outCycles) {
-		// Next program value
-		const address addr = { m_PC++ }; 
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_IMM(const word operand, fast_byte& outCycles) {
+		// The operand is the value itself
+		SetSupplied(GET_LOW_BYTE(operand));
 
 		// No additional cost
 		outCycles = 1;
 
-		return addr;
+		return address{ m_PC - 1 };
 	}
 
-	address CPU::Addr_IMP(fast_byte& outCycles) {
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_IMP(const word, fast_byte& outCycles) {
 		SetSupplied(m_Acc);
 
 		// No addressing needed
@@ -127,18 +237,16 @@ namespace mos6502 {
 		return { 0 };
 	}
 
-	address CPU::Addr_IND(fast_byte& outCycles) {
-		byte low = ReadByte(m_PC);
-		m_PC++;
-		byte high = ReadByte(m_PC);
-		m_PC++;
-		const address pointer = { MAKE_WORD(low, high) };
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_IND(const word operand, fast_byte& outCycles) {
+		const address pointer = { operand };
 		
 		// Read the final low byte from the pointer location
-		low = ReadByte(pointer);
+		const byte low = ReadByte(pointer);
 		
 		//Check if the page-boundary bug is in effect.
 		//If so, the page portion may wrap.
+		byte high;
 		if (pointer.record == 0xFF) {
 			high = ReadByte(pointer.value & 0xFF00);
 		} else {
@@ -150,42 +258,40 @@ namespace mos6502 {
 		return address{ MAKE_WORD(low, high) };
 	}
 
-	address CPU::Addr_INX(fast_byte& outCycles) {
-		const word table = static_cast<word>( ReadByte(m_PC) );
-		m_PC++;
-
-		const word xword = static_cast<word>(m_X);
-
-		const byte low = ReadByte( (table + xword) & 0x00FF );
-		const byte high = ReadByte( (table + xword + 1) & 0xFF00);
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_INX(const word operand, fast_byte& outCycles) {
+		// Add the X register, but don't leave the zero page, even for the
+		// high byte of the pointer
+		const byte table = static_cast<byte>(GET_LOW_BYTE(operand) + m_X);
 
 		outCycles = 5; // reference data-tables ellude to 4 cycles
 
-		return address{ MAKE_WORD(low, high) };
+		return address{ ReadZeroPageWord(table) };
 	}
 
-	address CPU::Addr_INY(fast_byte& outCycles) {
-		const word table = static_cast<word>(ReadByte(m_PC));
-		m_PC++;
-
-		const byte low = ReadByte(table & 0x00FF);
-		const byte high = ReadByte((table + 1) & 0x00FF);
-
-		const address addr = { MAKE_WORD(low, high) + m_Y };
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_INY(const word operand, fast_byte& outCycles) {
+		const word pointer = ReadZeroPageWord(GET_LOW_BYTE(operand));
+		const address addr = { pointer + m_Y };
 
 		//Calculate cost
-		if (addr.page != high)// Check for page change
+		if (addr.page != GET_HIGH_BYTE(pointer)) { // Check for page change
 			outCycles = 5; // 16-bit address with a page change
-		else
+#ifdef MOS6502_PROFILE
+			if (m_Profile)
+				m_Profile->RecordPageCrossing(AddressMode::INY);
+#endif
+		} else {
 			outCycles = 4; // 16-bit address within the same page
+		}
 
 		return addr;
 	}
 
-	address CPU::Addr_REL(fast_byte& outCycles) {
-		byte rel = ReadByte(m_PC);
-		m_PC++;
-
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_REL(const word operand, fast_byte& outCycles) {
+		// Widened before sign extending, so backward branches work
+		word rel = GET_LOW_BYTE(operand);
 		if (rel & 0x80)
 			rel |= 0xFF00;
 
@@ -195,36 +301,37 @@ namespace mos6502 {
 		return { rel };
 	}
 
-	address CPU::Addr_ZPG(fast_byte& outCycles) { 
-		const address addr = static_cast<address>(ReadByte(m_PC));
-		m_PC++;
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_ZPG(const word operand, fast_byte& outCycles) {
+		const address addr = static_cast<address>(GET_LOW_BYTE(operand));
 
 		outCycles = 2; // 1 byte read
 
 		return addr;
 	}
 
-	address CPU::Addr_ZPX(fast_byte& outCycles) { 
-		const byte low = ReadByte(m_PC);
-		m_PC++;
-
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_ZPX(const word operand, fast_byte& outCycles) {
 		// Add the X register, but don't leave the zero page.
-		const address addr = { (low + m_X) & 0x00FF };
+		const address addr = { (GET_LOW_BYTE(operand) + m_X) & 0x00FF };
 
 		outCycles = 3; // 1 byte read, 1 added
 
 		return addr;
 	}
 
-	address CPU::Addr_ZPY(fast_byte& outCycles) { 
-		const byte low = ReadByte(m_PC);
-		m_PC++;
-
+	template<class BusT>
+	address BasicCPU<BusT>::Resolve_ZPY(const word operand, fast_byte& outCycles) {
 		// Add the Y register, but don't leave the zero page.
-		const address addr = { (low + m_Y) & 0x00FF };
+		const address addr = { (GET_LOW_BYTE(operand) + m_Y) & 0x00FF };
 
 		outCycles = 3; // 1 byte read, 1 added
 
 		return addr;
 	}
+
+	// Explicit instantiations for the supported bus types (see cpu.h)
+	template class BasicCPU<IODevice>;
+	template class BasicCPU<FlatMemoryBus>;
+	template class BasicCPU<Bus>;
 }
\ No newline at end of file
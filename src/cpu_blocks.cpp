@@ -0,0 +1,319 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "cpu.h"
+
+#include <iostream>
+#include <type_traits>
+#include <typeinfo>
+
+namespace mos6502 {
+
+	namespace {
+		// Instructions that may move the program counter anywhere, ending a block
+		constexpr bool EndsBlock(const Instruction instruction) {
+			switch (instruction) {
+			case Instruction::BCC:
+			case Instruction::BCS:
+			case Instruction::BEQ:
+			case Instruction::BMI:
+			case Instruction::BNE:
+			case Instruction::BPL:
+			case Instruction::BVC:
+			case Instruction::BVS:
+			case Instruction::BRK:
+			case Instruction::JMP:
+			case Instruction::JSR:
+			case Instruction::RTI:
+			case Instruction::RTS:
+				return true;
+			default:
+				return false;
+			}
+		}
+	}
+
+	template<class BusT>
+	void BasicCPU<BusT>::SetBlockCache(const bool enabled) {
+		if (!enabled) {
+			m_Jit.reset();
+			m_BlockCache.reset();
+			return;
+		}
+
+		if (!m_BlockCache)
+			m_BlockCache = std::make_unique<BlockCache<CachedOp>>();
+		FlushBlockCache();
+	}
+
+	template<class BusT>
+	void BasicCPU<BusT>::FlushBlockCache() {
+		if (!m_BlockCache)
+			return;
+
+		// Code read through a Bus goes stale when its pages are remapped
+		const Bus* bus = nullptr;
+		if constexpr (std::is_same_v<BusT, Bus>)
+			bus = m_Bus.get();
+		else if constexpr (std::is_same_v<BusT, IODevice>)
+			bus = dynamic_cast<const Bus*>(m_Bus.get());
+
+		m_BlockCache->Clear(bus);
+	}
+
+	template<class BusT>
+	bool BasicCPU<BusT>::SetJit(const bool enabled) {
+		if (!enabled) {
+			// The compiled code goes with the compiler
+			if (m_Jit) {
+				m_Jit.reset();
+				FlushBlockCache();
+			}
+			return true;
+		}
+
+		if (m_Jit)
+			return true;
+
+		// Compiled code reads and writes the memory of a FlatMemoryBus directly
+		if constexpr (!std::is_same_v<BusT, FlatMemoryBus>) {
+			std::cerr << "mos6502::CPU::SetJit the JIT compiler is only supported by FlatCPU" << std::endl;
+			return false;
+		} else {
+			auto jit = std::make_unique<JitCompiler>();
+			if (!jit->IsAvailable()) {
+				std::cerr << "mos6502::CPU::SetJit the JIT compiler is not available on this host" << std::endl;
+				return false;
+			}
+
+			SetBlockCache(true);
+			m_Jit = std::move(jit);
+			return true;
+		}
+	}
+
+	template<class BusT>
+	bool BasicCPU<BusT>::FindCodeSource(const byte page, typename BlockCache<CachedOp>::Source& outSource) {
+		if (!m_Bus)
+			return false;
+
+		const Bus* bus = nullptr;
+		if constexpr (std::is_same_v<BusT, FlatMemoryBus>) {
+			outSource = { m_Bus->GetMemory().get(), page };
+			return true;
+		} else if constexpr (std::is_same_v<BusT, Bus>) {
+			bus = m_Bus.get();
+		} else {
+			if (const FlatMemoryBus* flat = dynamic_cast<const FlatMemoryBus*>(m_Bus.get())) {
+				outSource = { flat->GetMemory().get(), page };
+				return true;
+			}
+
+			// Only exactly Memory, subclasses may change how reads and writes behave
+			if (typeid(*m_Bus) == typeid(Memory)) {
+				Memory* memory = static_cast<Memory*>(m_Bus.get());
+				if ((page + 1) * Memory::PAGE_SIZE > memory->GetSize())
+					return false;
+
+				outSource = { memory, page };
+				return true;
+			}
+
+			bus = dynamic_cast<const Bus*>(m_Bus.get());
+		}
+
+		if (!bus)
+			return false;
+
+		// Pages mapped directly onto a Memory know which one
+		const Bus::Page& entry = bus->GetPage(page);
+		if (!entry.memory)
+			return false;
+
+		outSource = { entry.memory, static_cast<size_t>(entry.data - entry.memory->GetData()) / Memory::PAGE_SIZE };
+		return true;
+	}
+
+	template<class BusT>
+	typename BasicCPU<BusT>::CachedBlock* BasicCPU<BusT>::FindBlock(const word pc) {
+		CachedBlock* block = m_BlockCache->Find(pc);
+		if (!block && m_BlockCache->IsCacheable(GET_HIGH_BYTE(pc)))
+			block = DecodeBlock(pc);
+		return block;
+	}
+
+	template<class BusT>
+	typename BasicCPU<BusT>::CachedBlock* BasicCPU<BusT>::DecodeBlock(const word pc) {
+		using Source = typename BlockCache<CachedOp>::Source;
+
+		CachedBlock block;
+		block.start = pc;
+		block.firstPage = block.lastPage = GET_HIGH_BYTE(pc);
+
+		Source first, second;
+		if (!FindCodeSource(block.firstPage, first)) {
+			m_BlockCache->SetUncached(block.firstPage);
+			return nullptr;
+		}
+
+		// A block may run on into the following page, if that is cacheable too
+		const auto usePage = [&](const byte page) {
+			if (page == block.lastPage)
+				return true;
+			if (block.lastPage != block.firstPage || page != static_cast<byte>(block.firstPage + 1))
+				return false;
+			if (!m_BlockCache->IsCacheable(page) || !FindCodeSource(page, second))
+				return false;
+
+			block.lastPage = page;
+			return true;
+		};
+
+		word at = pc;
+		while (block.ops.size() < BlockCache<CachedOp>::MAX_BLOCK_LENGTH) {
+			if (!usePage(GET_HIGH_BYTE(at)))
+				break;
+
+			// Illegal opcodes are left to the interpreter, which stops Run()
+			const byte opCode = FetchByte(at);
+			const InstructionDetail& detail = InstructionDetails[opCode];
+			if (detail.instruction == Instruction::ILL)
+				break;
+
+			const word next = static_cast<word>(at + detail.bytesUsed);
+			if (!usePage(GET_HIGH_BYTE(static_cast<word>(next - 1))))
+				break;
+
+			word operand = 0;
+			if (detail.bytesUsed > 1)
+				operand = FetchByte(static_cast<word>(at + 1));
+			if (detail.bytesUsed > 2)
+				operand |= FetchByte(static_cast<word>(at + 2)) << 8;
+
+			block.ops.push_back(CachedOp{ CachedTable[opCode], operand, next, opCode, detail.instruction });
+			at = next;
+
+			if (EndsBlock(detail.instruction))
+				break;
+		}
+
+		if (block.ops.empty())
+			return nullptr;
+
+		// Superinstructions, each taking the place of the first of its pair
+		for (size_t i = 0; i + 1 < block.ops.size(); i++) {
+			if (const CachedHandler fused = FindFusedHandler(block.ops[i].opCode, block.ops[i + 1].opCode))
+				block.ops[i].handler = fused;
+		}
+
+		return m_BlockCache->Insert(std::move(block), first, second);
+	}
+
+	template<class BusT>
+	uint64_t BasicCPU<BusT>::RunBlock(const CachedBlock& block, const uint64_t budget, Instruction& outInstruction) {
+		const CachedOp* op = block.ops.data();
+		const CachedOp* const end = op + block.ops.size();
+
+		// The same checks Run() makes between instructions. Each handler
+		// counts the instructions it ran, which is how far to move on.
+		uint64_t consumed = 0;
+		do {
+			const uint64_t executed = m_InstructionsExecuted;
+			consumed += op->handler(*this, *op, budget - consumed);
+			op += m_InstructionsExecuted - executed;
+		} while (op != end && consumed < budget && !HasPendingInterrupt() && !m_BlockCache->HasInvalidations());
+
+		outInstruction = op[-1].instruction;
+		m_CyclesExecuted += consumed;
+		return consumed;
+	}
+
+	template<class BusT>
+	uint64_t BasicCPU<BusT>::RunNative(CachedBlock& block, const uint64_t budget, Instruction& outInstruction) {
+		if constexpr (std::is_same_v<BusT, FlatMemoryBus>) {
+			JitBlock& native = block.native;
+			if (!native.function && !native.attempted && ++native.runs >= JIT_THRESHOLD) {
+				native.attempted = true;
+
+				std::vector<JitInstruction> instructions;
+				instructions.reserve(block.ops.size());
+				word pc = block.start;
+				for (const CachedOp& op : block.ops) {
+					instructions.push_back(JitInstruction{ pc, op.operand, op.opCode });
+					pc = op.nextPC;
+				}
+
+				if (!m_Jit->Compile(instructions, native) && m_Jit->IsFull()) {
+					// Out of executable memory, start again. That throws away
+					// this block too, so nothing is run this time around.
+					m_Jit->Reset();
+					FlushBlockCache();
+					outInstruction = Instruction::NOP;
+					return 0;
+				}
+			}
+
+			// With more budget than that, Run() would not stop before the last
+			// compiled instruction either
+			if (native.function && budget > native.maxCyclesBeforeLast) {
+				Memory& memory = *m_Bus->GetMemory();
+
+				JitState state{};
+				state.memory = memory.GetData();
+				state.dirty = memory.GetDirtyBitmap();
+				state.code = memory.GetCodeBitmap();
+				state.cycleLimit = budget - native.maxCyclesBeforeLast;
+				state.pc = m_PC;
+				state.acc = m_Acc;
+				state.x = m_X;
+				state.y = m_Y;
+				state.sp = m_SP;
+				state.status = m_ProcStatus.value;
+				state.resultZ = m_ResultZ;
+				state.resultN = m_ResultN;
+
+				native.function(&state);
+
+				if (state.instructions > 0) {
+					m_PC = state.pc;
+					m_Acc = state.acc;
+					m_X = state.x;
+					m_Y = state.y;
+					m_SP = state.sp;
+					m_ProcStatus.value = state.status;
+					m_ResultZ = state.resultZ;
+					m_ResultN = state.resultN;
+
+					m_InstructionsExecuted += state.instructions;
+					m_CyclesExecuted += state.cycles;
+
+					// Lets the memory tell the block cache about the write
+					if (state.codeWritten)
+						memory.MarkDirty(state.codeAddress);
+
+					// Compiled code never runs BRK or an illegal opcode
+					outInstruction = Instruction::NOP;
+					return state.cycles;
+				}
+
+				// Nothing has run if it stopped straight away (before decimal
+				// mode arithmetic). The handlers take it from here, and from
+				// now on, as it is likely to happen again.
+				native.function = nullptr;
+			}
+		}
+
+		return RunBlock(block, budget, outInstruction);
+	}
+
+	// Explicit instantiations for the supported bus types (see cpu.h)
+	template class BasicCPU<IODevice>;
+	template class BasicCPU<FlatMemoryBus>;
+	template class BasicCPU<Bus>;
+
+}
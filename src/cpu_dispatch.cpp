@@ -0,0 +1,344 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "cpu.h"
+
+#include <iostream>
+#include <iterator>
+
+namespace mos6502 {
+
+	// NOTE: The methods are called qualified (CPU::) on purpose.
+	// This binds them statically to the base implementation so that no
+	// virtual lookups are performed, leaving the compiler free to inline
+	// them into each handler. Subclasses wanting their overrides honored
+	// should enable the virtual dispatch path instead.
+
+	template<class BusT>
+	template<AddressMode Mode>
+	address BasicCPU<BusT>::AddressingFor(BasicCPU& cpu, fast_byte& outCycles) {
+		if constexpr (Mode == AddressMode::ABS)
+			return cpu.BasicCPU::Addr_ABS(outCycles);
+		else if constexpr (Mode == AddressMode::ABX)
+			return cpu.BasicCPU::Addr_ABX(outCycles);
+		else if constexpr (Mode == AddressMode::ABY)
+			return cpu.BasicCPU::Addr_ABY(outCycles);
+		else if constexpr (Mode == AddressMode::ACC)
+			return cpu.BasicCPU::Addr_ACC(outCycles);
+		else if constexpr (Mode == AddressMode::IMM)
+			return cpu.BasicCPU::Addr_IMM(outCycles);
+		else if constexpr (Mode == AddressMode::IMP)
+			return cpu.BasicCPU::Addr_IMP(outCycles);
+		else if constexpr (Mode == AddressMode::IND)
+			return cpu.BasicCPU::Addr_IND(outCycles);
+		else if constexpr (Mode == AddressMode::INX)
+			return cpu.BasicCPU::Addr_INX(outCycles);
+		else if constexpr (Mode == AddressMode::INY)
+			return cpu.BasicCPU::Addr_INY(outCycles);
+		else if constexpr (Mode == AddressMode::REL)
+			return cpu.BasicCPU::Addr_REL(outCycles);
+		else if constexpr (Mode == AddressMode::ZPG)
+			return cpu.BasicCPU::Addr_ZPG(outCycles);
+		else if constexpr (Mode == AddressMode::ZPX)
+			return cpu.BasicCPU::Addr_ZPX(outCycles);
+		else if constexpr (Mode == AddressMode::ZPY)
+			return cpu.BasicCPU::Addr_ZPY(outCycles);
+		else // Illegal Address Mode, reported by the instruction
+			return 0;
+	}
+
+	template<class BusT>
+	template<Instruction Instr>
+	fast_byte BasicCPU<BusT>::InstructionFor(BasicCPU& cpu, const address& addr) {
+		if constexpr (Instr == Instruction::ADC)
+			return cpu.BasicCPU::Ins_ADC(addr);
+		else if constexpr (Instr == Instruction::AND)
+			return cpu.BasicCPU::Ins_AND(addr);
+		else if constexpr (Instr == Instruction::ASL)
+			return cpu.BasicCPU::Ins_ASL(addr);
+		else if constexpr (Instr == Instruction::BCC)
+			return cpu.BasicCPU::Ins_BCC(addr);
+		else if constexpr (Instr == Instruction::BCS)
+			return cpu.BasicCPU::Ins_BCS(addr);
+		else if constexpr (Instr == Instruction::BEQ)
+			return cpu.BasicCPU::Ins_BEQ(addr);
+		else if constexpr (Instr == Instruction::BIT)
+			return cpu.BasicCPU::Ins_BIT(addr);
+		else if constexpr (Instr == Instruction::BMI)
+			return cpu.BasicCPU::Ins_BMI(addr);
+		else if constexpr (Instr == Instruction::BNE)
+			return cpu.BasicCPU::Ins_BNE(addr);
+		else if constexpr (Instr == Instruction::BPL)
+			return cpu.BasicCPU::Ins_BPL(addr);
+		else if constexpr (Instr == Instruction::BRK)
+			return cpu.BasicCPU::Ins_BRK(addr);
+		else if constexpr (Instr == Instruction::BVC)
+			return cpu.BasicCPU::Ins_BVC(addr);
+		else if constexpr (Instr == Instruction::BVS)
+			return cpu.BasicCPU::Ins_BVS(addr);
+		else if constexpr (Instr == Instruction::CLC)
+			return cpu.BasicCPU::Ins_CLC(addr);
+		else if constexpr (Instr == Instruction::CLD)
+			return cpu.BasicCPU::Ins_CLD(addr);
+		else if constexpr (Instr == Instruction::CLI)
+			return cpu.BasicCPU::Ins_CLI(addr);
+		else if constexpr (Instr == Instruction::CLV)
+			return cpu.BasicCPU::Ins_CLV(addr);
+		else if constexpr (Instr == Instruction::CMP)
+			return cpu.BasicCPU::Ins_CMP(addr);
+		else if constexpr (Instr == Instruction::CPX)
+			return cpu.BasicCPU::Ins_CPX(addr);
+		else if constexpr (Instr == Instruction::CPY)
+			return cpu.BasicCPU::Ins_CPY(addr);
+		else if constexpr (Instr == Instruction::DEC)
+			return cpu.BasicCPU::Ins_DEC(addr);
+		else if constexpr (Instr == Instruction::DEX)
+			return cpu.BasicCPU::Ins_DEX(addr);
+		else if constexpr (Instr == Instruction::DEY)
+			return cpu.BasicCPU::Ins_DEY(addr);
+		else if constexpr (Instr == Instruction::EOR)
+			return cpu.BasicCPU::Ins_EOR(addr);
+		else if constexpr (Instr == Instruction::INC)
+			return cpu.BasicCPU::Ins_INC(addr);
+		else if constexpr (Instr == Instruction::INX)
+			return cpu.BasicCPU::Ins_INX(addr);
+		else if constexpr (Instr == Instruction::INY)
+			return cpu.BasicCPU::Ins_INY(addr);
+		else if constexpr (Instr == Instruction::JMP)
+			return cpu.BasicCPU::Ins_JMP(addr);
+		else if constexpr (Instr == Instruction::JSR)
+			return cpu.BasicCPU::Ins_JSR(addr);
+		else if constexpr (Instr == Instruction::LDA)
+			return cpu.BasicCPU::Ins_LDA(addr);
+		else if constexpr (Instr == Instruction::LDX)
+			return cpu.BasicCPU::Ins_LDX(addr);
+		else if constexpr (Instr == Instruction::LDY)
+			return cpu.BasicCPU::Ins_LDY(addr);
+		else if constexpr (Instr == Instruction::LSR)
+			return cpu.BasicCPU::Ins_LSR(addr);
+		else if constexpr (Instr == Instruction::NOP)
+			return cpu.BasicCPU::Ins_NOP(addr);
+		else if constexpr (Instr == Instruction::ORA)
+			return cpu.BasicCPU::Ins_ORA(addr);
+		else if constexpr (Instr == Instruction::PHA)
+			return cpu.BasicCPU::Ins_PHA(addr);
+		else if constexpr (Instr == Instruction::PHP)
+			return cpu.BasicCPU::Ins_PHP(addr);
+		else if constexpr (Instr == Instruction::PLA)
+			return cpu.BasicCPU::Ins_PLA(addr);
+		else if constexpr (Instr == Instruction::PLP)
+			return cpu.BasicCPU::Ins_PLP(addr);
+		else if constexpr (Instr == Instruction::ROL)
+			return cpu.BasicCPU::Ins_ROL(addr);
+		else if constexpr (Instr == Instruction::ROR)
+			return cpu.BasicCPU::Ins_ROR(addr);
+		else if constexpr (Instr == Instruction::RTI)
+			return cpu.BasicCPU::Ins_RTI(addr);
+		else if constexpr (Instr == Instruction::RTS)
+			return cpu.BasicCPU::Ins_RTS(addr);
+		else if constexpr (Instr == Instruction::SBC)
+			return cpu.BasicCPU::Ins_SBC(addr);
+		else if constexpr (Instr == Instruction::SEC)
+			return cpu.BasicCPU::Ins_SEC(addr);
+		else if constexpr (Instr == Instruction::SED)
+			return cpu.BasicCPU::Ins_SED(addr);
+		else if constexpr (Instr == Instruction::SEI)
+			return cpu.BasicCPU::Ins_SEI(addr);
+		else if constexpr (Instr == Instruction::STA)
+			return cpu.BasicCPU::Ins_STA(addr);
+		else if constexpr (Instr == Instruction::STX)
+			return cpu.BasicCPU::Ins_STX(addr);
+		else if constexpr (Instr == Instruction::STY)
+			return cpu.BasicCPU::Ins_STY(addr);
+		else if constexpr (Instr == Instruction::TAX)
+			return cpu.BasicCPU::Ins_TAX(addr);
+		else if constexpr (Instr == Instruction::TAY)
+			return cpu.BasicCPU::Ins_TAY(addr);
+		else if constexpr (Instr == Instruction::TSX)
+			return cpu.BasicCPU::Ins_TSX(addr);
+		else if constexpr (Instr == Instruction::TXA)
+			return cpu.BasicCPU::Ins_TXA(addr);
+		else if constexpr (Instr == Instruction::TXS)
+			return cpu.BasicCPU::Ins_TXS(addr);
+		else if constexpr (Instr == Instruction::TYA)
+			return cpu.BasicCPU::Ins_TYA(addr);
+		else { // Illegal Operand
+			std::cerr << "attempting to execute an illegal instruction in mos6502::CPU::Dispatch" << std::endl;
+			return 0;
+		}
+	}
+
+	template<class BusT>
+	template<AddressMode Mode, Instruction Instr>
+	fast_byte BasicCPU<BusT>::Dispatch(BasicCPU& cpu) {
+		cpu.ClearSupplied();
+
+		fast_byte countAddressing = 0;
+		const address addr = AddressingFor<Mode>(cpu, countAddressing);
+
+		return countAddressing + InstructionFor<Instr>(cpu, addr);
+	}
+
+	template<class BusT>
+	template<size_t... OpCodes>
+	constexpr std::array<typename BasicCPU<BusT>::Handler, 256> BasicCPU<BusT>::MakeDispatchTable(std::index_sequence<OpCodes...>) {
+		return { {
+			&BasicCPU::Dispatch<InstructionDetails[OpCodes].addressing, InstructionDetails[OpCodes].instruction>...
+		} };
+	}
+
+	template<class BusT>
+	const std::array<typename BasicCPU<BusT>::Handler, 256> BasicCPU<BusT>::DispatchTable = BasicCPU<BusT>::MakeDispatchTable(std::make_index_sequence<256>{});
+
+	template<class BusT>
+	template<AddressMode Mode>
+	address BasicCPU<BusT>::ResolveFor(BasicCPU& cpu, const word operand, fast_byte& outCycles) {
+		if constexpr (Mode == AddressMode::ABS)
+			return cpu.BasicCPU::Resolve_ABS(operand, outCycles);
+		else if constexpr (Mode == AddressMode::ABX)
+			return cpu.BasicCPU::Resolve_ABX(operand, outCycles);
+		else if constexpr (Mode == AddressMode::ABY)
+			return cpu.BasicCPU::Resolve_ABY(operand, outCycles);
+		else if constexpr (Mode == AddressMode::ACC)
+			return cpu.BasicCPU::Resolve_ACC(operand, outCycles);
+		else if constexpr (Mode == AddressMode::IMM)
+			return cpu.BasicCPU::Resolve_IMM(operand, outCycles);
+		else if constexpr (Mode == AddressMode::IMP)
+			return cpu.BasicCPU::Resolve_IMP(operand, outCycles);
+		else if constexpr (Mode == AddressMode::IND)
+			return cpu.BasicCPU::Resolve_IND(operand, outCycles);
+		else if constexpr (Mode == AddressMode::INX)
+			return cpu.BasicCPU::Resolve_INX(operand, outCycles);
+		else if constexpr (Mode == AddressMode::INY)
+			return cpu.BasicCPU::Resolve_INY(operand, outCycles);
+		else if constexpr (Mode == AddressMode::REL)
+			return cpu.BasicCPU::Resolve_REL(operand, outCycles);
+		else if constexpr (Mode == AddressMode::ZPG)
+			return cpu.BasicCPU::Resolve_ZPG(operand, outCycles);
+		else if constexpr (Mode == AddressMode::ZPX)
+			return cpu.BasicCPU::Resolve_ZPX(operand, outCycles);
+		else if constexpr (Mode == AddressMode::ZPY)
+			return cpu.BasicCPU::Resolve_ZPY(operand, outCycles);
+		else // Illegal Address Mode, reported by the instruction
+			return 0;
+	}
+
+	template<class BusT>
+	template<AddressMode Mode, Instruction Instr>
+	fast_byte BasicCPU<BusT>::CachedDispatch(BasicCPU& cpu, const CachedOp& op, const uint64_t) {
+		// The opcode and operand were fetched when the block was decoded
+		cpu.m_PC = op.nextPC;
+		cpu.m_InstructionsExecuted++;
+		cpu.ClearSupplied();
+
+		fast_byte countAddressing = 0;
+		const address addr = ResolveFor<Mode>(cpu, op.operand, countAddressing);
+
+		return countAddressing + InstructionFor<Instr>(cpu, addr);
+	}
+
+	template<class BusT>
+	template<byte First, byte Second>
+	fast_byte BasicCPU<BusT>::FusedDispatch(BasicCPU& cpu, const CachedOp& op, const uint64_t budget) {
+		constexpr const InstructionDetail& first = InstructionDetails[First];
+		constexpr const InstructionDetail& second = InstructionDetails[Second];
+
+		const fast_byte cycles = CachedDispatch<first.addressing, first.instruction>(cpu, op, budget);
+
+		// Stop in between wherever Run() would have (see RunBlock)
+		if (cycles >= budget || cpu.HasPendingInterrupt() || cpu.m_BlockCache->HasInvalidations())
+			return cycles;
+
+		return cycles + CachedDispatch<second.addressing, second.instruction>(cpu, (&op)[1], budget - cycles);
+	}
+
+	template<class BusT>
+	template<size_t... OpCodes>
+	constexpr std::array<typename BasicCPU<BusT>::CachedHandler, 256> BasicCPU<BusT>::MakeCachedTable(std::index_sequence<OpCodes...>) {
+		return { {
+			&BasicCPU::CachedDispatch<InstructionDetails[OpCodes].addressing, InstructionDetails[OpCodes].instruction>...
+		} };
+	}
+
+	template<class BusT>
+	const std::array<typename BasicCPU<BusT>::CachedHandler, 256> BasicCPU<BusT>::CachedTable = BasicCPU<BusT>::MakeCachedTable(std::make_index_sequence<256>{});
+
+	namespace {
+		// Pairs of opcodes given a single handler when one follows the other
+		// in a cached block. None of the first opcodes write to memory, so the
+		// code of the second cannot change in between.
+		struct FusedPair {
+			byte first;
+			byte second;
+		};
+
+		// LDA #, zpg, zpg,X, abs, abs,X, abs,Y, (ind),Y
+		constexpr byte FUSED_LOADS[] = { 0xA9, 0xA5, 0xB5, 0xAD, 0xBD, 0xB9, 0xB1 };
+
+		// STA zpg, zpg,X, abs, abs,X, abs,Y, (ind),Y
+		constexpr byte FUSED_STORES[] = { 0x85, 0x95, 0x8D, 0x9D, 0x99, 0x91 };
+
+		// CMP #, zpg, abs, abs,X, abs,Y, (ind),Y, then CPX and CPY #, zpg, abs
+		constexpr byte FUSED_COMPARES[] = { 0xC9, 0xC5, 0xCD, 0xDD, 0xD9, 0xD1, 0xE0, 0xE4, 0xEC, 0xC0, 0xC4, 0xCC };
+
+		// DEX, DEY, INX, INY
+		constexpr byte FUSED_COUNTERS[] = { 0xCA, 0x88, 0xE8, 0xC8 };
+
+		// BNE, BEQ, BCC, BCS, BPL, BMI
+		constexpr byte FUSED_BRANCHES[] = { 0xD0, 0xF0, 0x90, 0xB0, 0x10, 0x30 };
+
+		constexpr size_t FUSED_PAIR_COUNT = std::size(FUSED_LOADS) * std::size(FUSED_STORES)
+			+ (std::size(FUSED_COMPARES) + std::size(FUSED_COUNTERS)) * std::size(FUSED_BRANCHES);
+
+		constexpr std::array<FusedPair, FUSED_PAIR_COUNT> MakeFusedPairs() {
+			std::array<FusedPair, FUSED_PAIR_COUNT> pairs{};
+			size_t count = 0;
+			for (const byte load : FUSED_LOADS) {
+				for (const byte store : FUSED_STORES)
+					pairs[count++] = { load, store };
+			}
+			for (const byte compare : FUSED_COMPARES) {
+				for (const byte branch : FUSED_BRANCHES)
+					pairs[count++] = { compare, branch };
+			}
+			for (const byte counter : FUSED_COUNTERS) {
+				for (const byte branch : FUSED_BRANCHES)
+					pairs[count++] = { counter, branch };
+			}
+			return pairs;
+		}
+
+		constexpr auto FusedPairs = MakeFusedPairs();
+	}
+
+	template<class BusT>
+	template<size_t... Pairs>
+	constexpr std::array<typename BasicCPU<BusT>::CachedHandler, sizeof...(Pairs)> BasicCPU<BusT>::MakeFusedTable(std::index_sequence<Pairs...>) {
+		return { {
+			&BasicCPU::FusedDispatch<FusedPairs[Pairs].first, FusedPairs[Pairs].second>...
+		} };
+	}
+
+	template<class BusT>
+	typename BasicCPU<BusT>::CachedHandler BasicCPU<BusT>::FindFusedHandler(const byte first, const byte second) {
+		static constexpr auto handlers = MakeFusedTable(std::make_index_sequence<FUSED_PAIR_COUNT>{});
+
+		// Only searched while decoding, so a plain scan will do
+		for (size_t i = 0; i < FUSED_PAIR_COUNT; i++) {
+			if (FusedPairs[i].first == first && FusedPairs[i].second == second)
+				return handlers[i];
+		}
+		return nullptr;
+	}
+
+	// Explicit instantiations for the supported bus types (see cpu.h)
+	template class BasicCPU<IODevice>;
+	template class BasicCPU<FlatMemoryBus>;
+	template class BasicCPU<Bus>;
+
+}
@@ -14,7 +14,8 @@
 
 namespace mos6502 {
 
-	fast_byte CPU::ExecuteInstruction(const Instruction& instr, const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::ExecuteInstruction(const Instruction& instr, const address& addr) {
 		switch (instr) {
 			case Instruction::ILL: // Illegal Operand
 				std::cerr << "attempting to execute an illegal instruction in mos6502::CPU::ExecuteInstruction" << std::endl;
@@ -140,12 +141,18 @@ namespace mos6502 {
 		return 0;
 	}
 
-	fast_byte CPU::Branch(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Branch(const address& addr) {
 		// Get the next program counter address
 		address nextPC = m_PC + addr.value;
 
 		// The amount of cycles increases if there was a page change
-		fast_byte cycles = nextPC.page != (m_PC & 0xFF00) ? 3 : 2;
+		fast_byte cycles = nextPC.page != GET_HIGH_BYTE(m_PC) ? 3 : 2;
+
+#ifdef MOS6502_PROFILE
+		if (m_Profile && cycles == 3)
+			m_Profile->RecordPageCrossing(AddressMode::REL);
+#endif
 
 		// Assign the new PC
 		m_PC = nextPC.value;
@@ -153,124 +160,98 @@ namespace mos6502 {
 		return cycles;
 	}
 
-	fast_byte CPU::Ins_ADC(const address& addr) {
-		word result = 0;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_ADC(const address& addr) {
+		const byte val = FetchData(addr);
 
 		if (HasStatusFlag(StatusFlag::DECIMAL)) {
-			// Make BCD versions of the acc and value
-			int acc_i = (m_Acc & 0xF) + (((m_Acc >> 4) & 0xF) * 10);
-			byte val = FetchData(addr);
-			int val_i = (val & 0xF) + (((val >> 4) & 0xF) * 10);
-
-			// Calculate the integer results
-			int temp = acc_i + val_i + GetStatusFlag(StatusFlag::CARRY);
-			
-			// Find and isolate the compliments
-			int hundreds = temp / 100;
-			int tens = (temp - (hundreds * 100)) / 10;
-			int ones = temp - (hundreds * 100) - (tens * 10);
-
-			result = (tens << 4) | ones;
-
-			SetStatusFlag(StatusFlag::CARRY, result > 0x99);
-		} else {
-			word carry = static_cast<word>(GetStatusFlag(StatusFlag::CARRY));
-			word acc = static_cast<word>(m_Acc);
-			word val = static_cast<word>(FetchData(addr));
-
-			result = acc + val + carry;
-
-			SetStatusFlag(StatusFlag::CARRY, result > 0xFF);
-			SetStatusFlag(StatusFlag::INT_OVERFLOW, (~(acc ^ val) & (acc ^ result)) & 0x0080);
+			SetDecimalResult(DecimalAddTable[DecimalIndex(m_Acc, val, HasStatusFlag(StatusFlag::CARRY))]);
+			return 1;
 		}
 
-		SetStatusFlag(StatusFlag::ZERO, GET_LOW_BYTE(result) == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
+		const AluResult result = AluAdd(m_Acc, val, HasStatusFlag(StatusFlag::CARRY));
+		SetAluResult(result);
 
 		//Assign the results
-		m_Acc = GET_LOW_BYTE(result); //Make it a byte
+		m_Acc = result.value;
 
 		// Minimum clock cycles required
 		return 1;
 	}
 
-	fast_byte CPU::Ins_AND(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_AND(const address& addr) {
 		m_Acc &= FetchData(addr);
 
-		SetStatusFlag(StatusFlag::ZERO, m_Acc == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Acc));
+		SetNZ(m_Acc);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_ASL(const address& addr) {
-		word result = static_cast<word>(FetchData(addr)) << 1;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_ASL(const address& addr) {
+		const AluResult result = AluShiftLeft(FetchData(addr));
+		SetAluResult(result);
 
-		{ // Set the processor status flags
-			SetStatusFlag(StatusFlag::CARRY, result > 0xFF);
-			SetStatusFlag(StatusFlag::ZERO, GET_LOW_BYTE(result) == 0);
-			SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
-		}
-
-		m_Acc = result & 0x00FF;
+		m_Acc = result.value;
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BCC(const address& addr) { 
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BCC(const address& addr) { 
 		if (HasStatusFlag(StatusFlag::CARRY) == false)
 			return Branch(addr);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BCS(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BCS(const address& addr) {
 		if (HasStatusFlag(StatusFlag::CARRY) == true)
 			return Branch(addr);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BEQ(const address& addr) { 
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BEQ(const address& addr) { 
 		if (HasStatusFlag(StatusFlag::ZERO) == true)
 			return Branch(addr);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BIT(const address& addr) {
-		byte value = FetchData(addr);
-
-		byte result = m_Acc & value;
-
-		{ // Set the processor status flags
-			SetStatusFlag(StatusFlag::ZERO, result == 0);
-			SetStatusFlag(StatusFlag::INT_OVERFLOW, value & 0x40);
-			SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(value));
-		}
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BIT(const address& addr) {
+		SetAluResult(AluBitTest(m_Acc, FetchData(addr)));
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BMI(const address& addr) { 
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BMI(const address& addr) { 
 		if (HasStatusFlag(StatusFlag::NEGATIVE) == true)
 			return Branch(addr);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BNE(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BNE(const address& addr) {
 		if (HasStatusFlag(StatusFlag::ZERO) == false)
 			return Branch(addr);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BPL(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BPL(const address& addr) {
 		if (HasStatusFlag(StatusFlag::NEGATIVE) == false)
 			return Branch(addr);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BRK(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BRK(const address& addr) {
 		//Increment PC past the brk
 		m_PC++;
 
@@ -279,7 +260,7 @@ namespace mos6502 {
 		PushToStack(GET_LOW_BYTE(m_PC)); // Low bit
 
 		//Push the Processor Status onto the stack
-		PushToStack(m_ProcStatus.value);
+		PushToStack(GetStatus().value);
 
 		//Load the interrupt vector
 		const byte low = ReadByte(0xFFFE);
@@ -294,146 +275,143 @@ namespace mos6502 {
 		return 6; //5 bytes of IO and the function
 	}
 
-	fast_byte CPU::Ins_BVC(const address& addr) { 
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BVC(const address& addr) { 
 		if (HasStatusFlag(StatusFlag::INT_OVERFLOW) == false)
 			return Branch(addr);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_BVS(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_BVS(const address& addr) {
 		if (HasStatusFlag(StatusFlag::INT_OVERFLOW) == true)
 			return Branch(addr);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_CLC(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_CLC(const address& addr) {
 		SetStatusFlag(StatusFlag::CARRY, false);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_CLD(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_CLD(const address& addr) {
 		SetStatusFlag(StatusFlag::DECIMAL, false);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_CLI(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_CLI(const address& addr) {
 		SetStatusFlag(StatusFlag::INTERRUPT, false);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_CLV(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_CLV(const address& addr) {
 		SetStatusFlag(StatusFlag::INT_OVERFLOW, false);
 		return 1;
 	}
 
-	fast_byte CPU::Ins_CMP(const address& addr) {
-		const byte value = FetchData(addr);
-		const byte result = m_Acc - value;
-
-		SetStatusFlag(StatusFlag::CARRY, m_Acc >= value);
-		SetStatusFlag(StatusFlag::ZERO, result == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_CMP(const address& addr) {
+		SetAluResult(AluCompare(m_Acc, FetchData(addr)));
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_CPX(const address& addr) {
-		const byte value = FetchData(addr);
-		const byte result = m_X - value;
-
-		SetStatusFlag(StatusFlag::CARRY, m_X >= value);
-		SetStatusFlag(StatusFlag::ZERO, result == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_CPX(const address& addr) {
+		SetAluResult(AluCompare(m_X, FetchData(addr)));
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_CPY(const address& addr) {
-		const byte value = FetchData(addr);
-		const byte result = m_Y - value;
-
-		SetStatusFlag(StatusFlag::CARRY, m_Y >= value);
-		SetStatusFlag(StatusFlag::ZERO, result == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_CPY(const address& addr) {
+		SetAluResult(AluCompare(m_Y, FetchData(addr)));
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_DEC(const address& addr) {
-		byte value = FetchData(addr);
-		value--;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_DEC(const address& addr) {
+		const AluResult result = AluDecrement(FetchData(addr));
 
 		//Write to the memory location
-		WriteByte(addr, value);
+		WriteByte(addr, result.value);
 
-		SetStatusFlag(StatusFlag::ZERO, value == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(value));
+		SetAluResult(result);
 
 		return 3; //Read, Execute, Write
 	}
 
-	fast_byte CPU::Ins_DEX(const address& addr) {
-		m_X--;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_DEX(const address& addr) {
+		const AluResult result = AluDecrement(m_X);
+		SetAluResult(result);
 
-		SetStatusFlag(StatusFlag::ZERO, m_X == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_X));
+		m_X = result.value;
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_DEY(const address& addr) {
-		m_Y--;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_DEY(const address& addr) {
+		const AluResult result = AluDecrement(m_Y);
+		SetAluResult(result);
 
-		SetStatusFlag(StatusFlag::ZERO, m_Y == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Y));
+		m_Y = result.value;
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_EOR(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_EOR(const address& addr) {
 		const byte value = FetchData(addr);
 
 		// Exclusive OR the accumulator
 		m_Acc ^= value;
 
-		SetStatusFlag(StatusFlag::ZERO, m_Acc == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Acc));
+		SetNZ(m_Acc);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_INC(const address& addr) {
-		byte value = FetchData(addr);
-		value++;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_INC(const address& addr) {
+		const AluResult result = AluIncrement(FetchData(addr));
 
 		//Write to the memory location
-		WriteByte(addr, value);
+		WriteByte(addr, result.value);
 
-		SetStatusFlag(StatusFlag::ZERO, value == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(value));
+		SetAluResult(result);
 
 		return 3; //Read, Execute, Write
 	}
 
-	fast_byte CPU::Ins_INX(const address& addr) {
-		m_X++;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_INX(const address& addr) {
+		const AluResult result = AluIncrement(m_X);
+		SetAluResult(result);
 
-		SetStatusFlag(StatusFlag::ZERO, m_X == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_X));
+		m_X = result.value;
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_INY(const address& addr) {
-		m_Y++;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_INY(const address& addr) {
+		const AluResult result = AluIncrement(m_Y);
+		SetAluResult(result);
 
-		SetStatusFlag(StatusFlag::ZERO, m_Y == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Y));
+		m_Y = result.value;
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_JMP(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_JMP(const address& addr) {
 		// NOTE: Original 6502 chips did not do this directly if the indirect addressing vector
 		// was on a page boundary (0x**FF).
 		// This was corrected in the 65SC02 chips and later.
@@ -442,7 +420,8 @@ namespace mos6502 {
 		return 1;
 	}
 
-	fast_byte CPU::Ins_JSR(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_JSR(const address& addr) {
 		//Correct the PC position
 		m_PC--;
 
@@ -456,50 +435,45 @@ namespace mos6502 {
 		return 3;
 	}
 
-	fast_byte CPU::Ins_LDA(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_LDA(const address& addr) {
 		m_Acc = FetchData(addr);
 
-		SetStatusFlag(StatusFlag::ZERO, m_Acc == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Acc));
+		SetNZ(m_Acc);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_LDX(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_LDX(const address& addr) {
 		m_X = FetchData(addr);
 
-		SetStatusFlag(StatusFlag::ZERO, m_X == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_X));
+		SetNZ(m_X);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_LDY(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_LDY(const address& addr) {
 		m_Y = FetchData(addr);
 
-		SetStatusFlag(StatusFlag::ZERO, m_Y == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Y));
+		SetNZ(m_Y);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_LSR(const address& addr) {
-		const byte value = FetchData(addr);
-
-		const byte result = value >> 1;
-
-		{ //Set status flag
-			SetStatusFlag(StatusFlag::CARRY, value & 0x01); // Last bit
-			SetStatusFlag(StatusFlag::ZERO, result == 0);
-			SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
-		}
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_LSR(const address& addr) {
+		const AluResult result = AluShiftRight(FetchData(addr));
+		SetAluResult(result);
 
-		m_Acc = result;
+		m_Acc = result.value;
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_NOP(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_NOP(const address& addr) {
 		//Do nothing.
 
 		//NOTE: Illegal opcodes may actually take 2 cycles.
@@ -508,73 +482,69 @@ namespace mos6502 {
 	}
 
 
-	fast_byte CPU::Ins_ORA(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_ORA(const address& addr) {
 		m_Acc |= FetchData(addr);
 
-		SetStatusFlag(StatusFlag::ZERO, m_Acc == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Acc));
+		SetNZ(m_Acc);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_PHA(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_PHA(const address& addr) {
 		PushToStack(m_Acc);
 
 		return 2;
 	}
 
-	fast_byte CPU::Ins_PHP(const address& addr) { 
-		PushToStack(m_ProcStatus.value);
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_PHP(const address& addr) { 
+		PushToStack(GetStatus().value);
 
 		return 2; 
 	}
 
-	fast_byte CPU::Ins_PLA(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_PLA(const address& addr) {
 		m_Acc = PullFromStack();
 
-		SetStatusFlag(StatusFlag::ZERO, m_Acc == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Acc));
+		SetNZ(m_Acc);
 
 		return 3;
 	}
 
-	fast_byte CPU::Ins_PLP(const address& addr) {
-		m_ProcStatus = PullFromStack();
-
-		SetStatusFlag(StatusFlag::UNUSED, true);
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_PLP(const address& addr) {
+		SetStatus(PullFromStack());
 
 		return 3;
 	}
 
-	fast_byte CPU::Ins_ROL(const address& addr) {
-		const byte value = FetchData(addr);
-		const byte result = (value << 1) | GetStatusFlag(StatusFlag::CARRY);
-
-		{ // Set status flags
-			SetStatusFlag(StatusFlag::CARRY, value & 0x80);
-			SetStatusFlag(StatusFlag::ZERO, result == 0);
-			SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
-		}
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_ROL(const address& addr) {
+		const AluResult result = AluRotateLeft(FetchData(addr), HasStatusFlag(StatusFlag::CARRY));
+		SetAluResult(result);
 
 		fast_byte cost = 1;
 		if (m_WasSupplied) {
-			m_Acc = result;
+			m_Acc = result.value;
 		} else {
 			cost++;
-			WriteByte(addr, result);
+			WriteByte(addr, result.value);
 		}
 
 		return cost;
 	}
 
-	fast_byte CPU::Ins_ROR(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_ROR(const address& addr) {
 		const byte value = FetchData(addr);
 		const byte result = (value >> 1) | (GetStatusFlag(StatusFlag::CARRY) << 8);
 
 		{ // Set status flags
 			SetStatusFlag(StatusFlag::CARRY, value & 0x01);
-			SetStatusFlag(StatusFlag::ZERO, result == 0);
-			SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
+			SetNZ(result);
 		}
 
 		fast_byte cost = 1;
@@ -588,9 +558,9 @@ namespace mos6502 {
 		return cost;
 	}
 
-	fast_byte CPU::Ins_RTI(const address& addr) {
-		m_ProcStatus = PullFromStack();
-		SetStatusFlag(StatusFlag::UNUSED, 1);
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_RTI(const address& addr) {
+		SetStatus(PullFromStack());
 		
 		const byte low = PullFromStack();
 		const byte high = PullFromStack();
@@ -599,7 +569,8 @@ namespace mos6502 {
 		return 5;
 	}
 
-	fast_byte CPU::Ins_RTS(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_RTS(const address& addr) {
 		const byte low = PullFromStack();
 		const byte high = PullFromStack();
 		m_PC = MAKE_WORD(low, high) + 1;
@@ -608,142 +579,122 @@ namespace mos6502 {
 		return 5;
 	}
 
-	fast_byte CPU::Ins_SBC(const address& addr) {
-		word result = 0;
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_SBC(const address& addr) {
+		const byte val = FetchData(addr);
 
 		if (HasStatusFlag(StatusFlag::DECIMAL)) {
-			// Make BCD versions of the acc and value
-			int acc_i = (m_Acc & 0xF) + (((m_Acc >> 4) & 0xF) * 10);
-			byte val = FetchData(addr);
-			int val_i = (val & 0xF) + (((val >> 4) & 0xF) * 10);
-
-			// Calculate the integer results
-			int temp = acc_i - val_i - (HasStatusFlag(StatusFlag::CARRY) ? 0 : 1);
-			if (temp < 0) temp += 2; // Hack: Correct for wrap around
-
-			// Find and isolate the compliments
-			int hundreds = std::abs(temp / 100);
-			int tens = (std::abs(temp) - (hundreds * 100)) / 10;
-			int ones = std::abs(temp) - (hundreds * 100) - (tens * 10);
-
-			if (temp < 0) {
-				tens = 9 - tens;
-				ones = 9 - ones;
-			}
-
-			result = (tens << 4) | ones;
-
-			SetStatusFlag(StatusFlag::CARRY, temp > 0);
-		} else {
-			word carry = static_cast<word>(GetStatusFlag(StatusFlag::CARRY));
-			word acc = static_cast<word>(m_Acc);
-			word val = static_cast<word>(FetchData(addr));
-
-			result = acc + (val ^ 0xFF) + carry;
-
-			//Correct for wrap around
-			if (!(result & 0xFF00))
-				result++;
-
-			SetStatusFlag(StatusFlag::CARRY, result < 0xFF);
-			SetStatusFlag(StatusFlag::INT_OVERFLOW, (~(acc ^ val) & (acc ^ result)) & 0x0080);
+			SetDecimalResult(DecimalSubtractTable[DecimalIndex(m_Acc, val, HasStatusFlag(StatusFlag::CARRY))]);
+			return 1;
 		}
 
-		SetStatusFlag(StatusFlag::ZERO, GET_LOW_BYTE(result) == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(result));
+		const AluResult result = AluSubtract(m_Acc, val, HasStatusFlag(StatusFlag::CARRY));
+		SetAluResult(result);
 
 		//Assign the results
-		m_Acc = GET_LOW_BYTE(result); //Make it a byte
+		m_Acc = result.value;
 
 		// Minimum clock cycles required
 		return 1;
 	}
 
-	fast_byte CPU::Ins_SEC(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_SEC(const address& addr) {
 		SetStatusFlag(StatusFlag::CARRY, true);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_SED(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_SED(const address& addr) {
 		SetStatusFlag(StatusFlag::DECIMAL, true);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_SEI(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_SEI(const address& addr) {
 		SetStatusFlag(StatusFlag::INTERRUPT, true);
 
 		return 1;
 	}
 
 
-	fast_byte CPU::Ins_STA(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_STA(const address& addr) {
 		WriteByte(addr, m_Acc);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_STX(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_STX(const address& addr) {
 		WriteByte(addr, m_X);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_STY(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_STY(const address& addr) {
 		WriteByte(addr, m_Y);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_TAX(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_TAX(const address& addr) {
 		m_X = m_Acc;
 
-		SetStatusFlag(StatusFlag::ZERO, m_X == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_X));
+		SetNZ(m_X);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_TAY(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_TAY(const address& addr) {
 		m_Y = m_Acc;
 
-		SetStatusFlag(StatusFlag::ZERO, m_Y == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Y));
+		SetNZ(m_Y);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_TSX(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_TSX(const address& addr) {
 		m_X = m_SP;
 
-		SetStatusFlag(StatusFlag::ZERO, m_X == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_X));
+		SetNZ(m_X);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_TXA(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_TXA(const address& addr) {
 		m_Acc = m_X;
 
-		SetStatusFlag(StatusFlag::ZERO, m_Acc == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Acc));
+		SetNZ(m_Acc);
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_TXS(const address& addr) { 
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_TXS(const address& addr) { 
 		m_SP = m_X;
 
 		return 1;
 	}
 
-	fast_byte CPU::Ins_TYA(const address& addr) {
+	template<class BusT>
+	fast_byte BasicCPU<BusT>::Ins_TYA(const address& addr) {
 		m_Acc = m_Y;
 
-		SetStatusFlag(StatusFlag::ZERO, m_Acc == 0);
-		SetStatusFlag(StatusFlag::NEGATIVE, IS_NEGATIVE(m_Acc));
+		SetNZ(m_Acc);
 
 		return 1;
 	}
+
+	// Explicit instantiations for the supported bus types (see cpu.h)
+	template class BasicCPU<IODevice>;
+	template class BasicCPU<FlatMemoryBus>;
+	template class BasicCPU<Bus>;
 };
\ No newline at end of file
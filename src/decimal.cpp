@@ -0,0 +1,43 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "decimal.h"
+
+namespace mos6502 {
+
+	namespace {
+		constexpr bool DecimalResultIs(const word packed, const byte result, const byte flags) {
+			return packed == PackDecimalResult(result, flags & DECIMAL_CARRY, flags & DECIMAL_ZERO, flags & DECIMAL_OVERFLOW, flags & DECIMAL_NEGATIVE);
+		}
+
+		// Known NMOS results, including the flags taken from intermediate values
+		static_assert(DecimalResultIs(DecimalAdd(0x12, 0x34, false), 0x46, 0), "12 + 34 = 46");
+		static_assert(DecimalResultIs(DecimalAdd(0x58, 0x46, true), 0x05, DECIMAL_CARRY | DECIMAL_OVERFLOW | DECIMAL_NEGATIVE), "58 + 46 + 1 = 105, N and V from 0xA5");
+		static_assert(DecimalResultIs(DecimalAdd(0x81, 0x92, false), 0x73, DECIMAL_CARRY | DECIMAL_OVERFLOW), "81 + 92 = 173");
+		static_assert(DecimalResultIs(DecimalAdd(0x99, 0x01, false), 0x00, DECIMAL_CARRY | DECIMAL_NEGATIVE), "99 + 01 = 100, Z from the binary sum");
+		static_assert(DecimalResultIs(DecimalSubtract(0x46, 0x12, true), 0x34, DECIMAL_CARRY), "46 - 12 = 34");
+		static_assert(DecimalResultIs(DecimalSubtract(0x32, 0x02, false), 0x29, DECIMAL_CARRY), "32 - 02 - 1 = 29");
+		static_assert(DecimalResultIs(DecimalSubtract(0x21, 0x34, false), 0x86, DECIMAL_NEGATIVE), "21 - 34 - 1 = -14, borrowing");
+		static_assert(DecimalResultIs(DecimalSubtract(0x00, 0x01, true), 0x99, DECIMAL_NEGATIVE), "00 - 01 = -1, borrowing");
+
+		template<word (*Operation)(const byte, const byte, const bool)>
+		std::array<word, DECIMAL_TABLE_SIZE> MakeDecimalTable() {
+			std::array<word, DECIMAL_TABLE_SIZE> table{};
+			for (int carry = 0; carry < 2; carry++) {
+				for (int a = 0; a < 256; a++) {
+					for (int b = 0; b < 256; b++)
+						table[DecimalIndex(a, b, carry)] = Operation(a, b, carry);
+				}
+			}
+			return table;
+		}
+	}
+
+	const std::array<word, DECIMAL_TABLE_SIZE> DecimalAddTable = MakeDecimalTable<DecimalAdd>();
+	const std::array<word, DECIMAL_TABLE_SIZE> DecimalSubtractTable = MakeDecimalTable<DecimalSubtract>();
+}
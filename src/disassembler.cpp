@@ -0,0 +1,268 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "disassembler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+#include "utils.h"
+
+namespace mos6502 {
+
+	namespace {
+		// The two hex digits of each byte value
+		struct HexTable {
+			char digits[256][2];
+
+			constexpr HexTable() : digits() {
+				for (int i = 0; i < 256; i++) {
+					digits[i][0] = "0123456789ABCDEF"[i >> 4];
+					digits[i][1] = "0123456789ABCDEF"[i & 0xF];
+				}
+			}
+		};
+		constexpr HexTable HEX_TABLE;
+
+		// Trace records per chunk formatted by a worker of FormatTraceFile()
+		constexpr size_t TRACE_CHUNK = 1 << 16;
+
+		inline char* PutByte(char* out, const byte value) {
+			out[0] = HEX_TABLE.digits[value][0];
+			out[1] = HEX_TABLE.digits[value][1];
+			return out + 2;
+		}
+
+		inline char* PutWord(char* out, const word value) {
+			return PutByte(PutByte(out, GET_HIGH_BYTE(value)), GET_LOW_BYTE(value));
+		}
+
+		inline char* PutText(char* out, const char* text, const size_t length) {
+			std::memcpy(out, text, length);
+			return out + length;
+		}
+
+		template<size_t N>
+		inline char* PutText(char* out, const char (&text)[N]) {
+			return PutText(out, text, N - 1);
+		}
+
+		inline char* PutMnemonic(char* out, const Instruction instruction) {
+			return PutText(out, GetInstructionMnmuemonic(instruction).data(), 3);
+		}
+
+		// Writes the operand as the assembler reads it, nothing for IMP
+		char* PutOperand(char* out, const InstructionDetail& detail, const word pc, const word operand) {
+			const byte low = GET_LOW_BYTE(operand);
+			switch (detail.addressing) {
+			case AddressMode::ABS:
+				return PutWord(PutText(out, "$"), operand);
+			case AddressMode::ABX:
+				return PutText(PutWord(PutText(out, "$"), operand), ",X");
+			case AddressMode::ABY:
+				return PutText(PutWord(PutText(out, "$"), operand), ",Y");
+			case AddressMode::ACC:
+				return PutText(out, "A");
+			case AddressMode::IMM:
+				return PutByte(PutText(out, "#$"), low);
+			case AddressMode::IND:
+				return PutText(PutWord(PutText(out, "($"), operand), ")");
+			case AddressMode::INX:
+				return PutText(PutByte(PutText(out, "($"), low), ",X)");
+			case AddressMode::INY:
+				return PutText(PutByte(PutText(out, "($"), low), "),Y");
+			case AddressMode::REL:
+				// Shown as the target, as it is written in the source
+				return PutWord(PutText(out, "$"), static_cast<word>(pc + 2 + static_cast<int8_t>(low)));
+			case AddressMode::ZPG:
+				return PutByte(PutText(out, "$"), low);
+			case AddressMode::ZPX:
+				return PutText(PutByte(PutText(out, "$"), low), ",X");
+			case AddressMode::ZPY:
+				return PutText(PutByte(PutText(out, "$"), low), ",Y");
+			default:
+				return out;
+			}
+		}
+	}
+
+	size_t Disassembler::FormatInstruction(char* out, const word pc, span<const byte> code) {
+		const InstructionDetail& detail = InstructionDetails[code.empty() ? 0 : code[0]];
+		const size_t length = detail.bytesUsed;
+
+		char* p = PutText(PutWord(out, pc), "  ");
+
+		// The bytes, "??" for those missing from the end of the code
+		word operand = 0;
+		for (size_t i = 0; i < 3; i++) {
+			if (i >= length)
+				p = PutText(p, "  ");
+			else if (i >= code.size())
+				p = PutText(p, "??");
+			else
+				p = PutByte(p, code[i]);
+			*p++ = ' ';
+
+			if (i > 0 && i < length && i < code.size())
+				operand |= static_cast<word>(code[i]) << ((i - 1) * 8);
+		}
+		*p++ = ' ';
+
+		p = PutMnemonic(p, detail.instruction);
+		if (code.size() < length) {
+			p = PutText(p, " ???");
+		} else {
+			char* operandStart = p + 1;
+			char* operandEnd = PutOperand(operandStart, detail, pc, operand);
+			if (operandEnd != operandStart) {
+				*p = ' ';
+				p = operandEnd;
+			}
+		}
+
+		*p++ = '\n';
+		return static_cast<size_t>(p - out);
+	}
+
+	size_t Disassembler::Disassemble(span<char> out, span<const byte> code, const word base, size_t& offset) {
+		size_t written = 0;
+		while (offset < code.size() && out.size() - written >= MAX_INSTRUCTION_LENGTH) {
+			written += FormatInstruction(out.data() + written, static_cast<word>(base + offset), code.subspan(offset, 3));
+			offset += InstructionDetails[code[offset]].bytesUsed;
+		}
+		return written;
+	}
+
+	void Disassembler::Disassemble(std::ostream& os, const IODevice& device, const word first, const word last) {
+		if (first > last)
+			return;
+
+		std::vector<byte> code(static_cast<size_t>(last - first) + 1);
+		code.resize(device.ReadBlock(first, code));
+
+		std::array<char, 1 << 14> buffer;
+		size_t offset = 0;
+		while (offset < code.size()) {
+			const size_t written = Disassemble(buffer, code, first, offset);
+			os.write(buffer.data(), written);
+		}
+	}
+
+	size_t Disassembler::FormatRecord(char* out, const TraceRecord& record, span<const byte> memory) {
+		const InstructionDetail& detail = InstructionDetails[record.opCode];
+
+		char* p = out;
+		for (int shift = 56; shift >= 0; shift -= 8)
+			p = PutByte(p, static_cast<byte>(record.cycle >> shift));
+		p = PutText(PutWord(PutText(p, "  "), record.pc), "  ");
+		p = PutText(PutByte(p, record.opCode), "  ");
+		p = PutMnemonic(p, detail.instruction);
+		*p++ = ' ';
+
+		// The operand, padded to the longest ("($1234)")
+		char* const operandEnd = p + 7;
+		const size_t last = static_cast<size_t>(record.pc) + detail.bytesUsed - 1;
+		if (last < memory.size()) {
+			word operand = 0;
+			if (detail.bytesUsed > 1)
+				operand = memory[record.pc + 1];
+			if (detail.bytesUsed > 2)
+				operand |= static_cast<word>(memory[record.pc + 2]) << 8;
+			p = PutOperand(p, detail, record.pc, operand);
+		} else {
+			p = PutText(p, GetAddressMnmuemonic(detail.addressing).data(), 3);
+		}
+		std::memset(p, ' ', operandEnd - p);
+		p = operandEnd;
+
+		p = PutByte(PutText(p, "  A="), record.acc);
+		p = PutByte(PutText(p, " X="), record.x);
+		p = PutByte(PutText(p, " Y="), record.y);
+		p = PutByte(PutText(p, " SP="), record.sp);
+
+		// As the CPU prints its status, upper case for the flags set
+		p = PutText(p, " PS=[");
+		for (int bit = 0; bit < 8; bit++)
+			*p++ = "czidbuvn"[bit] - ((record.status >> bit) & 1 ? 'a' - 'A' : 0);
+		p = PutText(p, "]\n");
+
+		return static_cast<size_t>(p - out);
+	}
+
+	size_t Disassembler::FormatTrace(span<char> out, span<const TraceRecord> records, size_t& index, span<const byte> memory) {
+		size_t written = 0;
+		while (index < records.size() && out.size() - written >= TRACE_LINE_LENGTH)
+			written += FormatRecord(out.data() + written, records[index++], memory);
+		return written;
+	}
+
+	bool Disassembler::FormatTraceFile(const std::string& tracePath, const std::string& textPath, const unsigned int threads, span<const byte> memory) {
+		std::error_code error;
+		const uintmax_t traceSize = std::filesystem::file_size(tracePath, error);
+		if (error || traceSize % sizeof(TraceRecord) != 0) {
+			std::cerr << "mos6502::Disassembler::FormatTraceFile the file \"" << tracePath << "\" is missing, or not a whole number of trace records" << std::endl;
+			return false;
+		}
+
+		// Emptied first, the mapping only ever grows it
+		{
+			std::ofstream text(textPath, std::ios::binary | std::ios::trunc);
+			if (!text) {
+				std::cerr << "mos6502::Disassembler::FormatTraceFile failed to open the file \"" << textPath << "\"" << std::endl;
+				return false;
+			}
+		}
+
+		const size_t recordCount = static_cast<size_t>(traceSize / sizeof(TraceRecord));
+		if (recordCount == 0)
+			return true;
+
+		const auto trace = MappedFile::Open(tracePath, MappedFile::Mode::READ_ONLY);
+		const auto text = trace ? MappedFile::Open(textPath, MappedFile::Mode::SHARED, recordCount * TRACE_LINE_LENGTH) : nullptr;
+		if (!text)
+			return false;
+
+		// Every line is the same length, so each chunk of records has its
+		// place in the text known up front, and the workers need not wait
+		// on each other to write them in order
+		const span<const TraceRecord> records(reinterpret_cast<const TraceRecord*>(trace->GetData()), recordCount);
+		char* const output = reinterpret_cast<char*>(text->GetData());
+		const size_t chunkCount = (recordCount + TRACE_CHUNK - 1) / TRACE_CHUNK;
+
+		std::atomic<size_t> next{ 0 };
+		const auto work = [&]() {
+			for (size_t chunk = next++; chunk < chunkCount; chunk = next++) {
+				const size_t first = chunk * TRACE_CHUNK;
+				const span<const TraceRecord> part = records.subspan(first, TRACE_CHUNK);
+
+				size_t index = 0;
+				FormatTrace(span<char>(output + first * TRACE_LINE_LENGTH, part.size() * TRACE_LINE_LENGTH), part, index, memory);
+			}
+		};
+
+		const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+		const size_t count = std::min<size_t>(threads ? threads : hardware, chunkCount);
+
+		// The calling thread is one of the workers
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < count; i++)
+			workers.emplace_back(work);
+		work();
+		for (std::thread& worker : workers)
+			worker.join();
+
+		return true;
+	}
+}
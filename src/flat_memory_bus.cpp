@@ -0,0 +1,36 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "flat_memory_bus.h"
+
+#include <iostream>
+
+namespace mos6502 {
+	std::shared_ptr<FlatMemoryBus> FlatMemoryBus::Make(std::shared_ptr<Memory> mem) {
+		return std::make_shared<FlatMemoryBus>(mem);
+	}
+
+	FlatMemoryBus::FlatMemoryBus(std::shared_ptr<Memory> mem) : m_Memory(mem) {
+		if (m_Memory && m_Memory->GetSize() < ADDRESS_SPACE_SIZE) {
+			std::cerr << "mos6502::FlatMemoryBus requires a 64KB memory, but was given "
+				<< m_Memory->GetSize() << " bytes. A new 64KB memory will be used instead." << std::endl;
+			m_Memory = nullptr;
+		} else if (m_Memory && m_Memory->IsReadOnly()) {
+			std::cerr << "mos6502::FlatMemoryBus requires a writable memory, but was given a read-only one. "
+				<< "A new 64KB memory will be used instead." << std::endl;
+			m_Memory = nullptr;
+		}
+
+		if (!m_Memory)
+			m_Memory = std::make_shared<Memory>(ADDRESS_SPACE_SIZE);
+
+		m_Data = m_Memory->GetData();
+		m_Dirty = m_Memory->GetDirtyBitmap();
+		m_Code = m_Memory->GetCodeBitmap();
+	}
+}
@@ -0,0 +1,49 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "io_device.h"
+
+#include <array>
+
+namespace mos6502 {
+
+	size_t TransferBlock(IODevice& dest, const address& destOffset, const IODevice& source, const address& sourceOffset, const size_t length) {
+		const size_t total = std::min({ length,
+			IODevice::ADDRESS_SPACE_SIZE - destOffset.value,
+			IODevice::ADDRESS_SPACE_SIZE - sourceOffset.value });
+
+		// Pages that cannot be copied straight out of the source are staged
+		std::array<byte, 256> buffer;
+
+		// Within one device, a destination just ahead of the source sees the
+		// bytes already copied, as when copying a byte at a time
+		size_t stride = buffer.size();
+		if (&dest == &source && destOffset.value > sourceOffset.value)
+			stride = std::min<size_t>(stride, destOffset.value - sourceOffset.value);
+
+		size_t index = 0;
+		while (index < total) {
+			const address from = { static_cast<int>(sourceOffset.value + index) };
+			const size_t count = std::min({ stride, buffer.size() - from.record, total - index });
+
+			span<const byte> chunk;
+			if (const byte* page = source.MapPage(from.page)) {
+				chunk = span<const byte>(page + from.record, count);
+			} else {
+				span<byte> staged(buffer.data(), count);
+				source.ReadBlock(from, staged);
+				chunk = staged;
+			}
+
+			dest.WriteBlock(static_cast<word>(destOffset.value + index), chunk);
+			index += count;
+		}
+
+		return total;
+	}
+}
@@ -0,0 +1,1087 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+
+#include "instructions.h"
+
+#ifdef MOS6502_JIT_X64
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace mos6502 {
+
+	bool JitCompiler::IsCompilable(const byte opCode) {
+		const InstructionDetail& detail = InstructionDetails[opCode];
+
+		bool memory = false;
+		bool immediate = false;
+		switch (detail.addressing) {
+		case AddressMode::ZPG:
+		case AddressMode::ZPX:
+		case AddressMode::ZPY:
+		case AddressMode::ABS:
+		case AddressMode::ABX:
+		case AddressMode::ABY:
+		case AddressMode::INY:
+			memory = true;
+			break;
+		case AddressMode::IMM:
+			immediate = true;
+			break;
+		default:
+			break;
+		}
+
+		switch (detail.instruction) {
+		case Instruction::LDA:
+		case Instruction::LDX:
+		case Instruction::LDY:
+		case Instruction::AND:
+		case Instruction::ORA:
+		case Instruction::EOR:
+		case Instruction::ADC:
+		case Instruction::SBC:
+		case Instruction::CMP:
+		case Instruction::CPX:
+		case Instruction::CPY:
+		case Instruction::BIT:
+			return memory || immediate;
+
+		case Instruction::STA:
+		case Instruction::STX:
+		case Instruction::STY:
+		case Instruction::INC:
+		case Instruction::DEC:
+			return memory;
+
+		// NOTE: ASL and LSR always write the accumulator, and ROR loses
+		// the carry, so only the forms that behave as documented are compiled
+		case Instruction::ROL:
+			return memory || detail.addressing == AddressMode::ACC;
+		case Instruction::ASL:
+		case Instruction::LSR:
+			return detail.addressing == AddressMode::ACC;
+
+		case Instruction::JMP:
+			return detail.addressing == AddressMode::ABS;
+
+		case Instruction::BCC:
+		case Instruction::BCS:
+		case Instruction::BEQ:
+		case Instruction::BMI:
+		case Instruction::BNE:
+		case Instruction::BPL:
+		case Instruction::BVC:
+		case Instruction::BVS:
+		case Instruction::CLC:
+		case Instruction::CLD:
+		case Instruction::CLV:
+		case Instruction::SEC:
+		case Instruction::SED:
+		case Instruction::DEX:
+		case Instruction::DEY:
+		case Instruction::INX:
+		case Instruction::INY:
+		case Instruction::TAX:
+		case Instruction::TAY:
+		case Instruction::TSX:
+		case Instruction::TXA:
+		case Instruction::TXS:
+		case Instruction::TYA:
+		case Instruction::PHA:
+		case Instruction::PHP:
+		case Instruction::PLA:
+		case Instruction::JSR:
+		case Instruction::RTS:
+		case Instruction::NOP:
+			return true;
+
+		// Everything else is interpreted, including anything touching the
+		// interrupt flag (CLI, SEI, PLP, RTI) or stopping Run() (BRK, ILL)
+		default:
+			return false;
+		}
+	}
+
+#ifdef MOS6502_JIT_X64
+
+	namespace {
+
+		// x86-64 general purpose registers
+		enum Reg : int { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7, R8 = 8, R9 = 9, R10 = 10, R11 = 11, R14 = 14, R15 = 15 };
+
+		// Condition codes, for Jcc and SETcc
+		enum Cond : int { CC_O = 0x0, CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6 };
+
+		// 8-bit ALU instructions, "op r/m8, r8". The /digit of the immediate forms is op >> 3.
+		enum Alu : int { ALU_ADD = 0x00, ALU_OR = 0x08, ALU_ADC = 0x10, ALU_SBB = 0x18, ALU_AND = 0x20, ALU_SUB = 0x28, ALU_XOR = 0x30, ALU_CMP = 0x38 };
+
+		// Shifts and rotates, as the /digit of their opcodes
+		enum Shift : int { SHIFT_RCL = 2, SHIFT_SHL = 4, SHIFT_SHR = 5 };
+
+		// Register use of the compiled code. A, X, Y, SP, and the Processor
+		// Status (but for Z and N) live in registers, zero extended. Z and N
+		// stay in the JitState, as resultZ and resultN, being stored by most
+		// instructions and read by few. RAX holds computed addresses, RCX
+		// operand values, RDI is scratch.
+#ifdef _WIN32
+		constexpr int ARGUMENT = RCX;
+#else
+		constexpr int ARGUMENT = RDI;
+#endif
+		constexpr int STATE = R11;
+		constexpr int MEMORY = R10;
+		constexpr int DIRTY = RBX;
+		constexpr int CODE = RSI;
+		constexpr int REG_A = R8;
+		constexpr int REG_X = R9;
+		constexpr int REG_Y = RDX;
+		constexpr int REG_SP = R14;
+		constexpr int REG_P = R15;
+
+		// A memory operand, [base + index + disp]
+		struct Mem {
+			int base;
+			int index;
+			int32_t disp;
+		};
+
+		constexpr Mem At(const int base, const int32_t disp = 0) { return Mem{ base, -1, disp }; }
+		constexpr Mem At(const int base, const int index, const int32_t disp) { return Mem{ base, index, disp }; }
+		constexpr Mem Field(const size_t offset) { return Mem{ STATE, -1, static_cast<int32_t>(offset) }; }
+
+		// Encodes the handful of x86-64 instructions the compiler needs
+		class Emitter {
+		public:
+			using Label = size_t;
+
+			std::vector<byte> code;
+
+			Label NewLabel() {
+				m_Labels.push_back(UNBOUND);
+				return m_Labels.size() - 1;
+			}
+
+			void Bind(const Label label) { m_Labels[label] = code.size(); }
+
+			// Fills in the jumps, once every label is bound
+			void Finish() {
+				for (const auto& [at, label] : m_Jumps) {
+					const int32_t rel = static_cast<int32_t>(m_Labels[label] - (at + 4));
+					std::memcpy(&code[at], &rel, sizeof(rel));
+				}
+			}
+
+			void Jcc(const Cond cc, const Label label) { Bytes({ 0x0F, 0x80 | cc }); Jump(label); }
+			void Jmp(const Label label) { Byte(0xE9); Jump(label); }
+			void Ret() { Byte(0xC3); }
+			void Cmc() { Byte(0xF5); }
+
+			void Push(const int reg) { Rex(false, 0, 0, reg); Byte(0x50 | (reg & 7)); }
+			void Pop(const int reg) { Rex(false, 0, 0, reg); Byte(0x58 | (reg & 7)); }
+
+			void Mov64(const int dst, const int src) { Op({ 0x89 }, src, dst, true); }
+			void Load64(const int dst, const Mem& m) { Op({ 0x8B }, dst, m, true); }
+			void Cmp64(const int reg, const Mem& m) { Op({ 0x3B }, reg, m, true); }
+			void Add64(const Mem& m, const int32_t imm) {
+				if (imm >= -128 && imm <= 127) {
+					Op({ 0x83 }, 0, m, true);
+					Byte(imm);
+				} else {
+					Op({ 0x81 }, 0, m, true);
+					Imm32(imm);
+				}
+			}
+
+			void Mov32(const int dst, const int src) { Op({ 0x89 }, src, dst); }
+			void Mov32Imm(const int dst, const int32_t imm) { Rex(false, 0, 0, dst); Byte(0xB8 | (dst & 7)); Imm32(imm); }
+			void Lea32(const int dst, const Mem& m) { Op({ 0x8D }, dst, m); }
+			void Alu32(const Alu alu, const int dst, const int src) { Op({ alu | 1 }, src, dst); }
+			void Alu32Imm(const Alu alu, const int dst, const int32_t imm) { Op({ 0x81 }, alu >> 3, dst); Imm32(imm); }
+			void Shift32(const Shift shift, const int dst, const byte count) { Op({ 0xC1 }, shift, dst); Byte(count); }
+			void Bt64(const Mem& m, const int bit) { Op({ 0x0F, 0xA3 }, bit, m, true); }
+			void Bts64(const Mem& m, const int bit) { Op({ 0x0F, 0xAB }, bit, m, true); }
+
+			void Movzx8(const int dst, const Mem& m) { Op({ 0x0F, 0xB6 }, dst, m); }
+			void Movzx8(const int dst, const int src) { Op({ 0x0F, 0xB6 }, dst, src, false, true); }
+			void Movzx16(const int dst, const int src) { Op({ 0x0F, 0xB7 }, dst, src); }
+			void Store8(const Mem& m, const int src) { Op({ 0x88 }, src, m, false, true); }
+			void Store8Imm(const Mem& m, const byte imm) { Op({ 0xC6 }, 0, m); Byte(imm); }
+			void Store16(const Mem& m, const int src) { Byte(0x66); Op({ 0x89 }, src, m); }
+			void Store16Imm(const Mem& m, const word imm) { Byte(0x66); Op({ 0xC7 }, 0, m); Byte(imm & 0xFF); Byte(imm >> 8); }
+
+			void Alu8(const Alu alu, const int dst, const int src) { Op({ alu }, src, dst, false, true); }
+			void Alu8Imm(const Alu alu, const int dst, const byte imm) { Op({ 0x80 }, alu >> 3, dst, false, true); Byte(imm); }
+			void Alu8(const Alu alu, const Mem& m, const int src) { Op({ alu }, src, m, false, true); }
+			void Alu8Imm(const Alu alu, const Mem& m, const byte imm) { Op({ 0x80 }, alu >> 3, m); Byte(imm); }
+			void Test8(const Mem& m, const byte imm) { Op({ 0xF6 }, 0, m); Byte(imm); }
+			void Test8(const int reg, const byte imm) { Op({ 0xF6 }, 0, reg, false, true); Byte(imm); }
+			void Inc8(const int reg) { Op({ 0xFE }, 0, reg, false, true); }
+			void Dec8(const int reg) { Op({ 0xFE }, 1, reg, false, true); }
+			void Dec8(const Mem& m) { Op({ 0xFE }, 1, m); }
+			void Shift8(const Shift shift, const int reg) { Op({ 0xD0 }, shift, reg, false, true); }
+			void Shift8(const Shift shift, const int reg, const byte count) { Op({ 0xC0 }, shift, reg, false, true); Byte(count); }
+			void Setcc(const Cond cc, const int reg) { Op({ 0x0F, 0x90 | cc }, 0, reg, false, true); }
+
+		private:
+			static constexpr size_t UNBOUND = ~size_t(0);
+
+			void Byte(const int value) { code.push_back(static_cast<byte>(value)); }
+			void Bytes(std::initializer_list<int> values) { for (const int value : values) Byte(value); }
+			void Imm32(const int32_t value) { for (int i = 0; i < 4; i++) Byte((value >> (i * 8)) & 0xFF); }
+
+			void Jump(const Label label) {
+				m_Jumps.emplace_back(code.size(), label);
+				Imm32(0);
+			}
+
+			// A REX prefix, if any of the registers need one. Byte operations
+			// on SPL, BPL, SIL, and DIL need one, even if otherwise empty.
+			void Rex(const bool wide, const int reg, const int index, const int base, const bool force = false) {
+				const int rex = 0x40 | (wide ? 0x08 : 0) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+				if (rex != 0x40 || force)
+					Byte(rex);
+			}
+
+			static bool NeedsByteRex(const int reg) { return reg >= RSP && reg <= RDI; }
+
+			// An instruction with a register (or /digit) and a register operand
+			void Op(std::initializer_list<int> opcode, const int reg, const int rm, const bool wide = false, const bool bytes = false) {
+				Rex(wide, reg, 0, rm, bytes && (NeedsByteRex(reg) || NeedsByteRex(rm)));
+				Bytes(opcode);
+				Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+			}
+
+			// An instruction with a register (or /digit) and a memory operand
+			void Op(std::initializer_list<int> opcode, const int reg, const Mem& m, const bool wide = false, const bool bytes = false) {
+				Rex(wide, reg, m.index < 0 ? 0 : m.index, m.base, bytes && NeedsByteRex(reg));
+				Bytes(opcode);
+
+				// RBP and R13 as a base always take a displacement
+				const int base = m.base & 7;
+				int mod = 2;
+				if (m.disp == 0 && base != RBP)
+					mod = 0;
+				else if (m.disp >= -128 && m.disp <= 127)
+					mod = 1;
+
+				if (m.index < 0) {
+					Byte((mod << 6) | ((reg & 7) << 3) | base);
+					if (base == RSP)
+						Byte(0x24);
+				} else {
+					Byte((mod << 6) | ((reg & 7) << 3) | 4);
+					Byte(((m.index & 7) << 3) | base);
+				}
+
+				if (mod == 1)
+					Byte(m.disp);
+				else if (mod == 2)
+					Imm32(m.disp);
+			}
+
+			std::vector<size_t> m_Labels;
+			std::vector<std::pair<size_t, Label>> m_Jumps;
+		};
+
+		// Clock cycles of an addressing mode, as added by BasicCPU::Resolve_*.
+		// ABX, ABY, and INY take one more crossing a page.
+		constexpr unsigned int AddressCycles(const AddressMode mode) {
+			switch (mode) {
+			case AddressMode::ZPG:
+				return 2;
+			case AddressMode::ABS:
+			case AddressMode::ABX:
+			case AddressMode::ABY:
+			case AddressMode::ZPX:
+			case AddressMode::ZPY:
+				return 3;
+			case AddressMode::INY:
+				return 4;
+			default:
+				return 1;
+			}
+		}
+
+		// Clock cycles of an instruction, as returned by BasicCPU::Ins_*.
+		// Branches return 1 when not taken.
+		constexpr unsigned int InstructionCycles(const Instruction instruction, const AddressMode mode) {
+			switch (instruction) {
+			case Instruction::INC:
+			case Instruction::DEC:
+			case Instruction::JSR:
+			case Instruction::PLA:
+				return 3;
+			case Instruction::PHA:
+			case Instruction::PHP:
+				return 2;
+			case Instruction::RTS:
+				return 5;
+			case Instruction::ROL:
+				return mode == AddressMode::ACC ? 1 : 2;
+			default:
+				return 1;
+			}
+		}
+
+		constexpr bool IsBranch(const Instruction instruction) {
+			switch (instruction) {
+			case Instruction::BCC:
+			case Instruction::BCS:
+			case Instruction::BEQ:
+			case Instruction::BMI:
+			case Instruction::BNE:
+			case Instruction::BPL:
+			case Instruction::BVC:
+			case Instruction::BVS:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// The most clock cycles an instruction may take
+		constexpr unsigned int MaxCycles(const InstructionDetail& detail) {
+			unsigned int cycles = AddressCycles(detail.addressing) + InstructionCycles(detail.instruction, detail.addressing);
+			if (detail.addressing == AddressMode::ABX || detail.addressing == AddressMode::ABY || detail.addressing == AddressMode::INY)
+				cycles++;
+			if (IsBranch(detail.instruction))
+				cycles += 2; // Taken, onto another page
+			return cycles;
+		}
+
+		// Returns true if the instruction jumps or branches to the address
+		bool LoopsToStart(const JitInstruction& last, const word start) {
+			const InstructionDetail& detail = InstructionDetails[last.opCode];
+			if (detail.instruction == Instruction::JMP)
+				return last.operand == start;
+			if (!IsBranch(detail.instruction))
+				return false;
+
+			const word rel = static_cast<word>(static_cast<int8_t>(GET_LOW_BYTE(last.operand)));
+			return static_cast<word>(last.pc + detail.bytesUsed + rel) == start;
+		}
+
+		// Compiles one block into an Emitter
+		class BlockCompiler {
+		public:
+			void Compile(const JitInstruction* instructions, const size_t count) {
+				m_Start = instructions[0].pc;
+				m_Epilogue = e.NewLabel();
+				m_Loop = e.NewLabel();
+
+				// Prologue, RBX, R14, R15 (and on Windows RSI and RDI) are callee saved
+				e.Mov64(STATE, ARGUMENT);
+				e.Push(RBX);
+				e.Push(RSI);
+				e.Push(RDI);
+				e.Push(R14);
+				e.Push(R15);
+				e.Load64(MEMORY, Field(offsetof(JitState, memory)));
+				e.Load64(DIRTY, Field(offsetof(JitState, dirty)));
+				e.Load64(CODE, Field(offsetof(JitState, code)));
+				e.Movzx8(REG_A, Field(offsetof(JitState, acc)));
+				e.Movzx8(REG_X, Field(offsetof(JitState, x)));
+				e.Movzx8(REG_Y, Field(offsetof(JitState, y)));
+				e.Movzx8(REG_SP, Field(offsetof(JitState, sp)));
+				e.Movzx8(REG_P, Field(offsetof(JitState, status)));
+				e.Bind(m_Loop);
+
+				for (size_t i = 0; i < count; i++) {
+					m_Current = &instructions[i];
+					m_Detail = &InstructionDetails[m_Current->opCode];
+					m_Next = static_cast<word>(m_Current->pc + m_Detail->bytesUsed);
+					m_Cost = AddressCycles(m_Detail->addressing) + InstructionCycles(m_Detail->instruction, m_Detail->addressing);
+
+					EmitInstruction();
+
+					if (i + 1 < count)
+						maxCyclesBeforeLast += MaxCycles(*m_Detail);
+					m_Cycles += m_Cost;
+					m_Instructions++;
+				}
+
+				// Ran off the end of the compiled instructions
+				if (!m_Terminated)
+					EmitExit(m_Next, m_Cycles, m_Instructions);
+
+				// Out-of-line exits, taken from the middle of the block
+				for (const Stub& stub : m_Stubs) {
+					e.Bind(stub.label);
+					if (stub.codeWritten) {
+						if (stub.constant)
+							e.Mov32Imm(RAX, stub.address);
+						e.Store16(Field(offsetof(JitState, codeAddress)), RAX);
+						e.Store8Imm(Field(offsetof(JitState, codeWritten)), 1);
+					}
+					EmitExit(stub.pc, stub.cycles, stub.instructions);
+				}
+
+				e.Bind(m_Epilogue);
+				e.Store8(Field(offsetof(JitState, acc)), REG_A);
+				e.Store8(Field(offsetof(JitState, x)), REG_X);
+				e.Store8(Field(offsetof(JitState, y)), REG_Y);
+				e.Store8(Field(offsetof(JitState, sp)), REG_SP);
+				e.Store8(Field(offsetof(JitState, status)), REG_P);
+				e.Pop(R15);
+				e.Pop(R14);
+				e.Pop(RDI);
+				e.Pop(RSI);
+				e.Pop(RBX);
+				e.Ret();
+
+				e.Finish();
+			}
+
+			Emitter e;
+			unsigned int maxCyclesBeforeLast = 0;
+
+		private:
+			// Where an instruction reads or writes memory
+			struct Target {
+				bool constant;		// The address is known, otherwise it is in RAX
+				word address;
+				int page;			// The page if known, otherwise -1
+			};
+
+			// An exit from the middle of the block, after the instructions counted
+			struct Stub {
+				Emitter::Label label;
+				word pc;
+				unsigned int cycles;
+				unsigned int instructions;
+				bool codeWritten;
+				bool constant;		// As for the Target written
+				word address;
+			};
+
+			Emitter::Label AddStub(const word pc, const unsigned int cycles, const unsigned int instructions) {
+				m_Stubs.push_back(Stub{ e.NewLabel(), pc, cycles, instructions, false, false, 0 });
+				return m_Stubs.back().label;
+			}
+
+			// Counts the instructions and cycles (beyond any page crossings
+			// already added) and leaves with the program counter
+			void EmitExit(const word pc, const unsigned int cycles, const unsigned int instructions) {
+				if (cycles > 0)
+					e.Add64(Field(offsetof(JitState, cycles)), cycles);
+				if (instructions > 0)
+					e.Add64(Field(offsetof(JitState, instructions)), instructions);
+				e.Store16Imm(Field(offsetof(JitState, pc)), pc);
+				e.Jmp(m_Epilogue);
+			}
+
+			// Leaves for the target of a jump, or goes around again if it is
+			// the start of the block and the budget allows
+			void EmitJump(const word target, const unsigned int cycles) {
+				m_Terminated = true;
+				if (target != m_Start) {
+					EmitExit(target, cycles, m_Instructions + 1);
+					return;
+				}
+
+				e.Add64(Field(offsetof(JitState, cycles)), cycles);
+				e.Add64(Field(offsetof(JitState, instructions)), m_Instructions + 1);
+				e.Load64(RAX, Field(offsetof(JitState, cycles)));
+				e.Cmp64(RAX, Field(offsetof(JitState, cycleLimit)));
+				e.Jcc(CC_B, m_Loop);
+				EmitExit(m_Start, 0, 0);
+			}
+
+			void AddPageCrossing() {
+				e.Add64(Field(offsetof(JitState, cycles)), 1);
+			}
+
+			// Computes the address of the operand, adding the page crossing
+			// cycle if that happens
+			Target EmitAddress() {
+				const word operand = m_Current->operand;
+				const byte low = GET_LOW_BYTE(operand);
+
+				switch (m_Detail->addressing) {
+				case AddressMode::ZPG:
+					return Target{ true, low, 0 };
+				case AddressMode::ABS:
+					return Target{ true, operand, GET_HIGH_BYTE(operand) };
+
+				case AddressMode::ZPX:
+				case AddressMode::ZPY:
+					e.Lea32(RAX, At(m_Detail->addressing == AddressMode::ZPX ? REG_X : REG_Y, low));
+					e.Movzx8(RAX, RAX);
+					return Target{ false, 0, 0 };
+
+				case AddressMode::ABX:
+				case AddressMode::ABY: {
+					const int index = m_Detail->addressing == AddressMode::ABX ? REG_X : REG_Y;
+					e.Lea32(RAX, At(index, operand));
+					e.Movzx16(RAX, RAX);
+
+					// Crossing a page when the index and low byte pass 0xFF
+					if (low > 0) {
+						const Emitter::Label same = e.NewLabel();
+						e.Alu32Imm(ALU_CMP, index, 0xFF - low);
+						e.Jcc(CC_BE, same);
+						AddPageCrossing();
+						e.Bind(same);
+					}
+					return Target{ false, 0, -1 };
+				}
+
+				case AddressMode::INY: {
+					e.Movzx8(RAX, At(MEMORY, low));
+					e.Movzx8(RCX, At(MEMORY, static_cast<byte>(low + 1)));
+					e.Alu32(ALU_ADD, RAX, REG_Y);
+
+					const Emitter::Label same = e.NewLabel();
+					e.Alu32Imm(ALU_CMP, RAX, 0xFF);
+					e.Jcc(CC_BE, same);
+					AddPageCrossing();
+					e.Bind(same);
+
+					e.Shift32(SHIFT_SHL, RCX, 8);
+					e.Alu32(ALU_ADD, RAX, RCX);
+					e.Movzx16(RAX, RAX);
+					return Target{ false, 0, -1 };
+				}
+
+				default:
+					return Target{ true, 0, 0 };
+				}
+			}
+
+			static Mem MemoryAt(const Target& target) {
+				return target.constant ? At(MEMORY, target.address) : At(MEMORY, RAX, 0);
+			}
+
+			// Loads the operand value (immediate or from memory) into the register
+			void EmitLoad(const int dst) {
+				if (m_Detail->addressing == AddressMode::IMM) {
+					e.Mov32Imm(dst, GET_LOW_BYTE(m_Current->operand));
+				} else {
+					const Target target = EmitAddress();
+					e.Movzx8(dst, MemoryAt(target));
+				}
+			}
+
+			// Marks the page written as dirty, and leaves if it holds code.
+			// The address is in RAX unless known.
+			void EmitWritten(const Target& target, const word pc) {
+				m_Stubs.push_back(Stub{ e.NewLabel(), pc, m_Cycles + m_Cost, m_Instructions + 1, true, target.constant, target.address });
+				const Emitter::Label stub = m_Stubs.back().label;
+
+				if (target.page >= 0) {
+					const byte mask = static_cast<byte>(1 << (target.page % 8));
+					e.Alu8Imm(ALU_OR, At(DIRTY, target.page / 8), mask);
+					e.Test8(At(CODE, target.page / 8), mask);
+					e.Jcc(CC_NE, stub);
+				} else {
+					e.Mov32(RCX, RAX);
+					e.Shift32(SHIFT_SHR, RCX, 8);
+					e.Bts64(At(DIRTY), RCX);
+					e.Bt64(At(CODE), RCX);
+					e.Jcc(CC_B, stub);
+				}
+			}
+
+			void EmitStore(const int src) {
+				const Target target = EmitAddress();
+				e.Store8(MemoryAt(target), src);
+				EmitWritten(target, m_Next);
+			}
+
+			void EmitNZ(const int reg) {
+				e.Store8(Field(offsetof(JitState, resultZ)), reg);
+				e.Store8(Field(offsetof(JitState, resultN)), reg);
+			}
+
+			// Sets the Carry flag from the register holding 0 or 1
+			void EmitCarry(const int reg) {
+				e.Alu8Imm(ALU_AND, REG_P, byte(0xFE));
+				e.Alu8(ALU_OR, REG_P, reg);
+			}
+
+			// Loads the Carry flag into the host carry, through the register
+			void EmitCarryIn(const int scratch) {
+				e.Movzx8(scratch, REG_P);
+				e.Shift8(SHIFT_SHR, scratch);
+			}
+
+			void EmitSetFlag(const byte flag, const bool set) {
+				if (set)
+					e.Alu8Imm(ALU_OR, REG_P, flag);
+				else
+					e.Alu8Imm(ALU_AND, REG_P, static_cast<byte>(~flag));
+			}
+
+			// Pushes the register onto the stack (the address written is left in RAX)
+			void EmitPush(const int src) {
+				e.Store8(At(MEMORY, REG_SP, 0x100), src);
+				e.Lea32(RAX, At(REG_SP, 0x100));
+				e.Dec8(REG_SP);
+				EmitWritten(Target{ false, 0, 1 }, m_Next);
+			}
+
+			void EmitPull(const int dst) {
+				e.Inc8(REG_SP);
+				e.Movzx8(dst, At(MEMORY, REG_SP, 0x100));
+			}
+
+			// ADC and SBC, in binary mode
+			void EmitArithmetic(const bool subtract) {
+				// Decimal mode is left to the interpreter
+				e.Test8(REG_P, byte(0x08));
+				e.Jcc(CC_NE, AddStub(m_Current->pc, m_Cycles, m_Instructions));
+
+				EmitLoad(RCX);
+				EmitCarryIn(RAX);
+				if (subtract) {
+					e.Cmc();
+					e.Alu8(ALU_SBB, REG_A, RCX);
+					e.Setcc(CC_AE, RAX);
+				} else {
+					e.Alu8(ALU_ADC, REG_A, RCX);
+					e.Setcc(CC_B, RAX);
+				}
+
+				e.Setcc(CC_O, RCX);
+				e.Shift8(SHIFT_SHL, RCX, 6);
+				e.Alu8(ALU_OR, RAX, RCX);
+				e.Alu8Imm(ALU_AND, REG_P, byte(0xBE));
+				e.Alu8(ALU_OR, REG_P, RAX);
+				EmitNZ(REG_A);
+			}
+
+			void EmitCompare(const int reg) {
+				EmitLoad(RCX);
+				e.Mov32(RAX, reg);
+				e.Alu8(ALU_SUB, RAX, RCX);
+				e.Setcc(CC_AE, RCX);
+				EmitCarry(RCX);
+				EmitNZ(RAX);
+			}
+
+			void EmitBranch() {
+				const word rel = static_cast<word>(static_cast<int8_t>(GET_LOW_BYTE(m_Current->operand)));
+				const word target = static_cast<word>(m_Next + rel);
+				const unsigned int taken = m_Cycles + AddressCycles(AddressMode::REL) + (GET_HIGH_BYTE(target) != GET_HIGH_BYTE(m_Next) ? 3 : 2);
+
+				// Z is set while resultZ is 0, N is bit 7 of resultN
+				Cond cc = CC_NE;
+				switch (m_Detail->instruction) {
+				case Instruction::BEQ:
+				case Instruction::BNE:
+					e.Alu8Imm(ALU_CMP, Field(offsetof(JitState, resultZ)), byte(0));
+					cc = m_Detail->instruction == Instruction::BEQ ? CC_NE : CC_E;
+					break;
+				case Instruction::BMI:
+				case Instruction::BPL:
+					e.Test8(Field(offsetof(JitState, resultN)), byte(0x80));
+					cc = m_Detail->instruction == Instruction::BMI ? CC_E : CC_NE;
+					break;
+				case Instruction::BCS:
+				case Instruction::BCC:
+					e.Test8(REG_P, byte(0x01));
+					cc = m_Detail->instruction == Instruction::BCS ? CC_E : CC_NE;
+					break;
+				default: // BVS, BVC
+					e.Test8(REG_P, byte(0x40));
+					cc = m_Detail->instruction == Instruction::BVS ? CC_E : CC_NE;
+					break;
+				}
+
+				// The condition jumps over the taken path, when not taken
+				const Emitter::Label notTaken = e.NewLabel();
+				e.Jcc(cc, notTaken);
+				EmitJump(target, taken);
+				e.Bind(notTaken);
+				EmitExit(m_Next, m_Cycles + m_Cost, m_Instructions + 1);
+			}
+
+			void EmitInstruction() {
+				const Instruction instruction = m_Detail->instruction;
+				if (IsBranch(instruction)) {
+					EmitBranch();
+					return;
+				}
+
+				switch (instruction) {
+				case Instruction::LDA:
+					EmitLoad(REG_A);
+					EmitNZ(REG_A);
+					break;
+				case Instruction::LDX:
+					EmitLoad(REG_X);
+					EmitNZ(REG_X);
+					break;
+				case Instruction::LDY:
+					EmitLoad(REG_Y);
+					EmitNZ(REG_Y);
+					break;
+
+				case Instruction::STA:
+					EmitStore(REG_A);
+					break;
+				case Instruction::STX:
+					EmitStore(REG_X);
+					break;
+				case Instruction::STY:
+					EmitStore(REG_Y);
+					break;
+
+				case Instruction::AND:
+				case Instruction::ORA:
+				case Instruction::EOR:
+					EmitLoad(RCX);
+					e.Alu8(instruction == Instruction::AND ? ALU_AND : instruction == Instruction::ORA ? ALU_OR : ALU_XOR, REG_A, RCX);
+					EmitNZ(REG_A);
+					break;
+
+				case Instruction::ADC:
+				case Instruction::SBC:
+					EmitArithmetic(instruction == Instruction::SBC);
+					break;
+
+				case Instruction::CMP:
+					EmitCompare(REG_A);
+					break;
+				case Instruction::CPX:
+					EmitCompare(REG_X);
+					break;
+				case Instruction::CPY:
+					EmitCompare(REG_Y);
+					break;
+
+				case Instruction::BIT:
+					EmitLoad(RCX);
+					e.Mov32(RAX, REG_A);
+					e.Alu8(ALU_AND, RAX, RCX);
+					e.Store8(Field(offsetof(JitState, resultZ)), RAX);
+					e.Store8(Field(offsetof(JitState, resultN)), RCX);
+					e.Alu8Imm(ALU_AND, RCX, byte(0x40));
+					e.Alu8Imm(ALU_AND, REG_P, byte(0xBF));
+					e.Alu8(ALU_OR, REG_P, RCX);
+					break;
+
+				case Instruction::INC:
+				case Instruction::DEC: {
+					const Target target = EmitAddress();
+					e.Movzx8(RCX, MemoryAt(target));
+					if (instruction == Instruction::INC)
+						e.Inc8(RCX);
+					else
+						e.Dec8(RCX);
+					e.Store8(MemoryAt(target), RCX);
+					EmitNZ(RCX);
+					EmitWritten(target, m_Next);
+					break;
+				}
+
+				case Instruction::ROL:
+					if (m_Detail->addressing == AddressMode::ACC) {
+						EmitCarryIn(RAX);
+						e.Shift8(SHIFT_RCL, REG_A);
+						e.Setcc(CC_B, RAX);
+						EmitCarry(RAX);
+						EmitNZ(REG_A);
+					} else {
+						const Target target = EmitAddress();
+						e.Movzx8(RCX, MemoryAt(target));
+						EmitCarryIn(RDI);
+						e.Shift8(SHIFT_RCL, RCX);
+						e.Setcc(CC_B, RDI);
+						EmitCarry(RDI);
+						e.Store8(MemoryAt(target), RCX);
+						EmitNZ(RCX);
+						EmitWritten(target, m_Next);
+					}
+					break;
+				case Instruction::ASL:
+				case Instruction::LSR:
+					e.Shift8(instruction == Instruction::ASL ? SHIFT_SHL : SHIFT_SHR, REG_A);
+					e.Setcc(CC_B, RAX);
+					EmitCarry(RAX);
+					EmitNZ(REG_A);
+					break;
+
+				case Instruction::INX:
+					e.Inc8(REG_X);
+					EmitNZ(REG_X);
+					break;
+				case Instruction::INY:
+					e.Inc8(REG_Y);
+					EmitNZ(REG_Y);
+					break;
+				case Instruction::DEX:
+					e.Dec8(REG_X);
+					EmitNZ(REG_X);
+					break;
+				case Instruction::DEY:
+					e.Dec8(REG_Y);
+					EmitNZ(REG_Y);
+					break;
+
+				case Instruction::TAX:
+					e.Mov32(REG_X, REG_A);
+					EmitNZ(REG_X);
+					break;
+				case Instruction::TAY:
+					e.Mov32(REG_Y, REG_A);
+					EmitNZ(REG_Y);
+					break;
+				case Instruction::TXA:
+					e.Mov32(REG_A, REG_X);
+					EmitNZ(REG_A);
+					break;
+				case Instruction::TYA:
+					e.Mov32(REG_A, REG_Y);
+					EmitNZ(REG_A);
+					break;
+				case Instruction::TSX:
+					e.Mov32(REG_X, REG_SP);
+					EmitNZ(REG_X);
+					break;
+				case Instruction::TXS:
+					e.Mov32(REG_SP, REG_X);
+					break;
+
+				case Instruction::CLC:
+					EmitSetFlag(0x01, false);
+					break;
+				case Instruction::SEC:
+					EmitSetFlag(0x01, true);
+					break;
+				case Instruction::CLD:
+					EmitSetFlag(0x08, false);
+					break;
+				case Instruction::SED:
+					EmitSetFlag(0x08, true);
+					break;
+				case Instruction::CLV:
+					EmitSetFlag(0x40, false);
+					break;
+
+				case Instruction::PHA:
+					EmitPush(REG_A);
+					break;
+				case Instruction::PHP:
+					// As GetStatus(), with Z and N from resultZ and resultN
+					e.Movzx8(RAX, REG_P);
+					e.Alu8Imm(ALU_AND, RAX, byte(0x7D));
+					e.Alu8Imm(ALU_CMP, Field(offsetof(JitState, resultZ)), byte(0));
+					e.Setcc(CC_E, RCX);
+					e.Shift8(SHIFT_SHL, RCX);
+					e.Alu8(ALU_OR, RAX, RCX);
+					e.Movzx8(RCX, Field(offsetof(JitState, resultN)));
+					e.Alu8Imm(ALU_AND, RCX, byte(0x80));
+					e.Alu8(ALU_OR, RAX, RCX);
+					EmitPush(RAX);
+					break;
+				case Instruction::PLA:
+					EmitPull(REG_A);
+					EmitNZ(REG_A);
+					break;
+
+				case Instruction::JMP:
+					EmitJump(m_Current->operand, m_Cycles + m_Cost);
+					break;
+
+				case Instruction::JSR: {
+					// Pushes the address of its last byte, high byte first
+					const word back = static_cast<word>(m_Next - 1);
+					e.Store8Imm(At(MEMORY, REG_SP, 0x100), GET_HIGH_BYTE(back));
+					e.Dec8(REG_SP);
+					e.Store8Imm(At(MEMORY, REG_SP, 0x100), GET_LOW_BYTE(back));
+					e.Lea32(RAX, At(REG_SP, 0x100));
+					e.Dec8(REG_SP);
+					EmitWritten(Target{ false, 0, 1 }, m_Current->operand);
+					EmitJump(m_Current->operand, m_Cycles + m_Cost);
+					break;
+				}
+
+				case Instruction::RTS:
+					EmitPull(RAX);
+					EmitPull(RDI);
+					e.Shift32(SHIFT_SHL, RDI, 8);
+					e.Alu32(ALU_OR, RAX, RDI);
+					e.Alu32Imm(ALU_ADD, RAX, 1);
+					e.Store16(Field(offsetof(JitState, pc)), RAX);
+					e.Add64(Field(offsetof(JitState, cycles)), m_Cycles + m_Cost);
+					e.Add64(Field(offsetof(JitState, instructions)), m_Instructions + 1);
+					e.Jmp(m_Epilogue);
+					m_Terminated = true;
+					break;
+
+				default: // NOP
+					break;
+				}
+			}
+
+			word m_Start = 0;
+			Emitter::Label m_Epilogue = 0;
+			Emitter::Label m_Loop = 0;
+			std::vector<Stub> m_Stubs;
+
+			// The instruction being compiled
+			const JitInstruction* m_Current = nullptr;
+			const InstructionDetail* m_Detail = nullptr;
+			word m_Next = 0;
+			unsigned int m_Cost = 0;
+
+			// Static cycles and instructions before it, since the start of the block.
+			// Page crossings are added to the JitState as they happen.
+			unsigned int m_Cycles = 0;
+			unsigned int m_Instructions = 0;
+			bool m_Terminated = false;
+		};
+	}
+
+	namespace {
+		size_t GetPageSize() {
+#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return info.dwPageSize;
+#else
+			return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		}
+	}
+
+	JitCompiler::JitCompiler(const size_t codeSize) {
+		m_PageSize = GetPageSize();
+		const size_t size = (codeSize + m_PageSize - 1) & ~(m_PageSize - 1);
+
+		// Mapped writable but not executable, the pages are made executable
+		// once written and never are both
+#ifdef _WIN32
+		void* code = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+		void* code = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (code == MAP_FAILED)
+			code = nullptr;
+#endif
+		m_Code = static_cast<byte*>(code);
+		m_CodeSize = m_Code ? size : 0;
+
+		// Hosts enforcing W^X may still refuse to make memory that was
+		// writable executable, which leaves the compiler unavailable
+		if (m_Code && !Protect(0, m_CodeSize, true)) {
+#ifdef _WIN32
+			VirtualFree(m_Code, 0, MEM_RELEASE);
+#else
+			munmap(m_Code, m_CodeSize);
+#endif
+			m_Code = nullptr;
+			m_CodeSize = 0;
+		}
+	}
+
+	JitCompiler::~JitCompiler() {
+		if (!m_Code)
+			return;
+#ifdef _WIN32
+		VirtualFree(m_Code, 0, MEM_RELEASE);
+#else
+		munmap(m_Code, m_CodeSize);
+#endif
+	}
+
+	bool JitCompiler::Protect(const size_t offset, const size_t size, const bool executable) {
+		const size_t begin = offset & ~(m_PageSize - 1);
+		const size_t end = std::min((offset + size + m_PageSize - 1) & ~(m_PageSize - 1), m_CodeSize);
+#ifdef _WIN32
+		DWORD old = 0;
+		return VirtualProtect(m_Code + begin, end - begin, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old) != 0;
+#else
+		return mprotect(m_Code + begin, end - begin, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) == 0;
+#endif
+	}
+
+	bool JitCompiler::Compile(const std::vector<JitInstruction>& instructions, JitBlock& outBlock) {
+		m_Full = false;
+		if (!m_Code || m_Failed)
+			return false;
+
+		size_t count = 0;
+		while (count < instructions.size() && IsCompilable(instructions[count].opCode))
+			count++;
+		if (count == 0 || (count < MIN_LENGTH && !LoopsToStart(instructions[count - 1], instructions[0].pc)))
+			return false;
+
+		BlockCompiler compiler;
+		compiler.Compile(instructions.data(), count);
+
+		const std::vector<byte>& code = compiler.e.code;
+		if (m_CodeUsed + code.size() > m_CodeSize) {
+			m_Full = true;
+			return false;
+		}
+
+		// Only the pages written to are writable, and only while they are.
+		// The code already compiled into the first of them cannot run in
+		// the meantime, which nothing does while compiling.
+		if (!Protect(m_CodeUsed, code.size(), false))
+			return false;
+
+		byte* function = m_Code + m_CodeUsed;
+		std::memcpy(function, code.data(), code.size());
+
+		if (!Protect(m_CodeUsed, code.size(), true)) {
+			// Whatever was compiled into these pages can no longer run, so
+			// everything is thrown away, as when full, and nothing more compiled
+			std::cerr << "mos6502::JitCompiler::Compile failed to make the compiled code executable" << std::endl;
+			m_Failed = true;
+			m_Full = true;
+			return false;
+		}
+#ifdef _WIN32
+		FlushInstructionCache(GetCurrentProcess(), function, code.size());
+#endif
+		// Kept aligned for the instruction fetch
+		m_CodeUsed += (code.size() + 15) & ~size_t(15);
+
+		outBlock.function = reinterpret_cast<JitFunction>(function);
+		outBlock.maxCyclesBeforeLast = compiler.maxCyclesBeforeLast;
+		return true;
+	}
+
+	void JitCompiler::Reset() {
+		m_CodeUsed = 0;
+		m_Full = false;
+	}
+
+#else // No JIT for this host
+
+	JitCompiler::JitCompiler(const size_t) {}
+	JitCompiler::~JitCompiler() {}
+
+	bool JitCompiler::Compile(const std::vector<JitInstruction>&, JitBlock&) {
+		m_Full = false;
+		return false;
+	}
+
+	void JitCompiler::Reset() {
+		m_CodeUsed = 0;
+		m_Full = false;
+	}
+
+#endif
+}
@@ -0,0 +1,200 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "journal.h"
+
+#include "utils.h"
+
+namespace mos6502 {
+
+	// A record is laid out as:
+	//   a byte of the flags below, for what the step changed
+	//   the cycles the step took, 7 bits to a byte, low first, the top bit
+	//     set on each byte but the last
+	//   the old value of each register flagged, in the order of the flags
+	//     (the program counter low byte first)
+	//   the number of bytes written, then the address (low byte first) and
+	//     old value of each
+	//   the length of the whole record, read when walking back from the head
+	namespace {
+		enum RecordFlag : byte {
+			CHANGED_PC		= (1 << 0),
+			CHANGED_SP		= (1 << 1),
+			CHANGED_ACC		= (1 << 2),
+			CHANGED_X		= (1 << 3),
+			CHANGED_Y		= (1 << 4),
+			CHANGED_STATUS	= (1 << 5),
+			CHANGED_TIMING	= (1 << 6),	// Remaining cycles, then the pending interrupts as bits
+			COUNTED			= (1 << 7),	// An instruction was executed
+		};
+
+		inline byte PendingBits(const Journal::Registers& registers) {
+			return (registers.pendingIRQ ? 1 : 0) | (registers.pendingNMI ? 2 : 0);
+		}
+	}
+
+	Journal::Journal(const size_t capacity) {
+		// Round up to a power of two so offsets can be masked
+		size_t size = 256;
+		while (size < capacity)
+			size <<= 1;
+
+		m_Data.resize(size);
+		m_Mask = size - 1;
+	}
+
+	void Journal::Clear() {
+		m_Head = m_Tail = 0;
+		m_Count = 0;
+		m_Writes.count = 0;
+		m_Overflow = false;
+		m_HasLast = false;
+	}
+
+	void Journal::EndStep(const Registers& start, const Registers& after) {
+		const Registers before = m_HasLast ? m_Last : start;
+		m_Last = after;
+		m_HasLast = true;
+
+		const uint64_t instructions = after.instructionsExecuted - before.instructionsExecuted;
+		if (m_Overflow || instructions > 1) {
+			// Not something a record can hold, so nothing before it can be undone
+			Clear();
+			m_Last = after;
+			m_HasLast = true;
+			return;
+		}
+
+		byte flags = instructions ? COUNTED : 0;
+		if (after.pc != before.pc) flags |= CHANGED_PC;
+		if (after.sp != before.sp) flags |= CHANGED_SP;
+		if (after.acc != before.acc) flags |= CHANGED_ACC;
+		if (after.x != before.x) flags |= CHANGED_X;
+		if (after.y != before.y) flags |= CHANGED_Y;
+		if (after.status != before.status) flags |= CHANGED_STATUS;
+		if (after.cyclesRem != before.cyclesRem || PendingBits(after) != PendingBits(before))
+			flags |= CHANGED_TIMING;
+
+		byte record[MAX_RECORD];
+		size_t length = 0;
+		record[length++] = flags;
+
+		uint64_t cycles = after.cyclesExecuted - before.cyclesExecuted;
+		while (cycles >= 0x80) {
+			record[length++] = static_cast<byte>(cycles | 0x80);
+			cycles >>= 7;
+		}
+		record[length++] = static_cast<byte>(cycles);
+
+		if (flags & CHANGED_PC) {
+			record[length++] = GET_LOW_BYTE(before.pc);
+			record[length++] = GET_HIGH_BYTE(before.pc);
+		}
+		if (flags & CHANGED_SP) record[length++] = before.sp;
+		if (flags & CHANGED_ACC) record[length++] = before.acc;
+		if (flags & CHANGED_X) record[length++] = before.x;
+		if (flags & CHANGED_Y) record[length++] = before.y;
+		if (flags & CHANGED_STATUS) record[length++] = before.status;
+		if (flags & CHANGED_TIMING) {
+			record[length++] = before.cyclesRem;
+			record[length++] = PendingBits(before);
+		}
+
+		record[length++] = static_cast<byte>(m_Writes.count);
+		for (size_t i = 0; i < m_Writes.count; i++) {
+			record[length++] = GET_LOW_BYTE(m_Writes.entries[i].addr);
+			record[length++] = GET_HIGH_BYTE(m_Writes.entries[i].addr);
+			record[length++] = m_Writes.entries[i].old;
+		}
+		length++;
+		record[length - 1] = static_cast<byte>(length);
+
+		while (m_Head - m_Tail + length > m_Data.size())
+			DropOldest();
+
+		for (size_t i = 0; i < length; i++)
+			m_Data[(m_Head + i) & m_Mask] = record[i];
+		m_Head += length;
+		m_Count++;
+
+		m_Writes.count = 0;
+	}
+
+	bool Journal::Pop(Registers& registers, Writes& outWrites) {
+		if (m_Count == 0)
+			return false;
+
+		const size_t start = m_Head - At(m_Head - 1);
+		size_t offset = start;
+
+		const byte flags = At(offset++);
+
+		uint64_t cycles = 0;
+		for (unsigned int shift = 0;; shift += 7) {
+			const byte part = At(offset++);
+			cycles |= static_cast<uint64_t>(part & 0x7F) << shift;
+			if (!(part & 0x80))
+				break;
+		}
+		registers.cyclesExecuted -= cycles;
+		if (flags & COUNTED)
+			registers.instructionsExecuted--;
+
+		if (flags & CHANGED_PC) {
+			const byte low = At(offset++);
+			const byte high = At(offset++);
+			registers.pc = MAKE_WORD(low, high);
+		}
+		if (flags & CHANGED_SP) registers.sp = At(offset++);
+		if (flags & CHANGED_ACC) registers.acc = At(offset++);
+		if (flags & CHANGED_X) registers.x = At(offset++);
+		if (flags & CHANGED_Y) registers.y = At(offset++);
+		if (flags & CHANGED_STATUS) registers.status = At(offset++);
+		if (flags & CHANGED_TIMING) {
+			registers.cyclesRem = At(offset++);
+			const byte pending = At(offset++);
+			registers.pendingIRQ = pending & 1;
+			registers.pendingNMI = pending & 2;
+		}
+
+		outWrites.count = At(offset++);
+		for (size_t i = 0; i < outWrites.count; i++) {
+			const byte low = At(offset++);
+			const byte high = At(offset++);
+			outWrites.entries[i] = Write{ static_cast<word>(MAKE_WORD(low, high)), At(offset++) };
+		}
+
+		m_Head = start;
+		m_Count--;
+
+		m_Last = registers;
+		return true;
+	}
+
+	void Journal::DropOldest() {
+		// The length is at the end, so walk the record from its start
+		size_t offset = m_Tail;
+
+		const byte flags = At(offset++);
+		while (At(offset++) & 0x80) {}
+
+		static constexpr byte REGISTER_BYTES[] = { 2, 1, 1, 1, 1, 1, 2 };
+		for (size_t i = 0; i < 7; i++) {
+			if (flags & (1 << i))
+				offset += REGISTER_BYTES[i];
+		}
+
+		const byte writes = At(offset++);
+		offset += writes * 3;
+		offset++; // The length
+
+		m_Tail = offset;
+		m_Count--;
+		m_Dropped++;
+	}
+}
@@ -0,0 +1,227 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "lockstep.h"
+
+#include <algorithm>
+
+#include "disassembler.h"
+#include "utils.h"
+
+namespace mos6502 {
+
+	namespace {
+		bool SameRegisters(const Breakpoints::Registers& a, const Breakpoints::Registers& b) {
+			return a.pc == b.pc && a.sp == b.sp && a.acc == b.acc && a.x == b.x && a.y == b.y && a.status == b.status;
+		}
+
+		void PrintRegisters(std::ostream& os, const Breakpoints::Registers& registers, const uint64_t cycles) {
+			os << "PS=" << CPU::Status(registers.status);
+			os << " PC=" << address(registers.pc);
+			os << " SP=" << Hex(registers.sp);
+			os << " A=" << Hex(registers.acc);
+			os << " X=" << Hex(registers.x);
+			os << " Y=" << Hex(registers.y);
+			os << " : CE=" << ToHex<uint64_t>(cycles);
+		}
+
+		// Calls the function with each page dirty in either memory
+		template<class Function>
+		void ForEachDirtyPage(Memory& a, Memory& b, Function function) {
+			const uint64_t* dirtyA = a.GetDirtyBitmap();
+			const uint64_t* dirtyB = b.GetDirtyBitmap();
+			const size_t words = (a.GetPageCount() + 63) / 64;
+
+			for (size_t i = 0; i < words; i++) {
+				const uint64_t dirty = dirtyA[i] | dirtyB[i];
+				if (dirty == 0)
+					continue;
+
+				for (size_t bit = 0; bit < 64; bit++) {
+					if (dirty & (uint64_t(1) << bit))
+						function(i * 64 + bit);
+				}
+			}
+		}
+	}
+
+	std::ostream& operator<<(std::ostream& os, const LockstepDivergence& divergence) {
+		char line[Disassembler::MAX_INSTRUCTION_LENGTH];
+		const size_t length = Disassembler::FormatInstruction(line, divergence.pc, span<const byte>(divergence.code.data(), divergence.code.size()));
+
+		os << "diverged " << (divergence.exact ? "at" : "by") << " instruction " << std::dec << divergence.instruction << ": ";
+		os.write(line, length - 1);
+
+		os << std::endl << "\treference ";
+		PrintRegisters(os, divergence.reference, divergence.referenceCycles);
+		os << std::endl << "\ttest      ";
+		PrintRegisters(os, divergence.test, divergence.testCycles);
+
+		if (!divergence.pages.empty()) {
+			os << std::endl << "\tpages differing:";
+			for (const size_t page : divergence.pages)
+				os << " $" << ToHex(page, 2);
+		}
+		return os;
+	}
+
+	template<class CPUT>
+	Lockstep<CPUT>::Lockstep(CPU& reference, Memory& referenceMemory, CPUT& test, Memory& testMemory)
+		: m_Reference(reference), m_ReferenceMemory(referenceMemory), m_Test(test), m_TestMemory(testMemory) {}
+
+	template<class CPUT>
+	bool Lockstep<CPUT>::Start(const CPU::State& state, const MemorySnapshot& memory) {
+		if (m_ReferenceMemory.GetSize() != m_TestMemory.GetSize()) {
+			std::cerr << "mos6502::Lockstep::Start the memories of the two cores are of different sizes" << std::endl;
+			return false;
+		}
+		if (!m_ReferenceMemory.Restore(memory) || !m_TestMemory.Restore(memory))
+			return false;
+
+		m_Reference.Restore(state);
+		m_Test.Restore(typename CPUT::State{
+			state.pc, state.sp, state.acc, state.x, state.y, typename CPUT::Status(state.status.value),
+			state.cyclesRem, state.cyclesExecuted, state.instructionsExecuted,
+			state.pendingIRQ, state.pendingNMI
+		});
+
+		const size_t pages = m_ReferenceMemory.GetPageCount();
+		m_ReferenceHashes.resize(pages);
+		m_TestHashes.resize(pages);
+		for (size_t page = 0; page < pages; page++) {
+			m_ReferenceHashes[page] = m_ReferenceMemory.HashPage(page);
+			m_TestHashes[page] = m_ReferenceHashes[page];
+		}
+
+		m_Compared = 0;
+		m_StartInstructions = m_Reference.GetInstructionsExecuted();
+		Checkpoint();
+		return true;
+	}
+
+	template<class CPUT>
+	std::optional<LockstepDivergence> Lockstep<CPUT>::Run(const uint64_t instructions) {
+		for (uint64_t remaining = instructions; remaining > 0;) {
+			const uint64_t count = std::min(remaining, m_Interval);
+
+			LockstepDivergence divergence;
+			if (Advance(count, divergence)) {
+				m_Compared += count;
+				remaining -= count;
+				Checkpoint();
+				continue;
+			}
+
+			// Somewhere in the interval, go back and find the instruction
+			if (Rewind()) {
+				for (uint64_t i = 0; i < count; i++) {
+					LockstepDivergence first;
+					first.instruction = m_Compared;
+					first.pc = m_Reference.GetProgramCounter();
+					m_ReferenceMemory.ReadBlock(first.pc, span<byte>(first.code.data(), first.code.size()));
+
+					if (!Advance(1, first))
+						return first;
+					m_Compared++;
+				}
+			}
+
+			// Not again the second time, so only the interval is known
+			divergence.exact = false;
+			divergence.instruction = m_Reference.GetInstructionsExecuted() - m_StartInstructions;
+			divergence.pc = m_Reference.GetProgramCounter();
+			m_ReferenceMemory.ReadBlock(divergence.pc, span<byte>(divergence.code.data(), divergence.code.size()));
+			return divergence;
+		}
+
+		return std::nullopt;
+	}
+
+	template<class CPUT>
+	void Lockstep<CPUT>::CatchUp() {
+		const uint64_t cycles = m_Reference.GetCyclesExecuted();
+		const uint64_t instructions = m_Reference.GetInstructionsExecuted();
+		while (m_Test.GetCyclesExecuted() < cycles) {
+			// Stopping early (for a BRK, say) leaves the rest for the next
+			// Run(). One stopping on an illegal opcode may take no cycles,
+			// but has still executed it.
+			const uint64_t before = m_Test.GetInstructionsExecuted();
+			if (m_Test.Run(cycles - m_Test.GetCyclesExecuted()) == 0 && m_Test.GetInstructionsExecuted() == before)
+				break;
+		}
+
+		// Illegal opcodes take no cycles, so any the reference ended on are
+		// stepped over here, Run() having no budget left to execute them
+		while (m_Test.GetCyclesExecuted() == cycles && m_Test.GetInstructionsExecuted() < instructions)
+			m_Test.Step();
+	}
+
+	template<class CPUT>
+	bool Lockstep<CPUT>::Advance(const uint64_t instructions, LockstepDivergence& outDivergence) {
+		for (uint64_t i = 0; i < instructions; i++)
+			m_Reference.Step();
+		CatchUp();
+
+		return Compare(outDivergence);
+	}
+
+	template<class CPUT>
+	bool Lockstep<CPUT>::Compare(LockstepDivergence& outDivergence) {
+		outDivergence.reference = m_Reference.GetRegisters();
+		outDivergence.test = m_Test.GetRegisters();
+		outDivergence.referenceCycles = m_Reference.GetCyclesExecuted();
+		outDivergence.testCycles = m_Test.GetCyclesExecuted();
+
+		// Only the pages either core wrote can have changed. Both are hashed
+		// again, so a write the test core made without marking the page is
+		// still seen, if the reference wrote the page too.
+		outDivergence.pages.clear();
+		ForEachDirtyPage(m_ReferenceMemory, m_TestMemory, [&](const size_t page) {
+			m_ReferenceHashes[page] = m_ReferenceMemory.HashPage(page);
+			m_TestHashes[page] = m_TestMemory.HashPage(page);
+			if (m_ReferenceHashes[page] != m_TestHashes[page])
+				outDivergence.pages.push_back(page);
+		});
+
+		return outDivergence.pages.empty()
+			&& outDivergence.referenceCycles == outDivergence.testCycles
+			&& SameRegisters(outDivergence.reference, outDivergence.test);
+	}
+
+	template<class CPUT>
+	void Lockstep<CPUT>::Checkpoint() {
+		m_ReferenceState = m_Reference.Snapshot();
+		m_TestState = m_Test.Snapshot();
+		m_ReferenceSnapshot = m_ReferenceMemory.Snapshot();
+		m_TestSnapshot = m_TestMemory.Snapshot();
+	}
+
+	template<class CPUT>
+	bool Lockstep<CPUT>::Rewind() {
+		// The pages written since the checkpoint go back to what they were
+		std::vector<size_t> written;
+		ForEachDirtyPage(m_ReferenceMemory, m_TestMemory, [&](const size_t page) { written.push_back(page); });
+
+		if (!m_ReferenceMemory.Restore(m_ReferenceSnapshot) || !m_TestMemory.Restore(m_TestSnapshot))
+			return false;
+		m_Reference.Restore(m_ReferenceState);
+		m_Test.Restore(m_TestState);
+
+		for (const size_t page : written) {
+			m_ReferenceHashes[page] = m_ReferenceMemory.HashPage(page);
+			m_TestHashes[page] = m_TestMemory.HashPage(page);
+		}
+		return true;
+	}
+
+	// The harness is defined here rather than in lockstep.h, so it is built
+	// once for each of the three CPU types that can be the core under test
+	template class Lockstep<CPU>;
+	template class Lockstep<FlatCPU>;
+	template class Lockstep<MappedCPU>;
+}
@@ -0,0 +1,119 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "mapped_file.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mos6502 {
+
+	std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path, const Mode mode, const size_t size) {
+		const bool writable = mode == Mode::SHARED;
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			std::cerr << "mos6502::MappedFile::Open failed to open " << path << std::endl;
+			return nullptr;
+		}
+
+		LARGE_INTEGER fileSize{};
+		GetFileSizeEx(file, &fileSize);
+		const size_t existing = static_cast<size_t>(fileSize.QuadPart);
+#else
+		const int fd = open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+		if (fd < 0) {
+			std::cerr << "mos6502::MappedFile::Open failed to open " << path << std::endl;
+			return nullptr;
+		}
+
+		struct stat info{};
+		fstat(fd, &info);
+		const size_t existing = static_cast<size_t>(info.st_size);
+#endif
+
+		// Only a SHARED file can be grown to the size asked for
+		const size_t length = size ? size : existing;
+		bool valid = length > 0 && (writable || length <= existing);
+		if (!valid)
+			std::cerr << "mos6502::MappedFile::Open " << path << " holds " << existing << " bytes, but " << length << " were asked for" << std::endl;
+
+		void* data = nullptr;
+#ifdef _WIN32
+		// Mapping a file past its end grows it
+		HANDLE mapping = nullptr;
+		if (valid) {
+			const DWORD protect = mode == Mode::READ_ONLY ? PAGE_READONLY : (mode == Mode::PRIVATE ? PAGE_WRITECOPY : PAGE_READWRITE);
+			const uint64_t mapSize = length;
+			mapping = CreateFileMappingA(file, nullptr, protect, static_cast<DWORD>(mapSize >> 32), static_cast<DWORD>(mapSize), nullptr);
+		}
+		if (mapping) {
+			const DWORD access = mode == Mode::READ_ONLY ? FILE_MAP_READ : (mode == Mode::PRIVATE ? FILE_MAP_COPY : FILE_MAP_WRITE);
+			data = MapViewOfFile(mapping, access, 0, 0, length);
+			CloseHandle(mapping);
+		}
+
+		// The view keeps the file open
+		CloseHandle(file);
+#else
+		if (valid && writable && length > existing && ftruncate(fd, static_cast<off_t>(length)) != 0) {
+			std::cerr << "mos6502::MappedFile::Open failed to grow " << path << std::endl;
+			valid = false;
+		}
+
+		if (valid) {
+			const int protect = mode == Mode::READ_ONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+			data = mmap(nullptr, length, protect, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+				data = nullptr;
+		}
+
+		// The mapping keeps the file open
+		close(fd);
+#endif
+
+		if (!data) {
+			if (valid)
+				std::cerr << "mos6502::MappedFile::Open failed to map " << path << std::endl;
+			return nullptr;
+		}
+
+		return std::shared_ptr<MappedFile>(new MappedFile(static_cast<byte*>(data), length, mode));
+	}
+
+	MappedFile::~MappedFile() {
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+#else
+		munmap(m_Data, m_Size);
+#endif
+	}
+
+	bool MappedFile::Flush() {
+		if (m_Mode != Mode::SHARED)
+			return true;
+
+#ifdef _WIN32
+		return FlushViewOfFile(m_Data, m_Size) != 0;
+#else
+		return msync(m_Data, m_Size, MS_SYNC) == 0;
+#endif
+	}
+}
@@ -11,6 +11,7 @@
 #include <iostream>
 #include <memory>
 #include <algorithm>
+#include <cstring>
 
 namespace mos6502 {
 
@@ -18,8 +19,57 @@ namespace mos6502 {
 		return std::make_shared<Memory>(size);
 	}
 
+	std::shared_ptr<Memory> Memory::MapFile(const std::string& path, const MappedFile::Mode mode, const size_t size) {
+		auto file = MappedFile::Open(path, mode, size);
+		if (!file)
+			return nullptr;
+		return std::make_shared<Memory>(std::move(file));
+	}
+
 	Memory::Memory(const size_t sizeBytes) : m_Size(sizeBytes) {
-		m_Data.resize(m_Size);
+		m_Storage.resize(m_Size);
+		m_Data = m_Storage.data();
+
+		// Nothing has been saved yet, so every page starts out dirty
+		m_Dirty.resize((GetPageCount() + 63) / 64);
+		m_Code.resize(m_Dirty.size());
+		m_Base.resize(GetPageCount());
+		MarkAllDirty();
+	}
+
+	Memory::Memory(std::shared_ptr<MappedFile> file)
+		: m_Size(file->GetSize()), m_Data(file->GetData()), m_File(std::move(file)) {
+		m_ReadOnly = m_File->IsReadOnly();
+
+		m_Dirty.resize((GetPageCount() + 63) / 64);
+		m_Code.resize(m_Dirty.size());
+		m_Base.resize(GetPageCount());
+		MarkAllDirty();
+	}
+
+	Memory::Memory(span<byte> storage) : m_Size(storage.size()), m_Data(storage.data()) {
+		m_Dirty.resize((GetPageCount() + 63) / 64);
+		m_Code.resize(m_Dirty.size());
+		m_Base.resize(GetPageCount());
+		MarkAllDirty();
+	}
+
+	Memory::Memory(Memory&& other)
+		: m_Size(other.m_Size), m_Data(other.m_Data), m_Storage(std::move(other.m_Storage)), m_File(std::move(other.m_File)),
+		m_ReadOnly(other.m_ReadOnly), m_Dirty(std::move(other.m_Dirty)), m_Base(std::move(other.m_Base)) {
+		other.m_Data = nullptr;
+
+		// The watchers decoded code from the old memory, which is now empty
+		m_Code.resize(m_Dirty.size());
+		for (CodeWatcher* watcher : other.m_CodeWatchers)
+			watcher->OnMemoryDestroyed(other);
+		other.m_CodeWatchers.clear();
+		other.m_Code.clear();
+	}
+
+	Memory::~Memory() {
+		for (CodeWatcher* watcher : m_CodeWatchers)
+			watcher->OnMemoryDestroyed(*this);
 	}
 
 	void Memory::Print(const fast_byte start, const fast_byte end, const fast_byte bpl) {
@@ -65,23 +115,178 @@ namespace mos6502 {
 	}
 
 	void Memory::WriteByte(const address& addr, const byte data) {
-		if (addr.value < m_Size)
+		if (addr.value < m_Size && !m_ReadOnly) {
 			m_Data[addr.value] = data;
+			MarkDirty(addr.value);
+		}
 	}
 
 	void Memory::WriteWord(const address& addr, const word data) {
-		if (addr.value < m_Size)
+		if (m_ReadOnly)
+			return;
+
+		if (addr.value < m_Size) {
 			m_Data[addr.value] = GET_LOW_BYTE(data);
-		if ((static_cast<size_t>(addr.value) + 1) < m_Size)
+			MarkDirty(addr.value);
+		}
+		if ((static_cast<size_t>(addr.value) + 1) < m_Size) {
 			m_Data[addr.value + 1] = GET_HIGH_BYTE(data);
+			MarkDirty(addr.value + 1);
+		}
 	}
 
 	void Memory::WriteBytes(const address& offset, const std::vector<byte>& bytes) {
+		WriteBlock(offset, bytes);
+	}
+
+	size_t Memory::ReadBlock(const address& offset, span<byte> out) const {
+		if (offset.value >= m_Size)
+			return 0;
+
+		const size_t length = std::min(out.size(), m_Size - offset.value);
+		memcpy(out.data(), &m_Data[offset.value], length);
+		return length;
+	}
+
+	size_t Memory::WriteBlock(const address& offset, span<const byte> bytes) {
+		if (offset.value >= m_Size)
+			return 0;
+
 		//Only itterate to the boundaries, no wrapping.
-		const size_t maxlen = std::min(bytes.size(), m_Size - offset.value);
+		const size_t length = std::min(bytes.size(), m_Size - offset.value);
+		if (m_ReadOnly)
+			return length;
 
 		// Fast C memory copy directly into the array.
-		// We know the max boundaries, and these are primitive types (byte)
-		memcpy(&m_Data[offset.value], bytes.data(), maxlen);
+		// We know the max boundaries, and these are primitive types (byte).
+		// NOTE: memmove, as TransferBlock() may copy from the memory itself
+		memmove(&m_Data[offset.value], bytes.data(), length);
+		MarkDirty(offset.value, length);
+		return length;
+	}
+
+	const byte* Memory::MapPage(const byte page) const {
+		if ((page + 1) * PAGE_SIZE > m_Size)
+			return nullptr;
+		return m_Data + page * PAGE_SIZE;
+	}
+
+	void Memory::MarkDirty(const size_t offset, const size_t length) {
+		if (length == 0 || offset >= m_Size)
+			return;
+
+		const size_t last = std::min(offset + length, m_Size) - 1;
+		for (size_t page = offset / PAGE_SIZE; page <= last / PAGE_SIZE; page++)
+			MarkDirty(page * PAGE_SIZE);
+	}
+
+	uint64_t Memory::HashPage(const size_t page) const {
+		const size_t start = page * PAGE_SIZE;
+		if (start >= m_Size)
+			return 0;
+
+		// A word at a time, with the partial last page zero-filled
+		uint64_t words[PAGE_SIZE / sizeof(uint64_t)] = {};
+		std::memcpy(words, m_Data + start, std::min(PAGE_SIZE, m_Size - start));
+
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (const uint64_t value : words) {
+			hash = (hash ^ value) * 0x100000001B3ull;
+			hash ^= hash >> 29;
+		}
+		return hash;
+	}
+
+	void Memory::MarkAllDirty() {
+		std::fill(m_Dirty.begin(), m_Dirty.end(), ~uint64_t(0));
+
+		for (size_t page = 0; page < GetPageCount(); page++) {
+			if (IsCodePage(page))
+				CodeWritten(page);
+		}
+	}
+
+	void Memory::WatchCode(const size_t page, CodeWatcher* watcher) {
+		if (page >= GetPageCount() || !watcher)
+			return;
+
+		m_Code[page / 64] |= uint64_t(1) << (page % 64);
+		if (std::find(m_CodeWatchers.begin(), m_CodeWatchers.end(), watcher) == m_CodeWatchers.end())
+			m_CodeWatchers.push_back(watcher);
+	}
+
+	void Memory::RemoveCodeWatcher(CodeWatcher* watcher) {
+		m_CodeWatchers.erase(std::remove(m_CodeWatchers.begin(), m_CodeWatchers.end(), watcher), m_CodeWatchers.end());
+
+		// With nobody left watching, writes need not check for code at all
+		if (m_CodeWatchers.empty())
+			std::fill(m_Code.begin(), m_Code.end(), uint64_t(0));
+	}
+
+	void Memory::CodeWritten(const size_t page) {
+		m_Code[page / 64] &= ~(uint64_t(1) << (page % 64));
+
+		for (CodeWatcher* watcher : m_CodeWatchers)
+			watcher->OnCodeWritten(*this, page);
+	}
+
+	MemorySnapshot Memory::Snapshot() {
+		// Copy out the pages that changed, the rest still match the base
+		for (size_t i = 0; i < m_Dirty.size(); i++) {
+			if (m_Dirty[i] == 0)
+				continue;
+
+			for (size_t bit = 0; bit < 64; bit++) {
+				const size_t page = i * 64 + bit;
+				if (!(m_Dirty[i] & (uint64_t(1) << bit)) || page >= m_Base.size())
+					continue;
+
+				auto image = std::make_shared<MemorySnapshot::PageImage>();
+				const size_t start = page * PAGE_SIZE;
+				const size_t length = std::min(PAGE_SIZE, m_Size - start);
+				std::copy_n(m_Data + start, length, image->begin());
+				std::fill(image->begin() + length, image->end(), byte(0));
+				m_Base[page] = std::move(image);
+			}
+			m_Dirty[i] = 0;
+		}
+
+		MemorySnapshot snapshot;
+		snapshot.m_Pages = m_Base;
+		snapshot.m_Size = m_Size;
+		return snapshot;
+	}
+
+	bool Memory::Restore(const MemorySnapshot& snapshot) {
+		if (snapshot.m_Size != m_Size || snapshot.m_Pages.size() != m_Base.size()) {
+			std::cerr << "mos6502::Memory::Restore the snapshot was taken from a memory of a different size" << std::endl;
+			return false;
+		}
+
+		for (size_t page = 0; page < m_Base.size(); page++) {
+			const auto& image = snapshot.m_Pages[page];
+			if (!IsPageDirty(page) && m_Base[page] == image)
+				continue; // Already holds the snapshot's contents
+
+			const size_t start = page * PAGE_SIZE;
+			const size_t length = std::min(PAGE_SIZE, m_Size - start);
+			if (m_ReadOnly) {
+				if (!std::equal(image->begin(), image->begin() + length, m_Data + start)) {
+					std::cerr << "mos6502::Memory::Restore the snapshot differs from the contents of a read-only memory" << std::endl;
+					return false;
+				}
+			} else {
+				std::copy_n(image->begin(), length, m_Data + start);
+			}
+
+			if (m_Base[page] != image)
+				m_Base[page] = image;
+
+			if (IsCodePage(page))
+				CodeWritten(page);
+		}
+
+		std::fill(m_Dirty.begin(), m_Dirty.end(), uint64_t(0));
+		return true;
 	}
 } // END - namespace mos6502
\ No newline at end of file
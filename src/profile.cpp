@@ -0,0 +1,134 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "profile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+
+#include "program.h"
+#include "utils.h"
+
+namespace mos6502 {
+
+	Profile::Profile() : m_AddressHits(ADDRESS_COUNT), m_AddressCycles(ADDRESS_COUNT) {
+		Reset();
+	}
+
+	void Profile::Reset() {
+		m_OpCodeInstructions.fill(0);
+		m_OpCodeCycles.fill(0);
+		m_BranchesTaken.fill(0);
+		m_BranchesNotTaken.fill(0);
+		m_PageCrossings.fill(0);
+		std::fill(m_AddressHits.begin(), m_AddressHits.end(), 0);
+		std::fill(m_AddressCycles.begin(), m_AddressCycles.end(), 0);
+	}
+
+	uint64_t Profile::GetTotalInstructions() const {
+		return std::accumulate(m_OpCodeInstructions.begin(), m_OpCodeInstructions.end(), uint64_t{ 0 });
+	}
+
+	uint64_t Profile::GetTotalCycles() const {
+		return std::accumulate(m_OpCodeCycles.begin(), m_OpCodeCycles.end(), uint64_t{ 0 });
+	}
+
+	void Profile::WriteFoldedStacks(std::ostream& os, const Program* program, const Weight weight) const {
+		const std::vector<uint64_t>& samples = weight == Weight::CYCLES ? m_AddressCycles : m_AddressHits;
+		const std::string root = program && !program->GetName().empty() ? program->GetName() : "mos6502";
+
+		// The line assembled at each address, and the labels among the symbols
+		std::vector<const Program::Line*> lines(ADDRESS_COUNT, nullptr);
+		std::vector<std::pair<word, const std::string*>> labels;
+		if (program) {
+			for (const Program::Line& line : program->GetSourceCode())
+				lines[static_cast<word>(line.pcOffset)] = &line;
+
+			for (const auto& symbol : program->GetSymbols()) {
+				if (lines[symbol.second])
+					labels.emplace_back(symbol.second, &symbol.first);
+			}
+			std::sort(labels.begin(), labels.end(), [](const auto& a, const auto& b) {
+				return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+			});
+		}
+
+		// Addresses are visited in order, so the label in effect only moves forward
+		auto label = labels.begin();
+		const std::string* current = nullptr;
+		for (size_t pc = 0; pc < ADDRESS_COUNT; pc++) {
+			while (label != labels.end() && label->first <= pc) {
+				if (!current || label->first != (label - 1)->first)
+					current = label->second;
+				++label;
+			}
+
+			if (samples[pc] == 0)
+				continue;
+
+			os << root << ';';
+			if (const Program::Line* line = lines[pc]) {
+				if (current)
+					os << *current << ';';
+				os << program->GetRaw(*line) << " (line " << line->lineNumber << ')';
+			} else {
+				os << '$' << Hex(static_cast<word>(pc));
+			}
+			os << ' ' << samples[pc] << '\n';
+		}
+	}
+
+	bool Profile::WriteFoldedStacks(const std::string& filepath, const Program* program, const Weight weight) const {
+		std::ofstream file(filepath, std::ios::trunc);
+		if (!file) {
+			std::cerr << "mos6502::Profile::WriteFoldedStacks failed to open the file \"" << filepath << "\"" << std::endl;
+			return false;
+		}
+
+		WriteFoldedStacks(file, program, weight);
+		file.flush();
+		if (!file) {
+			std::cerr << "mos6502::Profile::WriteFoldedStacks failed to write the file \"" << filepath << "\"" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const Profile& p) {
+		const uint64_t cycles = p.GetTotalCycles();
+		os << "Instructions: " << p.GetTotalInstructions() << ", cycles: " << cycles << std::endl;
+
+		// The opcodes taking the most time
+		std::array<byte, 256> opCodes;
+		for (size_t i = 0; i < opCodes.size(); i++)
+			opCodes[i] = static_cast<byte>(i);
+		std::stable_sort(opCodes.begin(), opCodes.end(), [&p](const byte a, const byte b) { return p.GetCycles(a) > p.GetCycles(b); });
+
+		os << "Opcodes by cycles:" << std::endl;
+		for (size_t i = 0; i < 16 && p.GetCycles(opCodes[i]) > 0; i++) {
+			const InstructionDetail& detail = InstructionDetails[opCodes[i]];
+			os << "\t$" << Hex(detail.opCode) << ' ' << GetInstructionMnmuemonic(detail.instruction) << ' ' << GetAddressMnmuemonic(detail.addressing)
+				<< ": " << p.GetInstructions(detail.opCode) << " instructions, " << p.GetCycles(detail.opCode) << " cycles ("
+				<< (100.0 * p.GetCycles(detail.opCode) / cycles) << "%)" << std::endl;
+		}
+
+		os << "Page crossings:";
+		for (const AddressMode mode : { AddressMode::ABX, AddressMode::ABY, AddressMode::INY, AddressMode::REL })
+			os << ' ' << GetAddressMnmuemonic(mode) << '=' << p.GetPageCrossings(mode);
+		os << std::endl;
+
+		os << "Branches (taken/not taken):";
+		for (const InstructionDetail& detail : InstructionDetails) {
+			if (detail.addressing == AddressMode::REL)
+				os << ' ' << GetInstructionMnmuemonic(detail.instruction) << '=' << p.GetBranchesTaken(detail.opCode) << '/' << p.GetBranchesNotTaken(detail.opCode);
+		}
+		os << std::endl;
+		return os;
+	}
+}
@@ -8,417 +8,869 @@
  */
 #include "program.h"
 
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
 #include <sstream>
-#include <map>
 
 #include "instructions.h"
 #include "utils.h"
 
-std::string TrimStart(const std::string& str, const std::string& ws = " \t") {
-	const auto loc = str.find_first_not_of(ws);
-	if( loc != std::string::npos )
-		return str.substr(loc);
+// Views are trimmed in place, nothing is copied
+std::string_view TrimSpace(std::string_view str) {
+	while( !str.empty() && (str.front() == ' ' || str.front() == '\t') )
+		str.remove_prefix(1);
+	while( !str.empty() && (str.back() == ' ' || str.back() == '\t') )
+		str.remove_suffix(1);
 	return str;
 }
 
-std::string TrimEnd(const std::string& str, const std::string& ws = " \t") {
-	const auto loc = str.find_last_not_of(ws);
-	if( loc != std::string::npos )
-		return str.substr(0, loc);
-	return str;
-}
+namespace mos6502 {
+	namespace {
+		enum class TokenType : byte {
+			IDENTIFIER,		// Mnmuemonics, labels, symbols, and the A/X/Y registers
+			NUMBER,			// $hex, %binary, or decimal literal
+			PUNCTUATION,	// One of # ( ) , * + - < > = :
+		};
 
-std::string TrimSpace(const std::string& str, const std::string& ws = " \t") {
-	const auto start = str.find_first_not_of(ws);
-	if( start == std::string::npos )
-		return ""; // Nothing
-	const auto end = str.find_last_not_of(ws);
-	const auto len = end - start + 1;
-	return str.substr(start, len);
-}
+		constexpr char ToUpper(const char c) {
+			return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+		}
 
-std::string ReplaceAll(const std::string& str, const std::string& search, const std::string& repl) {
-	std::string ret(str);
+		// Identifiers are case-insensitive, and kept upper-cased in the SymbolTable
+		std::string ToUpper(const std::string_view str) {
+			std::string upper(str);
+			for( char& c : upper )
+				c = ToUpper(c);
+			return upper;
+		}
 
-	size_t ind = 0;
-	while( ind < str.length() ) {
-		ind = ret.find(search, ind);
-		if( ind == std::string::npos )
-			break;
-		ret.replace(ind, search.length(), repl);
-		ind += repl.length();
-	}
+		struct Token {
+			TokenType type;
 
-	return ret;
-}
+			// The text of the token, a view into the source
+			std::string_view text;
 
-namespace mos6502 {
-	std::optional<progptr> Program::CompileFile(const std::string& filepath) {
-		progptr program = std::make_shared<Program>();
-		if( program->CompileSourceFile(filepath) )
-			return { program };
-		return std::nullopt;
-	}
+			// Value of a NUMBER
+			int value = 0;
 
-	bool Program::CompileSourceFile(const std::string& filepath) {
-		const std::filesystem::path path(filepath);
+			bool Is(const char c) const { return type == TokenType::PUNCTUATION && text[0] == c; }
 
-		//Verify the file exists
-		if( std::filesystem::exists(path) == false ) {
-			std::cerr << "mos6502::Program::CompileSourceFile system reports that the file \"" << filepath << "\" does not exist" << std::endl;
-			return false;
-		}
+			// Compares against an upper-cased name, ignoring the case of the identifier
+			bool IsIdentifier(const std::string_view name) const {
+				if( type != TokenType::IDENTIFIER || text.length() != name.length() )
+					return false;
+				for( size_t i = 0; i < name.length(); i++ ) {
+					if( ToUpper(text[i]) != name[i] )
+						return false;
+				}
+				return true;
+			}
 
-		m_Path = path.string();
-		m_Name = path.stem().string();
+			// The text as reported in errors, identifiers upper-cased as in the SymbolTable
+			std::string Describe() const { return type == TokenType::IDENTIFIER ? ToUpper(text) : std::string(text); }
+		};
 
-		//Start reading the contents into a string using classic C fread
+		using Tokens = std::vector<Token>;
 
-		// Get the file size now for use later
-		const long fileSize = static_cast<long>(std::filesystem::file_size(path));
-		if( fileSize <= 0 ) {
-			std::cerr << "mos6502::Program::CompileSourceFile the supplied file \"" << filepath << "\" is empty" << std::endl;
-			return false;
+		// Hashes and compares symbol names ignoring case, so that they can be
+		// looked up straight from the source while assembling
+		struct NameHash {
+			size_t operator()(const std::string_view name) const {
+				size_t hash = 14695981039346656037ull & SIZE_MAX;
+				for( const char c : name )
+					hash = (hash ^ static_cast<byte>(ToUpper(c))) * 1099511628211ull;
+				return hash;
+			}
+		};
+
+		struct NameEqual {
+			bool operator()(const std::string_view a, const std::string_view b) const {
+				if( a.length() != b.length() )
+					return false;
+				for( size_t i = 0; i < a.length(); i++ ) {
+					if( ToUpper(a[i]) != ToUpper(b[i]) )
+						return false;
+				}
+				return true;
+			}
+		};
+
+		struct Symbol {
+			word value;
+
+			// The value is an offset from where the linker places the module
+			bool relocatable;
+		};
+
+		// The symbols while assembling, keyed by views into the source
+		using Symbols = std::unordered_map<std::string_view, Symbol, NameHash, NameEqual>;
+
+		// Where the code being assembled is placed
+		struct Section {
+			// Assembling a module (see Program::CompileModuleFile()), where
+			// symbols left undefined are imported from the other modules
+			bool module;
+
+			// The code is placed by the linker, the PC is an offset from there
+			bool relocatable;
+		};
+
+		// Returns the instruction named by an identifier in any case, or ILL
+		Instruction FindMnemonic(const Token& token) {
+			if( token.type != TokenType::IDENTIFIER || token.text.length() != 3 )
+				return Instruction::ILL;
+			const char upper[3] = { ToUpper(token.text[0]), ToUpper(token.text[1]), ToUpper(token.text[2]) };
+			return MnmuemonicToInstruction(std::string_view(upper, 3));
+		}
+
+		void ReportError(const unsigned int lineNumber, const std::string& message) {
+			// Written at once, as modules may be assembled on several threads
+			std::cerr << "mos6502::Program::CompileString error on line " + std::to_string(lineNumber) + ": " + message + "\n" << std::flush;
 		}
 
-		std::string sourceData;
-		{ // C-style file reading
-			// Lambda for closing a file
-			const auto closeFile = [](FILE* file) { fclose(file); };
+		constexpr bool IsDigit(const char c) {
+			return c >= '0' && c <= '9';
+		}
+
+		constexpr bool IsIdentifierStart(const char c) {
+			return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == '.';
+		}
 
-			FILE* file = nullptr;
+		constexpr bool IsIdentifierChar(const char c) {
+			return IsIdentifierStart(c) || IsDigit(c);
+		}
 
-			// Open the file, checking for errors as we go
-			errno_t err = fopen_s(&file, path.string().c_str(), "rb");
-			if( err || !file ) {
-				std::cerr << "mos6502::Program::CompileSourceFile failed to open the file \"" << filepath << "\"" << std::endl;
+		constexpr bool IsPunctuation(const char c) {
+			switch( c ) {
+			case '#': case '(': case ')': case ',': case '*': case '+':
+			case '-': case '<': case '>': case '=': case ':':
+				return true;
+			default:
 				return false;
 			}
+		}
 
-			auto handle = std::unique_ptr<FILE, decltype(closeFile)>(file, closeFile);
-			if( !handle ) {
-				std::cerr << "mos6502::Program::CompileSourceFile failed to open a handle to the file \"" << filepath << "\"" << std::endl;
-				return false;
+		// Returns the value of a single digit in the given base, or -1 if it is not one
+		int DigitValue(const char c, const int base) {
+			int digit = -1;
+			if( c >= '0' && c <= '9' )
+				digit = c - '0';
+			else if( c >= 'A' && c <= 'F' )
+				digit = c - 'A' + 10;
+			else if( c >= 'a' && c <= 'f' )
+				digit = c - 'a' + 10;
+			return digit < base ? digit : -1;
+		}
+
+		// Splits the code portion of a line (the comment already removed) into
+		// tokens, appended onto the end of tokens. The tokens view the code.
+		bool Tokenize(const std::string_view code, const unsigned int lineNumber, Tokens& tokens) {
+			size_t i = 0;
+			while( i < code.length() ) {
+				const char c = code[i];
+
+				if( c == ' ' || c == '\t' ) {
+					i++;
+				} else if( IsIdentifierStart(c) ) {
+					const size_t start = i;
+					while( i < code.length() && IsIdentifierChar(code[i]) )
+						i++;
+					tokens.push_back(Token{ TokenType::IDENTIFIER, code.substr(start, i - start) });
+				} else if( c == '$' || c == '%' || IsDigit(c) ) {
+					const int base = c == '$' ? 16 : c == '%' ? 2 : 10;
+					const size_t start = i;
+					if( base != 10 )
+						i++;
+
+					int value = 0, digits = 0;
+					while( i < code.length() && IsIdentifierChar(code[i]) ) {
+						const int digit = DigitValue(code[i], base);
+						if( digit < 0 ) {
+							ReportError(lineNumber, "invalid digit '" + std::string(1, code[i]) + "' in number \"" + std::string(code.substr(start, i - start + 1)) + "\"");
+							return false;
+						}
+						value = value * base + digit;
+						if( value > 0xFFFF ) {
+							ReportError(lineNumber, "number \"" + std::string(code.substr(start, i - start + 1)) + "\" is larger than 16-bits");
+							return false;
+						}
+						digits++;
+						i++;
+					}
+
+					if( digits == 0 ) {
+						ReportError(lineNumber, "expected digits after '" + std::string(1, c) + "'");
+						return false;
+					}
+					tokens.push_back(Token{ TokenType::NUMBER, code.substr(start, i - start), value });
+				} else if( IsPunctuation(c) ) {
+					tokens.push_back(Token{ TokenType::PUNCTUATION, code.substr(i, 1) });
+					i++;
+				} else {
+					ReportError(lineNumber, "unexpected character '" + std::string(1, c) + "'");
+					return false;
+				}
 			}
+			return true;
+		}
 
-			// Make sure we got the data reserved for this
-			sourceData.resize(fileSize);
+		// Evaluates the operand expression held in tokens [begin, end):
+		//	expression := [ '<' | '>' ] [ '+' | '-' ] term { ( '+' | '-' ) term }
+		//	term := NUMBER | symbol | '*'
+		// '*' is the address of the current instruction, '<' and '>' take the
+		// low or high byte of the result. A leading sign is applied to the PC
+		// when relative, which lets branches keep the "-4" shorthand for "*-4".
+		// Undefined symbols set unresolved and count as zero when allowed (the
+		// first pass, for forward references). In a module they are otherwise
+		// imported, and are an error anywhere else.
+		// Whatever is only known once linked (imports, and the base address
+		// of relocatable code) is left out of the result and counted aside,
+		// along with any selector, see IsLinked().
+		class Expression {
+		public:
+			// A symbol from another module, added or subtracted
+			struct Import {
+				bool negative;
+				std::string_view name;
+			};
+
+			Expression(const Symbols& symbols, const Section& section, const unsigned int lineNumber, const word pc, const bool allowUnresolved)
+				: m_Symbols(symbols), m_Section(section), m_LineNumber(lineNumber), m_PC(pc), m_AllowUnresolved(allowUnresolved) {}
+
+			std::optional<int> Evaluate(const Tokens& tokens, size_t begin, const size_t end, const bool relative = false) {
+				if( begin == end ) {
+					ReportError(m_LineNumber, "expected a value");
+					return std::nullopt;
+				}
 
-			// Read the contents into the string directly.
-			// We should make the pointer const for fread, C++17 doesn't do that with data()
-			fread(const_cast<char*>(sourceData.data()), 1, fileSize, handle.get());
+				char selector = 0;
+				if( tokens[begin].Is('<') || tokens[begin].Is('>') )
+					selector = tokens[begin++].text[0];
+
+				int result = 0;
+				if( begin < end && !tokens[begin].Is('+') && !tokens[begin].Is('-') ) {
+					const auto term = Term(tokens, begin, end, false);
+					if( !term )
+						return std::nullopt;
+					result = term.value();
+				} else if( relative ) {
+					result = m_PC;
+					m_Bases += m_Section.relocatable ? 1 : 0;
+				}
 
-		}; //file handle is cleared
+				while( begin < end ) {
+					const Token& op = tokens[begin++];
+					if( !op.Is('+') && !op.Is('-') ) {
+						ReportError(m_LineNumber, "unexpected \"" + op.Describe() + "\" in expression");
+						return std::nullopt;
+					}
 
-		return CompileString(sourceData); // Was ok, pass onto compilation
-	}
+					const auto term = Term(tokens, begin, end, op.Is('-'));
+					if( !term )
+						return std::nullopt;
+					result += op.Is('+') ? term.value() : -term.value();
+				}
 
-	bool Program::CompileString(const std::string& source) {
-		/*
-			NOTES!
-			- Need to do dual pass, where the labels and symbols are extracted
-			first, then can be used within the expressions
-			- Support for basic directives
-			- Support for CHAR types
-			- Possible expression support?
-		*/
+				// The linker takes the byte once the rest is known
+				if( IsLinked() ) {
+					m_Selector = selector;
+					return result;
+				}
 
-		//Reset everything needed
-		m_SourceCode.clear();
+				if( selector == '<' )
+					result = GET_LOW_BYTE(result);
+				else if( selector == '>' )
+					result = GET_HIGH_BYTE(result);
+				return result;
+			}
+
+			bool IsUnresolved() const { return m_Unresolved; }
 
-		// Setup needed variables
-		unsigned int lineNumber = 1;
-		word pcOffset = 0x0200, startingPCOffset = 0x0200;
-		std::string tempStr, comment, symbol;
-		Instruction instruction = Instruction::ILL;
-		bool setStartingPC = false;
-
-		std::map<std::string, word> symbols;
-
-		enum class Mode {
-			IDLE,
-			COMMENT,
-			SYMBOL,
-			ASSIGNMENT,
-			INSTRUCTION,
-			DIRECTIVE
-		} mode = Mode::IDLE;
-
-		auto replaceSymbols = [&](const std::string& str) -> std::string {
-			std::string ret(str);
-			for( const auto& [key, val] : symbols ) {
-				ret = ReplaceAll(ret, key, std::to_string(val));
+			// Returns true if the result is only complete once linked
+			bool IsLinked() const { return m_Bases != 0 || !m_Imports.empty(); }
+
+			// Returns how many times the base address of the module is added
+			// to the result (or subtracted, when negative)
+			int GetBases() const { return m_Bases; }
+
+			const std::vector<Import>& GetImports() const { return m_Imports; }
+
+			// Returns the '<' or '>' left for the linker to apply, or 0
+			char GetSelector() const { return m_Selector; }
+
+		private:
+			std::optional<int> Term(const Tokens& tokens, size_t& pos, const size_t end, const bool negative) {
+				if( pos == end ) {
+					ReportError(m_LineNumber, "expected a value at the end of the expression");
+					return std::nullopt;
+				}
+
+				const Token& token = tokens[pos++];
+				if( token.type == TokenType::NUMBER )
+					return token.value;
+				if( token.Is('*') ) {
+					if( m_Section.relocatable )
+						m_Bases += negative ? -1 : 1;
+					return m_PC;
+				}
+
+				if( token.type == TokenType::IDENTIFIER ) {
+					const auto it = m_Symbols.find(token.text);
+					if( it != m_Symbols.end() ) {
+						if( it->second.relocatable )
+							m_Bases += negative ? -1 : 1;
+						return it->second.value;
+					}
+
+					if( m_AllowUnresolved ) {
+						m_Unresolved = true;
+						return 0;
+					}
+					if( m_Section.module ) {
+						m_Imports.push_back(Import{ negative, token.text });
+						return 0;
+					}
+					ReportError(m_LineNumber, "undefined symbol \"" + token.Describe() + "\"");
+					return std::nullopt;
+				}
+
+				ReportError(m_LineNumber, "expected a value but found \"" + token.Describe() + "\"");
+				return std::nullopt;
 			}
-			return ret;
+
+			const Symbols& m_Symbols;
+			const Section& m_Section;
+			const unsigned int m_LineNumber;
+			const word m_PC;
+			const bool m_AllowUnresolved;
+			bool m_Unresolved = false;
+
+			int m_Bases = 0;
+			std::vector<Import> m_Imports;
+			char m_Selector = 0;
 		};
 
-		auto parseValue = [&](const std::string& str) -> word {
-			std::string ret = replaceSymbols(str);
+		// An instruction found by the first pass, waiting to be encoded
+		struct Statement {
+			unsigned int lineNumber;
+			word pc;
+
+			uint32_t rawOffset, rawLength;
+			uint32_t commentOffset, commentLength;
+
+			const InstructionDetail* detail;
 
-			auto ltr = ret.at(0);
-			if( ltr == '$' ) { //Hex
-				return static_cast<word>(std::stoul(ret.substr(1), nullptr, 16));
-			} else if( ltr == '%' ) { //Binary
-				return static_cast<word>(std::stoul(ret.substr(1), nullptr, 2));
-			} else if( ret == "*" ) { // Current PC
-				return pcOffset;
+			// The operand's expression, without the addressing syntax around
+			// it, as a range of the tokens of the whole source
+			size_t operandBegin, operandEnd;
+		};
+
+		bool HasMode(const Instruction instruction, const AddressMode mode) {
+			return FindInstructionDetail(instruction, mode).instruction != Instruction::ILL;
+		}
+
+		// Picks the zero-page form when the value is known to fit and the
+		// instruction has one, otherwise the absolute form. Values only known
+		// in the second pass (forward references) get the absolute form, as the
+		// instruction's size must be fixed in the first pass.
+		AddressMode PickPageMode(const Instruction instruction, const AddressMode zeroPage, const AddressMode absolute, const bool fitsZeroPage) {
+			if( fitsZeroPage && HasMode(instruction, zeroPage) )
+				return zeroPage;
+			if( HasMode(instruction, absolute) )
+				return absolute;
+			return zeroPage;
+		}
+
+		// Works out the addressing mode from the operand syntax in tokens [begin, end),
+		// and returns the range of the expression within it
+		bool ParseOperand(const Tokens& tokens, const size_t begin, const size_t end, const Instruction instruction,
+			const Symbols& symbols, const Section& section, const unsigned int lineNumber, const word pc,
+			AddressMode& outMode, size_t& outBegin, size_t& outEnd) {
+			const size_t count = end - begin;
+			outBegin = begin;
+			outEnd = end;
+
+			if( count == 0 ) {
+				// A bare "ASL" is the same as "ASL A"
+				outMode = HasMode(instruction, AddressMode::IMP) ? AddressMode::IMP : AddressMode::ACC;
+				return true;
 			}
 
-			word val = 0;
-			try {
-				 val = static_cast<word>(std::stoul(ret));
-			} catch(std::invalid_argument ex) {
-				std::cerr << "failed to parse value \"" << str << "\" on line " << lineNumber << std::endl;
+			if( count == 1 && tokens[begin].IsIdentifier("A") && HasMode(instruction, AddressMode::ACC) ) {
+				outMode = AddressMode::ACC;
+				outBegin = end;
+				return true;
 			}
 
-			return val;
-		};
+			if( tokens[begin].Is('#') ) {
+				outMode = AddressMode::IMM;
+				outBegin = begin + 1;
+				return true;
+			}
+
+			if( tokens[begin].Is('(') ) {
+				size_t close = begin + 1;
+				while( close < end && !tokens[close].Is(')') )
+					close++;
+				if( close == end ) {
+					ReportError(lineNumber, "missing ')' in indirect address");
+					return false;
+				}
+
+				outBegin = begin + 1;
+				outEnd = close;
+				if( close + 1 == end ) {
+					if( close - begin >= 3 && tokens[close - 2].Is(',') ) {
+						if( !tokens[close - 1].IsIdentifier("X") ) {
+							ReportError(lineNumber, "indexed indirect addresses only use X, as in (value,X)");
+							return false;
+						}
+						outMode = AddressMode::INX;
+						outEnd = close - 2;
+					} else {
+						outMode = AddressMode::IND;
+					}
+					return true;
+				}
+				if( close + 3 == end && tokens[close + 1].Is(',') && tokens[close + 2].IsIdentifier("Y") ) {
+					outMode = AddressMode::INY;
+					return true;
+				}
 
-		const auto handleToken = [&](const std::string& token) {
-			if( !symbol.empty() ) {
-				// Hanging symbol needs to be a label now
-				symbols.emplace(symbol, pcOffset);
-				symbol = "";
+				ReportError(lineNumber, "invalid indirect address, expected (value), (value,X), or (value),Y");
+				return false;
 			}
 
-			auto inst = MnmuemonicToInstruction(token);
-			if( inst != Instruction::ILL ) {
-				mode = Mode::INSTRUCTION;
-				instruction = inst;
-			} else {
-				mode = Mode::SYMBOL;
+			if( HasMode(instruction, AddressMode::REL) ) {
+				outMode = AddressMode::REL;
+				return true;
+			}
 
-				symbol = token;
+			AddressMode zeroPage = AddressMode::ZPG, absolute = AddressMode::ABS;
+			if( count >= 2 && tokens[end - 2].Is(',') ) {
+				if( tokens[end - 1].IsIdentifier("X") ) {
+					zeroPage = AddressMode::ZPX;
+					absolute = AddressMode::ABX;
+				} else if( tokens[end - 1].IsIdentifier("Y") ) {
+					zeroPage = AddressMode::ZPY;
+					absolute = AddressMode::ABY;
+				} else {
+					ReportError(lineNumber, "expected X or Y after ','");
+					return false;
+				}
+				outEnd = end - 2;
 			}
-		};
 
-		const auto parseInstruction = [&](const std::string& str) {
-			// Check if we haven't set the starting PC offset (first instruction)
-			if( !setStartingPC )
-				m_StartingPCOffset = pcOffset;
+			Expression expr(symbols, section, lineNumber, pc, true);
+			const auto value = expr.Evaluate(tokens, outBegin, outEnd);
+			if( !value )
+				return false;
+
+			// Relocatable addresses are never taken to be in the zero page
+			const bool fitsZeroPage = !expr.IsUnresolved() && !expr.IsLinked() && value.value() >= 0 && value.value() <= 0xFF;
+			outMode = PickPageMode(instruction, zeroPage, absolute, fitsZeroPage);
+			return true;
+		}
+	}
+
+	std::optional<progptr> Program::CompileFile(const std::string& filepath) {
+		progptr program = std::make_shared<Program>();
+		if( program->CompileSourceFile(filepath) )
+			return { program };
+		return std::nullopt;
+	}
+
+	bool Program::CompileSourceFile(const std::string& filepath) {
+		return AssembleFile(filepath, false);
+	}
+
+	bool Program::CompileString(const std::string_view source) {
+		m_SourceStorage.assign(source);
+		m_SourceFile.reset();
+		return Assemble(false);
+	}
+
+	bool Program::CompileModuleFile(const std::string& filepath) {
+		return AssembleFile(filepath, true);
+	}
 
-			word instrPC = pcOffset;
+	bool Program::CompileModuleString(const std::string_view source) {
+		m_SourceStorage.assign(source);
+		m_SourceFile.reset();
+		return Assemble(true);
+	}
 
-			//Increment PC by one initially
-			pcOffset++;
+	bool Program::AssembleFile(const std::string& filepath, const bool module) {
+		const std::filesystem::path path(filepath);
 
-			std::string addrStr = replaceSymbols(TrimSpace(str));
+		const auto file = OpenSourceFile(filepath);
+		if( !file )
+			return false;
 
-			AddressMode addressing = AddressMode::ILL;
-			word value = 0;
-
-			if( addrStr.empty() ) {
-				addressing = AddressMode::IMP;
-			} else if( addrStr == "A" ) {
-				addressing = AddressMode::ACC;
-			} else {
-				const char& ltr = addrStr.at(0);
-				if( ltr == '#' ) { // Immediate
-					addressing = AddressMode::IMM;
-					value = parseValue( addrStr.substr(1));
-
-					pcOffset++;
-					if( GET_HIGH_BYTE(value) > 0 ) pcOffset++;
-				} else if( ltr == '*' || ltr == '+' || ltr == '-' ) { // Relative
-					addressing = AddressMode::REL;
-					if( ltr == '*' )
-						value = parseValue(addrStr.substr(1));
-					else
-						value = parseValue(addrStr);
-					value = GET_LOW_BYTE(value);
-					pcOffset++;
-				} else if( ltr == '(' ) { // Indirect
-					auto ltrCom = addrStr.find(',', 1);
-					auto ltrPar = addrStr.find(')', 1);
-					if( ltrPar == std::string::npos ) { // No closing parenthasis
-						//Invalid indirect value
-						std::cerr << "invalid indirect address on line " << std::to_string(lineNumber) << std::endl;
-					} else  if( ltrCom != std::string::npos ) { // Contains a comma (INX, INY)
-						if( ltrCom < ltrPar ) { // Comma before parenthasis means INX
-							addressing = AddressMode::INX;
-							value = parseValue(addrStr.substr(1, ltrCom - 1));
-						} else { // Comma after parenthasis means INY
-							addressing = AddressMode::INY;
-							value = parseValue(addrStr.substr(1, ltrPar - 1));
-						}
-						pcOffset++;
-					} else { // No comma, just IND
-						addressing = AddressMode::IND;
-						value = parseValue(addrStr.substr(1, ltrPar - 1));
+		m_SourceFile = file;
+		m_SourceStorage.clear();
+		m_Path = path.string();
+		m_Name = path.stem().string();
+
+		return Assemble(module); // Was ok, pass onto compilation
+	}
+
+	std::string_view Program::GetSource() const {
+		if( m_SourceFile )
+			return std::string_view(reinterpret_cast<const char*>(m_SourceFile->GetData()), m_SourceFile->GetSize());
+		return m_SourceStorage;
+	}
+
+	std::shared_ptr<MappedFile> Program::OpenSourceFile(const std::string& filepath) {
+		const std::filesystem::path path(filepath);
+
+		//Verify the file exists
+		if( std::filesystem::exists(path) == false ) {
+			std::cerr << "mos6502::Program::CompileSourceFile system reports that the file \"" << filepath << "\" does not exist" << std::endl;
+			return nullptr;
+		}
+
+		// Zero bytes cannot be mapped, and there would be nothing to assemble anyway
+		std::error_code error;
+		if( std::filesystem::file_size(path, error) == 0 || error ) {
+			std::cerr << "mos6502::Program::CompileSourceFile the supplied file \"" << filepath << "\" is empty" << std::endl;
+			return nullptr;
+		}
+
+		// The source is mapped rather than read in, the lines are views of the mapping
+		const auto file = MappedFile::Open(path.string(), MappedFile::Mode::READ_ONLY);
+		if( !file ) {
+			std::cerr << "mos6502::Program::CompileSourceFile failed to open the file \"" << filepath << "\"" << std::endl;
+			return nullptr;
+		}
+		return file;
+	}
+
+	bool Program::Assemble(const bool module) {
+		/*
+			NOTES!
+			- Support for basic directives
+			- Support for CHAR types
+		*/
+		const std::string_view source = GetSource();
+
+		//Reset everything needed
+		m_SourceCode.clear();
+		m_ByteCode.clear();
+		m_Symbols.clear();
+		m_StartingPCOffset = 0x0200;
+		m_SourceHash = HashSource(source);
+
+		m_Module = module;
+		m_Relocatable = false;
+		m_RelocatableSymbols.clear();
+		m_Imports.clear();
+		m_RelocationTerms.clear();
+		m_Relocations.clear();
+
+		// The tokens of every line are kept in one vector, and every name is
+		// a view of the source, so no line costs an allocation of its own
+		Tokens tokens;
+		Symbols symbols;
+		std::vector<Statement> statements;
+		bool ok = true;
+
+		// A module's code is placed by the linker, unless the PC is moved
+		// before any of it
+		Section section = { module, module };
+		word pcOffset = module ? 0 : 0x0200;
+		bool placed = false;
+
+		// First pass, defines the labels and symbols, and works out the
+		// addressing mode (and so the size) of each instruction.
+		unsigned int lineNumber = 0;
+		size_t lineStart = 0;
+		while( lineStart < source.length() ) {
+			size_t lineEnd = source.find('\n', lineStart);
+			if( lineEnd == std::string_view::npos )
+				lineEnd = source.length();
+
+			std::string_view line = source.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd + 1;
+			lineNumber++;
+
+			// Ignore carriage return for new-lines
+			if( !line.empty() && line.back() == '\r' )
+				line.remove_suffix(1);
+
+			std::string_view comment;
+			const auto commentStart = line.find(';');
+			if( commentStart != std::string_view::npos ) {
+				comment = TrimSpace(line.substr(commentStart + 1));
+				line = line.substr(0, commentStart);
+			}
+
+			// Only the tokens of statements are kept, anything else is dropped
+			// again before the next line
+			const size_t first = tokens.size();
+			if( !Tokenize(line, lineNumber, tokens) ) {
+				tokens.resize(first);
+				ok = false;
+				continue;
+			}
+			const size_t last = tokens.size();
+			if( first == last )
+				continue;
 
-						pcOffset += 2;
+			const auto dropTokens = [&tokens, first]() { tokens.resize(first); };
+
+			// Moving the PC, "*=$0200"
+			if( last - first >= 2 && tokens[first].Is('*') && tokens[first + 1].Is('=') ) {
+				Expression expr(symbols, section, lineNumber, pcOffset, false);
+				const auto value = expr.Evaluate(tokens, first + 2, last);
+				if( !value ) {
+					ok = false;
+				} else if( expr.IsLinked() ) {
+					ReportError(lineNumber, "origin must be a constant known within the module");
+					ok = false;
+				} else if( placed ) {
+					ReportError(lineNumber, "origin cannot follow labels or code placed by the linker");
+					ok = false;
+				} else if( value.value() < 0 || value.value() > 0xFFFF ) {
+					ReportError(lineNumber, "origin is outside of the address space");
+					ok = false;
+				} else {
+					pcOffset = static_cast<word>(value.value());
+					section.relocatable = false;
+				}
+				dropTokens();
+				continue;
+			}
+
+			// Assignments "NAME = value", and labels "NAME:" or "NAME" before any instruction
+			size_t pos = first;
+			if( tokens[first].type == TokenType::IDENTIFIER ) {
+				const std::string_view name = tokens[first].text;
+				const bool isAssignment = last - first >= 2 && tokens[first + 1].Is('=');
+				const bool isExplicitLabel = last - first >= 2 && tokens[first + 1].Is(':');
+
+				if( isAssignment || isExplicitLabel || FindMnemonic(tokens[first]) == Instruction::ILL ) {
+					if( symbols.count(name) ) {
+						ReportError(lineNumber, "symbol \"" + tokens[first].Describe() + "\" is already defined");
+						ok = false;
+						dropTokens();
+						continue;
 					}
-				} else { // Either absolute or zero-page
-					auto ltrCom = addrStr.find(',');
-					if( ltrCom == std::string::npos ) { // No comma means no X/Y offset
-						value = parseValue(addrStr);
-						if( GET_HIGH_BYTE(value) != 0 ) {
-							addressing = AddressMode::ABS;
-							pcOffset += 2;
-						} else {
-							addressing = AddressMode::ZPG;
-							pcOffset++;
-						}
-					} else {
-						value = parseValue(addrStr.substr(0, ltrCom));
-						bool isX = addrStr.at(addrStr.length() - 1) == 'X';
-						if( GET_HIGH_BYTE(value) != 0 ) {
-							addressing = isX ? AddressMode::ABX : AddressMode::ABY;
-							pcOffset += 2;
+
+					if( isAssignment ) {
+						Expression expr(symbols, section, lineNumber, pcOffset, false);
+						const auto value = expr.Evaluate(tokens, first + 2, last);
+						if( !value ) {
+							ok = false;
+						} else if( !expr.GetImports().empty() || expr.GetSelector() || (expr.GetBases() != 0 && expr.GetBases() != 1) ) {
+							ReportError(lineNumber, "the value of \"" + tokens[first].Describe() + "\" must be a constant or an address within the module");
+							ok = false;
 						} else {
-							addressing = isX ? AddressMode::ZPX : AddressMode::ZPY;
-							pcOffset++;
+							symbols.emplace(name, Symbol{ static_cast<word>(value.value()), expr.GetBases() == 1 });
 						}
+						dropTokens();
+						continue;
 					}
+
+					symbols.emplace(name, Symbol{ pcOffset, section.relocatable });
+					placed = placed || section.relocatable;
+					pos = isExplicitLabel ? first + 2 : first + 1;
 				}
 			}
 
-			//Branching optimization
-			if( instruction == Instruction::BCC
-				|| instruction == Instruction::BCS
-				|| instruction == Instruction::BEQ
-				|| instruction == Instruction::BMI
-				|| instruction == Instruction::BNE
-				|| instruction == Instruction::BPL
-				|| instruction == Instruction::BVC
-				|| instruction == Instruction::BVS ) {
-				//If we can set to relative, which in almost every case we can,
-				//then we should
-				int diff = static_cast<int>(startingPCOffset) - static_cast<int>(instrPC);
-				if( diff >= -126 && diff <= 129 ) {
-					//Make a signed byte of the relative offset
-					byte rel = diff < 0 ? (256 + diff) & 0xFF : diff & 0x7F;
-					addressing = AddressMode::REL; 
-					value = rel - 2; //Offset by the cycles to execute this instruction
-				}
+			if( pos == last ) {
+				dropTokens();
+				continue; // Only a label
 			}
-			
-			// Find the matching instruction details for the parsed values.
-			const auto instrDetail = FindInstructionDetail(instruction, addressing);
-			if( instrDetail.instruction != Instruction::ILL ) {
-				//Write a program line, notice we only keep actionable lines
-				m_SourceCode.push_back(Line{
-						lineNumber,
-						instrPC,
-						"",			//Raw Source
-						"",			//Comment
-						instrDetail.opCode,
-						instrDetail.instruction,
-						instrDetail.addressing,
-						value
-					});
-
-				// Write the byte code
-				m_ByteCode.push_back(instrDetail.opCode);
-				if( instrDetail.addressing != AddressMode::IMP && instrDetail.addressing != AddressMode::ACC ) {
-					m_ByteCode.push_back(GET_LOW_BYTE(value));
-					if( GET_HIGH_BYTE(value) != 0 )
-						m_ByteCode.push_back(GET_HIGH_BYTE(value));
-				}
 
-				setStartingPC = true;
+			const Token& mnemonic = tokens[pos];
+			const Instruction instruction = FindMnemonic(mnemonic);
+			if( instruction == Instruction::ILL ) {
+				ReportError(lineNumber, "unknown instruction \"" + mnemonic.Describe() + "\"");
+				ok = false;
+				dropTokens();
+				continue;
 			}
-		};
 
-		const auto completeOp = [&]() {
-			if( mode == Mode::ASSIGNMENT ) {
-				const auto value = TrimSpace(tempStr);
+			AddressMode addressing = AddressMode::ILL;
+			size_t operandBegin = 0, operandEnd = 0;
+			if( !ParseOperand(tokens, pos + 1, last, instruction, symbols, section, lineNumber, pcOffset, addressing, operandBegin, operandEnd) ) {
+				ok = false;
+				dropTokens();
+				continue;
+			}
 
-				if( symbol == "*" ) {
-					pcOffset = parseValue(value);
-				} else {
-					auto wordval = parseValue(value);
-					symbols.emplace(symbol, wordval);
-				}
+			const InstructionDetail& detail = FindInstructionDetail(instruction, addressing);
+			if( detail.instruction == Instruction::ILL ) {
+				ReportError(lineNumber, mnemonic.Describe() + " does not support " + GetAddressMnmuemonic(addressing) + " addressing");
+				ok = false;
+				dropTokens();
+				continue;
+			}
 
-				symbol = "";
-			} else if( mode == Mode::INSTRUCTION ) {
-				tempStr = replaceSymbols(tempStr);
-				parseInstruction(tempStr);
-			} else if( mode == Mode::SYMBOL ) {
-				symbols.emplace(symbol, pcOffset);
-				symbol = "";
-			} else if( !tempStr.empty() ) {
-				handleToken(tempStr);
-
-				if( mode == Mode::INSTRUCTION ) // Hanging instruction
-					parseInstruction("");
+			if( static_cast<size_t>(pcOffset) + detail.bytesUsed > 0x10000 ) {
+				ReportError(lineNumber, "instruction runs past the end of the address space");
+				ok = false;
+				dropTokens();
+				continue;
 			}
-		};
 
-		// Walk each character at a time
-		// to effectively normalize the source code
-		// into an easier way to aggregate.
-		// "Tokenizing"
-		for(const char& c : source ) {
-			// Ignore carriage return for new-lines
-			if( c == '\r' ) continue;
-
-			//New lines effectively force the instruction
-			//to be complete.
-			if( c == '\n' ) {
-				if( mode == Mode::COMMENT ) {
-					//Clean first leading space if it exists
-					const auto letter = tempStr.at(0);
-					if( letter == ' ' || letter == '\t' )
-						tempStr = tempStr.substr(1);
-				} else {
-					completeOp();
+			const std::string_view raw = TrimSpace(line);
+			statements.push_back(Statement{
+					lineNumber,
+					pcOffset,
+					static_cast<uint32_t>(raw.data() - source.data()),
+					static_cast<uint32_t>(raw.length()),
+					static_cast<uint32_t>(comment.empty() ? 0 : comment.data() - source.data()),
+					static_cast<uint32_t>(comment.length()),
+					&detail,
+					operandBegin,
+					operandEnd
+				});
+			pcOffset += detail.bytesUsed;
+			placed = placed || section.relocatable;
+		}
+
+		// The names are views of the source, the SymbolTable keeps its own copies
+		m_Symbols.reserve(symbols.size());
+		for( const auto& symbol : symbols ) {
+			std::string name = ToUpper(symbol.first);
+			if( symbol.second.relocatable )
+				m_RelocatableSymbols.insert(name);
+			m_Symbols.emplace(std::move(name), symbol.second.value);
+		}
+		m_Relocatable = section.relocatable;
+
+		// Each symbol imported is kept once, along with its place in m_Imports
+		std::unordered_map<std::string_view, uint32_t, NameHash, NameEqual> imports;
+
+		// Errors in the first pass would only cascade into more in the second
+		if( !ok )
+			return false;
 
-					if( mode == Mode::SYMBOL ) {
-						symbols.emplace(symbol, pcOffset);
+		// Second pass, every symbol is known so the operands can be encoded
+		m_SourceCode.reserve(statements.size());
+
+		// The addresses already holding code, for finding code assembled over
+		std::vector<bool> assembled(0x10000, false);
+		for( const Statement& statement : statements ) {
+			const InstructionDetail& detail = *statement.detail;
+
+			int value = 0;
+			bool relocated = false;
+			if( detail.bytesUsed > 1 ) {
+				const bool relative = detail.addressing == AddressMode::REL;
+				Expression expr(symbols, section, statement.lineNumber, statement.pc, false);
+				const auto result = expr.Evaluate(tokens, statement.operandBegin, statement.operandEnd, relative);
+				if( !result ) {
+					ok = false;
+					continue;
+				}
+				value = result.value();
+
+				// A branch within relocatable code does not depend on where it
+				// is placed, anything else left for the linker is relocated
+				const bool withinModule = relative && section.relocatable && expr.GetBases() == 1 && expr.GetImports().empty() && !expr.GetSelector();
+				relocated = expr.IsLinked() && !withinModule;
+				if( relocated ) {
+					const uint32_t termsBegin = static_cast<uint32_t>(m_RelocationTerms.size());
+					for( const Expression::Import& import : expr.GetImports() ) {
+						const auto found = imports.emplace(import.name, static_cast<uint32_t>(m_Imports.size()));
+						if( found.second )
+							m_Imports.push_back(ToUpper(import.name));
+						m_RelocationTerms.push_back(RelocationTerm{ import.negative, found.first->second });
 					}
+					m_Relocations.push_back(Relocation{
+							static_cast<uint32_t>(m_SourceCode.size()),
+							value,
+							expr.GetBases(),
+							expr.GetSelector(),
+							termsBegin,
+							static_cast<uint32_t>(m_RelocationTerms.size())
+						});
+					value = 0;
 				}
+			}
 
-				// Increment the line number
-				lineNumber++;
-
-				// Reset the states we need to
-				mode = Mode::IDLE;
-				tempStr = "";
-				symbol = "";
-				instruction = Instruction::ILL;
+			std::string error;
+			if( !relocated && !EncodeOperand(detail, statement.pc, value, error) ) {
+				ReportError(statement.lineNumber, error);
+				ok = false;
+				continue;
+			}
 
+			const size_t pc = static_cast<size_t>(statement.pc);
+			if( std::any_of(assembled.begin() + pc, assembled.begin() + pc + detail.bytesUsed, [](const bool b) { return b; }) ) {
+				ReportError(statement.lineNumber, "code at $" + Hex(statement.pc) + " overlaps code already assembled");
+				ok = false;
 				continue;
-			} 
-
-			// Always handle comments first
-			if( mode == Mode::COMMENT ) {
-				tempStr.push_back(c);
-			} else if( c == ';' ) {
-				completeOp();
-
-				mode = Mode::COMMENT;
-				tempStr = "";
-			} else if( mode == Mode::ASSIGNMENT || mode == Mode::INSTRUCTION ) {
-				tempStr.push_back(std::toupper(c));
-			} else if( c == ' ' || c == '\t' ) {
-				// If there is something in the temp str,
-				// then a token has just broken (changed)
-				if( !tempStr.empty() )
-					handleToken(tempStr);
-				tempStr = "";
-			} else if( c == '=' ) {
-				// We are starting an assignment
-				if( !tempStr.empty() )
-					symbol = tempStr;
-				mode = Mode::ASSIGNMENT;
-				tempStr = "";
-			} else if( c == ':' ) { //Explicit label
-				symbols.emplace(tempStr, pcOffset);
-
-				mode = Mode::IDLE;
-				tempStr = "";
-			} else {
-				tempStr.push_back(std::toupper(c));
 			}
+			std::fill(assembled.begin() + pc, assembled.begin() + pc + detail.bytesUsed, true);
+
+			// Code is kept as one block from the lowest address assembled to,
+			// with the gaps left by moving the PC filled with zeros. An origin
+			// below the code so far moves the start of the block down.
+			if( m_ByteCode.empty() ) {
+				m_StartingPCOffset = statement.pc;
+			} else if( statement.pc < m_StartingPCOffset ) {
+				m_ByteCode.insert(m_ByteCode.begin(), m_StartingPCOffset - pc, 0);
+				m_StartingPCOffset = statement.pc;
+			}
+
+			const size_t offset = pc - m_StartingPCOffset;
+			if( m_ByteCode.size() < offset + detail.bytesUsed )
+				m_ByteCode.resize(offset + detail.bytesUsed, 0);
+
+			// Write the byte code
+			m_ByteCode[offset] = detail.opCode;
+			if( detail.bytesUsed > 1 )
+				m_ByteCode[offset + 1] = GET_LOW_BYTE(value);
+			if( detail.bytesUsed > 2 )
+				m_ByteCode[offset + 2] = GET_HIGH_BYTE(value);
+
+			//Write a program line, notice we only keep actionable lines
+			m_SourceCode.push_back(Line{
+					statement.lineNumber,
+					statement.pc,
+					statement.rawOffset,
+					statement.rawLength,
+					statement.commentOffset,
+					statement.commentLength,
+					detail.opCode,
+					detail.instruction,
+					detail.addressing,
+					static_cast<word>(value)
+				});
 		}
 
-		if( !tempStr.empty() || !symbol.empty() )
-			completeOp();
+		return ok;
+	}
 
+	bool Program::EncodeOperand(const InstructionDetail& detail, const int pc, int& value, std::string& outError) {
+		if( detail.bytesUsed < 2 ) {
+			value = 0;
+		} else if( detail.addressing == AddressMode::REL ) {
+			// Offset from the instruction following the branch
+			const int offset = value - (pc + 2);
+			if( offset < -128 || offset > 127 ) {
+				outError = "branch target is " + std::to_string(offset) + " bytes away, out of range of -128 to 127";
+				return false;
+			}
+			value = offset & 0xFF;
+		} else if( detail.addressing == AddressMode::IMM ) {
+			if( value < -128 || value > 0xFF ) {
+				outError = "immediate value " + std::to_string(value) + " does not fit in a byte";
+				return false;
+			}
+			value &= 0xFF;
+		} else if( detail.bytesUsed == 2 && (value < 0 || value > 0xFF) ) {
+			outError = "address " + std::to_string(value) + " is outside of the zero page";
+			return false;
+		} else if( value < 0 || value > 0xFFFF ) {
+			outError = "address " + std::to_string(value) + " is outside of the address space";
+			return false;
+		}
 		return true;
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,250 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "program.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "instructions.h"
+#include "utils.h"
+
+namespace mos6502 {
+	namespace {
+		// The addresses [start, end) taken by a module's code
+		struct Placement {
+			size_t start, end;
+			size_t module;
+		};
+
+		void ReportLinkError(const Program& module, const unsigned int lineNumber, const std::string& message) {
+			std::cerr << "mos6502::Program::Link error in \"" << module.GetName() << "\" on line " << lineNumber << ": " << message << std::endl;
+		}
+	}
+
+	std::optional<progptr> Program::Link(const std::vector<progptr>& modules) {
+		for( const progptr& module : modules ) {
+			if( !module || !module->IsModule() ) {
+				std::cerr << "mos6502::Program::Link was given a program that was not assembled as a module" << std::endl;
+				return std::nullopt;
+			}
+		}
+
+		// The modules placed with "*=" take their addresses first
+		std::vector<size_t> bases(modules.size(), 0);
+		std::vector<Placement> placements;
+		for( size_t i = 0; i < modules.size(); i++ ) {
+			const Program& module = *modules[i];
+			if( module.m_Relocatable || module.m_ByteCode.empty() )
+				continue;
+
+			const size_t start = module.m_StartingPCOffset;
+			placements.push_back(Placement{ start, start + module.m_ByteCode.size(), i });
+		}
+
+		std::sort(placements.begin(), placements.end(), [](const Placement& a, const Placement& b) { return a.start < b.start; });
+		for( size_t i = 1; i < placements.size(); i++ ) {
+			const Placement& previous = placements[i - 1];
+			if( placements[i].start < previous.end ) {
+				std::cerr << "mos6502::Program::Link the code of \"" << modules[placements[i].module]->GetName() << "\" at $" << Hex(static_cast<word>(placements[i].start))
+					<< " overlaps the code of \"" << modules[previous.module]->GetName() << "\"" << std::endl;
+				return std::nullopt;
+			}
+		}
+
+		// Then the relocatable modules go in the first space left large enough
+		for( size_t i = 0; i < modules.size(); i++ ) {
+			const Program& module = *modules[i];
+			if( !module.m_Relocatable )
+				continue;
+
+			const size_t size = module.m_ByteCode.size();
+			size_t start = 0x0200;
+			auto next = placements.begin();
+			for( ; next != placements.end() && next->start < start + size; ++next ) {
+				if( next->end > start )
+					start = next->end;
+			}
+
+			if( start + size > 0x10000 ) {
+				std::cerr << "mos6502::Program::Link there is no room left for the " << size << " bytes of \"" << module.GetName() << "\"" << std::endl;
+				return std::nullopt;
+			}
+
+			// The byte code of a relocatable module starts at offset 0
+			bases[i] = start;
+			if( size > 0 )
+				placements.insert(next, Placement{ start, start + size, i });
+		}
+
+		progptr program = std::make_shared<Program>();
+		if( !modules.empty() )
+			program->m_Name = modules.front()->GetName();
+
+		// Every symbol is global, once its module is placed
+		SymbolTable& symbols = program->m_Symbols;
+		for( size_t i = 0; i < modules.size(); i++ ) {
+			const Program& module = *modules[i];
+			for( const auto& symbol : module.m_Symbols ) {
+				const bool relocatable = module.m_RelocatableSymbols.count(symbol.first) != 0;
+				const word value = static_cast<word>(relocatable ? bases[i] + symbol.second : symbol.second);
+				if( symbols.emplace(symbol.first, value).second )
+					continue;
+
+				for( size_t j = 0; j < i; j++ ) {
+					if( modules[j]->m_Symbols.count(symbol.first) ) {
+						std::cerr << "mos6502::Program::Link the symbol \"" << symbol.first << "\" is defined by both \"" << modules[j]->GetName()
+							<< "\" and \"" << module.GetName() << "\"" << std::endl;
+						break;
+					}
+				}
+				return std::nullopt;
+			}
+		}
+
+		// The byte code is one block, from the lowest module to the end of the highest
+		if( !placements.empty() ) {
+			program->m_StartingPCOffset = static_cast<word>(placements.front().start);
+			program->m_ByteCode.resize(placements.back().end - placements.front().start, 0);
+		}
+		for( const Placement& placement : placements ) {
+			const auto& code = modules[placement.module]->m_ByteCode;
+			std::copy(code.begin(), code.end(), program->m_ByteCode.begin() + (placement.start - program->m_StartingPCOffset));
+		}
+
+		// The lines keep the text of the modules' lines, as an object file does
+		bool ok = true;
+		uint64_t hash = 0;
+		std::vector<int> imports;
+		std::vector<bool> defined;
+		for( size_t i = 0; i < modules.size(); i++ ) {
+			const Program& module = *modules[i];
+			const size_t firstLine = program->m_SourceCode.size();
+			const int offset = module.m_Relocatable ? static_cast<int>(bases[i]) : 0;
+			hash = (hash ^ module.m_SourceHash) * 1099511628211ull;
+
+			for( const Line& line : module.m_SourceCode ) {
+				const uint32_t rawOffset = static_cast<uint32_t>(program->m_SourceStorage.size());
+				program->m_SourceStorage += module.GetRaw(line);
+				const uint32_t commentOffset = static_cast<uint32_t>(program->m_SourceStorage.size());
+				program->m_SourceStorage += module.GetComment(line);
+
+				program->m_SourceCode.push_back(Line{
+						line.lineNumber,
+						line.pcOffset + offset,
+						rawOffset,
+						line.rawLength,
+						commentOffset,
+						line.commentLength,
+						line.opCode,
+						line.instruction,
+						line.addressing,
+						line.value
+					});
+			}
+
+			// Each import is looked up once per module, not once per use
+			imports.assign(module.m_Imports.size(), 0);
+			defined.assign(module.m_Imports.size(), false);
+			for( size_t j = 0; j < module.m_Imports.size(); j++ ) {
+				const auto it = symbols.find(module.m_Imports[j]);
+				if( it != symbols.end() ) {
+					imports[j] = it->second;
+					defined[j] = true;
+				}
+			}
+
+			for( const Relocation& relocation : module.m_Relocations ) {
+				Line& line = program->m_SourceCode[firstLine + relocation.line];
+
+				int value = relocation.addend + relocation.bases * static_cast<int>(bases[i]);
+				bool resolved = true;
+				for( uint32_t t = relocation.termsBegin; t < relocation.termsEnd; t++ ) {
+					const RelocationTerm& term = module.m_RelocationTerms[t];
+					if( !defined[term.import] ) {
+						ReportLinkError(module, line.lineNumber, "undefined symbol \"" + module.m_Imports[term.import] + "\"");
+						resolved = false;
+						break;
+					}
+					value += term.negative ? -imports[term.import] : imports[term.import];
+				}
+				if( !resolved ) {
+					ok = false;
+					continue;
+				}
+
+				if( relocation.selector == '<' )
+					value = GET_LOW_BYTE(value);
+				else if( relocation.selector == '>' )
+					value = GET_HIGH_BYTE(value);
+
+				const InstructionDetail& detail = InstructionDetails[line.opCode];
+				std::string error;
+				if( !EncodeOperand(detail, line.pcOffset, value, error) ) {
+					ReportLinkError(module, line.lineNumber, error);
+					ok = false;
+					continue;
+				}
+
+				// Patch the operand in place
+				const size_t at = static_cast<size_t>(line.pcOffset) - program->m_StartingPCOffset + 1;
+				program->m_ByteCode[at] = GET_LOW_BYTE(value);
+				if( detail.bytesUsed > 2 )
+					program->m_ByteCode[at + 1] = GET_HIGH_BYTE(value);
+				line.value = static_cast<word>(value);
+			}
+		}
+
+		if( !ok )
+			return std::nullopt;
+
+		program->m_SourceHash = hash;
+		return { program };
+	}
+
+	std::optional<progptr> Program::CompileFiles(const std::vector<std::string>& filepaths, const unsigned int threads) {
+		std::vector<progptr> modules(filepaths.size());
+		std::vector<char> assembled(filepaths.size(), 0);
+
+		// The files are independent until linked, each worker takes the next
+		// one not yet started
+		std::atomic<size_t> next{ 0 };
+		const auto work = [&]() {
+			for( size_t i = next++; i < filepaths.size(); i = next++ ) {
+				progptr module = std::make_shared<Program>();
+				assembled[i] = module->CompileModuleFile(filepaths[i]);
+				modules[i] = std::move(module);
+			}
+		};
+
+		const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+		const size_t count = std::min<size_t>(threads ? threads : hardware, filepaths.size());
+
+		// The calling thread is one of the workers
+		std::vector<std::thread> workers;
+		for( size_t i = 1; i < count; i++ )
+			workers.emplace_back(work);
+		work();
+		for( std::thread& worker : workers )
+			worker.join();
+
+		bool ok = true;
+		for( size_t i = 0; i < filepaths.size(); i++ ) {
+			if( !assembled[i] ) {
+				std::cerr << "mos6502::Program::CompileFiles failed to assemble \"" << filepaths[i] << "\"" << std::endl;
+				ok = false;
+			}
+		}
+		if( !ok )
+			return std::nullopt;
+
+		return Link(modules);
+	}
+}
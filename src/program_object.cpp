@@ -0,0 +1,316 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "program.h"
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "instructions.h"
+#include "utils.h"
+
+// Object files are little-endian throughout:
+//	magic "M65O", u16 version, u64 source hash, u16 starting PC
+//	u32 length, name
+//	u32 length, byte code
+//	u32 count, { u16 value, u32 length, name } per symbol
+//	u32 length, text of the lines
+//	u32 count, { u32 line number, u16 pc, u8 opcode, u16 value,
+//	             u32 raw offset, u32 raw length,
+//	             u32 comment offset, u32 comment length } per line
+
+namespace mos6502 {
+	namespace {
+		constexpr char OBJECT_MAGIC[4] = { 'M', '6', '5', 'O' };
+
+		// Bumped whenever the layout changes, older files are reassembled
+		constexpr uint16_t OBJECT_VERSION = 2;
+
+		class ObjectWriter {
+		public:
+			void U8(const byte value) { m_Data.push_back(value); }
+			void U16(const word value) {
+				U8(GET_LOW_BYTE(value));
+				U8(GET_HIGH_BYTE(value));
+			}
+			void U32(const uint32_t value) {
+				U16(static_cast<word>(value));
+				U16(static_cast<word>(value >> 16));
+			}
+			void U64(const uint64_t value) {
+				U32(static_cast<uint32_t>(value));
+				U32(static_cast<uint32_t>(value >> 32));
+			}
+			void Bytes(const byte* data, const size_t length) {
+				U32(static_cast<uint32_t>(length));
+				m_Data.insert(m_Data.end(), data, data + length);
+			}
+			void String(const std::string_view str) {
+				Bytes(reinterpret_cast<const byte*>(str.data()), str.size());
+			}
+
+			const std::vector<byte>& GetData() const { return m_Data; }
+
+		private:
+			std::vector<byte> m_Data;
+		};
+
+		// Reads back what ObjectWriter wrote. Running off the end of the data
+		// (a truncated or corrupt file) fails every read from then on.
+		class ObjectReader {
+		public:
+			ObjectReader(const std::vector<byte>& data) : m_Data(data) {}
+
+			bool IsValid() const { return m_Valid; }
+
+			byte U8() {
+				if( !Has(1) )
+					return 0;
+				return m_Data[m_Pos++];
+			}
+			word U16() {
+				const byte low = U8();
+				const byte high = U8();
+				return static_cast<word>(MAKE_WORD(low, high));
+			}
+			uint32_t U32() {
+				const uint32_t low = U16();
+				return low | static_cast<uint32_t>(U16()) << 16;
+			}
+			uint64_t U64() {
+				const uint64_t low = U32();
+				return low | static_cast<uint64_t>(U32()) << 32;
+			}
+			bool Bytes(std::vector<byte>& out) {
+				const uint32_t length = U32();
+				if( !Has(length) )
+					return false;
+				out.assign(m_Data.begin() + m_Pos, m_Data.begin() + m_Pos + length);
+				m_Pos += length;
+				return true;
+			}
+			template<class StringT>
+			bool String(StringT& out) {
+				const uint32_t length = U32();
+				if( !Has(length) )
+					return false;
+				out.assign(reinterpret_cast<const char*>(m_Data.data()) + m_Pos, length);
+				m_Pos += length;
+				return true;
+			}
+
+		private:
+			bool Has(const size_t length) {
+				if( m_Valid && m_Data.size() - m_Pos < length )
+					m_Valid = false;
+				return m_Valid;
+			}
+
+			const std::vector<byte>& m_Data;
+			size_t m_Pos = 0;
+			bool m_Valid = true;
+		};
+
+		bool ReadFileBytes(const std::string& filepath, std::vector<byte>& out) {
+			std::ifstream file(filepath, std::ios::binary);
+			if( !file )
+				return false;
+			out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return !file.bad();
+		}
+
+		std::string DefaultObjectPath(const std::string& filepath) {
+			return std::filesystem::path(filepath).replace_extension(Program::OBJECT_EXTENSION).string();
+		}
+	}
+
+	uint64_t Program::HashSource(const std::string_view source) {
+		uint64_t hash = 14695981039346656037ull;
+		for( const char c : source )
+			hash = (hash ^ static_cast<byte>(c)) * 1099511628211ull;
+		return hash;
+	}
+
+	bool Program::SaveObject(const std::string& filepath) const {
+		// Relocations are not kept, only linked programs can be saved
+		if( m_Module ) {
+			std::cerr << "mos6502::Program::SaveObject cannot save the module \"" << m_Name << "\" before it is linked" << std::endl;
+			return false;
+		}
+
+		ObjectWriter writer;
+		for( const char c : OBJECT_MAGIC )
+			writer.U8(static_cast<byte>(c));
+		writer.U16(OBJECT_VERSION);
+		writer.U64(m_SourceHash);
+		writer.U16(m_StartingPCOffset);
+		writer.String(m_Name);
+		writer.Bytes(m_ByteCode.data(), m_ByteCode.size());
+
+		writer.U32(static_cast<uint32_t>(m_Symbols.size()));
+		for( const auto& symbol : m_Symbols ) {
+			writer.U16(symbol.second);
+			writer.String(symbol.first);
+		}
+
+		// Only the text of the lines is kept, not the whole of the source
+		std::string text;
+		std::vector<uint32_t> offsets;
+		offsets.reserve(m_SourceCode.size() * 2);
+		for( const Line& line : m_SourceCode ) {
+			offsets.push_back(static_cast<uint32_t>(text.size()));
+			text += GetRaw(line);
+			offsets.push_back(static_cast<uint32_t>(text.size()));
+			text += GetComment(line);
+		}
+		writer.String(text);
+
+		writer.U32(static_cast<uint32_t>(m_SourceCode.size()));
+		for( size_t i = 0; i < m_SourceCode.size(); i++ ) {
+			const Line& line = m_SourceCode[i];
+			writer.U32(line.lineNumber);
+			writer.U16(static_cast<word>(line.pcOffset));
+			writer.U8(line.opCode);
+			writer.U16(line.value);
+			writer.U32(offsets[i * 2]);
+			writer.U32(line.rawLength);
+			writer.U32(offsets[i * 2 + 1]);
+			writer.U32(line.commentLength);
+		}
+
+		// Written aside and moved into place, so that a reader never sees
+		// half of a file
+		const std::string temporary = filepath + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			const std::vector<byte>& data = writer.GetData();
+			if( !file || !file.write(reinterpret_cast<const char*>(data.data()), data.size()) ) {
+				std::cerr << "mos6502::Program::SaveObject failed to write the file \"" << temporary << "\"" << std::endl;
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary, filepath, error);
+		if( error ) {
+			std::cerr << "mos6502::Program::SaveObject failed to replace the file \"" << filepath << "\": " << error.message() << std::endl;
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		return true;
+	}
+
+	bool Program::LoadObject(const std::string& filepath) {
+		std::vector<byte> data;
+		if( !ReadFileBytes(filepath, data) ) {
+			std::cerr << "mos6502::Program::LoadObject failed to read the file \"" << filepath << "\"" << std::endl;
+			return false;
+		}
+
+		ObjectReader reader(data);
+		bool magic = true;
+		for( const char c : OBJECT_MAGIC )
+			magic = reader.U8() == static_cast<byte>(c) && magic;
+		if( !magic || reader.U16() != OBJECT_VERSION ) {
+			std::cerr << "mos6502::Program::LoadObject the file \"" << filepath << "\" is not an object file of this version" << std::endl;
+			return false;
+		}
+
+		Program program;
+		program.m_Path = filepath;
+		program.m_SourceHash = reader.U64();
+		program.m_StartingPCOffset = reader.U16();
+		reader.String(program.m_Name);
+		reader.Bytes(program.m_ByteCode);
+
+		const uint32_t symbolCount = reader.U32();
+		for( uint32_t i = 0; i < symbolCount && reader.IsValid(); i++ ) {
+			const word value = reader.U16();
+			std::string name;
+			if( reader.String(name) )
+				program.m_Symbols.emplace(std::move(name), value);
+		}
+
+		reader.String(program.m_SourceStorage);
+		const size_t textLength = program.m_SourceStorage.size();
+		bool inText = true;
+
+		const uint32_t lineCount = reader.U32();
+		for( uint32_t i = 0; i < lineCount && reader.IsValid(); i++ ) {
+			const unsigned int lineNumber = reader.U32();
+			const word pc = reader.U16();
+			const byte opCode = reader.U8();
+			const word value = reader.U16();
+			const uint32_t rawOffset = reader.U32(), rawLength = reader.U32();
+			const uint32_t commentOffset = reader.U32(), commentLength = reader.U32();
+
+			// Every line must view the text read in
+			inText = inText && rawOffset <= textLength && rawLength <= textLength - rawOffset
+				&& commentOffset <= textLength && commentLength <= textLength - commentOffset;
+
+			const InstructionDetail& detail = InstructionDetails[opCode];
+			program.m_SourceCode.push_back(Line{
+					lineNumber,
+					pc,
+					rawOffset,
+					rawLength,
+					commentOffset,
+					commentLength,
+					opCode,
+					detail.instruction,
+					detail.addressing,
+					value
+				});
+		}
+
+		if( !reader.IsValid() || !inText || program.m_StartingPCOffset + program.m_ByteCode.size() > 0x10000 ) {
+			std::cerr << "mos6502::Program::LoadObject the file \"" << filepath << "\" is truncated or corrupt" << std::endl;
+			return false;
+		}
+
+		*this = std::move(program);
+		return true;
+	}
+
+	std::optional<progptr> Program::LoadObjectFile(const std::string& filepath) {
+		progptr program = std::make_shared<Program>();
+		if( program->LoadObject(filepath) )
+			return { program };
+		return std::nullopt;
+	}
+
+	std::optional<progptr> Program::CompileFileCached(const std::string& filepath, const std::string& objectPath) {
+		const std::string cachePath = objectPath.empty() ? DefaultObjectPath(filepath) : objectPath;
+
+		const auto source = OpenSourceFile(filepath);
+		if( !source )
+			return std::nullopt;
+		const uint64_t hash = HashSource(std::string_view(reinterpret_cast<const char*>(source->GetData()), source->GetSize()));
+
+		progptr program = std::make_shared<Program>();
+		const bool cached = std::filesystem::exists(cachePath) && program->LoadObject(cachePath) && program->m_SourceHash == hash;
+		if( !cached ) {
+			program->m_SourceFile = source;
+			program->m_SourceStorage.clear();
+			if( !program->Assemble(false) )
+				return std::nullopt;
+		}
+
+		const std::filesystem::path path(filepath);
+		program->m_Path = path.string();
+		program->m_Name = path.stem().string();
+		if( cached )
+			return { program };
+
+		// A failure to save only costs the next run the reassembly
+		program->SaveObject(cachePath);
+		return { program };
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "scheduler.h"
+
+#include <algorithm>
+
+namespace mos6502 {
+
+	bool EventScheduler::IsLater(const Event& a, const Event& b) {
+		if (a.cycle != b.cycle)
+			return a.cycle > b.cycle;
+		return a.id > b.id;
+	}
+
+	EventId EventScheduler::Schedule(const uint64_t cycle, EventCallback callback) {
+		const EventId id = m_NextId++;
+		m_Events.push_back(Event{ cycle, id, std::move(callback) });
+		std::push_heap(m_Events.begin(), m_Events.end(), IsLater);
+
+		m_Deadline = m_Events.front().cycle;
+		return id;
+	}
+
+	bool EventScheduler::Cancel(const EventId id) {
+		auto it = std::find_if(m_Events.begin(), m_Events.end(), [id](const Event& e) { return e.id == id; });
+		if (it == m_Events.end())
+			return false;
+
+		// Few events are ever scheduled at once, so simply rebuild the heap
+		m_Events.erase(it);
+		std::make_heap(m_Events.begin(), m_Events.end(), IsLater);
+
+		m_Deadline = m_Events.empty() ? NEVER : m_Events.front().cycle;
+		return true;
+	}
+
+	void EventScheduler::Clear() {
+		m_Events.clear();
+		m_Deadline = NEVER;
+	}
+
+	void EventScheduler::RunDue(const uint64_t cycle) {
+		while (!m_Events.empty() && m_Events.front().cycle <= cycle) {
+			std::pop_heap(m_Events.begin(), m_Events.end(), IsLater);
+			Event due = std::move(m_Events.back());
+			m_Events.pop_back();
+			m_Deadline = m_Events.empty() ? NEVER : m_Events.front().cycle;
+
+			// Taken off first, the callback may schedule and cancel freely
+			due.callback(due.cycle);
+		}
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "system.h"
+
+#include <iostream>
+#include <memory>
+#include <new>
+
+namespace mos6502 {
+
+	namespace {
+		// A shared pointer to an object owned elsewhere. Having no control
+		// block, it allocates nothing and copies of it count nothing.
+		template<class T>
+		std::shared_ptr<T> Unowned(T& object) {
+			return std::shared_ptr<T>(std::shared_ptr<T>(), &object);
+		}
+
+		// The contents of a cleared system. Restoring it only copies the
+		// pages that differ, and the images are kept per thread so that
+		// systems on different threads do not share their reference counts.
+		const MemorySnapshot& GetBlankSnapshot() {
+			thread_local const MemorySnapshot blank = Memory(System::MEMORY_SIZE).Snapshot();
+			return blank;
+		}
+	}
+
+	System::System()
+		: m_Data(), m_Memory(span<byte>(m_Data.data(), m_Data.size())), m_Bus(Unowned(m_Memory)), m_CPU(Unowned(m_Bus)) {
+		Clear();
+	}
+
+	void System::Clear() {
+		m_Memory.Restore(GetBlankSnapshot());
+		m_CPU.Restore(FlatCPU::State{});
+		m_CPU.GetScheduler().Clear();
+	}
+
+	void System::Load(span<const byte> program, const word loadAddress, const word entry) {
+		Clear();
+		m_Memory.WriteBlock(loadAddress, program);
+		m_Memory.WriteWord(ADDRESS_RESET_VECTOR, entry);
+		m_CPU.Reset();
+	}
+
+	SystemPool::SystemPool(const size_t count) {
+		const size_t size = GetArenaSize(count);
+		m_Storage = std::make_unique<byte[]>(size);
+		Place(m_Storage.get(), size);
+	}
+
+	SystemPool::SystemPool(span<byte> arena) {
+		Place(arena.data(), arena.size());
+	}
+
+	SystemPool::~SystemPool() {
+		for (size_t i = 0; i < m_Count; i++)
+			m_Systems[i].~System();
+	}
+
+	void SystemPool::Place(byte* block, const size_t size) {
+		void* start = block;
+		size_t space = size;
+		if (!std::align(alignof(System), sizeof(System), start, space)) {
+			std::cerr << "mos6502::SystemPool::SystemPool the arena is too small to hold a system" << std::endl;
+			return;
+		}
+
+		m_Systems = static_cast<System*>(start);
+		m_Count = space / sizeof(System);
+
+		m_Free.reserve(m_Count);
+		for (size_t i = m_Count; i > 0; i--)
+			m_Free.push_back(new (&m_Systems[i - 1]) System());
+	}
+
+	System* SystemPool::Acquire() {
+		if (m_Free.empty())
+			return nullptr;
+
+		System* system = m_Free.back();
+		m_Free.pop_back();
+		system->Clear();
+		return system;
+	}
+
+	void SystemPool::Release(System* system) {
+		if (system < m_Systems || system >= m_Systems + m_Count) {
+			std::cerr << "mos6502::SystemPool::Release the system does not belong to the pool" << std::endl;
+			return;
+		}
+		m_Free.push_back(system);
+	}
+}
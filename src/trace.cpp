@@ -0,0 +1,79 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace mos6502 {
+
+	TraceBuffer::TraceBuffer(const size_t capacity) {
+		// Round up to a power of two so indices can be masked
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		m_Records.resize(size);
+		m_Mask = size - 1;
+	}
+
+	size_t TraceBuffer::Pop(TraceRecord* out, const size_t maxCount) {
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		const size_t head = m_Head.load(std::memory_order_acquire);
+
+		const size_t count = std::min(head - tail, maxCount);
+		for (size_t i = 0; i < count; i++)
+			out[i] = m_Records[(tail + i) & m_Mask];
+
+		m_Tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	TraceDrain::Sink TraceDrain::MakeStreamSink(std::ostream& os) {
+		return [&os](const TraceRecord* records, size_t count) {
+			os.write(reinterpret_cast<const char*>(records), count * sizeof(TraceRecord));
+		};
+	}
+
+	TraceDrain::TraceDrain(TraceBuffer& buffer, Sink sink, const size_t batchSize)
+		: m_Buffer(buffer), m_Sink(std::move(sink)) {
+		m_Batch.resize(std::max<size_t>(batchSize, 1));
+		m_Thread = std::thread(&TraceDrain::Run, this);
+	}
+
+	TraceDrain::~TraceDrain() {
+		Stop();
+	}
+
+	void TraceDrain::Stop() {
+		m_Running.store(false, std::memory_order_release);
+		if (m_Thread.joinable())
+			m_Thread.join();
+	}
+
+	void TraceDrain::Run() {
+		for (;;) {
+			// Read the flag before popping, so a stop request can never
+			// land between an empty pop and us exiting with data left over.
+			const bool running = m_Running.load(std::memory_order_acquire);
+
+			const size_t count = m_Buffer.Pop(m_Batch.data(), m_Batch.size());
+			if (count > 0 && m_Sink)
+				m_Sink(m_Batch.data(), count);
+
+			if (count == 0) {
+				if (!running)
+					break;
+
+				// Nothing to do, back off instead of spinning a core
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+	}
+}
@@ -0,0 +1,732 @@
+/*
+ *	MOS-6502 Emulator
+ * ===================
+ * Simple emulator recreating the processes of the famous MOS-6502 processor.
+ *
+ * Copyright (c) 2021 Chris Pikul.
+ * MIT License. See file "LICENSE.txt" for full license.
+ */
+#include "wide_cpu.h"
+
+#include "utils.h"
+
+namespace mos6502 {
+
+	namespace {
+		// The whole of each calculation is done for every lane, running or
+		// not, and the lanes that are not running keep what they had. Without
+		// a branch per lane the loops stay vectorizable.
+		inline byte Select(const byte mask, const byte value, const byte otherwise) {
+			return static_cast<byte>((value & mask) | (otherwise & ~mask));
+		}
+
+		inline word Select(const byte mask, const word value, const word otherwise) {
+			return mask ? value : otherwise;
+		}
+
+		// The status with the Zero and Negative flags set from the result
+		inline byte WithNZ(const byte status, const byte result) {
+			return AluStatus(status, AluResult{ result, result, 0, 0 });
+		}
+
+		// Whether the opcode runs in RunVector(). The addressing modes are
+		// those resolved the same way for every instruction, and shifts of
+		// memory are left to the FlatCPU, which keeps their result in the
+		// accumulator.
+		constexpr bool IsVectorized(const InstructionDetail& detail) {
+			switch (detail.addressing) {
+			case AddressMode::ILL:
+			case AddressMode::IND:
+			case AddressMode::INX:
+				return false;
+			default:
+				break;
+			}
+
+			switch (detail.instruction) {
+			case Instruction::ASL:
+			case Instruction::LSR:
+			case Instruction::ROL:
+				return detail.addressing == AddressMode::ACC;
+			case Instruction::ADC: case Instruction::AND: case Instruction::BIT:
+			case Instruction::CMP: case Instruction::CPX: case Instruction::CPY:
+			case Instruction::EOR: case Instruction::ORA: case Instruction::SBC:
+			case Instruction::LDA: case Instruction::LDX: case Instruction::LDY:
+			case Instruction::STA: case Instruction::STX: case Instruction::STY:
+			case Instruction::INC: case Instruction::DEC:
+			case Instruction::INX: case Instruction::INY:
+			case Instruction::DEX: case Instruction::DEY:
+			case Instruction::TAX: case Instruction::TAY: case Instruction::TSX:
+			case Instruction::TXA: case Instruction::TXS: case Instruction::TYA:
+			case Instruction::CLC: case Instruction::SEC: case Instruction::CLD:
+			case Instruction::SED: case Instruction::CLI: case Instruction::SEI:
+			case Instruction::CLV: case Instruction::NOP:
+			case Instruction::BCC: case Instruction::BCS: case Instruction::BEQ:
+			case Instruction::BMI: case Instruction::BNE: case Instruction::BPL:
+			case Instruction::BVC: case Instruction::BVS:
+			case Instruction::JMP: case Instruction::JSR: case Instruction::RTS:
+			case Instruction::PHA: case Instruction::PHP:
+			case Instruction::PLA: case Instruction::PLP:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		template<size_t... OpCodes>
+		constexpr std::array<bool, 256> MakeVectorizedTable(std::index_sequence<OpCodes...>) {
+			return { { IsVectorized(InstructionDetails[OpCodes])... } };
+		}
+
+		constexpr std::array<bool, 256> Vectorized = MakeVectorizedTable(std::make_index_sequence<256>{});
+
+		// Whether the instruction uses the byte its addressing mode points at
+		constexpr bool ReadsOperand(const Instruction instruction) {
+			switch (instruction) {
+			case Instruction::ADC: case Instruction::AND: case Instruction::BIT:
+			case Instruction::CMP: case Instruction::CPX: case Instruction::CPY:
+			case Instruction::EOR: case Instruction::ORA: case Instruction::SBC:
+			case Instruction::LDA: case Instruction::LDX: case Instruction::LDY:
+			case Instruction::INC: case Instruction::DEC:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// The flag a branch tests, and the value it branches on
+		constexpr std::pair<byte, bool> BranchCondition(const Instruction instruction) {
+			switch (instruction) {
+			case Instruction::BCC: return { ALU_CARRY, false };
+			case Instruction::BCS: return { ALU_CARRY, true };
+			case Instruction::BNE: return { ALU_ZERO, false };
+			case Instruction::BEQ: return { ALU_ZERO, true };
+			case Instruction::BPL: return { ALU_NEGATIVE, false };
+			case Instruction::BMI: return { ALU_NEGATIVE, true };
+			case Instruction::BVC: return { ALU_OVERFLOW, false };
+			default: return { ALU_OVERFLOW, true };
+			}
+		}
+	}
+
+	double WideStats::GetVectorFraction() const {
+		const uint64_t total = vectorLaneInstructions + scalarInstructions;
+		return total ? static_cast<double>(vectorLaneInstructions) / static_cast<double>(total) : 0.0;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const WideStats& stats) {
+		const double lanes = stats.vectorInstructions
+			? static_cast<double>(stats.vectorLaneInstructions) / static_cast<double>(stats.vectorInstructions)
+			: 0.0;
+
+		os << std::dec << "vector " << stats.vectorInstructions << " (" << lanes << " lanes each)";
+		os << ", scalar " << stats.scalarInstructions;
+		os << ", fallbacks " << stats.fallbacks;
+		os << ", divergences " << stats.divergences;
+		os << ", reconvergences " << stats.reconvergences;
+		os << ", " << (stats.GetVectorFraction() * 100.0) << "% vectorized";
+		return os;
+	}
+
+	template<size_t Lanes>
+	WideCPU<Lanes>::WideCPU() : m_Pool(Lanes) {
+		for (size_t i = 0; i < Lanes; i++) {
+			m_Lanes[i] = m_Pool.Acquire();
+			m_Data[i] = m_Lanes[i]->GetMemory().GetData();
+			m_StopReasons[i] = StopReason::NONE;
+		}
+	}
+
+	template<size_t Lanes>
+	void WideCPU<Lanes>::Load(span<const byte> program, const word loadAddress, const word entry) {
+		for (System* lane : m_Lanes)
+			lane->Load(program, loadAddress, entry);
+	}
+
+	template<size_t Lanes>
+	void WideCPU<Lanes>::Run(const uint64_t cycleBudget) {
+		for (size_t i = 0; i < Lanes; i++) {
+			m_Start[i] = m_Lanes[i]->GetCPU().GetCyclesExecuted();
+			m_End[i] = m_Start[i] + cycleBudget;
+			m_StopReasons[i] = StopReason::BUDGET;
+			m_Running[i] = cycleBudget > 0 ? 0xFF : 0;
+		}
+
+		bool apart = false;
+		while (IsRunning()) {
+			word pc = 0;
+			if (!IsConverged(pc)) {
+				// Those furthest behind catch up first, so that lanes split by
+				// a branch over some code meet again at its end
+				word lowest = 0xFFFF;
+				for (size_t i = 0; i < Lanes; i++) {
+					if (m_Running[i] && m_Lanes[i]->GetCPU().GetProgramCounter() < lowest)
+						lowest = m_Lanes[i]->GetCPU().GetProgramCounter();
+				}
+				for (size_t i = 0; i < Lanes; i++) {
+					if (m_Running[i] && m_Lanes[i]->GetCPU().GetProgramCounter() == lowest)
+						StepLane(i);
+				}
+				continue;
+			}
+
+			if (apart) {
+				m_Stats.reconvergences++;
+				apart = false;
+			}
+
+			if (CanVectorize()) {
+				const VectorExit exit = RunVector(pc);
+				if (exit == VectorExit::SPLIT) {
+					m_Stats.divergences++;
+					apart = true;
+					continue;
+				} else if (exit == VectorExit::DONE) {
+					break;
+				}
+			}
+
+			// Together on an instruction that has to be run lane by lane
+			m_Stats.fallbacks++;
+			for (size_t i = 0; i < Lanes; i++) {
+				if (m_Running[i])
+					StepLane(i);
+			}
+			if (IsRunning() && !IsConverged(pc)) {
+				m_Stats.divergences++;
+				apart = true;
+			}
+		}
+
+		for (size_t i = 0; i < Lanes; i++)
+			m_Consumed[i] = m_Lanes[i]->GetCPU().GetCyclesExecuted() - m_Start[i];
+	}
+
+	template<size_t Lanes>
+	bool WideCPU<Lanes>::IsConverged(word& outPC) const {
+		bool found = false;
+		for (size_t i = 0; i < Lanes; i++) {
+			if (!m_Running[i])
+				continue;
+
+			const word pc = m_Lanes[i]->GetCPU().GetProgramCounter();
+			if (found && pc != outPC)
+				return false;
+			outPC = pc;
+			found = true;
+		}
+		return found;
+	}
+
+	template<size_t Lanes>
+	bool WideCPU<Lanes>::CanVectorize() {
+		for (size_t i = 0; i < Lanes; i++) {
+			if (!m_Running[i])
+				continue;
+
+			FlatCPU& cpu = m_Lanes[i]->GetCPU();
+			if (cpu.GetBreakpoints() || cpu.GetJournal() || cpu.HasPendingInterrupt() || cpu.Snapshot().cyclesRem != 0)
+				return false;
+#ifdef MOS6502_TRACE
+			if (cpu.GetTrace())
+				return false;
+#endif
+#ifdef MOS6502_PROFILE
+			if (cpu.GetProfile())
+				return false;
+#endif
+			// Events due are run by StepLane()
+			if (cpu.GetCyclesExecuted() >= cpu.GetScheduler().GetNextDeadline())
+				return false;
+		}
+		return true;
+	}
+
+	template<size_t Lanes>
+	void WideCPU<Lanes>::Gather() {
+		for (size_t i = 0; i < Lanes; i++) {
+			FlatCPU& cpu = m_Lanes[i]->GetCPU();
+			const FlatCPU::State state = cpu.Snapshot();
+			m_PC[i] = state.pc;
+			m_SP[i] = state.sp;
+			m_A[i] = state.acc;
+			m_X[i] = state.x;
+			m_Y[i] = state.y;
+			m_P[i] = state.status.value;
+			m_Cycles[i] = state.cyclesExecuted;
+			m_Instructions[i] = state.instructionsExecuted;
+			m_Deadline[i] = cpu.GetScheduler().GetNextDeadline();
+			m_PendingIRQ[i] = state.pendingIRQ;
+		}
+	}
+
+	template<size_t Lanes>
+	void WideCPU<Lanes>::Scatter() {
+		for (size_t i = 0; i < Lanes; i++) {
+			FlatCPU& cpu = m_Lanes[i]->GetCPU();
+			FlatCPU::State state = cpu.Snapshot();
+			state.pc = m_PC[i];
+			state.sp = m_SP[i];
+			state.acc = m_A[i];
+			state.x = m_X[i];
+			state.y = m_Y[i];
+			state.status = m_P[i];
+			state.cyclesExecuted = m_Cycles[i];
+			state.instructionsExecuted = m_Instructions[i];
+			cpu.Restore(state);
+		}
+	}
+
+	template<size_t Lanes>
+	typename WideCPU<Lanes>::VectorExit WideCPU<Lanes>::RunVector(word pc) {
+		Gather();
+
+		VectorExit exit = VectorExit::FALLBACK;
+		for (;;) {
+			bool split = false;
+			if (!StepVector(pc, split))
+				break;
+
+			RetireLanes();
+			if (!IsRunning()) {
+				exit = VectorExit::DONE;
+				break;
+			}
+			if (split) {
+				exit = VectorExit::SPLIT;
+				break;
+			}
+
+			// The lanes go one at a time to run the events due, or to stop
+			// for an IRQ that interrupts have just been enabled for
+			bool due = false;
+			for (size_t i = 0; i < Lanes; i++)
+				due |= m_Running[i] && (m_Cycles[i] >= m_Deadline[i] || (m_PendingIRQ[i] && !(m_P[i] & ALU_INTERRUPT)));
+			if (due)
+				break;
+		}
+
+		Scatter();
+		return exit;
+	}
+
+	template<size_t Lanes>
+	bool WideCPU<Lanes>::StepVector(word& pc, bool& outSplit) {
+		size_t first = 0;
+		while (!m_Running[first])
+			first++;
+
+		const byte opcode = m_Data[first][pc];
+		if (!Vectorized[opcode])
+			return false;
+
+		const InstructionDetail& detail = InstructionDetails[opcode];
+		const byte low = m_Data[first][static_cast<word>(pc + 1)];
+		const byte high = m_Data[first][static_cast<word>(pc + 2)];
+
+		// Every lane has to be running the same code, decimal arithmetic is
+		// left to the FlatCPU
+		const bool decimal = detail.instruction == Instruction::ADC || detail.instruction == Instruction::SBC;
+		for (size_t i = first; i < Lanes; i++) {
+			if (!m_Running[i])
+				continue;
+
+			const byte* data = m_Data[i];
+			if (data[pc] != opcode
+				|| (detail.bytesUsed > 1 && data[static_cast<word>(pc + 1)] != low)
+				|| (detail.bytesUsed > 2 && data[static_cast<word>(pc + 2)] != high))
+				return false;
+			if (decimal && (m_P[i] & ALU_DECIMAL))
+				return false;
+		}
+
+		const word operand = MAKE_WORD(low, high);
+		const word next = static_cast<word>(pc + detail.bytesUsed);
+
+		// Addressing, the address (or value) and cycle cost of each lane
+		alignas(64) std::array<word, Lanes> ea{};
+		alignas(64) std::array<byte, Lanes> value{};
+		alignas(64) std::array<byte, Lanes> cycles{};
+		bool memory = true;
+		switch (detail.addressing) {
+		case AddressMode::IMP:
+		case AddressMode::ACC:
+			value = m_A;
+			cycles.fill(1);
+			memory = false;
+			break;
+		case AddressMode::IMM:
+			value.fill(low);
+			cycles.fill(1);
+			memory = false;
+			break;
+		case AddressMode::REL:
+			cycles.fill(1);
+			memory = false;
+			break;
+		case AddressMode::ZPG:
+			ea.fill(low);
+			cycles.fill(2);
+			break;
+		case AddressMode::ZPX:
+			for (size_t i = 0; i < Lanes; i++)
+				ea[i] = static_cast<byte>(low + m_X[i]);
+			cycles.fill(3);
+			break;
+		case AddressMode::ZPY:
+			for (size_t i = 0; i < Lanes; i++)
+				ea[i] = static_cast<byte>(low + m_Y[i]);
+			cycles.fill(3);
+			break;
+		case AddressMode::ABS:
+			ea.fill(operand);
+			cycles.fill(3);
+			break;
+		case AddressMode::ABX:
+			for (size_t i = 0; i < Lanes; i++) {
+				ea[i] = static_cast<word>(operand + m_X[i]);
+				cycles[i] = GET_HIGH_BYTE(ea[i]) != high ? 4 : 3;
+			}
+			break;
+		case AddressMode::ABY:
+			for (size_t i = 0; i < Lanes; i++) {
+				ea[i] = static_cast<word>(operand + m_Y[i]);
+				cycles[i] = GET_HIGH_BYTE(ea[i]) != high ? 4 : 3;
+			}
+			break;
+		case AddressMode::INY:
+			for (size_t i = 0; i < Lanes; i++) {
+				if (!m_Running[i])
+					continue;
+
+				const byte pointerHigh = m_Data[i][static_cast<byte>(low + 1)];
+				ea[i] = static_cast<word>(MAKE_WORD(m_Data[i][low], pointerHigh) + m_Y[i]);
+				cycles[i] = GET_HIGH_BYTE(ea[i]) != pointerHigh ? 5 : 4;
+			}
+			break;
+		default:
+			return false;
+		}
+
+		if (memory && ReadsOperand(detail.instruction)) {
+			for (size_t i = 0; i < Lanes; i++) {
+				if (m_Running[i])
+					value[i] = m_Data[i][ea[i]];
+			}
+		}
+
+		// The cost of the instruction itself, added on below
+		byte cost = 1;
+
+		// The program counter is the same for every lane afterwards, unless
+		// this is set
+		bool perLane = false;
+		alignas(64) std::array<word, Lanes> nextPC{};
+
+		switch (detail.instruction) {
+		case Instruction::ADC:
+		case Instruction::SBC: {
+			// Subtraction adds the one's complement (see AluSubtract)
+			const byte flip = detail.instruction == Instruction::SBC ? 0xFF : 0x00;
+			for (size_t i = 0; i < Lanes; i++) {
+				const AluResult result = AluAdd(m_A[i], static_cast<byte>(value[i] ^ flip), m_P[i] & ALU_CARRY);
+				m_A[i] = Select(m_Running[i], result.value, m_A[i]);
+				m_P[i] = Select(m_Running[i], AluStatus(m_P[i], result), m_P[i]);
+			}
+			break;
+		}
+		case Instruction::AND:
+			for (size_t i = 0; i < Lanes; i++) {
+				const byte result = m_A[i] & value[i];
+				m_A[i] = Select(m_Running[i], result, m_A[i]);
+				m_P[i] = Select(m_Running[i], WithNZ(m_P[i], result), m_P[i]);
+			}
+			break;
+		case Instruction::ORA:
+			for (size_t i = 0; i < Lanes; i++) {
+				const byte result = m_A[i] | value[i];
+				m_A[i] = Select(m_Running[i], result, m_A[i]);
+				m_P[i] = Select(m_Running[i], WithNZ(m_P[i], result), m_P[i]);
+			}
+			break;
+		case Instruction::EOR:
+			for (size_t i = 0; i < Lanes; i++) {
+				const byte result = m_A[i] ^ value[i];
+				m_A[i] = Select(m_Running[i], result, m_A[i]);
+				m_P[i] = Select(m_Running[i], WithNZ(m_P[i], result), m_P[i]);
+			}
+			break;
+		case Instruction::BIT:
+			for (size_t i = 0; i < Lanes; i++)
+				m_P[i] = Select(m_Running[i], AluStatus(m_P[i], AluBitTest(m_A[i], value[i])), m_P[i]);
+			break;
+		case Instruction::CMP:
+		case Instruction::CPX:
+		case Instruction::CPY: {
+			const std::array<byte, Lanes>& reg = detail.instruction == Instruction::CMP ? m_A
+				: detail.instruction == Instruction::CPX ? m_X : m_Y;
+			for (size_t i = 0; i < Lanes; i++)
+				m_P[i] = Select(m_Running[i], AluStatus(m_P[i], AluCompare(reg[i], value[i])), m_P[i]);
+			break;
+		}
+		case Instruction::ASL:
+		case Instruction::LSR:
+		case Instruction::ROL: {
+			const Instruction instruction = detail.instruction;
+			for (size_t i = 0; i < Lanes; i++) {
+				const AluResult result = instruction == Instruction::ASL ? AluShiftLeft(value[i])
+					: instruction == Instruction::LSR ? AluShiftRight(value[i])
+					: AluRotateLeft(value[i], m_P[i] & ALU_CARRY);
+				m_A[i] = Select(m_Running[i], result.value, m_A[i]);
+				m_P[i] = Select(m_Running[i], AluStatus(m_P[i], result), m_P[i]);
+			}
+			break;
+		}
+		case Instruction::INC:
+		case Instruction::DEC: {
+			const bool increment = detail.instruction == Instruction::INC;
+			for (size_t i = 0; i < Lanes; i++) {
+				if (!m_Running[i])
+					continue;
+
+				const AluResult result = increment ? AluIncrement(value[i]) : AluDecrement(value[i]);
+				m_Lanes[i]->GetBus().WriteByte(ea[i], result.value);
+				m_P[i] = AluStatus(m_P[i], result);
+			}
+			cost = 3;
+			break;
+		}
+		case Instruction::LDA:
+		case Instruction::LDX:
+		case Instruction::LDY: {
+			std::array<byte, Lanes>& reg = detail.instruction == Instruction::LDA ? m_A
+				: detail.instruction == Instruction::LDX ? m_X : m_Y;
+			for (size_t i = 0; i < Lanes; i++) {
+				reg[i] = Select(m_Running[i], value[i], reg[i]);
+				m_P[i] = Select(m_Running[i], WithNZ(m_P[i], value[i]), m_P[i]);
+			}
+			break;
+		}
+		case Instruction::STA:
+		case Instruction::STX:
+		case Instruction::STY: {
+			const std::array<byte, Lanes>& reg = detail.instruction == Instruction::STA ? m_A
+				: detail.instruction == Instruction::STX ? m_X : m_Y;
+			for (size_t i = 0; i < Lanes; i++) {
+				if (m_Running[i])
+					m_Lanes[i]->GetBus().WriteByte(ea[i], reg[i]);
+			}
+			break;
+		}
+		case Instruction::INX:
+		case Instruction::DEX:
+		case Instruction::INY:
+		case Instruction::DEY: {
+			const bool x = detail.instruction == Instruction::INX || detail.instruction == Instruction::DEX;
+			const bool increment = detail.instruction == Instruction::INX || detail.instruction == Instruction::INY;
+			std::array<byte, Lanes>& reg = x ? m_X : m_Y;
+			for (size_t i = 0; i < Lanes; i++) {
+				const AluResult result = increment ? AluIncrement(reg[i]) : AluDecrement(reg[i]);
+				reg[i] = Select(m_Running[i], result.value, reg[i]);
+				m_P[i] = Select(m_Running[i], AluStatus(m_P[i], result), m_P[i]);
+			}
+			break;
+		}
+		case Instruction::TAX:
+		case Instruction::TAY:
+		case Instruction::TSX:
+		case Instruction::TXA:
+		case Instruction::TYA: {
+			const std::array<byte, Lanes>& from = detail.instruction == Instruction::TSX ? m_SP
+				: detail.instruction == Instruction::TXA ? m_X
+				: detail.instruction == Instruction::TYA ? m_Y : m_A;
+			std::array<byte, Lanes>& to = detail.instruction == Instruction::TAX || detail.instruction == Instruction::TSX ? m_X
+				: detail.instruction == Instruction::TAY ? m_Y : m_A;
+			for (size_t i = 0; i < Lanes; i++) {
+				const byte result = from[i];
+				to[i] = Select(m_Running[i], result, to[i]);
+				m_P[i] = Select(m_Running[i], WithNZ(m_P[i], result), m_P[i]);
+			}
+			break;
+		}
+		case Instruction::TXS:
+			for (size_t i = 0; i < Lanes; i++)
+				m_SP[i] = Select(m_Running[i], m_X[i], m_SP[i]);
+			break;
+		case Instruction::CLC:
+		case Instruction::SEC:
+		case Instruction::CLD:
+		case Instruction::SED:
+		case Instruction::CLI:
+		case Instruction::SEI:
+		case Instruction::CLV: {
+			const Instruction instruction = detail.instruction;
+			const byte flag = instruction == Instruction::CLC || instruction == Instruction::SEC ? ALU_CARRY
+				: instruction == Instruction::CLD || instruction == Instruction::SED ? ALU_DECIMAL
+				: instruction == Instruction::CLV ? ALU_OVERFLOW : ALU_INTERRUPT;
+			const byte set = instruction == Instruction::SEC || instruction == Instruction::SED || instruction == Instruction::SEI ? flag : 0;
+			for (size_t i = 0; i < Lanes; i++)
+				m_P[i] = Select(m_Running[i], static_cast<byte>((m_P[i] & ~flag) | set), m_P[i]);
+			break;
+		}
+		case Instruction::NOP:
+			break;
+		case Instruction::BCC:
+		case Instruction::BCS:
+		case Instruction::BEQ:
+		case Instruction::BMI:
+		case Instruction::BNE:
+		case Instruction::BPL:
+		case Instruction::BVC:
+		case Instruction::BVS: {
+			// Widened before sign extending, so backward branches work
+			const word target = static_cast<word>(next + static_cast<int8_t>(low));
+			const byte takenCost = GET_HIGH_BYTE(target) != GET_HIGH_BYTE(next) ? 3 : 2;
+			const auto condition = BranchCondition(detail.instruction);
+			for (size_t i = 0; i < Lanes; i++) {
+				const bool taken = ((m_P[i] & condition.first) != 0) == condition.second;
+				nextPC[i] = taken ? target : next;
+				cycles[i] += taken ? takenCost : 1;
+			}
+			cost = 0;
+			perLane = true;
+			break;
+		}
+		case Instruction::JMP:
+			nextPC.fill(operand);
+			break;
+		case Instruction::JSR: {
+			// The address of the last byte of the JSR goes on the stack
+			const word ret = static_cast<word>(next - 1);
+			for (size_t i = 0; i < Lanes; i++) {
+				if (!m_Running[i])
+					continue;
+
+				FlatMemoryBus& bus = m_Lanes[i]->GetBus();
+				bus.WriteByte(StackAddress(m_SP[i]), GET_HIGH_BYTE(ret));
+				bus.WriteByte(StackAddress(StackPushed(m_SP[i])), GET_LOW_BYTE(ret));
+				m_SP[i] = StackPushed(StackPushed(m_SP[i]));
+			}
+			nextPC.fill(operand);
+			cost = 3;
+			break;
+		}
+		case Instruction::RTS:
+			for (size_t i = 0; i < Lanes; i++) {
+				const byte sp = StackPulled(m_SP[i]);
+				const byte low = m_Data[i][StackAddress(sp)];
+				const byte high = m_Data[i][StackAddress(StackPulled(sp))];
+				nextPC[i] = static_cast<word>(MAKE_WORD(low, high) + 1);
+				m_SP[i] = Select(m_Running[i], StackPulled(sp), m_SP[i]);
+			}
+			cost = 5;
+			perLane = true;
+			break;
+		case Instruction::PHA:
+		case Instruction::PHP: {
+			const std::array<byte, Lanes>& reg = detail.instruction == Instruction::PHA ? m_A : m_P;
+			for (size_t i = 0; i < Lanes; i++) {
+				if (!m_Running[i])
+					continue;
+
+				m_Lanes[i]->GetBus().WriteByte(StackAddress(m_SP[i]), reg[i]);
+				m_SP[i] = StackPushed(m_SP[i]);
+			}
+			cost = 2;
+			break;
+		}
+		case Instruction::PLA:
+		case Instruction::PLP:
+			for (size_t i = 0; i < Lanes; i++) {
+				const byte sp = StackPulled(m_SP[i]);
+				const byte pulled = m_Data[i][StackAddress(sp)];
+				if (detail.instruction == Instruction::PLA) {
+					m_A[i] = Select(m_Running[i], pulled, m_A[i]);
+					m_P[i] = Select(m_Running[i], WithNZ(m_P[i], pulled), m_P[i]);
+				} else {
+					m_P[i] = Select(m_Running[i], StatusWithUnused(pulled), m_P[i]);
+				}
+				m_SP[i] = Select(m_Running[i], sp, m_SP[i]);
+			}
+			cost = 3;
+			break;
+		default:
+			// Not reached, Vectorized holds only the instructions above
+			return false;
+		}
+
+		// Jumps give every lane the same program counter, the rest go on to
+		// the next instruction
+		if (detail.instruction == Instruction::JMP || detail.instruction == Instruction::JSR)
+			pc = operand;
+		else if (!perLane)
+			pc = next;
+
+		if (perLane) {
+			pc = nextPC[first];
+			for (size_t i = first + 1; i < Lanes; i++)
+				outSplit |= m_Running[i] && nextPC[i] != pc;
+		} else {
+			nextPC.fill(pc);
+		}
+
+		unsigned int lanes = 0;
+		for (size_t i = 0; i < Lanes; i++) {
+			const byte running = m_Running[i] & 1;
+			m_PC[i] = Select(m_Running[i], nextPC[i], m_PC[i]);
+			m_Cycles[i] += running * (cycles[i] + cost);
+			m_Instructions[i] += running;
+			lanes += running;
+		}
+
+		m_Stats.vectorInstructions++;
+		m_Stats.vectorLaneInstructions += lanes;
+		return true;
+	}
+
+	template<size_t Lanes>
+	void WideCPU<Lanes>::StepLane(const size_t lane) {
+		FlatCPU& cpu = m_Lanes[lane]->GetCPU();
+
+		// As in FlatCPU::Run(), the events due go first, and an interrupt they
+		// (or anything before them) raise stops the lane rather than being
+		// serviced, other than before its first instruction
+		EventScheduler& scheduler = cpu.GetScheduler();
+		if (cpu.GetCyclesExecuted() >= scheduler.GetNextDeadline())
+			scheduler.RunDue(cpu.GetCyclesExecuted());
+		if (cpu.GetCyclesExecuted() > m_Start[lane] && cpu.HasPendingInterrupt()) {
+			m_StopReasons[lane] = StopReason::INTERRUPT;
+			m_Running[lane] = 0;
+			return;
+		}
+
+		cpu.Run(1);
+		m_Stats.scalarInstructions++;
+
+		const StopReason reason = cpu.GetStopReason();
+		if (reason != StopReason::BUDGET) {
+			m_StopReasons[lane] = reason;
+			m_Running[lane] = 0;
+		} else if (cpu.GetCyclesExecuted() >= m_End[lane]) {
+			m_Running[lane] = 0;
+		}
+	}
+
+	template<size_t Lanes>
+	void WideCPU<Lanes>::RetireLanes() {
+		for (size_t i = 0; i < Lanes; i++)
+			m_Running[i] = Select(m_Running[i], static_cast<byte>(m_Cycles[i] < m_End[i] ? 0xFF : 0), m_Running[i]);
+	}
+
+	template<size_t Lanes>
+	bool WideCPU<Lanes>::IsRunning() const {
+		byte any = 0;
+		for (size_t i = 0; i < Lanes; i++)
+			any |= m_Running[i];
+		return any != 0;
+	}
+
+	// Explicit instantiations for the supported widths (see wide_cpu.h)
+	template class WideCPU<8>;
+	template class WideCPU<16>;
+}